@@ -30,215 +30,33 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include "BenchtopBrushless200.h"
-
-#include "DLLAccess.h"
+#include "MotorFamily.h"
 
 #include "Thorlabs.MotionControl.Benchtop.BrushlessMotor.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.Benchtop.BrushlessMotor.dll" };
-
-
-bool
-BenchtopBrushless200Access::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-BenchtopBrushless200Access::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopBrushless200Access::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-BenchtopBrushless200Access::Kinesis_GetNumChannels() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetNumChannels, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_RequestSettings, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_RequestStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-bool
-BenchtopBrushless200::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_StartPolling, func);
-    return func(CSerialNo(), Channel(), intervalMs);
-}
-
-
-void
-BenchtopBrushless200::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_StopPolling, func);
-    func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetHardwareInfo, func);
-
-    short shortNumChannels;
-
-    short ret = func(CSerialNo(), Channel(), modelNo, sizeOfModelNo,
-        type, &shortNumChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-
-    *numChannels = shortNumChannels;
-
-    return ret;
-}
-
-
-DWORD
-BenchtopBrushless200::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_EnableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_DisableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopBrushless200::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetMotorTravelMode, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_SetMotorTravelMode, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-BenchtopBrushless200::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_ResetRotationModes, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_SetRotationModes, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-short
-BenchtopBrushless200::Kinesis_SetHomingParams(int direction, int limitSwitchMode, int offsetDistance, int velocity)
-{
-    STATIC_DLL_FUNC(kinesisDll, BMC_SetHomingParamsBlock, func);
-    MOT_HomingParameters params;
-    params.direction = (MOT_TravelDirection)direction;
-    params.limitSwitch = (MOT_HomeLimitSwitchDirection)limitSwitchMode;
-    params.offsetDistance = offsetDistance;
-    params.velocity = velocity;
-
-    return func(CSerialNo(), Channel(), &params);
-}
-
-short
-BenchtopBrushless200::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_RequestPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopBrushless200::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-long
-BenchtopBrushless200::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetPositionCounter, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_MoveToPosition, func);
-    return func(CSerialNo(), Channel(), index);
-}
-
-
-bool
-BenchtopBrushless200::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_CanHome, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_Home, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless200::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), Channel(), deviceUnits, realValue, unitType);
-}
-
-
-short
-BenchtopBrushless200::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), Channel(), realValue, deviceUnits, unitType);
-}
-
-
-long
-BenchtopBrushless200::Kinesis_GetEncoderCounter() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetEncoderCounter, func);
-    return func(CSerialNo(), Channel());
+namespace {
+    struct BenchtopBrushless200Traits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.Benchtop.BrushlessMotor.dll";
+        }
+        static constexpr bool isMultiChannel = true;
+
+        struct Functions : FunctionTable {
+            KINESIS_DEVICE_FUNCTIONS(BMC);
+            KINESIS_MULTICHANNEL_FUNCTIONS(BMC);
+            KINESIS_MOTOR_FUNCTIONS(BMC);
+            KINESIS_ROTATION_MODE_FUNCTIONS(BMC);
+            KINESIS_HOMING_PARAMS_FUNCTIONS(BMC);
+            KINESIS_ENCODER_FUNCTIONS(BMC);
+            KINESIS_VELOCITY_PARAMS_FUNCTIONS(BMC);
+            KINESIS_MESSAGE_QUEUE_FUNCTIONS(BMC);
+        };
+    };
+} // namespace
+
+
+MotorFamilyEntry const&
+BenchtopBrushless200Family() {
+    return MotorFamily<BenchtopBrushless200Traits>::Entry();
 }
@@ -0,0 +1,735 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "Broker.h"
+
+#include "Connections.h"
+
+#include <sddl.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+    std::mutex activeClientMutex;
+    std::shared_ptr<BrokerClient> activeClient; // Guarded by activeClientMutex
+
+    // A security descriptor whose DACL grants access only to the user
+    // running this process (to be freed with LocalFree()); null on error
+    PSECURITY_DESCRIPTOR
+    MakeCurrentUserSecurityDescriptor() {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+            return nullptr;
+        DWORD size = 0;
+        GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+        std::vector<char> tokenUser(size);
+        char* sid = nullptr;
+        bool const gotSid = size > 0 &&
+            GetTokenInformation(token, TokenUser, tokenUser.data(), size, &size) &&
+            ConvertSidToStringSidA(
+                reinterpret_cast<TOKEN_USER*>(tokenUser.data())->User.Sid, &sid);
+        CloseHandle(token);
+        if (!gotSid)
+            return nullptr;
+
+        // Protected DACL with a single entry: generic all to the user
+        std::string const sddl = std::string("D:P(A;;GA;;;") + sid + ")";
+        LocalFree(sid);
+        PSECURITY_DESCRIPTOR descriptor = nullptr;
+        if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(),
+                SDDL_REVISION_1, &descriptor, nullptr))
+            return nullptr;
+        return descriptor;
+    }
+
+    // The connections and drives opened by one client; released when the
+    // client disconnects
+    class BrokerSession {
+        std::map<std::string, std::shared_ptr<KinesisDeviceConnection>> connections_;
+        std::map<std::pair<std::string, short>, std::unique_ptr<MotorDrive>> drives_;
+
+    public:
+        void Dispatch(BrokerRequest const& request, BrokerResponse* response);
+
+    private:
+        MotorDrive* Drive(std::string const& serialNo, short channel);
+    };
+
+
+    MotorDrive*
+    BrokerSession::Drive(std::string const& serialNo, short channel) {
+        auto const key = std::make_pair(serialNo, channel);
+        auto it = drives_.find(key);
+        if (it != drives_.end())
+            return it->second.get();
+
+        auto conn = connections_.find(serialNo);
+        if (conn == connections_.end())
+            return nullptr; // Not opened by this client
+        auto drive = MakeKinesisMotorDrive(conn->second, channel);
+        if (!drive)
+            return nullptr;
+        return (drives_[key] = std::move(drive)).get();
+    }
+
+
+    void
+    BrokerSession::Dispatch(BrokerRequest const& request,
+        BrokerResponse* response) {
+        std::string const serialNo(request.serialNo,
+            strnlen(request.serialNo, sizeof(request.serialNo)));
+        short const channel = short(request.channel);
+        int32_t const* const a = request.args;
+
+        switch (request.op) {
+        case BrokerOpOpen: {
+            auto connection = MakeConnection(serialNo);
+            if (!connection)
+                response->status = BrokerStatusNotConnected;
+            else if (!connection->IsValid())
+                response->result = connection->ConnectionError();
+            else
+                connections_[serialNo] = connection;
+            return;
+        }
+        case BrokerOpClose:
+            for (auto it = drives_.begin(); it != drives_.end(); ) {
+                if (it->first.first == serialNo)
+                    it = drives_.erase(it);
+                else
+                    ++it;
+            }
+            connections_.erase(serialNo);
+            return;
+        case BrokerOpGetNumChannels: {
+            auto conn = connections_.find(serialNo);
+            response->result = conn == connections_.end() ? 0 :
+                conn->second->GetNumChannels();
+            return;
+        }
+        default:
+            break;
+        }
+
+        MotorDrive* d = Drive(serialNo, channel);
+        if (!d) {
+            response->status = BrokerStatusNotConnected;
+            return;
+        }
+
+        switch (request.op) {
+        case BrokerOpGetCapabilities:
+            response->result = d->GetCapabilities();
+            break;
+        case BrokerOpRequestSettings:
+            response->result = d->RequestSettings();
+            break;
+        case BrokerOpRequestStatusBits:
+            response->result = d->RequestStatusBits();
+            break;
+        case BrokerOpStartPolling:
+            response->result = d->StartPolling(a[0]);
+            break;
+        case BrokerOpStopPolling:
+            d->StopPolling();
+            break;
+        case BrokerOpGetModelNo: {
+            std::string const modelNo = d->GetModelNo();
+            std::strncpy(response->text, modelNo.c_str(), sizeof(response->text) - 1);
+            break;
+        }
+        case BrokerOpGetStatusBits:
+            response->result = DWORD(d->GetStatusBits());
+            break;
+        case BrokerOpEnableChannel:
+            response->result = d->SetChannelEnabled(true);
+            break;
+        case BrokerOpDisableChannel:
+            response->result = d->SetChannelEnabled(false);
+            break;
+        case BrokerOpGetMotorTravelMode:
+            response->result = d->GetMotorTravelMode();
+            break;
+        case BrokerOpSetMotorTravelMode:
+            response->result = d->SetMotorTravelMode(MotorDrive::TravelMode(a[0]));
+            break;
+        case BrokerOpResetRotationModes:
+            response->result = d->ResetRotationMode();
+            break;
+        case BrokerOpSetRotationModes:
+            response->result = d->SetRotationMode(MotorDrive::RotationMode(a[0]),
+                MotorDrive::RotationDirection(a[1]));
+            break;
+        case BrokerOpSetHomingParams:
+            response->result = d->SetHomingParameters(a[0], a[1], a[2], a[3]);
+            break;
+        case BrokerOpSetLimitSwitchParams:
+            response->result = d->SetLimitSwitchParameters(a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case BrokerOpRequestPosition:
+            response->result = d->RequestPosition();
+            break;
+        case BrokerOpGetPosition:
+            response->result = d->GetPosition();
+            break;
+        case BrokerOpGetPositionCounter:
+            response->result = d->GetPositionCounter();
+            break;
+        case BrokerOpMoveToPosition:
+            response->result = d->MoveToPosition(a[0]);
+            break;
+        case BrokerOpCanHome:
+            response->result = d->CanHome();
+            break;
+        case BrokerOpHome:
+            response->result = d->Home();
+            break;
+        case BrokerOpLoadSettings:
+            response->result = d->LoadSettings();
+            break;
+        case BrokerOpGetConnectedActuatorName: {
+            std::string name;
+            response->result = d->GetConnectedActuatorName(&name);
+            std::strncpy(response->text, name.c_str(), sizeof(response->text) - 1);
+            break;
+        }
+        case BrokerOpGetVelParams: {
+            int acceleration = 0, maxVelocity = 0;
+            response->result = d->GetVelocityParameters(&acceleration, &maxVelocity);
+            response->outputs[0] = acceleration;
+            response->outputs[1] = maxVelocity;
+            break;
+        }
+        case BrokerOpSetVelParams:
+            response->result = d->SetVelocityParameters(a[0], a[1]);
+            break;
+        case BrokerOpGetRealValueFromDeviceUnit:
+            response->result = d->DeviceToPhysicalValue(a[0],
+                response->realOutput, a[1]);
+            break;
+        case BrokerOpGetDeviceUnitFromRealValue: {
+            int deviceUnits = 0;
+            response->result = d->PhysicalToDeviceValue(request.realArg,
+                deviceUnits, a[0]);
+            response->outputs[0] = deviceUnits;
+            break;
+        }
+        case BrokerOpGetEncoderCounter: {
+            auto encoderDrive = dynamic_cast<NonStepperMotorDrive*>(d);
+            response->result = encoderDrive ? encoderDrive->GetEncoderCounter() : 0;
+            break;
+        }
+        default:
+            response->status = BrokerStatusNotConnected;
+            break;
+        }
+    }
+} // namespace
+
+
+BrokerServer::BrokerServer(std::string const& pipeName) :
+    pipeName_{ pipeName }
+{}
+
+
+BrokerServer::~BrokerServer() {
+    Stop();
+    if (security_)
+        LocalFree(security_);
+}
+
+
+bool
+BrokerServer::Start() {
+    if (acceptThread_.joinable())
+        return true;
+
+    if (!security_) {
+        security_ = MakeCurrentUserSecurityDescriptor();
+        if (!security_)
+            return false;
+    }
+
+    // Fail if another server already owns the name
+    HANDLE first = CreatePipeInstance(true);
+    if (first == INVALID_HANDLE_VALUE)
+        return false;
+
+    stopRequested_ = false;
+    acceptThread_ = std::thread([this, first] { Accept(first); });
+    return true;
+}
+
+
+void
+BrokerServer::Stop() {
+    if (!acceptThread_.joinable())
+        return;
+
+    stopRequested_ = true;
+
+    // Wake the accept thread with a connection of our own
+    HANDLE self = CreateFileA(pipeName_.c_str(), GENERIC_READ | GENERIC_WRITE,
+        0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (self != INVALID_HANDLE_VALUE)
+        CloseHandle(self);
+    acceptThread_.join();
+
+    std::vector<std::unique_ptr<Client>> clients;
+    {
+        std::lock_guard<std::mutex> lock{ clientsMutex_ };
+        clients.swap(clients_);
+    }
+    for (auto& client : clients) {
+        // Abort the blocking read on the client's thread
+        CancelSynchronousIo(client->thread.native_handle());
+        DisconnectNamedPipe(client->pipe);
+        client->thread.join();
+        CloseHandle(client->pipe);
+    }
+}
+
+
+HANDLE
+BrokerServer::CreatePipeInstance(bool first) {
+    SECURITY_ATTRIBUTES attributes{};
+    attributes.nLength = sizeof(attributes);
+    attributes.lpSecurityDescriptor = security_;
+    attributes.bInheritHandle = FALSE;
+    return CreateNamedPipeA(pipeName_.c_str(),
+        PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT |
+        PIPE_REJECT_REMOTE_CLIENTS,
+        PIPE_UNLIMITED_INSTANCES, sizeof(BrokerResponse), sizeof(BrokerRequest),
+        0, &attributes);
+}
+
+
+void
+BrokerServer::Accept(HANDLE pipe) {
+    for (;;) {
+        bool const connected = ConnectNamedPipe(pipe, nullptr) ||
+            GetLastError() == ERROR_PIPE_CONNECTED;
+        if (stopRequested_) {
+            CloseHandle(pipe);
+            return;
+        }
+        if (connected) {
+            ReapDisconnectedClients();
+            auto client = std::make_unique<Client>();
+            client->pipe = pipe;
+            Client* c = client.get();
+            std::lock_guard<std::mutex> lock{ clientsMutex_ };
+            client->thread = std::thread([this, c] { Serve(*c); });
+            clients_.push_back(std::move(client));
+        }
+        else {
+            CloseHandle(pipe);
+        }
+
+        pipe = CreatePipeInstance(false);
+        if (pipe == INVALID_HANDLE_VALUE)
+            return;
+    }
+}
+
+
+void
+BrokerServer::ReapDisconnectedClients() {
+    std::lock_guard<std::mutex> lock{ clientsMutex_ };
+    for (auto it = clients_.begin(); it != clients_.end(); ) {
+        if ((*it)->done) {
+            (*it)->thread.join();
+            CloseHandle((*it)->pipe);
+            it = clients_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+
+void
+BrokerServer::Serve(Client& client) {
+    HANDLE const pipe = client.pipe;
+    BrokerSession session;
+    for (;;) {
+        BrokerRequest request;
+        DWORD bytesRead = 0;
+        if (!ReadFile(pipe, &request, sizeof(request), &bytesRead, nullptr) ||
+                bytesRead != sizeof(request))
+            break;
+
+        BrokerResponse response{};
+        session.Dispatch(request, &response);
+
+        DWORD bytesWritten = 0;
+        if (!WriteFile(pipe, &response, sizeof(response), &bytesWritten, nullptr))
+            break;
+    }
+    DisconnectNamedPipe(pipe);
+    client.done = true;
+}
+
+
+std::shared_ptr<BrokerClient>
+BrokerClient::Connect(std::string const& pipeName) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        HANDLE pipe = CreateFileA(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE,
+            0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            DWORD mode = PIPE_READMODE_MESSAGE;
+            if (!SetNamedPipeHandleState(pipe, &mode, nullptr, nullptr)) {
+                CloseHandle(pipe);
+                return {};
+            }
+            return std::shared_ptr<BrokerClient>(new BrokerClient{ pipe });
+        }
+        // All instances busy (the server is between accepts); wait
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(pipeName.c_str(), 2000))
+            return {};
+    }
+    return {};
+}
+
+
+std::shared_ptr<BrokerClient>
+BrokerClient::Active() {
+    std::lock_guard<std::mutex> lock{ activeClientMutex };
+    return activeClient;
+}
+
+
+void
+BrokerClient::SetActive(std::shared_ptr<BrokerClient> client) {
+    std::lock_guard<std::mutex> lock{ activeClientMutex };
+    activeClient = std::move(client);
+}
+
+
+BrokerClient::~BrokerClient() {
+    CloseHandle(pipe_);
+}
+
+
+bool
+BrokerClient::Call(BrokerRequest const& request, BrokerResponse* response) {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    DWORD bytesRead = 0;
+    return TransactNamedPipe(pipe_, const_cast<BrokerRequest*>(&request),
+        sizeof(request), response, sizeof(*response), &bytesRead, nullptr) &&
+        bytesRead == sizeof(*response);
+}
+
+
+namespace {
+    BrokerRequest
+    MakeRequest(BrokerOp op, std::string const& serialNo, short channel) {
+        BrokerRequest request{};
+        request.op = op;
+        request.channel = channel;
+        std::strncpy(request.serialNo, serialNo.c_str(), sizeof(request.serialNo) - 1);
+        return request;
+    }
+
+    int64_t
+    CallOrFail(BrokerClient& client, BrokerRequest const& request) {
+        BrokerResponse response{};
+        if (!client.Call(request, &response) ||
+                response.status != BrokerStatusOK)
+            return BrokerErrorNotConnected;
+        return response.result;
+    }
+}
+
+
+short
+BrokerAccess::Kinesis_Open() {
+    return short(CallOrFail(*client_, MakeRequest(BrokerOpOpen, SerialNo(), -1)));
+}
+
+
+short
+BrokerAccess::Kinesis_Close() {
+    return short(CallOrFail(*client_, MakeRequest(BrokerOpClose, SerialNo(), -1)));
+}
+
+
+short
+BrokerAccess::Kinesis_GetNumChannels() {
+    return short(CallOrFail(*client_,
+        MakeRequest(BrokerOpGetNumChannels, SerialNo(), -1)));
+}
+
+
+BrokerMotorDrive::BrokerMotorDrive(std::shared_ptr<BrokerClient> client,
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+    NonStepperMotorDrive{ connection, channel },
+    client_{ std::move(client) },
+    capabilities_{ 0 }
+{
+    BrokerResponse response = Call(BrokerOpGetCapabilities);
+    if (response.status == BrokerStatusOK)
+        capabilities_ = unsigned(response.result);
+}
+
+
+BrokerResponse
+BrokerMotorDrive::Call(BrokerOp op, std::initializer_list<int32_t> args,
+    double realArg) {
+    BrokerRequest request = MakeRequest(op, SerialNo(), Channel());
+    std::copy_n(args.begin(), std::min(args.size(), size_t(5)), request.args);
+    request.realArg = realArg;
+
+    BrokerResponse response{};
+    if (!client_->Call(request, &response)) {
+        response = BrokerResponse{};
+        response.status = BrokerStatusNotConnected;
+    }
+    if (response.status != BrokerStatusOK)
+        response.result = BrokerErrorNotConnected;
+    return response;
+}
+
+
+int64_t
+BrokerMotorDrive::CallForValue(BrokerOp op, std::atomic<int64_t>& lastValue) {
+    BrokerResponse response = Call(op);
+    if (response.status != BrokerStatusOK) {
+        GetConnection()->ReportLost();
+        return lastValue.load();
+    }
+    lastValue.store(response.result);
+    return response.result;
+}
+
+
+short
+BrokerMotorDrive::Kinesis_RequestSettings() {
+    return short(Call(BrokerOpRequestSettings).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_RequestStatusBits() {
+    return short(Call(BrokerOpRequestStatusBits).result);
+}
+
+
+bool
+BrokerMotorDrive::Kinesis_StartPolling(int intervalMs) {
+    BrokerResponse response = Call(BrokerOpStartPolling, { intervalMs });
+    return response.status == BrokerStatusOK && response.result != 0;
+}
+
+
+void
+BrokerMotorDrive::Kinesis_StopPolling() {
+    Call(BrokerOpStopPolling);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
+    // Only the model number is forwarded
+    BrokerResponse response = Call(BrokerOpGetModelNo);
+    if (response.result)
+        return short(response.result);
+    if (sizeOfModelNo > 0) {
+        std::strncpy(modelNo, response.text, sizeOfModelNo - 1);
+        modelNo[sizeOfModelNo - 1] = '\0';
+    }
+    if (sizeOfNotes > 0)
+        notes[0] = '\0';
+    *type = 0;
+    *numChannels = 0;
+    *firmwareVersion = 0;
+    *hardwareVersion = 0;
+    *modificationState = 0;
+    return 0;
+}
+
+
+DWORD
+BrokerMotorDrive::Kinesis_GetStatusBits() {
+    return DWORD(CallForValue(BrokerOpGetStatusBits, lastStatusBits_));
+}
+
+
+short
+BrokerMotorDrive::Kinesis_EnableChannel() {
+    return short(Call(BrokerOpEnableChannel).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_DisableChannel() {
+    return short(Call(BrokerOpDisableChannel).result);
+}
+
+
+int
+BrokerMotorDrive::Kinesis_GetMotorTravelMode() {
+    return int(CallForValue(BrokerOpGetMotorTravelMode, lastMotorTravelMode_));
+}
+
+
+short
+BrokerMotorDrive::Kinesis_SetMotorTravelMode(int mode) {
+    return short(Call(BrokerOpSetMotorTravelMode, { mode }).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_ResetRotationModes() {
+    return short(Call(BrokerOpResetRotationModes).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_SetRotationModes(int mode, int direction) {
+    return short(Call(BrokerOpSetRotationModes, { mode, direction }).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_SetHomingParams(int direction, int limitSwitchMode,
+    int offsetDistance, int velocity) {
+    return short(Call(BrokerOpSetHomingParams,
+        { direction, limitSwitchMode, offsetDistance, velocity }).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_SetLimitSwitchParams(int ccwHardwareLimitMode,
+    int ccwSoftwareLimitPosition, int cwHardwareLimitMode,
+    int cwSoftwareLimitPosition, int softwareLimitMode) {
+    return short(Call(BrokerOpSetLimitSwitchParams,
+        { ccwHardwareLimitMode, ccwSoftwareLimitPosition, cwHardwareLimitMode,
+        cwSoftwareLimitPosition, softwareLimitMode }).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_RequestPosition() {
+    return short(Call(BrokerOpRequestPosition).result);
+}
+
+
+int
+BrokerMotorDrive::Kinesis_GetPosition() {
+    return int(CallForValue(BrokerOpGetPosition, lastPosition_));
+}
+
+
+long
+BrokerMotorDrive::Kinesis_GetPositionCounter() {
+    return long(CallForValue(BrokerOpGetPositionCounter, lastPositionCounter_));
+}
+
+
+short
+BrokerMotorDrive::Kinesis_MoveToPosition(int index) {
+    return short(Call(BrokerOpMoveToPosition, { index }).result);
+}
+
+
+bool
+BrokerMotorDrive::Kinesis_CanHome() {
+    return CallForValue(BrokerOpCanHome, lastCanHome_) != 0;
+}
+
+
+short
+BrokerMotorDrive::Kinesis_Home() {
+    return short(Call(BrokerOpHome).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_LoadSettings() {
+    return short(Call(BrokerOpLoadSettings).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_GetConnectedActuatorName(std::string* actuatorName) {
+    BrokerResponse response = Call(BrokerOpGetConnectedActuatorName);
+    actuatorName->append(response.text);
+    return short(response.result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_GetVelParams(int* acceleration, int* maxVelocity) {
+    BrokerResponse response = Call(BrokerOpGetVelParams);
+    *acceleration = response.outputs[0];
+    *maxVelocity = response.outputs[1];
+    return short(response.result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_SetVelParams(int acceleration, int maxVelocity) {
+    return short(Call(BrokerOpSetVelParams, { acceleration, maxVelocity }).result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
+    double* realValue, int unitType) {
+    BrokerResponse response = Call(BrokerOpGetRealValueFromDeviceUnit,
+        { deviceUnits, unitType });
+    *realValue = response.realOutput;
+    return short(response.result);
+}
+
+
+short
+BrokerMotorDrive::Kinesis_GetDeviceUnitFromRealValue(double realValue,
+    int* deviceUnits, int unitType) {
+    BrokerResponse response = Call(BrokerOpGetDeviceUnitFromRealValue,
+        { unitType }, realValue);
+    *deviceUnits = response.outputs[0];
+    return short(response.result);
+}
+
+
+long
+BrokerMotorDrive::Kinesis_GetEncoderCounter() {
+    return long(CallForValue(BrokerOpGetEncoderCounter, lastEncoderCounter_));
+}
@@ -0,0 +1,283 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// Sharing devices between processes.
+//
+// Only one process can open a Kinesis device, but it is often useful to
+// control, say, one channel of a benchtop controller from Micro-Manager and
+// another from an alignment tool. In broker mode, one process (the server;
+// a Micro-Manager instance whose hub has BrokerMode=Serve) owns the device
+// connections and executes Kinesis commands on behalf of clients connected
+// over a local named pipe. In a client (BrokerMode=Client), connections and
+// motor drives are BrokerAccess and BrokerMotorDrive objects, which send
+// each Kinesis call to the server instead of the DLL.
+//
+// Each call is one fixed-size request and response (a single
+// TransactNamedPipe() round trip), so there is no parsing. Live status
+// without round trips is available from the StatusBoard, if the server
+// publishes one.
+//
+// The pipe only accepts local clients running as the same user as the
+// server.
+
+enum BrokerOp : uint32_t {
+    BrokerOpOpen = 1,
+    BrokerOpClose,
+    BrokerOpGetNumChannels,
+    BrokerOpGetCapabilities,
+    BrokerOpRequestSettings,
+    BrokerOpRequestStatusBits,
+    BrokerOpStartPolling,
+    BrokerOpStopPolling,
+    BrokerOpGetModelNo,
+    BrokerOpGetStatusBits,
+    BrokerOpEnableChannel,
+    BrokerOpDisableChannel,
+    BrokerOpGetMotorTravelMode,
+    BrokerOpSetMotorTravelMode,
+    BrokerOpResetRotationModes,
+    BrokerOpSetRotationModes,
+    BrokerOpSetHomingParams,
+    BrokerOpSetLimitSwitchParams,
+    BrokerOpRequestPosition,
+    BrokerOpGetPosition,
+    BrokerOpGetPositionCounter,
+    BrokerOpMoveToPosition,
+    BrokerOpCanHome,
+    BrokerOpHome,
+    BrokerOpLoadSettings,
+    BrokerOpGetConnectedActuatorName,
+    BrokerOpGetVelParams,
+    BrokerOpSetVelParams,
+    BrokerOpGetRealValueFromDeviceUnit,
+    BrokerOpGetDeviceUnitFromRealValue,
+    BrokerOpGetEncoderCounter,
+};
+
+
+struct BrokerRequest {
+    uint32_t op; // BrokerOp
+    int32_t channel; // -1 for single-channel devices
+    char serialNo[16];
+    int32_t args[5];
+    double realArg;
+};
+
+
+enum BrokerStatus : int32_t {
+    BrokerStatusOK = 0,
+    BrokerStatusNotConnected, // Server unreachable, or device not open
+};
+
+
+struct BrokerResponse {
+    int64_t result; // Return value of the call; valid if status is OK
+    int32_t status; // BrokerStatus
+    int32_t outputs[2];
+    double realOutput;
+    char text[64]; // Model number or actuator name
+};
+
+
+// Error code returned to callers of brokered Kinesis functions when the
+// status is BrokerStatusNotConnected; the same code as a device that has been
+// unplugged, so that the connection is reported lost and reopened
+short const BrokerErrorNotConnected = 7; // Device no longer present
+
+
+// The server: accepts clients and runs their calls against this process's
+// connections (see UniqueConnection())
+class BrokerServer {
+    std::string const pipeName_;
+    PSECURITY_DESCRIPTOR security_ = nullptr; // Current user only
+
+    std::atomic<bool> stopRequested_{ false };
+    std::thread acceptThread_;
+
+    struct Client {
+        HANDLE pipe;
+        std::thread thread;
+        std::atomic<bool> done{ false }; // Set when the client disconnects
+    };
+    std::mutex clientsMutex_;
+    std::vector<std::unique_ptr<Client>> clients_; // Guarded by clientsMutex_
+
+public:
+    explicit BrokerServer(std::string const& pipeName);
+    ~BrokerServer();
+
+    // Noncopyable
+    BrokerServer(BrokerServer const&) = delete;
+    BrokerServer& operator=(BrokerServer const&) = delete;
+
+    bool Start();
+    void Stop();
+
+private:
+    HANDLE CreatePipeInstance(bool first);
+    void Accept(HANDLE pipe);
+    void Serve(Client& client);
+    void ReapDisconnectedClients();
+};
+
+
+// The client's link to the server, shared by all brokered devices
+class BrokerClient {
+    HANDLE pipe_;
+    std::mutex mutex_; // One transaction at a time
+
+    explicit BrokerClient(HANDLE pipe) : pipe_{ pipe } {}
+
+public:
+    // Connect to the server; return null if it is not running
+    static std::shared_ptr<BrokerClient> Connect(std::string const& pipeName);
+
+    // The link that new connections should use; null unless in client mode
+    static std::shared_ptr<BrokerClient> Active();
+    static void SetActive(std::shared_ptr<BrokerClient> client);
+
+    ~BrokerClient();
+
+    // Noncopyable
+    BrokerClient(BrokerClient const&) = delete;
+    BrokerClient& operator=(BrokerClient const&) = delete;
+
+    // Send the request and wait for the response; return false if the
+    // server has gone away
+    bool Call(BrokerRequest const& request, BrokerResponse* response);
+};
+
+
+class BrokerAccess final : public KinesisDeviceAccess {
+    std::shared_ptr<BrokerClient> const client_;
+
+public:
+    BrokerAccess(std::shared_ptr<BrokerClient> client,
+        std::string const& serialNo) :
+        KinesisDeviceAccess{ serialNo },
+        client_{ std::move(client) }
+    {}
+
+protected:
+    bool IsKinesisDriverAvailable() override { return true; }
+    short Kinesis_Open() override;
+    short Kinesis_Close() override;
+    short Kinesis_GetNumChannels() override;
+};
+
+
+// Always presents the NonStepperMotorDrive interface; the encoder counter
+// reads as zero if the server's drive has none.
+class BrokerMotorDrive final : public NonStepperMotorDrive {
+    std::shared_ptr<BrokerClient> const client_;
+    unsigned capabilities_;
+
+    // Last values received, returned while the server cannot be reached
+    std::atomic<int64_t> lastStatusBits_{ 0 };
+    std::atomic<int64_t> lastMotorTravelMode_{ 0 };
+    std::atomic<int64_t> lastPosition_{ 0 };
+    std::atomic<int64_t> lastPositionCounter_{ 0 };
+    std::atomic<int64_t> lastCanHome_{ 0 };
+    std::atomic<int64_t> lastEncoderCounter_{ 0 };
+
+public:
+    BrokerMotorDrive(std::shared_ptr<BrokerClient> client,
+        std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+
+    unsigned GetCapabilities() const override { return capabilities_; }
+
+protected:
+    short Kinesis_RequestSettings() override;
+    short Kinesis_RequestStatusBits() override;
+    bool Kinesis_StartPolling(int intervalMs) override;
+    void Kinesis_StopPolling() override;
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion,
+        WORD* modificationState) override;
+    DWORD Kinesis_GetStatusBits() override;
+
+    short Kinesis_EnableChannel() override;
+    short Kinesis_DisableChannel() override;
+    int Kinesis_GetMotorTravelMode() override;
+    short Kinesis_SetMotorTravelMode(int mode) override;
+    short Kinesis_ResetRotationModes() override;
+    short Kinesis_SetRotationModes(int mode, int direction) override;
+    short Kinesis_SetHomingParams(int direction, int limitSwitchMode,
+        int offsetDistance, int velocity) override;
+    short Kinesis_SetLimitSwitchParams(int ccwHardwareLimitMode,
+        int ccwSoftwareLimitPosition, int cwHardwareLimitMode,
+        int cwSoftwareLimitPosition, int softwareLimitMode) override;
+    short Kinesis_RequestPosition() override;
+    int Kinesis_GetPosition() override;
+    long Kinesis_GetPositionCounter() override;
+    short Kinesis_MoveToPosition(int index) override;
+    bool Kinesis_CanHome() override;
+    short Kinesis_Home() override;
+    short Kinesis_LoadSettings() override;
+    short Kinesis_GetConnectedActuatorName(std::string* actuatorName) override;
+    short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) override;
+    short Kinesis_SetVelParams(int acceleration, int maxVelocity) override;
+    short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
+        double* realValue, int unitType) override;
+    short Kinesis_GetDeviceUnitFromRealValue(double realValue,
+        int* deviceUnits, int unitType) override;
+
+    long Kinesis_GetEncoderCounter() override;
+
+private:
+    // Make the call; on failure to reach the server, the result is
+    // BrokerErrorNotConnected
+    BrokerResponse Call(BrokerOp op, std::initializer_list<int32_t> args = {},
+        double realArg = 0.0);
+
+    // Make a call whose result is a value rather than an error code; on
+    // failure, mark the connection lost and return the last value received
+    int64_t CallForValue(BrokerOp op, std::atomic<int64_t>& lastValue);
+};
@@ -0,0 +1,245 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "CallStatistics.h"
+
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+
+namespace {
+    // Counters for one function, written by a single thread
+    struct FunctionBuckets {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> errors;
+        std::atomic<uint64_t> totalNs;
+        std::atomic<uint64_t> maxNs;
+        std::array<std::atomic<uint64_t>, CallStatistics::NumBuckets> buckets;
+
+        FunctionBuckets() :
+            calls{ 0 },
+            errors{ 0 },
+            totalNs{ 0 },
+            maxNs{ 0 }
+        {
+            for (auto& bucket : buckets)
+                bucket.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    // Only the owning thread writes, so a plain load and store (rather than
+    // a locked read-modify-write) suffices; readers may see slightly stale
+    // values.
+    inline void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+            std::memory_order_relaxed);
+    }
+
+    struct ThreadBuckets {
+        std::array<std::atomic<FunctionBuckets*>, Instrumentation::MaxFunctions> functions;
+
+        ThreadBuckets() {
+            for (auto& f : functions)
+                f.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~ThreadBuckets() {
+            for (auto& f : functions)
+                delete f.load(std::memory_order_relaxed);
+        }
+
+        // Noncopyable
+        ThreadBuckets(ThreadBuckets const&) = delete;
+        ThreadBuckets& operator=(ThreadBuckets const&) = delete;
+    };
+
+    // Buckets are kept after their thread exits, so that its calls are
+    // still reported.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuckets>> threads;
+    };
+
+    Registry& TheRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local ThreadBuckets* threadBuckets = nullptr;
+
+    ThreadBuckets& BucketsOfThisThread() {
+        if (!threadBuckets) {
+            auto buckets = std::make_unique<ThreadBuckets>();
+            threadBuckets = buckets.get();
+            Registry& registry = TheRegistry();
+            std::lock_guard<std::mutex> lock{ registry.mutex };
+            registry.threads.push_back(std::move(buckets));
+        }
+        return *threadBuckets;
+    }
+
+    unsigned HighestBit(uint64_t value) {
+        unsigned bit = 0;
+        while (value >>= 1)
+            ++bit;
+        return bit;
+    }
+
+    double Microseconds(uint64_t ns) {
+        return double(ns) / 1000.0;
+    }
+}
+
+
+bool
+CallStatistics::IsEnabled() {
+    return (Instrumentation::Active() & Instrumentation::FlagsStatistics) != 0;
+}
+
+
+void
+CallStatistics::SetEnabled(bool enabled) {
+    Instrumentation::SetFlag(Instrumentation::FlagsStatistics, enabled);
+}
+
+
+void
+CallStatistics::Record(size_t function, std::chrono::nanoseconds latency,
+    bool error) {
+    if (function >= Instrumentation::MaxFunctions)
+        return;
+
+    auto& slot = BucketsOfThisThread().functions[function];
+    FunctionBuckets* buckets = slot.load(std::memory_order_relaxed);
+    if (!buckets) {
+        buckets = new FunctionBuckets;
+        slot.store(buckets, std::memory_order_release);
+    }
+
+    uint64_t const ns = uint64_t(std::max<long long>(0, latency.count()));
+    Add(buckets->calls, 1);
+    if (error)
+        Add(buckets->errors, 1);
+    Add(buckets->totalNs, ns);
+    if (ns > buckets->maxNs.load(std::memory_order_relaxed))
+        buckets->maxNs.store(ns, std::memory_order_relaxed);
+    Add(buckets->buckets[BucketOf(ns)], 1);
+}
+
+
+size_t
+CallStatistics::BucketOf(uint64_t nanoseconds) {
+    uint64_t const subBuckets = uint64_t(1) << SubBucketBits;
+    if (nanoseconds < subBuckets)
+        return size_t(nanoseconds);
+    unsigned exponent = HighestBit(nanoseconds);
+    if (exponent >= MaxLatencyBits)
+        return NumBuckets - 1;
+    uint64_t const sub = (nanoseconds >> (exponent - SubBucketBits)) & (subBuckets - 1);
+    return size_t((exponent - SubBucketBits + 1) * subBuckets + sub);
+}
+
+
+uint64_t
+CallStatistics::BucketLowerBound(size_t bucket) {
+    size_t const subBuckets = size_t(1) << SubBucketBits;
+    if (bucket < subBuckets)
+        return bucket;
+    size_t const octave = bucket / subBuckets;
+    size_t const sub = bucket % subBuckets;
+    return uint64_t(subBuckets + sub) << (octave - 1);
+}
+
+
+std::string
+CallStatistics::Format() {
+    size_t const functionCount = Instrumentation::FunctionCount();
+
+    Registry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1);
+    for (size_t id = 0; id < functionCount; ++id) {
+        uint64_t calls = 0, errors = 0, totalNs = 0, maxNs = 0;
+        std::array<uint64_t, NumBuckets> histogram{};
+        for (auto const& thread : registry.threads) {
+            FunctionBuckets const* buckets =
+                thread->functions[id].load(std::memory_order_acquire);
+            if (!buckets)
+                continue;
+            calls += buckets->calls.load(std::memory_order_relaxed);
+            errors += buckets->errors.load(std::memory_order_relaxed);
+            totalNs += buckets->totalNs.load(std::memory_order_relaxed);
+            maxNs = std::max(maxNs, buckets->maxNs.load(std::memory_order_relaxed));
+            for (size_t b = 0; b < NumBuckets; ++b)
+                histogram[b] += buckets->buckets[b].load(std::memory_order_relaxed);
+        }
+        if (calls == 0)
+            continue;
+
+        auto percentile = [&](double fraction) {
+            uint64_t const rank = uint64_t(std::ceil(fraction * double(calls)));
+            uint64_t seen = 0;
+            for (size_t b = 0; b < NumBuckets; ++b) {
+                seen += histogram[b];
+                if (seen >= rank && seen > 0)
+                    return BucketLowerBound(b);
+            }
+            return maxNs;
+        };
+
+        report << Instrumentation::FunctionName(id) << " (" <<
+            Instrumentation::FunctionLibrary(id) << "): " <<
+            "calls=" << calls << " errors=" << errors <<
+            " mean=" << Microseconds(totalNs / calls) << "us" <<
+            " p50=" << Microseconds(percentile(0.50)) << "us" <<
+            " p90=" << Microseconds(percentile(0.90)) << "us" <<
+            " p99=" << Microseconds(percentile(0.99)) << "us" <<
+            " max=" << Microseconds(maxNs) << "us\n";
+        report << "  histogram (us:count):";
+        for (size_t b = 0; b < NumBuckets; ++b) {
+            if (histogram[b])
+                report << ' ' << Microseconds(BucketLowerBound(b)) << ':' << histogram[b];
+        }
+        report << '\n';
+    }
+    return report.str();
+}
@@ -0,0 +1,80 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Opt-in statistics for calls made through DLLFunc: per-function call
+// counts, error counts, and latency histograms.
+//
+// Each thread records into its own buckets, without locking or contended
+// atomic operations; the buckets are only summed when a report is made.
+// When statistics are disabled (the default), the only overhead of a call is
+// testing a flag (see Instrumentation).
+//
+// Latencies are kept in a log-linear (HDR-style) histogram of nanoseconds,
+// with 8 sub-buckets per power of 2, so that each bucket's lower bound is
+// within 12.5% of the recorded values.
+class CallStatistics {
+public:
+    static unsigned const SubBucketBits = 3;
+    static unsigned const MaxLatencyBits = 40; // ~18 minutes
+    static size_t const NumBuckets =
+        (MaxLatencyBits - SubBucketBits + 1) << SubBucketBits;
+
+    static bool IsEnabled();
+    static void SetEnabled(bool enabled);
+
+    // Function ids are from Instrumentation::FunctionId()
+    static void Record(size_t function, std::chrono::nanoseconds latency,
+        bool error);
+
+    // Report of all functions called while enabled, one line each for the
+    // summary and the nonempty histogram buckets. Empty if none.
+    static std::string Format();
+
+    static size_t BucketOf(uint64_t nanoseconds);
+    static uint64_t BucketLowerBound(size_t bucket);
+};
+
+
+// Whether the result of a Kinesis function indicates an error: functions
+// returning short return an error code; other results are not errors.
+inline bool IsKinesisErrorResult(short result) { return result != 0; }
+
+template<typename R>
+bool IsKinesisErrorResult(R const&) { return false; }
@@ -0,0 +1,272 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "CallTrace.h"
+
+#include "CallTraceFile.h"
+#include "Instrumentation.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+using namespace CallTraceFile;
+
+
+namespace {
+    class Recorder {
+        HANDLE file_;
+        HANDLE mapping_;
+        char* view_;
+        TraceFileHeader* header_;
+        char* ring_;
+        uint64_t const capacity_;
+        std::chrono::steady_clock::time_point const origin_;
+
+    public:
+        Recorder(HANDLE file, HANDLE mapping, char* view, uint64_t capacity) :
+            file_{ file },
+            mapping_{ mapping },
+            view_{ view },
+            header_{ reinterpret_cast<TraceFileHeader*>(view) },
+            ring_{ view + sizeof(TraceFileHeader) },
+            capacity_{ capacity },
+            origin_{ std::chrono::steady_clock::now() }
+        {
+            std::memset(header_, 0, sizeof(TraceFileHeader));
+            std::memcpy(header_->magic, TraceMagic, sizeof(TraceMagic));
+            header_->version = TraceVersion;
+            header_->headerSize = sizeof(TraceFileHeader);
+            header_->capacity = capacity_;
+        }
+
+        ~Recorder() {
+            FlushViewOfFile(view_, 0);
+            UnmapViewOfFile(view_);
+            CloseHandle(mapping_);
+            CloseHandle(file_);
+        }
+
+        // Noncopyable
+        Recorder(Recorder const&) = delete;
+        Recorder& operator=(Recorder const&) = delete;
+
+        void Append(size_t function,
+            std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::duration duration,
+            std::string const& inputs, std::string const& outputs,
+            std::string const& result) {
+
+            if (function >= Instrumentation::MaxFunctions)
+                return;
+            char* name = header_->functions[function];
+            if (name[0] == '\0') {
+                std::string fullName = Instrumentation::FunctionLibrary(function) +
+                    "!" + Instrumentation::FunctionName(function);
+                fullName.copy(name, FunctionNameSize - 1);
+            }
+
+            uint64_t const size = RoundUp8(sizeof(TraceRecordHeader) +
+                inputs.size() + outputs.size() + result.size());
+            if (size > capacity_ / 2)
+                return; // Not expected for any Kinesis function
+
+            uint64_t const remaining = capacity_ - header_->head % capacity_;
+            if (remaining < size) {
+                MakeRoom(remaining);
+                if (remaining >= sizeof(TraceRecordHeader)) {
+                    TraceRecordHeader wrap{};
+                    wrap.size = uint32_t(remaining);
+                    wrap.function = WrapRecord;
+                    std::memcpy(ring_ + header_->head % capacity_, &wrap, sizeof(wrap));
+                }
+                header_->head += remaining;
+            }
+
+            MakeRoom(size);
+            TraceRecordHeader record{};
+            record.size = uint32_t(size);
+            record.function = uint16_t(function);
+            record.thread = GetCurrentThreadId();
+            record.inputsSize = uint32_t(inputs.size());
+            record.outputsSize = uint32_t(outputs.size());
+            record.resultSize = uint32_t(result.size());
+            record.startNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                start - origin_).count());
+            record.durationNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                duration).count());
+
+            char* p = ring_ + header_->head % capacity_;
+            std::memcpy(p, &record, sizeof(record));
+            p += sizeof(record);
+            std::memcpy(p, inputs.data(), inputs.size());
+            p += inputs.size();
+            std::memcpy(p, outputs.data(), outputs.size());
+            p += outputs.size();
+            std::memcpy(p, result.data(), result.size());
+            header_->head += size;
+        }
+
+    private:
+        // Drop the oldest records until size bytes can be written at head
+        void MakeRoom(uint64_t size) {
+            while (header_->head + size - header_->tail > capacity_) {
+                uint64_t const remaining = capacity_ - header_->tail % capacity_;
+                if (remaining < sizeof(TraceRecordHeader)) {
+                    header_->tail += remaining;
+                    continue;
+                }
+                TraceRecordHeader oldest;
+                std::memcpy(&oldest, ring_ + header_->tail % capacity_, sizeof(oldest));
+                header_->tail += oldest.size;
+            }
+        }
+    };
+
+
+    std::mutex traceMutex;
+    std::unique_ptr<Recorder> recorder;
+    std::unique_ptr<TracePlayer> player;
+}
+
+
+bool
+CallTrace::StartRecording(std::string const& path, uint64_t sizeBytes) {
+    std::lock_guard<std::mutex> lock{ traceMutex };
+    if (recorder || player)
+        return false;
+
+    uint64_t const capacity = RoundUp8(std::max<uint64_t>(sizeBytes, 4096));
+    uint64_t const fileSize = sizeof(TraceFileHeader) + capacity;
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE || !file)
+        return false;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+        DWORD(fileSize >> 32), DWORD(fileSize & 0xffffffff), nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size_t(fileSize));
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    recorder = std::make_unique<Recorder>(file, mapping, static_cast<char*>(view), capacity);
+    Instrumentation::SetFlag(Instrumentation::FlagsTraceRecord, true);
+    return true;
+}
+
+
+bool
+CallTrace::StartReplay(std::string const& path, bool originalTiming) {
+    std::lock_guard<std::mutex> lock{ traceMutex };
+    if (recorder || player)
+        return false;
+
+    auto newPlayer = std::make_unique<TracePlayer>(originalTiming);
+    if (!newPlayer->Load(path))
+        return false;
+    player = std::move(newPlayer);
+    Instrumentation::SetFlag(Instrumentation::FlagsTraceReplay, true);
+    return true;
+}
+
+
+void
+CallTrace::Stop() {
+    Instrumentation::SetFlag(Instrumentation::FlagsTraceRecord, false);
+    std::lock_guard<std::mutex> lock{ traceMutex };
+    recorder.reset();
+    player.reset();
+}
+
+
+bool
+CallTrace::IsRecording() {
+    return (Instrumentation::Active() & Instrumentation::FlagsTraceRecord) != 0;
+}
+
+
+bool
+CallTrace::IsReplaying() {
+    return (Instrumentation::Active() & Instrumentation::FlagsTraceReplay) != 0;
+}
+
+
+void
+CallTrace::Append(size_t function,
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::duration duration,
+    TraceBuffer const& inputs, TraceBuffer const& outputs,
+    TraceBuffer const& result) {
+
+    std::lock_guard<std::mutex> lock{ traceMutex };
+    if (recorder) {
+        recorder->Append(function, start, duration,
+            inputs.Bytes(), outputs.Bytes(), result.Bytes());
+    }
+}
+
+
+bool
+CallTrace::FindResponse(size_t function, TraceBuffer const& inputs,
+    Response* response) {
+    std::string const name = Instrumentation::FunctionLibrary(function) + "!" +
+        Instrumentation::FunctionName(function);
+
+    std::lock_guard<std::mutex> lock{ traceMutex };
+    if (!player)
+        return false;
+    return player->Find(name, inputs.Bytes(), response);
+}
+
+
+void
+CallTrace::WaitForReplay(Response const& response) {
+    bool originalTiming;
+    {
+        std::lock_guard<std::mutex> lock{ traceMutex };
+        originalTiming = player && player->OriginalTiming();
+    }
+    if (originalTiming)
+        std::this_thread::sleep_for(response.duration);
+}
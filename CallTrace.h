@@ -0,0 +1,243 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+
+// Recording of Kinesis calls to a binary trace file, and replay of the
+// recorded responses in place of the Kinesis DLLs.
+//
+// Every call made through DLLFunc is recorded with its function, input
+// arguments, output arguments (pointed-to values after the call), return
+// value, thread, start time, and duration. The trace file is a fixed-size,
+// memory-mapped ring buffer, so that the most recent calls are kept (and
+// survive a crash of the application).
+//
+// During replay, each call is answered with the next recorded response for
+// the same function and the same input arguments (repeating the last one if
+// the call is made more often than it was recorded), so that the adapter
+// code can be exercised and profiled without the hardware. Calls that were
+// never recorded return zero without touching output arguments.
+
+
+class TraceBuffer {
+    std::string bytes_;
+
+public:
+    void Put(void const* data, size_t size) {
+        bytes_.append(static_cast<char const*>(data), size);
+    }
+
+    template<typename T>
+    void PutValue(T const& value) {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "Only trivially copyable values can be recorded");
+        Put(&value, sizeof(T));
+    }
+
+    void PutString(char const* s) {
+        uint32_t const length = s ? uint32_t(std::strlen(s)) : 0;
+        PutValue(length);
+        Put(s, length);
+    }
+
+    // Output buffers are not necessarily null-terminated (e.g. after a failed
+    // call), so read no further than their size
+    void PutString(char const* s, size_t bufferSize) {
+        uint32_t const length = s ? uint32_t(strnlen(s, bufferSize)) : 0;
+        PutValue(length);
+        Put(s, length);
+    }
+
+    std::string const& Bytes() const { return bytes_; }
+};
+
+
+class TraceReader {
+    char const* next_;
+    char const* const end_;
+
+public:
+    explicit TraceReader(std::string const& bytes) :
+        next_{ bytes.data() },
+        end_{ bytes.data() + bytes.size() }
+    {}
+
+    bool Get(void* data, size_t size) {
+        if (size_t(end_ - next_) < size)
+            return false;
+        if (data)
+            std::memcpy(data, next_, size);
+        next_ += size;
+        return true;
+    }
+
+    template<typename T>
+    bool GetValue(T* value) {
+        return Get(value, sizeof(T));
+    }
+
+    // Copies the string, with a terminating null, to dest (if not null),
+    // truncating it to fit in destSize bytes
+    bool GetString(char* dest, size_t destSize) {
+        uint32_t length;
+        if (!GetValue(&length) || size_t(end_ - next_) < length)
+            return false;
+        if (dest && destSize > 0) {
+            size_t const copied = std::min<size_t>(length, destSize - 1);
+            std::memcpy(dest, next_, copied);
+            dest[copied] = '\0';
+        }
+        next_ += length;
+        return true;
+    }
+};
+
+
+// How each parameter type is recorded. Values, input strings, and structs
+// passed by pointer-to-const are inputs (which identify the call during
+// replay). Non-const pointers are outputs: the pointed-to value is recorded
+// after the call and written back during replay. Outputs also receive the
+// value of the following parameter, which is the size of the buffer for
+// output strings (0 if there is no following integer parameter).
+template<typename T>
+struct ArgCodec {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+        "Unsupported Kinesis parameter type");
+    static void PutInput(TraceBuffer& buffer, T value) { buffer.PutValue(value); }
+    static void PutOutput(TraceBuffer&, T, size_t) {}
+    static void GetOutput(TraceReader&, T, size_t) {}
+};
+
+template<>
+struct ArgCodec<char const*> {
+    static void PutInput(TraceBuffer& buffer, char const* s) { buffer.PutString(s); }
+    static void PutOutput(TraceBuffer&, char const*, size_t) {}
+    static void GetOutput(TraceReader&, char const*, size_t) {}
+};
+
+// Output string buffer (e.g. model number), followed by its size
+template<>
+struct ArgCodec<char*> {
+    static void PutInput(TraceBuffer&, char*) {}
+    static void PutOutput(TraceBuffer& buffer, char* s, size_t size) {
+        buffer.PutString(s, size);
+    }
+    static void GetOutput(TraceReader& reader, char* s, size_t size) {
+        reader.GetString(s, size);
+    }
+};
+
+template<typename T>
+struct ArgCodec<T const*> {
+    static void PutInput(TraceBuffer& buffer, T const* p) {
+        buffer.PutValue(bool(p));
+        if (p)
+            buffer.PutValue(*p);
+    }
+    static void PutOutput(TraceBuffer&, T const*, size_t) {}
+    static void GetOutput(TraceReader&, T const*, size_t) {}
+};
+
+template<typename T>
+struct ArgCodec<T*> {
+    static void PutInput(TraceBuffer&, T*) {}
+    static void PutOutput(TraceBuffer& buffer, T* p, size_t) {
+        buffer.PutValue(bool(p));
+        if (p)
+            buffer.PutValue(*p);
+    }
+    static void GetOutput(TraceReader& reader, T* p, size_t) {
+        bool present = false;
+        reader.GetValue(&present);
+        if (present) {
+            T value;
+            if (reader.GetValue(&value) && p)
+                *p = value;
+        }
+    }
+};
+
+// Output by reference (e.g. KIM_GetDriveOPParameters)
+template<typename T>
+struct ArgCodec<T&> {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+        "Unsupported Kinesis parameter type");
+    static void PutInput(TraceBuffer&, T&) {}
+    static void PutOutput(TraceBuffer& buffer, T& r, size_t) { buffer.PutValue(r); }
+    static void GetOutput(TraceReader& reader, T& r, size_t) { reader.GetValue(&r); }
+};
+
+
+class CallTrace {
+public:
+    struct Response {
+        std::string outputs;
+        std::string result;
+        std::chrono::nanoseconds duration;
+    };
+
+    // Record all calls to a ring buffer file of the given size; the oldest
+    // calls are overwritten when it is full.
+    static bool StartRecording(std::string const& path, uint64_t sizeBytes);
+
+    // Serve all calls from a recorded trace instead of the DLLs, which are
+    // then not loaded. With originalTiming, each call takes as long as it
+    // did when recorded; otherwise responses are returned immediately.
+    // Replay cannot be turned off once started, because DLL functions are
+    // resolved to placeholders.
+    static bool StartReplay(std::string const& path, bool originalTiming);
+
+    // Close the trace file (recording), or discard the trace (replay)
+    static void Stop();
+
+    static bool IsRecording();
+    static bool IsReplaying();
+
+    // For InstrumentedCall
+    static void Append(size_t function,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::duration duration,
+        TraceBuffer const& inputs, TraceBuffer const& outputs,
+        TraceBuffer const& result);
+    static bool FindResponse(size_t function, TraceBuffer const& inputs,
+        Response* response);
+    static void WaitForReplay(Response const& response);
+};
@@ -0,0 +1,112 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "CallTrace.h"
+#include "Instrumentation.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Call trace file format, shared by the recorder (CallTrace.cpp, which writes
+// through a Windows file mapping) and the player (CallTraceReplay.cpp, which
+// uses only standard C++ so that traces can be read on any platform).
+namespace CallTraceFile {
+    // Trace file layout: TraceFileHeader, followed by the ring buffer of
+    // records (each a TraceRecordHeader followed by the input, output, and
+    // result bytes, padded to a multiple of 8 bytes). Offsets in the header
+    // are logical (ever-increasing); the position in the ring is the
+    // logical offset modulo the capacity. A record never straddles the end
+    // of the ring: the remainder is skipped (and marked with a wrap record
+    // if there is room for one).
+
+    char const TraceMagic[8] = { 'K', 'I', 'N', 'T', 'R', 'A', 'C', 'E' };
+    uint32_t const TraceVersion = 1;
+    size_t const FunctionNameSize = 96;
+
+    struct TraceFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t capacity;
+        uint64_t head; // One past the newest record
+        uint64_t tail; // Oldest record
+        // "Library!Name" by function id; empty if not (yet) called
+        char functions[Instrumentation::MaxFunctions][FunctionNameSize];
+    };
+
+    uint16_t const WrapRecord = 0xffff;
+
+    struct TraceRecordHeader {
+        uint32_t size; // Including this header and padding
+        uint16_t function;
+        uint16_t reserved;
+        uint32_t thread;
+        uint32_t inputsSize;
+        uint32_t outputsSize;
+        uint32_t resultSize;
+        uint64_t startNs; // Since start of recording
+        uint64_t durationNs;
+    };
+
+    inline uint64_t RoundUp8(uint64_t n) {
+        return (n + 7) & ~uint64_t(7);
+    }
+}
+
+
+// Recorded responses loaded from a trace file, by function and inputs
+class TracePlayer {
+    struct Queue {
+        std::vector<CallTrace::Response> responses;
+        size_t next = 0;
+    };
+
+    // By "Library!Name", then by input bytes
+    std::map<std::string, std::map<std::string, Queue>> queues_;
+    bool const originalTiming_;
+
+public:
+    explicit TracePlayer(bool originalTiming) :
+        originalTiming_{ originalTiming }
+    {}
+
+    bool OriginalTiming() const { return originalTiming_; }
+
+    bool Load(std::string const& path);
+    bool Find(std::string const& function, std::string const& inputs,
+        CallTrace::Response* response);
+};
@@ -0,0 +1,114 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "CallTraceFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+using namespace CallTraceFile;
+
+
+bool
+TracePlayer::Load(std::string const& path) {
+    std::ifstream stream{ path, std::ios::binary };
+    if (!stream)
+        return false;
+    std::string const file{ std::istreambuf_iterator<char>(stream),
+        std::istreambuf_iterator<char>() };
+
+    if (file.size() < sizeof(TraceFileHeader))
+        return false;
+    auto header = std::make_unique<TraceFileHeader>();
+    std::memcpy(header.get(), file.data(), sizeof(TraceFileHeader));
+    if (std::memcmp(header->magic, TraceMagic, sizeof(TraceMagic)) != 0 ||
+        header->version != TraceVersion ||
+        header->headerSize != sizeof(TraceFileHeader) ||
+        file.size() < sizeof(TraceFileHeader) + header->capacity)
+        return false;
+
+    char const* ring = file.data() + sizeof(TraceFileHeader);
+    uint64_t const capacity = header->capacity;
+    for (uint64_t pos = header->tail; pos < header->head; ) {
+        uint64_t const remaining = capacity - pos % capacity;
+        if (remaining < sizeof(TraceRecordHeader)) {
+            pos += remaining;
+            continue;
+        }
+        TraceRecordHeader record;
+        std::memcpy(&record, ring + pos % capacity, sizeof(record));
+        if (record.size < sizeof(TraceRecordHeader) || record.size > remaining)
+            return false; // Corrupt
+        if (sizeof(record) + uint64_t(record.inputsSize) + record.outputsSize +
+            record.resultSize > record.size)
+            return false; // Corrupt
+        pos += record.size;
+        if (record.function == WrapRecord ||
+            record.function >= Instrumentation::MaxFunctions)
+            continue;
+
+        char const* p = ring + (pos - record.size) % capacity + sizeof(record);
+        std::string inputs{ p, record.inputsSize };
+        p += record.inputsSize;
+        CallTrace::Response response;
+        response.outputs.assign(p, record.outputsSize);
+        p += record.outputsSize;
+        response.result.assign(p, record.resultSize);
+        response.duration = std::chrono::nanoseconds{ record.durationNs };
+
+        char const* name = header->functions[record.function];
+        std::string const function{ name, strnlen(name, FunctionNameSize) };
+        queues_[function][inputs].responses.push_back(std::move(response));
+    }
+    return true;
+}
+
+
+bool
+TracePlayer::Find(std::string const& function, std::string const& inputs,
+    CallTrace::Response* response) {
+    auto byFunction = queues_.find(function);
+    if (byFunction == queues_.end())
+        return false;
+    auto byInputs = byFunction->second.find(inputs);
+    if (byInputs == byFunction->second.end())
+        return false;
+    Queue& queue = byInputs->second;
+    if (queue.responses.empty())
+        return false;
+    *response = queue.responses[queue.next];
+    if (queue.next + 1 < queue.responses.size())
+        ++queue.next;
+    return true;
+}
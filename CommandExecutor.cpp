@@ -0,0 +1,149 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "CommandExecutor.h"
+
+#include <algorithm>
+#include <sstream>
+
+
+void
+CommandExecutor::Acquire(Lane lane) {
+    std::unique_lock<std::mutex> lock{ mutex_ };
+
+    auto const self = std::this_thread::get_id();
+    if (nesting_ > 0 && owner_ == self) {
+        ++nesting_;
+        return;
+    }
+
+    auto const start = Clock::now();
+    uint64_t const ticket = nextTicket_[lane]++;
+
+    LaneStatistics& stats = stats_[lane];
+    unsigned const depth = static_cast<unsigned>(ticket - nowServing_[lane] + 1);
+    stats.maxQueueDepth = std::max(stats.maxQueueDepth, depth);
+
+    cv_.wait(lock, [&] {
+        return nesting_ == 0 &&
+            nowServing_[lane] == ticket &&
+            !IsHigherLaneWaiting(lane);
+    });
+
+    owner_ = self;
+    nesting_ = 1;
+    activeLane_ = lane;
+
+    double const waitUs = std::chrono::duration<double, std::micro>(
+        Clock::now() - start).count();
+    ++stats.calls;
+    stats.totalWaitUs += waitUs;
+    stats.maxWaitUs = std::max(stats.maxWaitUs, waitUs);
+}
+
+
+void
+CommandExecutor::Release() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        if (--nesting_ > 0)
+            return;
+
+        owner_ = std::thread::id{};
+        ++nowServing_[activeLane_];
+    }
+    cv_.notify_all();
+}
+
+
+bool
+CommandExecutor::IsHigherLaneWaiting(Lane lane) const {
+    for (int l = 0; l < lane; ++l) {
+        if (nowServing_[l] != nextTicket_[l])
+            return true;
+    }
+    return false;
+}
+
+
+unsigned
+CommandExecutor::QueueDepth(Lane lane) const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    uint64_t depth = nextTicket_[lane] - nowServing_[lane];
+    if (nesting_ > 0 && activeLane_ == lane)
+        --depth; // Not waiting; in progress
+    return static_cast<unsigned>(depth);
+}
+
+
+CommandExecutor::LaneStatistics
+CommandExecutor::GetStatistics(Lane lane) const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return stats_[lane];
+}
+
+
+void
+CommandExecutor::ResetStatistics() {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    stats_.fill(LaneStatistics{});
+}
+
+
+std::string
+CommandExecutor::FormatStatistics() const {
+    std::ostringstream s;
+    for (int l = 0; l < NumLanes; ++l) {
+        auto const lane = static_cast<Lane>(l);
+        auto const stats = GetStatistics(lane);
+        double const meanWaitUs = stats.calls ?
+            stats.totalWaitUs / stats.calls : 0.0;
+        if (l > 0)
+            s << '\n';
+        s << LaneName(lane) << ": " << stats.calls << " calls, " <<
+            "max queue depth " << stats.maxQueueDepth << ", " <<
+            "wait mean " << meanWaitUs << " us, max " <<
+            stats.maxWaitUs << " us";
+    }
+    return s.str();
+}
+
+
+char const*
+CommandExecutor::LaneName(Lane lane) {
+    switch (lane) {
+    case LaneMotion: return "Motion";
+    case LaneConfiguration: return "Configuration";
+    case LaneStatus: return "Status";
+    default: return "Unknown";
+    }
+}
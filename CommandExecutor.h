@@ -0,0 +1,139 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+
+// Serializes all Kinesis calls made through one device connection.
+//
+// Multi-channel controllers are shared by several SingleAxisStage instances
+// (one per channel), and MMCore may call into them from different threads
+// (e.g. Busy() from the acquisition engine while the UI thread reads the
+// position). Nothing in the Kinesis documentation promises that concurrent
+// calls for the same device are safe, so we funnel them through a strand.
+//
+// Rather than handing work to a dedicated thread (which would add a context
+// switch to every call), the calling thread runs its own function once it
+// reaches the head of the queue. Waiting callers are ordered by lane, so that
+// a motion command never waits behind a backlog of status queries; within a
+// lane, calls are served in FIFO order. A call already in progress is never
+// interrupted.
+//
+// Calls made while the current thread is already running inside the executor
+// are run inline, so that wrappers may be nested without deadlocking.
+class CommandExecutor {
+public:
+    enum Lane {
+        LaneMotion = 0, // Moves, homing
+        LaneConfiguration, // Settings, parameters, enable/disable, polling
+        LaneStatus, // Status bits, position, and other read-only queries
+        NumLanes
+    };
+
+    struct LaneStatistics {
+        uint64_t calls = 0;
+        unsigned maxQueueDepth = 0; // Including the caller itself
+        double totalWaitUs = 0.0;
+        double maxWaitUs = 0.0;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread::id owner_;
+    unsigned nesting_ = 0;
+    Lane activeLane_ = LaneMotion; // Valid while nesting_ > 0
+
+    // Per-lane ticket counters give FIFO order within each lane
+    std::array<uint64_t, NumLanes> nextTicket_{};
+    std::array<uint64_t, NumLanes> nowServing_{};
+    std::array<LaneStatistics, NumLanes> stats_{};
+
+    // RAII object that holds the executor for the duration of one call
+    class Turn {
+        CommandExecutor& executor_;
+
+    public:
+        Turn(CommandExecutor& executor, Lane lane) :
+            executor_{ executor }
+        {
+            executor_.Acquire(lane);
+        }
+
+        ~Turn() { executor_.Release(); }
+
+        Turn(Turn const&) = delete;
+        Turn& operator=(Turn const&) = delete;
+    };
+
+public:
+    CommandExecutor() = default;
+
+    // Noncopyable
+    CommandExecutor(CommandExecutor const&) = delete;
+    CommandExecutor& operator=(CommandExecutor const&) = delete;
+
+    // Run f() on the calling thread once it is this lane's turn, and return
+    // its result.
+    template<typename F>
+    decltype(auto) Execute(Lane lane, F&& f) {
+        Turn turn{ *this, lane };
+        return std::forward<F>(f)();
+    }
+
+    // Number of callers currently waiting in the given lane
+    unsigned QueueDepth(Lane lane) const;
+
+    LaneStatistics GetStatistics(Lane lane) const;
+    void ResetStatistics();
+
+    // One line per lane, for logging
+    std::string FormatStatistics() const;
+
+    static char const* LaneName(Lane lane);
+
+private:
+    void Acquire(Lane lane);
+    void Release();
+    bool IsHigherLaneWaiting(Lane lane) const; // Requires mutex_ held
+};
@@ -0,0 +1,222 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "CommandRetrier.h"
+
+#include <algorithm>
+#include <sstream>
+
+
+namespace {
+    std::mutex defaultPolicyMutex;
+    CommandRetrier::Policy defaultPolicy; // Guarded by defaultPolicyMutex
+}
+
+
+CommandRetrier::Policy
+CommandRetrier::GetPolicy() const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return policy_;
+}
+
+
+void
+CommandRetrier::SetPolicy(Policy const& policy) {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    policy_ = policy;
+}
+
+
+CommandRetrier::Statistics
+CommandRetrier::GetStatistics() const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return stats_;
+}
+
+
+bool
+CommandRetrier::IsBreakerOpen() const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return breakerOpen_;
+}
+
+
+void
+CommandRetrier::ResetBreaker() {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    consecutiveFailures_ = 0;
+    breakerOpen_ = false;
+    breakerTrialRunning_ = false;
+}
+
+
+std::string
+CommandRetrier::FormatStatistics() const {
+    Statistics const stats = GetStatistics();
+    std::ostringstream s;
+    s << "retries";
+    for (int c = ErrorClassNone + 1; c < NumErrorClasses; ++c) {
+        s << ' ' << ErrorClassName(static_cast<ErrorClass>(c)) << ' ' <<
+            stats.retries[c];
+    }
+    s << ", recovered " << stats.recovered <<
+        ", exhausted " << stats.exhausted <<
+        ", rejected " << stats.rejected <<
+        ", breaker trips " << stats.breakerTrips;
+    return s.str();
+}
+
+
+CommandRetrier::ErrorClass
+CommandRetrier::ClassOf(short err) {
+    // See KinesisErrorCodes()
+    switch (err) {
+    case 36: // The function could not be completed at this time
+    case 47: // Command temporarily unavailable; device may be busy
+        return ErrorClassBusy;
+    case 4: // An I/O error has occurred
+        return ErrorClassIO;
+    default:
+        return ErrorClassNone;
+    }
+}
+
+
+bool
+CommandRetrier::IsDeviceFailure(short err) {
+    switch (err) {
+    case 7: // The device is no longer present
+    case 33: // The device has stopped responding
+        return true;
+    default:
+        return ClassOf(err) != ErrorClassNone;
+    }
+}
+
+
+char const*
+CommandRetrier::ErrorClassName(ErrorClass errorClass) {
+    switch (errorClass) {
+    case ErrorClassNone: return "None";
+    case ErrorClassBusy: return "Busy";
+    case ErrorClassIO: return "IO";
+    default: return "Unknown";
+    }
+}
+
+
+CommandRetrier::Policy
+CommandRetrier::DefaultPolicy() {
+    std::lock_guard<std::mutex> lock{ defaultPolicyMutex };
+    return defaultPolicy;
+}
+
+
+void
+CommandRetrier::SetDefaultPolicy(Policy const& policy) {
+    std::lock_guard<std::mutex> lock{ defaultPolicyMutex };
+    defaultPolicy = policy;
+}
+
+
+bool
+CommandRetrier::Admit(short* err) {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    if (!breakerOpen_)
+        return true;
+
+    if (!breakerTrialRunning_ &&
+            Clock::now() - breakerOpenedAt_ >= policy_.breakerCooldown) {
+        breakerTrialRunning_ = true;
+        return true;
+    }
+
+    ++stats_.rejected;
+    *err = breakerError_;
+    return false;
+}
+
+
+bool
+CommandRetrier::NextBackoff(ErrorClass errorClass, unsigned attempt,
+    Clock::time_point start, std::chrono::milliseconds* backoff) {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    if (attempt >= policy_.maxAttempts[errorClass])
+        return false;
+    // Do not keep retrying a device that the breaker has given up on
+    if (breakerOpen_ && !breakerTrialRunning_)
+        return false;
+
+    *backoff = attempt == 1 ? policy_.initialBackoff :
+        std::min(*backoff * 2, policy_.maxBackoff);
+    if (Clock::now() + *backoff - start > policy_.latencyBudget)
+        return false;
+
+    ++stats_.retries[errorClass];
+    return true;
+}
+
+
+void
+CommandRetrier::Complete(short err, unsigned attempts, bool breaker) {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    bool const failed = IsDeviceFailure(err);
+
+    if (attempts > 1) {
+        if (err == 0)
+            ++stats_.recovered;
+        else
+            ++stats_.exhausted;
+    }
+
+    if (!breaker)
+        return;
+
+    if (!failed) {
+        consecutiveFailures_ = 0;
+        breakerOpen_ = false;
+        breakerTrialRunning_ = false;
+        return;
+    }
+
+    ++consecutiveFailures_;
+    bool const trialFailed = breakerTrialRunning_;
+    breakerTrialRunning_ = false;
+    if (trialFailed || (policy_.breakerThreshold > 0 &&
+            consecutiveFailures_ >= policy_.breakerThreshold && !breakerOpen_)) {
+        if (!breakerOpen_)
+            ++stats_.breakerTrips;
+        breakerOpen_ = true;
+        breakerOpenedAt_ = Clock::now();
+        breakerError_ = err;
+    }
+}
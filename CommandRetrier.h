@@ -0,0 +1,172 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+// Retries Kinesis commands that fail with transient errors.
+//
+// Some errors (e.g. 47, "Command temporarily unavailable; device may be
+// busy") say nothing about the command itself and usually go away if the
+// command is simply repeated a little later. Rather than surfacing these to
+// MMCore (which aborts an acquisition on any error), commands are retried
+// with exponential backoff, as long as the total time spent does not exceed
+// a latency budget.
+//
+// If commands keep failing even after retrying, the device is probably gone;
+// a circuit breaker then fails further commands immediately (with the last
+// error) for a cooldown period, instead of hammering the device with
+// retries. After the cooldown, one command is let through; if it succeeds,
+// normal operation resumes. Only commands run with the breaker enabled (all
+// but read-only status queries) are counted towards or failed by the
+// breaker, so that a flaky status query cannot hold up moves.
+//
+// One retrier is owned by each device connection, so that all channels of a
+// controller share the breaker. Each attempt is a separate turn on the
+// connection's CommandExecutor, so that backoff does not hold up other
+// callers.
+class CommandRetrier {
+public:
+    enum ErrorClass {
+        ErrorClassNone = 0, // Success or an error that is not retried
+        ErrorClassBusy, // 36, 47: device could not take the command now
+        ErrorClassIO, // 4: communication error
+        NumErrorClasses
+    };
+
+    struct Policy {
+        // Maximum attempts, including the first, for each error class
+        std::array<unsigned, NumErrorClasses> maxAttempts{ { 1, 5, 3 } };
+        std::chrono::milliseconds initialBackoff{ 5 };
+        std::chrono::milliseconds maxBackoff{ 100 };
+        // No retry is started once this much time has passed since the
+        // first attempt began (so the worst case is the budget plus the
+        // duration of one attempt)
+        std::chrono::milliseconds latencyBudget{ 500 };
+        // Consecutive failed commands (after retries) that open the breaker;
+        // zero disables the breaker
+        unsigned breakerThreshold = 5;
+        std::chrono::milliseconds breakerCooldown{ 2000 };
+    };
+
+    struct Statistics {
+        std::array<uint64_t, NumErrorClasses> retries{}; // By error class
+        uint64_t recovered = 0; // Commands that succeeded after a retry
+        uint64_t exhausted = 0; // Commands that failed despite retries
+        uint64_t rejected = 0; // Commands failed by the open breaker
+        uint64_t breakerTrips = 0;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    mutable std::mutex mutex_;
+    Policy policy_;
+    Statistics stats_;
+    unsigned consecutiveFailures_ = 0;
+    bool breakerOpen_ = false;
+    bool breakerTrialRunning_ = false; // A command let through after cooldown
+    Clock::time_point breakerOpenedAt_{};
+    short breakerError_ = 0;
+
+public:
+    CommandRetrier() :
+        policy_{ DefaultPolicy() }
+    {}
+
+    // Noncopyable
+    CommandRetrier(CommandRetrier const&) = delete;
+    CommandRetrier& operator=(CommandRetrier const&) = delete;
+
+    // Run f(), which returns a Kinesis error code, retrying according to the
+    // policy. Return the final error code. If breaker is false, the command
+    // is neither failed by nor counted towards the breaker.
+    template<typename F>
+    short Execute(F&& f, bool breaker = true) {
+        short err;
+        if (breaker && !Admit(&err))
+            return err;
+
+        auto const start = Clock::now();
+        std::chrono::milliseconds backoff{ 0 };
+        for (unsigned attempt = 1; ; ++attempt) {
+            err = f();
+            ErrorClass const errorClass = ClassOf(err);
+            if (errorClass == ErrorClassNone) {
+                Complete(err, attempt, breaker);
+                return err;
+            }
+            if (!NextBackoff(errorClass, attempt, start, &backoff)) {
+                Complete(err, attempt, breaker);
+                return err;
+            }
+            std::this_thread::sleep_for(backoff);
+        }
+    }
+
+    Policy GetPolicy() const;
+    void SetPolicy(Policy const& policy);
+
+    Statistics GetStatistics() const;
+    bool IsBreakerOpen() const;
+    // Close the breaker and forget past failures
+    void ResetBreaker();
+
+    // One line, for logging
+    std::string FormatStatistics() const;
+
+    static ErrorClass ClassOf(short err);
+    // Whether err counts towards opening the breaker: transient errors that
+    // persisted through retries, and errors saying the device is gone
+    static bool IsDeviceFailure(short err);
+    static char const* ErrorClassName(ErrorClass errorClass);
+
+    // Policy given to retriers created from now on
+    static Policy DefaultPolicy();
+    static void SetDefaultPolicy(Policy const& policy);
+
+private:
+    // Return false (setting *err) if the breaker rejects the command
+    bool Admit(short* err);
+    // Return false if no further attempt should be made; otherwise count
+    // the retry and set *backoff to the delay before it
+    bool NextBackoff(ErrorClass errorClass, unsigned attempt,
+        Clock::time_point start, std::chrono::milliseconds* backoff);
+    void Complete(short err, unsigned attempts, bool breaker);
+};
@@ -32,80 +32,193 @@
 
 #include "Connections.h"
 
+#include "Broker.h"
 #include "DeviceEnumeration.h"
+#include "FaultInjection.h"
 
-#include "BenchtopBrushless200.h"
-#include "BenchtopBrushless300.h"
-#include "BenchtopDCServo.h"
-#include "BenchtopStepper.h"
-#include "KCubeBrushless.h"
-#include "KCubeDCServo.h"
-#include "KCubeStepper.h"
-#include "TCubeBrushless.h"
-#include "TCubeDCServo.h"
-#include "TCubeStepper.h"
-#include "IntegratedStepper.h"
-#include "VerticalStage.h"
+#include "DeviceFamilies.h"
+#include "MotorFamilies.h"
+#include "PiezoFamilies.h"
+
+
+namespace {
+    MotorFamilyEntry const* FamilyOfSerialNo(std::string const& serialNo) {
+        switch (TypeIDOfSerialNo(serialNo)) {
+        case TypeIDBenchtopBrushless200:
+            return &BenchtopBrushless200Family();
+        case TypeIDBenchtopBrushless300:
+            return &BenchtopBrushless300Family();
+        case TypeIDBenchtopDCServo1Channel:
+        case TypeIDBenchtopDCServo3Channel:
+            return &BenchtopDCServoFamily();
+
+        case TypeIDBenchtopStepper1Channel:
+        case TypeIDBenchtopStepper3Channel:
+            return &BenchtopStepperFamily();
+
+        case TypeIDKCubeBrushless:
+            return &KCubeBrushlessFamily();
+
+        case TypeIDKCubeDCServo:
+            return &KCubeDCServoFamily();
+
+        case TypeIDKCubeStepper:
+            return &KCubeStepperFamily();
+
+        case TypeIDModularStepper:
+            return &ModularStepperFamily();
+
+        case TypeIDTCubeBrushless:
+            return &TCubeBrushlessFamily();
+
+        case TypeIDTCubeDCServo:
+            return &TCubeDCServoFamily();
+
+        case TypeIDTCubeStepper:
+            return &TCubeStepperFamily();
+
+        case TypeIDLabJack050:
+        case TypeIDLabJack490:
+        case TypeIDLongTravelStage:
+        case TypeIDCageRotator:
+            return &IntegratedStepperFamily();
+
+        case TypeIDVerticalStage:
+            return &VerticalStageFamily();
+
+        default:
+            return nullptr;
+        }
+    }
+
+
+    PiezoFamilyEntry const* PiezoFamilyOfSerialNo(std::string const& serialNo) {
+        switch (TypeIDOfSerialNo(serialNo)) {
+        case TypeIDBenchtopPiezo1Channel:
+        case TypeIDBenchtopPiezo3Channel:
+            return &BenchtopPiezoFamily();
+
+        case TypeIDKCubePiezo:
+            return &KCubePiezoFamily();
+
+        case TypeIDTCubePiezo:
+            return &TCubePiezoFamily();
+
+        default:
+            return nullptr;
+        }
+    }
+
+
+    DeviceFamilyEntry<FlipperDrive> const* FlipperFamilyOfSerialNo(std::string const& serialNo) {
+        if (TypeIDOfSerialNo(serialNo) == TypeIDFilterFlipper)
+            return &FilterFlipperFamily();
+        return nullptr;
+    }
+
+
+    DeviceFamilyEntry<InertialMotorDrive> const* InertialMotorFamilyOfSerialNo(
+        std::string const& serialNo) {
+        switch (TypeIDOfSerialNo(serialNo)) {
+        case TypeIDKCubeInertialMotor:
+            return &KCubeInertialMotorFamily();
+
+        case TypeIDTCubeInertialMotor:
+            return &TCubeInertialMotorFamily();
+
+        default:
+            return nullptr;
+        }
+    }
+
+
+    DeviceFamilyEntry<SolenoidDrive> const* SolenoidFamilyOfSerialNo(
+        std::string const& serialNo) {
+        switch (TypeIDOfSerialNo(serialNo)) {
+        case TypeIDKCubeSolenoid:
+            return &KCubeSolenoidFamily();
+
+        case TypeIDTCubeSolenoid:
+            return &TCubeSolenoidFamily();
+
+        default:
+            return nullptr;
+        }
+    }
+
+
+    DeviceFamilyEntry<StrainGaugeDrive> const* StrainGaugeFamilyOfSerialNo(
+        std::string const& serialNo) {
+        switch (TypeIDOfSerialNo(serialNo)) {
+        case TypeIDKCubeStrainGauge:
+            return &KCubeStrainGaugeFamily();
+
+        case TypeIDTCubeStrainGauge:
+            return &TCubeStrainGaugeFamily();
+
+        default:
+            return nullptr;
+        }
+    }
+
+
+    DeviceFamilyEntry<PolarizerDrive> const* PolarizerFamilyOfSerialNo(
+        std::string const& serialNo) {
+        if (TypeIDOfSerialNo(serialNo) == TypeIDPolarizer)
+            return &PolarizerFamily();
+        return nullptr;
+    }
+
+
+    DeviceFamilyEntry<FilterWheelDrive> const* FilterWheelFamilyOfSerialNo(
+        std::string const& serialNo) {
+        if (TypeIDOfSerialNo(serialNo) == TypeIDFilterWheel)
+            return &FilterWheelFamily();
+        return nullptr;
+    }
+
+
+    using AccessMaker = std::unique_ptr<KinesisDeviceAccess> (*)(std::string const&);
+
+    // Null if the device type is not supported
+    AccessMaker AccessMakerOfSerialNo(std::string const& serialNo) {
+        if (MotorFamilyEntry const* family = FamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (PiezoFamilyEntry const* family = PiezoFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (auto family = FlipperFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (auto family = InertialMotorFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (auto family = SolenoidFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (auto family = StrainGaugeFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (auto family = PolarizerFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        if (auto family = FilterWheelFamilyOfSerialNo(serialNo))
+            return family->makeAccess;
+        return nullptr;
+    }
+} // namespace
 
 
 std::shared_ptr<KinesisDeviceConnection> MakeConnection(std::string const& serialNo) {
-    std::unique_ptr<KinesisDeviceAccess> access;
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDBenchtopBrushless200:
-        access = std::make_unique<BenchtopBrushless200Access>(serialNo);
-        break;
-    case TypeIDBenchtopBrushless300:
-        access = std::make_unique<BenchtopBrushless300Access>(serialNo);
-        break;
-    case TypeIDBenchtopDCServo1Channel:
-    case TypeIDBenchtopDCServo3Channel:
-        access = std::make_unique<BenchtopDCServoAccess>(serialNo);
-        break;
-
-    case TypeIDBenchtopStepper1Channel:
-    case TypeIDBenchtopStepper3Channel:
-        access = std::make_unique<BenchtopStepperAccess>(serialNo);
-        break;
-
-    case TypeIDKCubeBrushless:
-        access = std::make_unique<KCubeBrushlessAccess>(serialNo);
-        break;
-
-    case TypeIDKCubeDCServo:
-        access = std::make_unique<KCubeDCServoAccess>(serialNo);
-        break;
-
-    case TypeIDKCubeStepper:
-        access = std::make_unique<KCubeStepperAccess>(serialNo);
-        break;
-
-    case TypeIDTCubeBrushless:
-        access = std::make_unique<TCubeBrushlessAccess>(serialNo);
-        break;
-
-    case TypeIDTCubeDCServo:
-        access = std::make_unique<TCubeDCServoAccess>(serialNo);
-        break;
-
-    case TypeIDTCubeStepper:
-        access = std::make_unique<TCubeStepperAccess>(serialNo);
-        break;
-
-    case TypeIDLabJack050:
-    case TypeIDLabJack490:
-    case TypeIDLongTravelStage:
-    case TypeIDCageRotator:
-        access = std::make_unique<IntegratedStepperAccess>(serialNo);
-        break;
-
-    case TypeIDVerticalStage:
-        access = std::make_unique<VerticalStageAccess>(serialNo);
-        break;
-
-    default:
+    if (!DeviceFilter::Active().Allows(serialNo))
+        return {};
+    AccessMaker makeAccess = AccessMakerOfSerialNo(serialNo);
+    if (!makeAccess)
         return {};
+    auto broker = BrokerClient::Active();
+    std::unique_ptr<KinesisDeviceAccess> access;
+    if (broker)
+        access = std::make_unique<BrokerAccess>(broker, serialNo);
+    else
+        access = makeAccess(serialNo);
+    if (FaultSchedule::IsActive()) {
+        access = std::make_unique<FaultInjectingAccess>(std::move(access),
+            FaultSchedule::Active());
     }
-
     return UniqueConnection(std::move(access));
 }
 
@@ -113,47 +226,130 @@ std::shared_ptr<KinesisDeviceConnection> MakeConnection(std::string const& seria
 std::unique_ptr<MotorDrive> MakeKinesisMotorDrive(
     std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
 
-    switch (TypeIDOfSerialNo(connection->SerialNo())) {
-    case TypeIDBenchtopBrushless200:
-        return std::make_unique<BenchtopBrushless200>(connection, channel);
-    case TypeIDBenchtopBrushless300:
-        return std::make_unique<BenchtopBrushless300>(connection, channel);
-    case TypeIDBenchtopDCServo1Channel:
-    case TypeIDBenchtopDCServo3Channel:
-        return std::make_unique<BenchtopDCServo>(connection, channel);
+    MotorFamilyEntry const* family = FamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    auto broker = BrokerClient::Active();
+    std::unique_ptr<MotorDrive> drive;
+    if (broker)
+        drive = std::make_unique<BrokerMotorDrive>(broker, connection, channel);
+    else
+        drive = family->makeDrive(connection, channel);
+    if (drive && FaultSchedule::IsActive()) {
+        drive = MakeFaultInjectingMotorDrive(std::move(drive),
+            FaultSchedule::Active());
+    }
+    return drive;
+}
+
 
-    case TypeIDBenchtopStepper1Channel:
-    case TypeIDBenchtopStepper3Channel:
-        return std::make_unique<BenchtopStepper>(connection, channel);
+std::unique_ptr<PiezoDrive> MakeKinesisPiezoDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+
+    PiezoFamilyEntry const* family = PiezoFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    // The broker only forwards motor commands
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, channel);
+}
 
-    case TypeIDKCubeBrushless:
-        return std::make_unique<KCubeBrushless>(connection);
 
-    case TypeIDKCubeDCServo:
-        return std::make_unique<KCubeDCServo>(connection);
+std::unique_ptr<FlipperDrive> MakeKinesisFlipperDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection) {
 
-    case TypeIDKCubeStepper:
-        return std::make_unique<KCubeStepper>(connection);
+    auto family = FlipperFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, -1);
+}
 
-    case TypeIDTCubeBrushless:
-        return std::make_unique<TCubeBrushless>(connection);
 
-    case TypeIDTCubeDCServo:
-        return std::make_unique<TCubeDCServo>(connection);
+std::unique_ptr<InertialMotorDrive> MakeKinesisInertialMotorDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
 
-    case TypeIDTCubeStepper:
-        return std::make_unique<TCubeStepper>(connection);
+    auto family = InertialMotorFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, channel);
+}
 
-    case TypeIDLabJack050:
-    case TypeIDLabJack490:
-    case TypeIDLongTravelStage:
-    case TypeIDCageRotator:
-        return std::make_unique<IntegratedStepper>(connection);
 
-    case TypeIDVerticalStage:
-        return std::make_unique<VerticalStage>(connection);
+std::unique_ptr<SolenoidDrive> MakeKinesisSolenoidDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection) {
 
-    default:
+    auto family = SolenoidFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
         return {};
-    }
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, -1);
+}
+
+
+std::unique_ptr<StrainGaugeDrive> MakeKinesisStrainGaugeDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection) {
+
+    auto family = StrainGaugeFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, -1);
+}
+
+
+std::unique_ptr<PolarizerDrive> MakeKinesisPolarizerDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection) {
+
+    auto family = PolarizerFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, -1);
+}
+
+
+std::unique_ptr<FilterWheelDrive> MakeKinesisFilterWheelDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection) {
+
+    auto family = FilterWheelFamilyOfSerialNo(connection->SerialNo());
+    if (!family)
+        return {};
+    if (BrokerClient::Active())
+        return {};
+    return family->makeDrive(connection, -1);
+}
+
+
+bool PollsChannelsTogether(std::string const& serialNo) {
+    MotorFamilyEntry const* family = FamilyOfSerialNo(serialNo);
+    return family && family->pollChannelsTogether;
+}
+
+
+std::vector<std::string> MissingKinesisFunctions(std::string const& serialNo) {
+    if (MotorFamilyEntry const* family = FamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (PiezoFamilyEntry const* family = PiezoFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (auto family = FlipperFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (auto family = InertialMotorFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (auto family = SolenoidFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (auto family = StrainGaugeFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (auto family = PolarizerFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    if (auto family = FilterWheelFamilyOfSerialNo(serialNo))
+        return family->missingFunctions();
+    return {};
 }
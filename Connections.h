@@ -35,21 +35,38 @@
 #include "KinesisDevice.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+
+// Connections uniqued by serial number
+// MMCore serializes its calls, but broker clients (see Broker.h) open
+// connections from the server's threads, and the device monitor checks for
+// open connections from its own thread, hence the lock.
+struct ConnectionRegistry {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<KinesisDeviceConnection>> connections;
+
+    static ConnectionRegistry& Instance() {
+        static ConnectionRegistry registry;
+        return registry;
+    }
+};
 
 
 // Get the connection to the given device if one exists; otherwise make the
 // connection using the given callback.
-// This is not thread safe, but MMCore ensures synchronization for us.
 inline std::shared_ptr<KinesisDeviceConnection> UniqueConnection(
     std::unique_ptr<KinesisDeviceAccess> access) {
 
-    // Connections uniqued by serial number
-    static std::unordered_map<std::string, std::weak_ptr<KinesisDeviceConnection>> connections;
+    ConnectionRegistry& registry = ConnectionRegistry::Instance();
+    auto& connections = registry.connections;
+    std::lock_guard<std::mutex> lock{ registry.mutex };
 
     // Prune closed connections
-    decltype(connections) pruned;
+    decltype(registry.connections) pruned;
     for (auto&& item : connections) {
         if (!item.second.expired())
             pruned.emplace(std::move(item));
@@ -69,7 +86,59 @@ inline std::shared_ptr<KinesisDeviceConnection> UniqueConnection(
 }
 
 
+// Whether a connection to the given device is currently in use
+inline bool IsConnectionOpen(std::string const& serialNo) {
+    ConnectionRegistry& registry = ConnectionRegistry::Instance();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    auto existing = registry.connections.find(serialNo);
+    return existing != registry.connections.end() && !existing->second.expired();
+}
+
+
 std::shared_ptr<KinesisDeviceConnection> MakeConnection(std::string const& serialNo);
 
 std::unique_ptr<MotorDrive> MakeKinesisMotorDrive(
     std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+
+// Null if the device is not a piezo controller, or if connected through a
+// broker (which does not support piezos)
+std::unique_ptr<PiezoDrive> MakeKinesisPiezoDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+
+// Null if the device is not a filter flipper, or if connected through a
+// broker
+std::unique_ptr<FlipperDrive> MakeKinesisFlipperDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection);
+
+// Null if the device is not an inertial motor controller, or if connected
+// through a broker
+std::unique_ptr<InertialMotorDrive> MakeKinesisInertialMotorDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+
+// Null if the device is not a solenoid controller, or if connected through
+// a broker
+std::unique_ptr<SolenoidDrive> MakeKinesisSolenoidDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection);
+
+// Null if the device is not a strain gauge reader, or if connected through
+// a broker
+std::unique_ptr<StrainGaugeDrive> MakeKinesisStrainGaugeDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection);
+
+// Null if the device is not a polarization controller, or if connected
+// through a broker
+std::unique_ptr<PolarizerDrive> MakeKinesisPolarizerDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection);
+
+// Null if the device is not a filter wheel, or if connected through a
+// broker
+std::unique_ptr<FilterWheelDrive> MakeKinesisFilterWheelDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection);
+
+// Whether the channels of the given device should be polled together (see
+// StatusPollerGroup); false if it is not a motor controller
+bool PollsChannelsTogether(std::string const& serialNo);
+
+// Names of required functions missing from the Kinesis DLL for the given
+// device; nonempty if the DLL was loaded but rejected as incompatible.
+std::vector<std::string> MissingKinesisFunctions(std::string const& serialNo);
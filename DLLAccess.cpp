@@ -65,3 +65,37 @@ DLLAccess::Unload(HMODULE h) {
     if (h)
         FreeLibrary(h);
 }
+
+
+namespace {
+    void NotCalled() {}
+}
+
+
+FARPROC
+DLLAccess::ReplayPlaceholder() {
+    return reinterpret_cast<FARPROC>(&NotCalled);
+}
+
+
+size_t
+FunctionTable::Resolve(DLLAccess& dll) {
+    size_t unresolved = 0;
+    for (DLLFuncBase* func : functions_) {
+        if (!func->Resolve(dll) && func->IsRequired())
+            ++unresolved;
+    }
+    return unresolved;
+}
+
+
+std::vector<std::string>
+FunctionTable::UnresolvedFunctions(Requirement requirement) const {
+    bool const required = requirement == RequirementRequired;
+    std::vector<std::string> ret;
+    for (DLLFuncBase const* func : functions_) {
+        if (!func->IsResolved() && func->IsRequired() == required)
+            ret.push_back(func->Name());
+    }
+    return ret;
+}
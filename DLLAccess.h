@@ -32,9 +32,12 @@
 
 #pragma once
 
+#include "Instrumentation.h"
+
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <Windows.h>
 
@@ -71,39 +74,130 @@ public:
     }
 
     bool IsValid() {
+        if (CallTrace::IsReplaying())
+            return true; // Calls are answered from the trace
         if (!dll_) {
             dll_ = Load(name_);
         }
         return dll_ != nullptr;
     }
 
-    template<typename F>
-    F* GetFunction(char const* func) {
+    std::string Name() const { return name_; }
+
+    FARPROC GetProc(char const* func) {
+        if (CallTrace::IsReplaying())
+            return ReplayPlaceholder();
         if (!IsValid())
             return nullptr;
-        return reinterpret_cast<F*>(GetProcAddress(dll_, func));
+        return GetProcAddress(dll_, func);
+    }
+
+    template<typename F>
+    F* GetFunction(char const* func) {
+        return reinterpret_cast<F*>(GetProc(func));
     }
 
 private:
     static HMODULE Load(std::string const& name);
     static void Unload(HMODULE h);
+
+    // Non-null stand-in for functions during replay (never called)
+    static FARPROC ReplayPlaceholder();
+};
+
+
+// Type-independent part of DLLFunc, so that a table of functions can be
+// resolved without knowing their signatures.
+class DLLFuncBase {
+    char const* const name_;
+    bool const required_;
+
+protected:
+    FARPROC proc_{ nullptr };
+    size_t functionId_{ Instrumentation::NoFunction };
+
+    DLLFuncBase(char const* name, bool required) :
+        name_{ name },
+        required_{ required }
+    {}
+
+public:
+    // Noncopyable
+    DLLFuncBase(DLLFuncBase const&) = delete;
+    DLLFuncBase& operator=(DLLFuncBase const&) = delete;
+
+    char const* Name() const { return name_; }
+    bool IsRequired() const { return required_; }
+    bool IsResolved() const { return proc_ != nullptr; }
+
+    bool Resolve(DLLAccess& dll) {
+        proc_ = dll.GetProc(name_);
+        if (IsResolved())
+            functionId_ = Instrumentation::FunctionId(dll.Name(), name_);
+        return IsResolved();
+    }
+};
+
+
+// A set of DLLFunc objects that are resolved together, when the DLL is
+// loaded. Derived classes declare their DLLFunc members with the table as
+// the first constructor argument (see KINESIS_FUNCTION in MotorFamily.h),
+// which registers them.
+class FunctionTable {
+    std::vector<DLLFuncBase*> functions_;
+
+public:
+    enum Requirement {
+        RequirementRequired,
+        RequirementOptional, // Absence disables a feature
+    };
+
+    FunctionTable() = default;
+
+    // Noncopyable (members refer to this object)
+    FunctionTable(FunctionTable const&) = delete;
+    FunctionTable& operator=(FunctionTable const&) = delete;
+
+    void Register(DLLFuncBase& func) { functions_.push_back(&func); }
+
+    // Resolve every registered function; return the number of required
+    // functions that could not be found. If nonzero, the table must not be
+    // used.
+    size_t Resolve(DLLAccess& dll);
+
+    // Names of functions that were not found
+    std::vector<std::string> UnresolvedFunctions(Requirement requirement) const;
+
+    std::vector<DLLFuncBase*> const& Functions() const { return functions_; }
 };
 
 
 // Object to cache function pointer and wrap call to it.
 // F = decltype of the function.
 template<typename F>
-class DLLFunc {
-    F* const func_;
-
+class DLLFunc : public DLLFuncBase {
 public:
+    // Resolve immediately
     DLLFunc(DLLAccess& dll, char const* func) :
-        func_{ dll.GetFunction<F>(func) }
-    {}
+        DLLFuncBase{ func, true }
+    {
+        Resolve(dll);
+    }
+
+    // Resolve later, together with the rest of the table
+    DLLFunc(FunctionTable& table, char const* func,
+        FunctionTable::Requirement requirement = FunctionTable::RequirementRequired) :
+        DLLFuncBase{ func, requirement == FunctionTable::RequirementRequired }
+    {
+        table.Register(*this);
+    }
 
     template<typename... Args>
-    decltype(auto) operator()(Args&&... args) {
-        return func_(std::forward<Args>(args)...);
+    decltype(auto) operator()(Args&&... args) const {
+        if (!Instrumentation::Active())
+            return reinterpret_cast<F*>(proc_)(std::forward<Args>(args)...);
+        return InstrumentedCall<F>::Invoke(functionId_,
+            reinterpret_cast<F*>(proc_), std::forward<Args>(args)...);
     }
 };
 
@@ -43,12 +43,80 @@
 // at a time.
 #include <Thorlabs.MotionControl.Benchtop.BrushlessMotor.h>
 
+#include <cstring>
+#include <mutex>
 #include <sstream>
 
 
 static DLLAccess kinesisDll{ "Thorlabs.MotionControl.Benchtop.BrushlessMotor.dll" };
 
 
+namespace {
+    std::mutex activeFilterMutex;
+    DeviceFilter activeFilter; // Guarded by activeFilterMutex
+
+    bool ParseFilterList(std::string const& list,
+        std::vector<std::string>* patterns, std::vector<int>* typeIDs) {
+        std::istringstream items{ list };
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            auto const first = item.find_first_not_of(" \t");
+            if (first == std::string::npos)
+                continue;
+            item = item.substr(first, item.find_last_not_of(" \t") - first + 1);
+
+            if (item.compare(0, 5, "type:") == 0) {
+                std::istringstream s{ item.substr(5) };
+                int typeID;
+                if (!(s >> typeID) || !s.eof() || typeID <= 0)
+                    return false;
+                typeIDs->push_back(typeID);
+            }
+            else {
+                if (item.find_first_not_of("0123456789*?") != std::string::npos)
+                    return false;
+                patterns->push_back(item);
+            }
+        }
+        return true;
+    }
+
+    bool MatchesPattern(char const* pattern, char const* serialNo) {
+        for (; *pattern; ++pattern, ++serialNo) {
+            if (*pattern == '*') {
+                // Try every possible length for the wildcard
+                for (char const* s = serialNo; ; ++s) {
+                    if (MatchesPattern(pattern + 1, s))
+                        return true;
+                    if (*s == '\0')
+                        return false;
+                }
+            }
+            if (*serialNo == '\0')
+                return false;
+            if (*pattern != '?' && *pattern != *serialNo)
+                return false;
+        }
+        return *serialNo == '\0';
+    }
+
+    bool MatchesAny(std::string const& serialNo,
+        std::vector<std::string> const& patterns,
+        std::vector<int> const& typeIDs) {
+        for (auto const& pattern : patterns) {
+            if (MatchesPattern(pattern.c_str(), serialNo.c_str()))
+                return true;
+        }
+        int const typeID = TypeIDOfSerialNo(serialNo);
+        for (int t : typeIDs) {
+            if (t == typeID)
+                return true;
+        }
+        return false;
+    }
+}
+
+
 struct KinesisDeviceInfo::Impl {
     TLI_DeviceInfo info_;
 
@@ -93,6 +161,7 @@ KinesisDeviceInfo::KinesisDeviceInfo(std::string const& serialNo) :
 {
     STATIC_DLL_FUNC(kinesisDll, TLI_GetDeviceInfo, getDeviceInfoFunc);
 
+    std::lock_guard<std::mutex> lock{ DeviceListMutex() };
     if (!getDeviceInfoFunc(serialNo.c_str(), &impl_->info_)) {
         // Device not present or not valid
         memset(&impl_->info_, 0, sizeof(impl_->info_));
@@ -158,47 +227,119 @@ bool IsKinesisDriverAvailable() {
 
 void EnableSimulatedDevices() {
     STATIC_DLL_FUNC(kinesisDll, TLI_InitializeSimulations, func);
+    std::lock_guard<std::mutex> lock{ DeviceListMutex() };
     func();
 }
 
 
 void DisableSimulatedDevices() {
     STATIC_DLL_FUNC(kinesisDll, TLI_UninitializeSimulations, func);
+    std::lock_guard<std::mutex> lock{ DeviceListMutex() };
     func();
 }
 
 std::vector<std::string> EnumerateSerialNumbers() {
+    std::vector<char> buffer;
+    if (!ReadDeviceList(buffer))
+        return {};
+
+    DeviceFilter const filter = DeviceFilter::Active();
+    std::vector<std::string> ret;
+    ForEachSerialNumber(buffer.data(), [&](char const* serialNo, size_t len) {
+        std::string s{ serialNo, len };
+        if (filter.Allows(s))
+            ret.push_back(std::move(s));
+    });
+    return ret;
+}
+
+
+bool ReadDeviceList(std::vector<char>& buffer) {
     STATIC_DLL_FUNC(kinesisDll, TLI_BuildDeviceList, buildDeviceListFunc);
     STATIC_DLL_FUNC(kinesisDll, TLI_GetDeviceListSize, getDeviceListSizeFunc);
     STATIC_DLL_FUNC(kinesisDll, TLI_GetDeviceListExt, getDeviceListExtFunc);
 
     // TLI_BuildDeviceList() fails with error 16 (FT_NoDLLLoaded) if we don't
-    // help it load this FTDI DLL in the Thorlabs/Kinesis directory.
-    DLLAccess ftdiDll{ "ftd2xx.dll" };
+    // help it load this FTDI DLL in the Thorlabs/Kinesis directory. Keep it
+    // loaded, as we may be called repeatedly (see DeviceMonitor).
+    static DLLAccess ftdiDll{ "ftd2xx.dll" };
     ftdiDll.IsValid(); // Trigger the lazy load
 
+    std::lock_guard<std::mutex> lock{ DeviceListMutex() };
     short err;
     err = buildDeviceListFunc();
     if (err)
-        return {};
+        return false;
 
     size_t deviceCount = getDeviceListSizeFunc();
 
     // Serial numbers are 8 digits each. Compute size needed for a
     // comma-separated list, plus some extra bytes.
     size_t buflen = 10 * deviceCount + 100;
-    auto serialNoBuffer = std::make_unique<char[]>(buflen);
+    if (buffer.size() < buflen)
+        buffer.resize(buflen);
 
     // (Pass size minus one just to be safe.)
-    err = getDeviceListExtFunc(serialNoBuffer.get(), static_cast<DWORD>(buflen - 1));
+    err = getDeviceListExtFunc(buffer.data(), static_cast<DWORD>(buflen - 1));
     if (err)
-        return {};
+        return false;
+    buffer[buflen - 1] = '\0';
+    return true;
+}
 
-    std::vector<std::string> ret;
-    std::istringstream serialNoStream{ serialNoBuffer.get() };
-    std::string serialNo;
-    while (std::getline(serialNoStream, serialNo, ',').good())
-        ret.push_back(serialNo);
 
-    return ret;
+std::mutex& DeviceListMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+
+bool
+DeviceFilter::Parse(std::string const& allowlist,
+    std::string const& denylist, DeviceFilter* filter) {
+    DeviceFilter result;
+    if (!ParseFilterList(allowlist, &result.allowPatterns_, &result.allowTypeIDs_))
+        return false;
+    if (!ParseFilterList(denylist, &result.denyPatterns_, &result.denyTypeIDs_))
+        return false;
+    *filter = result;
+    return true;
+}
+
+
+bool
+DeviceFilter::IsEmpty() const {
+    return allowPatterns_.empty() && allowTypeIDs_.empty() &&
+        denyPatterns_.empty() && denyTypeIDs_.empty();
+}
+
+
+bool
+DeviceFilter::Allows(std::string const& serialNo) const {
+    if (MatchesAny(serialNo, denyPatterns_, denyTypeIDs_))
+        return false;
+    if (allowPatterns_.empty() && allowTypeIDs_.empty())
+        return true;
+    return MatchesAny(serialNo, allowPatterns_, allowTypeIDs_);
+}
+
+
+DeviceFilter
+DeviceFilter::Active() {
+    std::lock_guard<std::mutex> lock{ activeFilterMutex };
+    return activeFilter;
+}
+
+
+void
+DeviceFilter::SetActive(DeviceFilter const& filter) {
+    std::lock_guard<std::mutex> lock{ activeFilterMutex };
+    activeFilter = filter;
+}
+
+
+void
+DeviceFilter::ClearActive() {
+    std::lock_guard<std::mutex> lock{ activeFilterMutex };
+    activeFilter = DeviceFilter{};
 }
@@ -32,7 +32,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -146,8 +148,10 @@ inline bool IsPotentiallyMultiChannel(std::string const& serialNo) {
     case TypeIDBenchtopPrecisionPiezo2Channel: // Note only PPC2_, not PPC_
     case TypeIDBenchtopStepper1Channel:
     case TypeIDBenchtopStepper3Channel:
+    case TypeIDKCubeInertialMotor:
     case TypeIDModularPiezo:
     case TypeIDModularStepper:
+    case TypeIDTCubeInertialMotor:
         return true;
     default:
         return false;
@@ -155,6 +159,36 @@ inline bool IsPotentiallyMultiChannel(std::string const& serialNo) {
 }
 
 
+// Which devices the adapter may open, so that controllers belonging to
+// another instrument (or process) on the same PC are left alone.
+//
+// Each list is comma-separated. An entry is either a serial number pattern,
+// in which '*' matches any digits and '?' one digit (e.g. "27*",
+// "8300012?"), or "type:N" to match a Kinesis type ID (the leading digits of
+// the serial number, e.g. "type:83"). An empty allowlist allows all devices;
+// the denylist takes precedence.
+class DeviceFilter {
+    std::vector<std::string> allowPatterns_;
+    std::vector<int> allowTypeIDs_;
+    std::vector<std::string> denyPatterns_;
+    std::vector<int> denyTypeIDs_;
+
+public:
+    // Return false if either list is malformed
+    static bool Parse(std::string const& allowlist,
+        std::string const& denylist, DeviceFilter* filter);
+
+    bool IsEmpty() const;
+    bool Allows(std::string const& serialNo) const;
+
+    // Filter applied to enumeration and to every new connection; allows all
+    // devices by default
+    static DeviceFilter Active();
+    static void SetActive(DeviceFilter const& filter);
+    static void ClearActive();
+};
+
+
 // If this returns false, all functions that access Kinesis will crash.
 bool IsKinesisDriverAvailable();
 
@@ -163,5 +197,32 @@ void EnableSimulatedDevices();
 
 void DisableSimulatedDevices();
 
-// Must be called before making connections to devices or getting info
+// Must be called before making connections to devices or getting info.
+// Devices not allowed by the active DeviceFilter are omitted.
 std::vector<std::string> EnumerateSerialNumbers();
+
+// Rebuild the Kinesis device list and read it, as a comma-separated string,
+// into buffer (which is reused across calls, so that repeated scans do not
+// allocate). Return false on error.
+bool ReadDeviceList(std::vector<char>& buffer);
+
+// Held while the device list is rebuilt or read, and while devices are
+// opened, so that the device monitor's periodic rebuild (see DeviceMonitor)
+// never runs concurrently with other TLI_* calls or with opening a device
+std::mutex& DeviceListMutex();
+
+// Call f(serialNo, length) for each nonempty entry of a comma-separated list
+// of serial numbers, pointing into the list rather than copying.
+template <typename F>
+void ForEachSerialNumber(char const* list, F f) {
+    char const* begin = list;
+    for (char const* p = list; ; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (p != begin)
+                f(begin, size_t(p - begin));
+            if (*p == '\0')
+                break;
+            begin = p + 1;
+        }
+    }
+}
@@ -34,8 +34,18 @@
 
 #include "DeviceEnumeration.h"
 
+#include "Flipper.h"
+#include "InertialStage.h"
+#include "PiezoStage.h"
+#include "PolarizationController.h"
 #include "SingleAxisStage.h"
+#include "SolenoidShutter.h"
+#include "StrainGauge.h"
 #include "UnsupportedDevice.h"
+#include "Wheel.h"
+#include "XYStage.h"
+
+#include <sstream>
 
 
 MM::Device* MakeDevice(std::string const& name, std::string const& serialNo,
@@ -63,8 +73,40 @@ MM::Device* MakeDevice(std::string const& name, std::string const& serialNo,
     case TypeIDBenchtopDCServo3Channel:
     case TypeIDBenchtopStepper1Channel:
     case TypeIDBenchtopStepper3Channel:
+    case TypeIDModularStepper:
         return new SingleAxisStage{ name, serialNo, channel, connection };
 
+    case TypeIDKCubePiezo:
+    case TypeIDTCubePiezo:
+        return new PiezoStage{ name, serialNo, -1, connection };
+
+    case TypeIDBenchtopPiezo1Channel:
+    case TypeIDBenchtopPiezo3Channel:
+        return new PiezoStage{ name, serialNo, channel, connection };
+
+    case TypeIDFilterFlipper:
+        return new Flipper{ name, serialNo, connection };
+
+    case TypeIDFilterWheel:
+        return new Wheel{ name, serialNo, connection };
+
+    case TypeIDKCubeInertialMotor:
+    case TypeIDTCubeInertialMotor:
+        if (channel < 1) // The API has no device-wide motion
+            return nullptr;
+        return new InertialStage{ name, serialNo, channel, connection };
+
+    case TypeIDKCubeSolenoid:
+    case TypeIDTCubeSolenoid:
+        return new SolenoidShutter{ name, serialNo, connection };
+
+    case TypeIDKCubeStrainGauge:
+    case TypeIDTCubeStrainGauge:
+        return new StrainGauge{ name, serialNo, connection };
+
+    case TypeIDPolarizer:
+        return new PolarizationController{ name, serialNo, connection };
+
     default:
         // Unsupported device: create placeholder only for first channel if it
         // is multi-channel
@@ -78,6 +120,68 @@ MM::Device* MakeDevice(std::string const& name, std::string const& serialNo,
 }
 
 
+bool IsSupportedMotorAxis(std::string const& serialNo) {
+    if (!IsValidSerialNo(serialNo))
+        return false;
+
+    switch (TypeIDOfSerialNo(serialNo)) {
+    case TypeIDKCubeBrushless:
+    case TypeIDKCubeDCServo:
+    case TypeIDKCubeStepper:
+    case TypeIDTCubeBrushless:
+    case TypeIDTCubeDCServo:
+    case TypeIDTCubeStepper:
+    case TypeIDLabJack050:
+    case TypeIDLabJack490:
+    case TypeIDLongTravelStage:
+    case TypeIDCageRotator:
+    case TypeIDVerticalStage:
+    case TypeIDBenchtopBrushless200:
+    case TypeIDBenchtopBrushless300:
+    case TypeIDBenchtopDCServo1Channel:
+    case TypeIDBenchtopDCServo3Channel:
+    case TypeIDBenchtopStepper1Channel:
+    case TypeIDBenchtopStepper3Channel:
+    case TypeIDModularStepper:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+MM::Device* MakeXYStage(std::string const& name) {
+    // XYStage_SerialNo[-Channel]_SerialNo[-Channel]
+    std::istringstream nameStream{ name };
+    std::string prefix, axes[2];
+    std::getline(nameStream, prefix, '_');
+    std::getline(nameStream, axes[0], '_');
+    std::getline(nameStream, axes[1]);
+    if (prefix != XYStage::NamePrefix || axes[1].empty())
+        return nullptr;
+
+    std::string serialNos[2];
+    short channels[2];
+    for (int i = 0; i < 2; ++i) {
+        auto dash = axes[i].find('-');
+        serialNos[i] = axes[i].substr(0, dash);
+        channels[i] = -1;
+        if (dash != std::string::npos) {
+            std::istringstream channelStream{ axes[i].substr(dash + 1) };
+            if (!(channelStream >> channels[i]) || channels[i] < 1)
+                return nullptr;
+        }
+        if (!IsSupportedMotorAxis(serialNos[i]))
+            return nullptr;
+    }
+    if (serialNos[0] == serialNos[1] && channels[0] == channels[1])
+        return nullptr;
+
+    return new XYStage{ name, serialNos[0], channels[0],
+        serialNos[1], channels[1] };
+}
+
+
 MM::Device* MakeUnsupportedDevice(std::string const& serialNo) {
     if (!IsValidSerialNo(serialNo))
         return nullptr;
@@ -44,3 +44,10 @@
 MM::Device* MakeDevice(std::string const& name, std::string const& serialNo,
     short channel, std::shared_ptr<KinesisDeviceConnection> connection = {});
 MM::Device* MakeUnsupportedDevice(std::string const& serialNo);
+
+// Creates an XYStage from its name (see XYStage.h), or returns null if the
+// name is malformed or an axis is not a supported motor.
+MM::Device* MakeXYStage(std::string const& name);
+
+// Whether the serial number is of a motor that can be an XYStage axis
+bool IsSupportedMotorAxis(std::string const& serialNo);
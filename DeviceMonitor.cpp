@@ -0,0 +1,213 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DeviceMonitor.h"
+
+#include "DeviceEnumeration.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+    int
+    CompareEntries(char const* a, size_t aLen, char const* b, size_t bLen) {
+        int cmp = std::memcmp(a, b, std::min(aLen, bLen));
+        if (cmp != 0)
+            return cmp;
+        return aLen < bLen ? -1 : aLen > bLen ? 1 : 0;
+    }
+}
+
+
+DeviceMonitor::DeviceMonitor(std::chrono::milliseconds interval,
+    Callback onAdded, Callback onRemoved, Predicate isOpen) :
+    interval_{ interval },
+    onAdded_{ std::move(onAdded) },
+    onRemoved_{ std::move(onRemoved) },
+    isOpen_{ std::move(isOpen) }
+{}
+
+
+DeviceMonitor::~DeviceMonitor() {
+    Stop();
+}
+
+
+void
+DeviceMonitor::Start() {
+    if (thread_.joinable())
+        return;
+
+    Scan(false);
+
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = false;
+    }
+    thread_ = std::thread([this] { Run(); });
+}
+
+
+void
+DeviceMonitor::Stop() {
+    if (!thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = true;
+    }
+    stopCv_.notify_all();
+    thread_.join();
+}
+
+
+uint64_t
+DeviceMonitor::Scans() {
+    std::lock_guard<std::mutex> lock{ stopMutex_ };
+    return scans_;
+}
+
+
+void
+DeviceMonitor::Run() {
+    std::unique_lock<std::mutex> lock{ stopMutex_ };
+    while (!stopCv_.wait_for(lock, interval_, [this] { return stopRequested_; })) {
+        lock.unlock();
+        Scan(true);
+        lock.lock();
+        ++scans_;
+    }
+}
+
+
+void
+DeviceMonitor::Scan(bool report) {
+    Snapshot& next = snapshots_[1 - current_];
+    next.entries.clear();
+    next.valid = ReadDeviceList(next.buffer);
+    if (!next.valid)
+        return; // Keep the current list; try again next time
+
+    char const* const base = next.buffer.data();
+    ForEachSerialNumber(base, [&](char const* serialNo, size_t len) {
+        next.entries.push_back({ size_t(serialNo - base), len });
+    });
+    std::sort(next.entries.begin(), next.entries.end(),
+        [base](Entry const& a, Entry const& b) {
+            return CompareEntries(base + a.offset, a.length,
+                base + b.offset, b.length) < 0;
+        });
+
+    Snapshot const& prev = snapshots_[current_];
+    if (prev.valid && isOpen_)
+        KeepOpen(prev, next, isOpen_);
+    if (report && prev.valid)
+        Diff(prev, next, onAdded_, onRemoved_);
+    current_ = 1 - current_;
+}
+
+
+void
+DeviceMonitor::KeepOpen(Snapshot const& before, Snapshot& after,
+    Predicate const& isOpen) {
+    size_t const listed = after.entries.size();
+    for (Entry const& entry : before.entries) {
+        char const* const serialNo = before.buffer.data() + entry.offset;
+        char const* const a = after.buffer.data();
+        auto const end = after.entries.begin() + listed;
+        auto const it = std::lower_bound(after.entries.begin(), end, entry,
+            [&](Entry const& x, Entry const&) {
+                return CompareEntries(a + x.offset, x.length,
+                    serialNo, entry.length) < 0;
+            });
+        bool const found = it != end && CompareEntries(a + it->offset,
+            it->length, serialNo, entry.length) == 0;
+        if (found || !isOpen(std::string(serialNo, entry.length)))
+            continue;
+
+        // Append after the list's terminating null (dropping anything
+        // appended when the buffer was last used)
+        if (after.entries.size() == listed)
+            after.buffer.resize(std::strlen(after.buffer.data()) + 1);
+        size_t const offset = after.buffer.size();
+        after.buffer.insert(after.buffer.end(), serialNo, serialNo + entry.length);
+        after.buffer.push_back('\0');
+        after.entries.push_back({ offset, entry.length });
+    }
+
+    if (after.entries.size() > listed) {
+        char const* const a = after.buffer.data();
+        std::sort(after.entries.begin(), after.entries.end(),
+            [a](Entry const& x, Entry const& y) {
+                return CompareEntries(a + x.offset, x.length,
+                    a + y.offset, y.length) < 0;
+            });
+    }
+}
+
+
+void
+DeviceMonitor::Diff(Snapshot const& before, Snapshot const& after,
+    Callback const& onAdded, Callback const& onRemoved) {
+    // Merge the two sorted lists
+    char const* const b = before.buffer.data();
+    char const* const a = after.buffer.data();
+    auto bi = before.entries.begin();
+    auto ai = after.entries.begin();
+    while (bi != before.entries.end() || ai != after.entries.end()) {
+        int cmp;
+        if (bi == before.entries.end())
+            cmp = 1;
+        else if (ai == after.entries.end())
+            cmp = -1;
+        else
+            cmp = CompareEntries(b + bi->offset, bi->length,
+                a + ai->offset, ai->length);
+
+        if (cmp < 0) {
+            if (onRemoved)
+                onRemoved(std::string(b + bi->offset, bi->length));
+            ++bi;
+        }
+        else if (cmp > 0) {
+            if (onAdded)
+                onAdded(std::string(a + ai->offset, ai->length));
+            ++ai;
+        }
+        else {
+            ++bi;
+            ++ai;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Background watcher for devices being plugged in or unplugged.
+//
+// The Kinesis device list is only built once, when the hub is initialized,
+// so controllers connected later cannot be opened. This rebuilds the list
+// (TLI_BuildDeviceList()) at a fixed interval and compares it with the
+// previous one, calling back for each serial number that appeared or
+// disappeared. A device that is open (according to the isOpen callback) is
+// kept in the list even if a rebuild misses it, as happens while it is being
+// reconnected; it is reported as removed once closed, if still absent.
+//
+// Each scan reuses the same buffers and compares serial numbers in place, so
+// that an unchanged list costs one Kinesis call and no allocation; strings
+// are only made for the (rare) changes.
+class DeviceMonitor {
+public:
+    using Callback = std::function<void(std::string const& serialNo)>;
+    using Predicate = std::function<bool(std::string const& serialNo)>;
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t length;
+    };
+
+    // A device list and its entries, sorted by serial number
+    struct Snapshot {
+        std::vector<char> buffer;
+        std::vector<Entry> entries;
+        bool valid = false;
+    };
+
+    std::chrono::milliseconds const interval_;
+    Callback const onAdded_;
+    Callback const onRemoved_;
+    Predicate const isOpen_;
+
+    Snapshot snapshots_[2]; // Only accessed by the scanning thread
+    int current_ = 0;
+    uint64_t scans_ = 0; // Guarded by stopMutex_
+
+    std::mutex stopMutex_;
+    std::condition_variable stopCv_;
+    bool stopRequested_ = false;
+    std::thread thread_;
+
+public:
+    // The callbacks are called on the monitor thread
+    DeviceMonitor(std::chrono::milliseconds interval,
+        Callback onAdded, Callback onRemoved, Predicate isOpen);
+    ~DeviceMonitor();
+
+    // Noncopyable
+    DeviceMonitor(DeviceMonitor const&) = delete;
+    DeviceMonitor& operator=(DeviceMonitor const&) = delete;
+
+    // Take the current device list as the baseline (without reporting it)
+    // and start scanning
+    void Start();
+    void Stop();
+
+    uint64_t Scans();
+
+private:
+    void Run();
+
+    // Read the device list into the other snapshot, report differences,
+    // and make it current
+    void Scan(bool report);
+
+    // Add to after the entries of before that are missing from it but open
+    static void KeepOpen(Snapshot const& before, Snapshot& after,
+        Predicate const& isOpen);
+
+    static void Diff(Snapshot const& before, Snapshot const& after,
+        Callback const& onAdded, Callback const& onRemoved);
+};
@@ -0,0 +1,387 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "EventTrace.h"
+
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace {
+    enum EventKind {
+        EventKindInstant,
+        EventKindComplete,
+        EventKindCall,
+    };
+
+    struct Event {
+        EventKind kind;
+        int track;
+        char const* name; // Unused for EventKindCall
+        size_t function; // EventKindCall only
+        bool error; // EventKindCall only
+        char const* argName;
+        int64_t arg;
+        EventTrace::Clock::time_point start;
+        EventTrace::Clock::duration duration;
+    };
+
+    // Single-producer, single-consumer ring of events. The owning thread
+    // appends; the writer thread drains. Events that do not fit are dropped
+    // (and counted) rather than making the producer wait.
+    struct ThreadEvents {
+        static size_t const Capacity = 8192;
+
+        std::array<Event, Capacity> events;
+        std::atomic<size_t> head{ 0 }; // Written by producer
+        std::atomic<size_t> tail{ 0 }; // Written by consumer
+        std::atomic<uint64_t> dropped{ 0 };
+        std::atomic<int> callTrack{ EventTrace::NoTrack }; // Created on first call
+
+        void Push(Event const& event) {
+            size_t const h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+                return;
+            }
+            events[h % Capacity] = event;
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        template<typename F>
+        void Drain(F f) {
+            size_t const h = head.load(std::memory_order_acquire);
+            size_t t = tail.load(std::memory_order_relaxed);
+            for (; t != h; ++t)
+                f(events[t % Capacity]);
+            tail.store(t, std::memory_order_release);
+        }
+    };
+
+    // Buffers are kept after their thread exits, so that its last events
+    // are still written.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadEvents>> threads;
+        std::vector<std::pair<int, std::string>> tracks;
+    };
+
+    Registry& TheRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local ThreadEvents* threadEvents = nullptr;
+
+    ThreadEvents& EventsOfThisThread() {
+        if (!threadEvents) {
+            auto events = std::make_unique<ThreadEvents>();
+            threadEvents = events.get();
+            Registry& registry = TheRegistry();
+            std::lock_guard<std::mutex> lock{ registry.mutex };
+            registry.threads.push_back(std::move(events));
+        }
+        return *threadEvents;
+    }
+
+    std::string JsonString(std::string const& s) {
+        std::string ret = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                ret += '\\';
+                ret += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+                ret += escaped;
+            }
+            else {
+                ret += c;
+            }
+        }
+        return ret + '"';
+    }
+
+    double Microseconds(EventTrace::Clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+
+    // Owns the output file and the thread that writes to it
+    class Writer {
+        static int const ProcessId = 1;
+
+        std::ofstream file_;
+        EventTrace::Clock::time_point const origin_;
+        size_t tracksWritten_ = 0;
+        bool first_ = true;
+
+        std::mutex stopMutex_;
+        std::condition_variable stopCv_;
+        bool stopRequested_ = false;
+        std::thread thread_;
+
+    public:
+        explicit Writer(std::string const& path) :
+            file_{ path, std::ios::out | std::ios::trunc },
+            origin_{ EventTrace::Clock::now() }
+        {}
+
+        ~Writer() { Stop(); }
+
+        // Noncopyable
+        Writer(Writer const&) = delete;
+        Writer& operator=(Writer const&) = delete;
+
+        bool IsOpen() const { return file_.is_open(); }
+
+        void Start() {
+            // Discard anything left from an earlier trace
+            Registry& registry = TheRegistry();
+            {
+                std::lock_guard<std::mutex> lock{ registry.mutex };
+                for (auto& events : registry.threads) {
+                    events->Drain([](Event const&) {});
+                    events->dropped.store(0, std::memory_order_relaxed);
+                }
+            }
+
+            file_ << "[\n";
+            WriteRaw("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" +
+                std::to_string(ProcessId) +
+                ",\"args\":{\"name\":\"Thorlabs Kinesis\"}}");
+            thread_ = std::thread([this] { Run(); });
+        }
+
+        void Stop() {
+            if (!thread_.joinable())
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock{ stopMutex_ };
+                stopRequested_ = true;
+            }
+            stopCv_.notify_all();
+            thread_.join();
+
+            Flush();
+            WriteDropCounts();
+            file_ << "\n]\n";
+            file_.close();
+        }
+
+    private:
+        void Run() {
+            std::unique_lock<std::mutex> lock{ stopMutex_ };
+            while (!stopCv_.wait_for(lock, std::chrono::milliseconds{ 100 },
+                    [this] { return stopRequested_; })) {
+                lock.unlock();
+                Flush();
+                lock.lock();
+            }
+        }
+
+        void Flush() {
+            std::vector<std::pair<int, std::string>> newTracks;
+            std::vector<ThreadEvents*> threads;
+            {
+                Registry& registry = TheRegistry();
+                std::lock_guard<std::mutex> lock{ registry.mutex };
+                newTracks.assign(registry.tracks.begin() + tracksWritten_,
+                    registry.tracks.end());
+                tracksWritten_ = registry.tracks.size();
+                for (auto& events : registry.threads)
+                    threads.push_back(events.get());
+            }
+
+            // The buffers are never deallocated, so they can be drained
+            // without holding the registry lock
+            for (auto const& track : newTracks) {
+                WriteRaw("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" +
+                    std::to_string(ProcessId) + ",\"tid\":" +
+                    std::to_string(track.first) + ",\"args\":{\"name\":" +
+                    JsonString(track.second) + "}}");
+            }
+            for (ThreadEvents* events : threads)
+                events->Drain([this](Event const& event) { Write(event); });
+            file_.flush();
+        }
+
+        void WriteDropCounts() {
+            Registry& registry = TheRegistry();
+            std::lock_guard<std::mutex> lock{ registry.mutex };
+            for (auto& events : registry.threads) {
+                uint64_t dropped = events->dropped.load(std::memory_order_relaxed);
+                if (dropped == 0)
+                    continue;
+                WriteRaw("{\"name\":\"EventsDropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":" +
+                    std::to_string(ProcessId) + ",\"tid\":" +
+                    std::to_string(events->callTrack.load()) + ",\"ts\":" +
+                    std::to_string(Microseconds(EventTrace::Clock::now() - origin_)) +
+                    ",\"args\":{\"count\":" + std::to_string(dropped) + "}}");
+            }
+        }
+
+        void Write(Event const& event) {
+            if (event.start < origin_)
+                return;
+
+            std::string json = "{\"name\":";
+            switch (event.kind) {
+            case EventKindInstant:
+                json += JsonString(event.name) + ",\"cat\":\"move\",\"ph\":\"i\",\"s\":\"t\"";
+                break;
+            case EventKindComplete:
+                json += JsonString(event.name) + ",\"cat\":\"move\",\"ph\":\"X\"";
+                break;
+            case EventKindCall:
+                json += JsonString(Instrumentation::FunctionName(event.function)) +
+                    ",\"cat\":\"kinesis\",\"ph\":\"X\"";
+                break;
+            }
+            json += ",\"pid\":" + std::to_string(ProcessId) +
+                ",\"tid\":" + std::to_string(event.track) +
+                ",\"ts\":" + std::to_string(Microseconds(event.start - origin_));
+            if (event.kind != EventKindInstant)
+                json += ",\"dur\":" + std::to_string(Microseconds(event.duration));
+            if (event.kind == EventKindCall && event.error)
+                json += ",\"args\":{\"error\":true}";
+            else if (event.argName)
+                json += ",\"args\":{" + JsonString(event.argName) + ":" +
+                    std::to_string(event.arg) + "}";
+            json += '}';
+            WriteRaw(json);
+        }
+
+        void WriteRaw(std::string const& json) {
+            if (!first_)
+                file_ << ",\n";
+            first_ = false;
+            file_ << json;
+        }
+    };
+
+    std::mutex writerMutex;
+    std::unique_ptr<Writer> writer; // Guarded by writerMutex
+}
+
+
+bool
+EventTrace::IsEnabled() {
+    return (Instrumentation::Active() & Instrumentation::FlagsEventTrace) != 0;
+}
+
+
+bool
+EventTrace::Start(std::string const& path) {
+    std::lock_guard<std::mutex> lock{ writerMutex };
+    if (writer) {
+        Instrumentation::SetFlag(Instrumentation::FlagsEventTrace, false);
+        writer.reset();
+    }
+
+    auto newWriter = std::make_unique<Writer>(path);
+    if (!newWriter->IsOpen())
+        return false;
+    newWriter->Start();
+    writer = std::move(newWriter);
+    Instrumentation::SetFlag(Instrumentation::FlagsEventTrace, true);
+    return true;
+}
+
+
+void
+EventTrace::Stop() {
+    std::lock_guard<std::mutex> lock{ writerMutex };
+    Instrumentation::SetFlag(Instrumentation::FlagsEventTrace, false);
+    writer.reset();
+}
+
+
+int
+EventTrace::NewTrack(std::string const& name) {
+    Registry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    int track = int(registry.tracks.size()) + 1;
+    registry.tracks.emplace_back(track, name);
+    return track;
+}
+
+
+void
+EventTrace::Instant(int track, char const* name, Clock::time_point time,
+    char const* argName, int64_t arg) {
+    if (!IsEnabled() || track == NoTrack)
+        return;
+    EventsOfThisThread().Push(Event{ EventKindInstant, track, name, 0, false,
+        argName, arg, time, Clock::duration::zero() });
+}
+
+
+void
+EventTrace::Complete(int track, char const* name, Clock::time_point start,
+    Clock::duration duration, char const* argName, int64_t arg) {
+    if (!IsEnabled() || track == NoTrack)
+        return;
+    EventsOfThisThread().Push(Event{ EventKindComplete, track, name, 0, false,
+        argName, arg, start, duration });
+}
+
+
+void
+EventTrace::KinesisCall(size_t function, Clock::time_point start,
+    Clock::duration duration, bool error) {
+    if (function >= Instrumentation::MaxFunctions)
+        return;
+    ThreadEvents& events = EventsOfThisThread();
+    int track = events.callTrack.load(std::memory_order_relaxed);
+    if (track == NoTrack) {
+        static std::atomic<int> threadCount{ 0 };
+        track = NewTrack("Kinesis calls (thread " +
+            std::to_string(++threadCount) + ")");
+        events.callTrack.store(track, std::memory_order_relaxed);
+    }
+    events.Push(Event{ EventKindCall, track, nullptr, function, error,
+        nullptr, 0, start, duration });
+}
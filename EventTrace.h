@@ -0,0 +1,83 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Optional export of move lifecycles and Kinesis calls as a Chrome trace
+// event file (JSON array format), which can be opened in Perfetto or
+// chrome://tracing to see how the axes overlap in time.
+//
+// Events are appended by the thread that produces them to a buffer owned by
+// that thread, without locking; a background thread periodically drains the
+// buffers and writes them to the file. When tracing is off, emitting an
+// event only tests a flag.
+//
+// Each axis gets its own track (shown as a thread by the viewers); Kinesis
+// calls appear as slices on a track for each calling thread.
+class EventTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static int const NoTrack = 0;
+
+    static bool IsEnabled();
+
+    // Start writing events to the given file, replacing any existing file.
+    // Return false if the file cannot be opened.
+    static bool Start(std::string const& path);
+
+    // Write out all buffered events and close the file
+    static void Stop();
+
+    // Allocate a named track. Tracks may be created whether or not tracing
+    // is on; they are listed in every trace file.
+    static int NewTrack(std::string const& name);
+
+    // Emit events. The name and argName must be string literals (or
+    // otherwise live until the trace is stopped). argName may be null.
+    static void Instant(int track, char const* name, Clock::time_point time,
+        char const* argName = nullptr, int64_t arg = 0);
+    static void Complete(int track, char const* name, Clock::time_point start,
+        Clock::duration duration, char const* argName = nullptr,
+        int64_t arg = 0);
+
+    // Emit a slice for a DLL call on the calling thread's track; the
+    // function id is from Instrumentation::FunctionId()
+    static void KinesisCall(size_t function, Clock::time_point start,
+        Clock::duration duration, bool error);
+};
@@ -0,0 +1,514 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "FaultInjection.h"
+
+#include <sstream>
+#include <thread>
+
+
+namespace {
+    std::mutex activeMutex;
+    bool isActive = false; // Guarded by activeMutex
+    FaultSchedule activeSchedule; // Guarded by activeMutex
+
+    // Stable across runs and builds (unlike std::hash)
+    uint64_t Fnv1a(std::string const& s) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : s) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool ParseRate(std::string const& text, double* rate) {
+        std::istringstream s{ text };
+        double value;
+        if (!(s >> value) || !s.eof() || value < 0.0 || value > 1.0)
+            return false;
+        *rate = value;
+        return true;
+    }
+
+    // "rate:ms"
+    bool ParseRateAndDuration(std::string const& text, double* rate,
+        std::chrono::milliseconds* duration) {
+        auto colon = text.find(':');
+        if (colon == std::string::npos)
+            return false;
+        std::istringstream s{ text.substr(colon + 1) };
+        long ms;
+        if (!(s >> ms) || !s.eof() || ms < 0)
+            return false;
+        if (!ParseRate(text.substr(0, colon), rate))
+            return false;
+        *duration = std::chrono::milliseconds{ ms };
+        return true;
+    }
+
+    DWORD const MovingBits =
+        MotorDrive::StatusBitsMovingCW |
+        MotorDrive::StatusBitsMovingCCW |
+        MotorDrive::StatusBitsHoming;
+}
+
+
+bool
+FaultSchedule::Parse(std::string const& spec, FaultSchedule* schedule) {
+    FaultSchedule result;
+    std::istringstream items{ spec };
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        if (item.empty())
+            continue;
+        auto equals = item.find('=');
+        if (equals == std::string::npos)
+            return false;
+        std::string const key = item.substr(0, equals);
+        std::string const value = item.substr(equals + 1);
+
+        bool ok;
+        if (key == "seed") {
+            std::istringstream s{ value };
+            ok = (s >> result.seed) && s.eof();
+        }
+        else if (key == "latency")
+            ok = ParseRateAndDuration(value, &result.latencySpikeRate, &result.latencySpike);
+        else if (key == "drop")
+            ok = ParseRate(value, &result.droppedStatusRate);
+        else if (key == "stuck")
+            ok = ParseRateAndDuration(value, &result.stuckMovingRate, &result.stuckMoving);
+        else if (key == "error7")
+            ok = ParseRate(value, &result.error7Rate);
+        else if (key == "error33")
+            ok = ParseRate(value, &result.error33Rate);
+        else if (key == "error47")
+            ok = ParseRate(value, &result.error47Rate);
+        else if (key == "open")
+            ok = ParseRate(value, &result.openFailureRate);
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    *schedule = result;
+    return true;
+}
+
+
+bool
+FaultSchedule::IsActive() {
+    std::lock_guard<std::mutex> lock{ activeMutex };
+    return isActive;
+}
+
+
+FaultSchedule
+FaultSchedule::Active() {
+    std::lock_guard<std::mutex> lock{ activeMutex };
+    return activeSchedule;
+}
+
+
+void
+FaultSchedule::SetActive(FaultSchedule const& schedule) {
+    std::lock_guard<std::mutex> lock{ activeMutex };
+    activeSchedule = schedule;
+    isActive = true;
+}
+
+
+void
+FaultSchedule::ClearActive() {
+    std::lock_guard<std::mutex> lock{ activeMutex };
+    isActive = false;
+}
+
+
+FaultInjector::FaultInjector(FaultSchedule const& schedule,
+    std::string const& stream) :
+    schedule_{ schedule },
+    random_{ schedule.seed ^ Fnv1a(stream) }
+{}
+
+
+bool
+FaultInjector::Roll(double rate) {
+    if (rate <= 0.0)
+        return false;
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return std::uniform_real_distribution<double>{ 0.0, 1.0 }(random_) < rate;
+}
+
+
+void
+FaultInjector::MaybeDelay() {
+    if (Roll(schedule_.latencySpikeRate))
+        std::this_thread::sleep_for(schedule_.latencySpike);
+}
+
+
+short
+FaultInjector::CommandError() {
+    if (Roll(schedule_.error7Rate))
+        return 7;
+    if (Roll(schedule_.error33Rate))
+        return 33;
+    if (Roll(schedule_.error47Rate))
+        return 47;
+    return 0;
+}
+
+
+FaultInjectingAccess::FaultInjectingAccess(
+    std::unique_ptr<KinesisDeviceAccess> inner, FaultSchedule const& schedule) :
+    KinesisDeviceAccess{ inner->SerialNo() },
+    inner_{ std::move(inner) },
+    injector_{ schedule, inner_->SerialNo() }
+{}
+
+
+bool
+FaultInjectingAccess::IsKinesisDriverAvailable() {
+    return inner_->IsKinesisDriverAvailable();
+}
+
+
+short
+FaultInjectingAccess::Kinesis_Open() {
+    injector_.MaybeDelay();
+    // Error 2: "The device could not be found"
+    if (injector_.Roll(injector_.Schedule().openFailureRate))
+        return 2;
+    return inner_->Kinesis_Open();
+}
+
+
+short
+FaultInjectingAccess::Kinesis_Close() {
+    return inner_->Kinesis_Close();
+}
+
+
+short
+FaultInjectingAccess::Kinesis_GetNumChannels() {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_GetNumChannels();
+}
+
+
+template<typename Base>
+FaultInjectingMotorDrive<Base>::FaultInjectingMotorDrive(
+    std::unique_ptr<MotorDrive> inner, FaultSchedule const& schedule) :
+    Base{ inner->GetConnection(), inner->Channel() },
+    inner_{ std::move(inner) },
+    injector_{ schedule,
+        inner_->SerialNo() + '-' + std::to_string(inner_->Channel()) }
+{}
+
+
+template<typename Base>
+unsigned
+FaultInjectingMotorDrive<Base>::GetCapabilities() const {
+    return inner_->GetCapabilities();
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_RequestSettings() {
+    return Command([&] { return inner_->Kinesis_RequestSettings(); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_RequestStatusBits() {
+    return Command([&] { return inner_->Kinesis_RequestStatusBits(); });
+}
+
+
+template<typename Base>
+bool
+FaultInjectingMotorDrive<Base>::Kinesis_StartPolling(int intervalMs) {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_StartPolling(intervalMs);
+}
+
+
+template<typename Base>
+void
+FaultInjectingMotorDrive<Base>::Kinesis_StopPolling() {
+    inner_->Kinesis_StopPolling();
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_GetHardwareInfo(char* modelNo,
+    DWORD sizeOfModelNo, WORD* type, WORD* numChannels, char* notes,
+    DWORD sizeOfNotes, DWORD* firmwareVersion, WORD* hardwareVersion,
+    WORD* modificationState) {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_GetHardwareInfo(modelNo, sizeOfModelNo, type,
+        numChannels, notes, sizeOfNotes, firmwareVersion, hardwareVersion,
+        modificationState);
+}
+
+
+template<typename Base>
+DWORD
+FaultInjectingMotorDrive<Base>::Kinesis_GetStatusBits() {
+    injector_.MaybeDelay();
+    std::lock_guard<std::mutex> lock{ statusMutex_ };
+    if (hasStatus_ && injector_.Roll(injector_.Schedule().droppedStatusRate))
+        return lastStatusBits_;
+
+    DWORD bits = inner_->Kinesis_GetStatusBits();
+    auto const now = Clock::now();
+    bool const wasMoving = hasStatus_ && (lastStatusBits_ & MovingBits);
+    if (wasMoving && !(bits & MovingBits) &&
+            injector_.Roll(injector_.Schedule().stuckMovingRate)) {
+        stuckBits_ = lastStatusBits_ & MovingBits;
+        stuckUntil_ = now + injector_.Schedule().stuckMoving;
+    }
+    if (stuckBits_ && now < stuckUntil_)
+        bits |= stuckBits_;
+    else
+        stuckBits_ = 0;
+
+    lastStatusBits_ = bits;
+    hasStatus_ = true;
+    return bits;
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_EnableChannel() {
+    return Command([&] { return inner_->Kinesis_EnableChannel(); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_DisableChannel() {
+    return Command([&] { return inner_->Kinesis_DisableChannel(); });
+}
+
+
+template<typename Base>
+int
+FaultInjectingMotorDrive<Base>::Kinesis_GetMotorTravelMode() {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_GetMotorTravelMode();
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_SetMotorTravelMode(int mode) {
+    return Command([&] { return inner_->Kinesis_SetMotorTravelMode(mode); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_ResetRotationModes() {
+    return Command([&] { return inner_->Kinesis_ResetRotationModes(); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_SetRotationModes(int mode, int direction) {
+    return Command([&] { return inner_->Kinesis_SetRotationModes(mode, direction); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_SetHomingParams(int direction,
+    int limitSwitchMode, int offsetDistance, int velocity) {
+    return Command([&] {
+        return inner_->Kinesis_SetHomingParams(direction, limitSwitchMode,
+            offsetDistance, velocity);
+    });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_SetLimitSwitchParams(
+    int ccwHardwareLimitMode, int ccwSoftwareLimitPosition,
+    int cwHardwareLimitMode, int cwSoftwareLimitPosition,
+    int softwareLimitMode) {
+    return Command([&] {
+        return inner_->Kinesis_SetLimitSwitchParams(ccwHardwareLimitMode,
+            ccwSoftwareLimitPosition, cwHardwareLimitMode,
+            cwSoftwareLimitPosition, softwareLimitMode);
+    });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_RequestPosition() {
+    return Command([&] { return inner_->Kinesis_RequestPosition(); });
+}
+
+
+template<typename Base>
+int
+FaultInjectingMotorDrive<Base>::Kinesis_GetPosition() {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_GetPosition();
+}
+
+
+template<typename Base>
+long
+FaultInjectingMotorDrive<Base>::Kinesis_GetPositionCounter() {
+    injector_.MaybeDelay();
+    std::lock_guard<std::mutex> lock{ statusMutex_ };
+    if (hasStatus_ && injector_.Roll(injector_.Schedule().droppedStatusRate))
+        return lastPositionCounter_;
+    lastPositionCounter_ = inner_->Kinesis_GetPositionCounter();
+    return lastPositionCounter_;
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_MoveToPosition(int index) {
+    return Command([&] { return inner_->Kinesis_MoveToPosition(index); });
+}
+
+
+template<typename Base>
+bool
+FaultInjectingMotorDrive<Base>::Kinesis_CanHome() {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_CanHome();
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_Home() {
+    return Command([&] { return inner_->Kinesis_Home(); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_LoadSettings() {
+    return Command([&] { return inner_->Kinesis_LoadSettings(); });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_GetConnectedActuatorName(
+    std::string* actuatorName) {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_GetConnectedActuatorName(actuatorName);
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_GetVelParams(int* acceleration,
+    int* maxVelocity) {
+    injector_.MaybeDelay();
+    return inner_->Kinesis_GetVelParams(acceleration, maxVelocity);
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_SetVelParams(int acceleration,
+    int maxVelocity) {
+    return Command([&] {
+        return inner_->Kinesis_SetVelParams(acceleration, maxVelocity);
+    });
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
+    double* realValue, int unitType) {
+    return inner_->Kinesis_GetRealValueFromDeviceUnit(deviceUnits, realValue,
+        unitType);
+}
+
+
+template<typename Base>
+short
+FaultInjectingMotorDrive<Base>::Kinesis_GetDeviceUnitFromRealValue(double realValue,
+    int* deviceUnits, int unitType) {
+    return inner_->Kinesis_GetDeviceUnitFromRealValue(realValue, deviceUnits,
+        unitType);
+}
+
+
+template class FaultInjectingMotorDrive<MotorDrive>;
+template class FaultInjectingMotorDrive<NonStepperMotorDrive>;
+
+
+FaultInjectingNonStepperMotorDrive::FaultInjectingNonStepperMotorDrive(
+    std::unique_ptr<NonStepperMotorDrive> inner, FaultSchedule const& schedule) :
+    FaultInjectingMotorDrive<NonStepperMotorDrive>{ std::move(inner), schedule }
+{}
+
+
+long
+FaultInjectingNonStepperMotorDrive::Kinesis_GetEncoderCounter() {
+    injector_.MaybeDelay();
+    return static_cast<NonStepperMotorDrive&>(*inner_).Kinesis_GetEncoderCounter();
+}
+
+
+std::unique_ptr<MotorDrive>
+MakeFaultInjectingMotorDrive(std::unique_ptr<MotorDrive> inner,
+    FaultSchedule const& schedule) {
+    if (dynamic_cast<NonStepperMotorDrive*>(inner.get())) {
+        std::unique_ptr<NonStepperMotorDrive> encoderDrive{
+            static_cast<NonStepperMotorDrive*>(inner.release()) };
+        return std::make_unique<FaultInjectingNonStepperMotorDrive>(
+            std::move(encoderDrive), schedule);
+    }
+    return std::make_unique<FaultInjectingMotorDrive<MotorDrive>>(
+        std::move(inner), schedule);
+}
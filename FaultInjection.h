@@ -0,0 +1,213 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+
+// Fault injection for testing timeouts, retries, and reconnection against
+// misbehaving devices (typically Kinesis simulated devices, which otherwise
+// never fail).
+//
+// When a schedule is set (see FaultSchedule::Parse()), every new connection
+// and motor drive is wrapped so that, at the configured rates, calls are
+// delayed, status updates are dropped, moving bits stay set after a move,
+// commands fail with errors 7, 33, or 47, and opening fails. Faults are
+// drawn from a pseudo-random sequence seeded from the schedule's seed and
+// the device serial number (and channel), so that a given sequence of calls
+// sees the same faults on every run.
+struct FaultSchedule {
+    uint64_t seed = 1;
+
+    double latencySpikeRate = 0.0; // Per call
+    std::chrono::milliseconds latencySpike{ 0 };
+    double droppedStatusRate = 0.0; // Per status or position read
+    double stuckMovingRate = 0.0; // Per completed move
+    std::chrono::milliseconds stuckMoving{ 0 };
+    double error7Rate = 0.0; // Per command; "device is no longer present"
+    double error33Rate = 0.0; // Per command; "stopped responding"
+    double error47Rate = 0.0; // Per command; "temporarily unavailable"
+    double openFailureRate = 0.0; // Per open
+
+    // Parse comma-separated key=value items, e.g.
+    // "seed=7,latency=0.01:250,drop=0.05,stuck=0.02:1500,error47=0.05,open=0.2"
+    // Keys: seed, latency (rate:ms), drop, stuck (rate:ms), error7, error33,
+    // error47, open. Return false if the string is malformed.
+    static bool Parse(std::string const& spec, FaultSchedule* schedule);
+
+    // Schedule applied to connections and drives made from now on; none by
+    // default
+    static bool IsActive();
+    static FaultSchedule Active();
+    static void SetActive(FaultSchedule const& schedule);
+    static void ClearActive();
+};
+
+
+// Seeded source of fault decisions
+class FaultInjector {
+    FaultSchedule const schedule_;
+    std::mutex mutex_;
+    std::mt19937_64 random_;
+
+public:
+    FaultInjector(FaultSchedule const& schedule, std::string const& stream);
+
+    // Noncopyable
+    FaultInjector(FaultInjector const&) = delete;
+    FaultInjector& operator=(FaultInjector const&) = delete;
+
+    FaultSchedule const& Schedule() const { return schedule_; }
+
+    // True with the given probability
+    bool Roll(double rate);
+
+    // Sleep if a latency spike is drawn
+    void MaybeDelay();
+
+    // An injected command error (7, 33, or 47), or zero
+    short CommandError();
+};
+
+
+class FaultInjectingAccess final : public KinesisDeviceAccess {
+    std::unique_ptr<KinesisDeviceAccess> const inner_;
+    FaultInjector injector_;
+
+public:
+    FaultInjectingAccess(std::unique_ptr<KinesisDeviceAccess> inner,
+        FaultSchedule const& schedule);
+
+protected:
+    bool IsKinesisDriverAvailable() override;
+    short Kinesis_Open() override;
+    short Kinesis_Close() override;
+    short Kinesis_GetNumChannels() override;
+};
+
+
+// Wraps a MotorDrive, presenting the same interface as the wrapped drive:
+// Base is MotorDrive for steppers and NonStepperMotorDrive (see
+// FaultInjectingNonStepperMotorDrive) for drives with an encoder counter.
+template<typename Base>
+class FaultInjectingMotorDrive : public Base {
+    using Clock = std::chrono::steady_clock;
+
+protected:
+    std::unique_ptr<MotorDrive> const inner_;
+    FaultInjector injector_;
+
+private:
+    // Status as last reported (returned again when an update is dropped)
+    std::mutex statusMutex_;
+    DWORD lastStatusBits_ = 0;
+    long lastPositionCounter_ = 0;
+    bool hasStatus_ = false;
+    DWORD stuckBits_ = 0; // Moving bits held after the move ended
+    Clock::time_point stuckUntil_{};
+
+public:
+    FaultInjectingMotorDrive(std::unique_ptr<MotorDrive> inner,
+        FaultSchedule const& schedule);
+
+    unsigned GetCapabilities() const override;
+
+protected:
+    short Kinesis_RequestSettings() override;
+    short Kinesis_RequestStatusBits() override;
+    bool Kinesis_StartPolling(int intervalMs) override;
+    void Kinesis_StopPolling() override;
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion,
+        WORD* modificationState) override;
+    DWORD Kinesis_GetStatusBits() override;
+
+    short Kinesis_EnableChannel() override;
+    short Kinesis_DisableChannel() override;
+    int Kinesis_GetMotorTravelMode() override;
+    short Kinesis_SetMotorTravelMode(int mode) override;
+    short Kinesis_ResetRotationModes() override;
+    short Kinesis_SetRotationModes(int mode, int direction) override;
+    short Kinesis_SetHomingParams(int direction, int limitSwitchMode,
+        int offsetDistance, int velocity) override;
+    short Kinesis_SetLimitSwitchParams(int ccwHardwareLimitMode,
+        int ccwSoftwareLimitPosition, int cwHardwareLimitMode,
+        int cwSoftwareLimitPosition, int softwareLimitMode) override;
+    short Kinesis_RequestPosition() override;
+    int Kinesis_GetPosition() override;
+    long Kinesis_GetPositionCounter() override;
+    short Kinesis_MoveToPosition(int index) override;
+    bool Kinesis_CanHome() override;
+    short Kinesis_Home() override;
+    short Kinesis_LoadSettings() override;
+    short Kinesis_GetConnectedActuatorName(std::string* actuatorName) override;
+    short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) override;
+    short Kinesis_SetVelParams(int acceleration, int maxVelocity) override;
+    short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
+        double* realValue, int unitType) override;
+    short Kinesis_GetDeviceUnitFromRealValue(double realValue,
+        int* deviceUnits, int unitType) override;
+
+private:
+    // Delay, and possibly fail, a command; otherwise run it
+    template<typename F>
+    short Command(F f) {
+        injector_.MaybeDelay();
+        short err = injector_.CommandError();
+        return err ? err : f();
+    }
+};
+
+
+class FaultInjectingNonStepperMotorDrive final :
+    public FaultInjectingMotorDrive<NonStepperMotorDrive> {
+public:
+    FaultInjectingNonStepperMotorDrive(std::unique_ptr<NonStepperMotorDrive> inner,
+        FaultSchedule const& schedule);
+
+protected:
+    long Kinesis_GetEncoderCounter() override;
+};
+
+
+// Wrap the drive in the fault injecting decorator matching its interface
+std::unique_ptr<MotorDrive> MakeFaultInjectingMotorDrive(
+    std::unique_ptr<MotorDrive> inner, FaultSchedule const& schedule);
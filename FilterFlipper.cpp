@@ -0,0 +1,159 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DeviceFamily.h"
+
+#include "Thorlabs.MotionControl.FilterFlipper.h"
+
+
+// Filter flippers have a single family, so its traits and the
+// implementation of FlipperDrive (see PiezoFamily.h for the analogous
+// multi-family case) are both here.
+
+namespace {
+    struct FilterFlipperTraits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.FilterFlipper.dll";
+        }
+        static constexpr bool isMultiChannel = false;
+
+        // FF has RequestStatus instead of RequestStatusBits, and no
+        // RequestSettings (the transit time is read directly)
+        struct Functions : FunctionTable {
+            KINESIS_FUNCTION(FF, Open);
+            KINESIS_FUNCTION(FF, Close);
+            KINESIS_FUNCTION_AS(RequestStatusBits, FF, RequestStatus);
+            KINESIS_FUNCTION(FF, StartPolling);
+            KINESIS_FUNCTION(FF, StopPolling);
+            KINESIS_FUNCTION(FF, GetHardwareInfo);
+            KINESIS_FUNCTION(FF, GetStatusBits);
+            KINESIS_FUNCTION(FF, Home);
+            KINESIS_FUNCTION(FF, MoveToPosition);
+            KINESIS_FUNCTION(FF, GetPosition);
+            KINESIS_FUNCTION(FF, GetTransitTime);
+            KINESIS_FUNCTION(FF, SetTransitTime);
+            KINESIS_MESSAGE_QUEUE_FUNCTIONS(FF);
+        };
+    };
+
+
+    template<typename Traits>
+    class FlipperFamilyDrive final : public MotorFamilyDriveBase<Traits, FlipperDrive> {
+        template<typename Func, size_t N>
+        using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+    public:
+        FlipperFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+            MotorFamilyDriveBase<Traits, FlipperDrive>{ connection, channel }
+        {}
+
+        unsigned GetCapabilities() const override {
+            auto const& table = this->Table();
+            if (table.ClearMessageQueue.IsResolved() &&
+                table.MessageQueueSize.IsResolved() &&
+                table.GetNextMessage.IsResolved())
+                return FlipperDrive::CapabilitiesMessageQueue;
+            return 0;
+        }
+
+    protected: // General
+        short Kinesis_RequestSettings() override {
+            return 0; // Not applicable
+        }
+
+        short Kinesis_RequestStatusBits() override {
+            return this->Call(this->Table().RequestStatusBits);
+        }
+
+        bool Kinesis_StartPolling(int intervalMs) override {
+            return this->Call(this->Table().StartPolling, intervalMs);
+        }
+
+        void Kinesis_StopPolling() override {
+            this->Call(this->Table().StopPolling);
+        }
+
+        short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+            WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+            DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+            override {
+            return this->Call(this->Table().GetHardwareInfo, modelNo,
+                sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+                firmwareVersion, hardwareVersion, modificationState);
+        }
+
+        DWORD Kinesis_GetStatusBits() override {
+            return this->Call(this->Table().GetStatusBits);
+        }
+
+    protected: // Flipper
+        short Kinesis_Home() override {
+            return this->Call(this->Table().Home);
+        }
+
+        short Kinesis_MoveToPosition(int position) override {
+            auto const& func = this->Table().MoveToPosition;
+            return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(position));
+        }
+
+        int Kinesis_GetPosition() override {
+            return static_cast<int>(this->Call(this->Table().GetPosition));
+        }
+
+        unsigned Kinesis_GetTransitTime() override {
+            return static_cast<unsigned>(this->Call(this->Table().GetTransitTime));
+        }
+
+        short Kinesis_SetTransitTime(unsigned ms) override {
+            auto const& func = this->Table().SetTransitTime;
+            return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(ms));
+        }
+
+        void Kinesis_ClearMessageQueue() override {
+            if (this->HasCapability(FlipperDrive::CapabilitiesMessageQueue))
+                this->Call(this->Table().ClearMessageQueue);
+        }
+
+        bool Kinesis_GetNextMessage(FlipperDrive::Message& message) override {
+            if (!this->HasCapability(FlipperDrive::CapabilitiesMessageQueue))
+                return false;
+            return this->Call(this->Table().GetNextMessage,
+                &message.type, &message.id, &message.data);
+        }
+    };
+} // namespace
+
+
+DeviceFamilyEntry<FlipperDrive> const&
+FilterFlipperFamily() {
+    return DeviceFamily<FilterFlipperTraits, FlipperDrive, FlipperFamilyDrive>::Entry();
+}
@@ -0,0 +1,159 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DeviceFamily.h"
+
+#include "Thorlabs.MotionControl.FilterWheel.h"
+
+
+// Filter wheels have a single family, so its traits and the implementation
+// of FilterWheelDrive are both here (as for filter flippers).
+
+namespace {
+    struct FilterWheelTraits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.FilterWheel.dll";
+        }
+        static constexpr bool isMultiChannel = false;
+
+        // No settings to request: the speed and trigger modes are read
+        // directly
+        struct Functions : FunctionTable {
+            KINESIS_FUNCTION(FW, Open);
+            KINESIS_FUNCTION(FW, Close);
+            KINESIS_FUNCTION_AS(RequestStatusBits, FW, RequestStatus);
+            KINESIS_FUNCTION(FW, StartPolling);
+            KINESIS_FUNCTION(FW, StopPolling);
+            KINESIS_FUNCTION(FW, GetHardwareInfo);
+            KINESIS_FUNCTION(FW, GetStatusBits);
+            KINESIS_FUNCTION(FW, GetPositionCount);
+            KINESIS_FUNCTION(FW, GetPosition);
+            KINESIS_FUNCTION(FW, MoveToPosition);
+            KINESIS_OPTIONAL_FUNCTION(FW, GetSpeedMode);
+            KINESIS_OPTIONAL_FUNCTION(FW, SetSpeedMode);
+            KINESIS_OPTIONAL_FUNCTION(FW, SetTriggerMode);
+        };
+    };
+
+
+    template<typename Traits>
+    class FilterWheelFamilyDrive final :
+        public MotorFamilyDriveBase<Traits, FilterWheelDrive> {
+        template<typename Func, size_t N>
+        using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+    public:
+        FilterWheelFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+            MotorFamilyDriveBase<Traits, FilterWheelDrive>{ connection, channel }
+        {}
+
+        unsigned GetCapabilities() const override {
+            auto const& table = this->Table();
+            unsigned ret = 0;
+            if (table.GetSpeedMode.IsResolved() && table.SetSpeedMode.IsResolved())
+                ret |= FilterWheelDrive::CapabilitiesSpeedMode;
+            if (table.SetTriggerMode.IsResolved())
+                ret |= FilterWheelDrive::CapabilitiesTriggerMode;
+            return ret;
+        }
+
+    protected: // General
+        short Kinesis_RequestSettings() override {
+            return 0; // Not applicable
+        }
+
+        short Kinesis_RequestStatusBits() override {
+            return this->Call(this->Table().RequestStatusBits);
+        }
+
+        bool Kinesis_StartPolling(int intervalMs) override {
+            return this->Call(this->Table().StartPolling, intervalMs);
+        }
+
+        void Kinesis_StopPolling() override {
+            this->Call(this->Table().StopPolling);
+        }
+
+        short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+            WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+            DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+            override {
+            return this->Call(this->Table().GetHardwareInfo, modelNo,
+                sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+                firmwareVersion, hardwareVersion, modificationState);
+        }
+
+        DWORD Kinesis_GetStatusBits() override {
+            return this->Call(this->Table().GetStatusBits);
+        }
+
+    protected: // Filter wheel
+        int Kinesis_GetPositionCount() override {
+            return static_cast<int>(this->Call(this->Table().GetPositionCount));
+        }
+
+        short Kinesis_MoveToPosition(int position) override {
+            auto const& func = this->Table().MoveToPosition;
+            return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(position));
+        }
+
+        int Kinesis_GetPosition() override {
+            return static_cast<int>(this->Call(this->Table().GetPosition));
+        }
+
+        int Kinesis_GetSpeedMode() override {
+            if (!this->HasCapability(FilterWheelDrive::CapabilitiesSpeedMode))
+                return 0;
+            return static_cast<int>(this->Call(this->Table().GetSpeedMode));
+        }
+
+        short Kinesis_SetSpeedMode(int mode) override {
+            if (!this->HasCapability(FilterWheelDrive::CapabilitiesSpeedMode))
+                return 18;
+            auto const& func = this->Table().SetSpeedMode;
+            return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(mode));
+        }
+
+        short Kinesis_SetTriggerMode(int mode) override {
+            if (!this->HasCapability(FilterWheelDrive::CapabilitiesTriggerMode))
+                return 18;
+            auto const& func = this->Table().SetTriggerMode;
+            return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(mode));
+        }
+    };
+} // namespace
+
+
+DeviceFamilyEntry<FilterWheelDrive> const&
+FilterWheelFamily() {
+    return DeviceFamily<FilterWheelTraits, FilterWheelDrive, FilterWheelFamilyDrive>::Entry();
+}
@@ -0,0 +1,219 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "Flipper.h"
+
+
+namespace {
+    char const* const PROP_TransitTimeMs = "TransitTimeMs";
+
+    // Range accepted by the MFF10x
+    long const MinTransitTimeMs = 300;
+    long const MaxTransitTimeMs = 2800;
+
+    // If neither a message nor the status bits report completion by this
+    // long after the transit time, stop reporting busy
+    double const CompletionTimeoutMs = 2000.0;
+}
+
+
+Flipper::Flipper(std::string const& name, std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, -1, connection, "Filter flippers" }
+{}
+
+
+Flipper::~Flipper() = default;
+
+
+int
+Flipper::Initialize() {
+    int ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    if (!drive_->HasCapability(FlipperDrive::CapabilitiesMessageQueue)) {
+        LogMessage(("Kinesis driver for serial no " + serialNo_ +
+            " has no message queue; move completion is detected by polling").c_str());
+    }
+
+    short err = drive_->RequestSettings();
+    if (err)
+        return ERR_OFFSET + err;
+    err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    // Start polling, which keeps the position and status bits up to date
+    if (!drive_->StartPolling(pollingIntervalMs_)) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+    drive_->ClearMessageQueue();
+
+    transitTimeMs_ = drive_->GetTransitTimeMs();
+
+    CreateIntegerProperty(MM::g_Keyword_State, 0, false,
+        new CPropertyAction(this, &Flipper::OnState));
+    AddAllowedValue(MM::g_Keyword_State, "0");
+    AddAllowedValue(MM::g_Keyword_State, "1");
+
+    CreateStringProperty(MM::g_Keyword_Label, "", false,
+        new CPropertyAction(this, &CStateBase::OnLabel));
+    SetPositionLabel(0, "Position-1");
+    SetPositionLabel(1, "Position-2");
+
+    CreateIntegerProperty(PROP_TransitTimeMs, long(transitTimeMs_), false,
+        new CPropertyAction(this, &Flipper::OnTransitTimeMs));
+    SetPropertyLimits(PROP_TransitTimeMs, MinTransitTimeMs, MaxTransitTimeMs);
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+Flipper::Shutdown() {
+    CloseDrive();
+    return DEVICE_OK;
+}
+
+
+bool
+Flipper::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection() != DEVICE_OK)
+        return false; // The restore is retried by the next command
+    if (!movePending_)
+        return false;
+    if (MoveFinished()) {
+        movePending_ = false;
+        return false;
+    }
+
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    if (msSinceMovementStart > transitTimeMs_ + CompletionTimeoutMs) {
+        LogMessage(("Move of serial no " + serialNo_ +
+            " not reported complete; no longer waiting").c_str());
+        movePending_ = false;
+        return false;
+    }
+    return true;
+}
+
+
+int
+Flipper::OnState(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        // While moving (or if unknown), report the requested position
+        int position = drive_->GetPosition();
+        if (movePending_ || (position != 1 && position != 2))
+            position = targetPosition_;
+        if (position == 1 || position == 2)
+            pProp->Set(long(position - 1));
+    }
+    else if (eAct == MM::AfterSet) {
+        long state;
+        pProp->Get(state);
+        int const position = int(state) + 1;
+
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        // Discard completion messages of earlier moves
+        drive_->ClearMessageQueue();
+        short err = drive_->MoveToPosition(position);
+        if (err)
+            return ERR_OFFSET + err;
+        targetPosition_ = position;
+        movePending_ = true;
+        lastMovementStart_ = GetCurrentMMTime();
+    }
+    return DEVICE_OK;
+}
+
+
+int
+Flipper::OnTransitTimeMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(long(transitTimeMs_));
+    }
+    else if (eAct == MM::AfterSet) {
+        long ms;
+        pProp->Get(ms);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        short err = drive_->SetTransitTimeMs(unsigned(ms));
+        if (err)
+            return ERR_OFFSET + err;
+        transitTimeMs_ = unsigned(ms);
+    }
+    return DEVICE_OK;
+}
+
+
+bool
+Flipper::MoveFinished() {
+    if (drive_->HasCapability(FlipperDrive::CapabilitiesMessageQueue)) {
+        bool completionMessage = false;
+        FlipperDrive::Message message;
+        while (drive_->GetNextMessage(message)) {
+            if (message.type != FlipperDrive::MessageTypeGenericMotor)
+                continue;
+            if (message.id == FlipperDrive::MessageIDMoved ||
+                message.id == FlipperDrive::MessageIDHomed ||
+                message.id == FlipperDrive::MessageIDStopped)
+                completionMessage = true;
+        }
+        // A message of an earlier move can arrive after ClearMessageQueue()
+        // (in OnState()), so only trust one that agrees with the position
+        if (completionMessage &&
+            drive_->GetPosition() == targetPosition_)
+            return true;
+    }
+
+    // The status bits lag the move by up to a polling interval
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    if (msSinceMovementStart < 2 * pollingIntervalMs_)
+        return false;
+    DWORD const moving =
+        FlipperDrive::StatusBitsMoving | FlipperDrive::StatusBitsHoming;
+    return !(drive_->GetStatusBits() & moving) &&
+        drive_->GetPosition() == targetPosition_;
+}
@@ -0,0 +1,78 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+
+
+// Filter flipper (MFF101, MFF102) as a two-position state device.
+//
+// A move is complete when the device sends its "moved" message or, failing
+// that (or if the DLL has no message queue), when the status bits show it
+// at rest in the requested position. The transit time (TransitTimeMs) is
+// the device's own setting and bounds how long Busy() stays true, so it can
+// be chosen to let other hardware move while the filter is in transit.
+class Flipper final :
+    public KinesisDriveDevice<CStateDeviceBase, Flipper, FlipperDrive> {
+    // Set during Initialize():
+    int pollingIntervalMs_{ 50 };
+
+    // Dynamic state:
+    bool movePending_{ false };
+    int targetPosition_{ 0 }; // 1 or 2; zero if never moved
+    MM::MMTime lastMovementStart_{ 0.0 };
+    unsigned transitTimeMs_{ 0 };
+
+public:
+    Flipper(std::string const& name, std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> connection);
+    ~Flipper() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    unsigned long GetNumberOfPositions() const override { return 2; }
+
+    int OnState(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTransitTimeMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    bool MoveFinished();
+};
@@ -0,0 +1,184 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceFamily.h"
+
+#include <memory>
+#include <string>
+
+
+// Generic implementation of InertialMotorDrive for the K-Cube and T-Cube
+// inertial motor controllers (see MotorFamily.h and PiezoFamily.h). Their
+// API mixes device-wide functions (open, settings, status requests,
+// polling), which take only the serial number, with per-channel functions,
+// which take a channel enum. The channel count is fixed:
+//
+//   struct KCubeInertialMotorTraits {
+//       static char const* DLLName() {
+//           return "Thorlabs.MotionControl.KCube.InertialMotor.dll";
+//       }
+//       static constexpr bool isMultiChannel = true;
+//       static constexpr short numChannels = 4;
+//
+//       struct Functions : FunctionTable {
+//           KINESIS_INERTIAL_MOTOR_FUNCTIONS(KIM);
+//       };
+//   };
+//
+// Drive parameters are accessed through the non-struct functions, because
+// the DriveOPParameters structs are declared with #pragma pack(1) but not
+// laid out that way by the DLL (see DeviceEnumeration.cpp).
+
+#define KINESIS_INERTIAL_MOTOR_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, Open); \
+    KINESIS_FUNCTION(prefix, Close); \
+    KINESIS_FUNCTION(prefix, RequestSettings); \
+    KINESIS_FUNCTION_AS(RequestStatusBits, prefix, RequestStatus); \
+    KINESIS_FUNCTION(prefix, StartPolling); \
+    KINESIS_FUNCTION(prefix, StopPolling); \
+    KINESIS_FUNCTION(prefix, GetHardwareInfo); \
+    KINESIS_FUNCTION(prefix, GetStatusBits); \
+    KINESIS_FUNCTION(prefix, MoveAbsolute); \
+    KINESIS_FUNCTION(prefix, MoveRelative); \
+    KINESIS_FUNCTION(prefix, MoveStop); \
+    KINESIS_FUNCTION(prefix, GetCurrentPosition); \
+    KINESIS_FUNCTION(prefix, SetPosition); \
+    KINESIS_FUNCTION(prefix, GetDriveOPParameters); \
+    KINESIS_FUNCTION(prefix, SetDriveOPParameters)
+
+
+template<typename Traits>
+class InertialMotorFamilyDrive final :
+    public MotorFamilyDriveBase<Traits, InertialMotorDrive> {
+    template<typename Func, size_t N>
+    using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+    // The channel enum type is the parameter after the serial number
+    template<typename Func>
+    using ChannelParam = MotorFamilyDetail::ApiParam<Func, false, 0>;
+
+public:
+    InertialMotorFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyDriveBase<Traits, InertialMotorDrive>{ connection, channel }
+    {}
+
+private:
+    template<typename Func, typename... Args>
+    decltype(auto) DeviceCall(Func const& func, Args&&... args) {
+        return func(this->CSerialNo(), std::forward<Args>(args)...);
+    }
+
+    template<typename Func, typename... Args>
+    decltype(auto) ChannelCall(Func const& func, Args&&... args) {
+        return func(this->CSerialNo(),
+            static_cast<ChannelParam<Func>>(this->Channel()),
+            std::forward<Args>(args)...);
+    }
+
+protected: // General
+    short Kinesis_RequestSettings() override {
+        return DeviceCall(this->Table().RequestSettings);
+    }
+
+    short Kinesis_RequestStatusBits() override {
+        return DeviceCall(this->Table().RequestStatusBits);
+    }
+
+    bool Kinesis_StartPolling(int intervalMs) override {
+        return DeviceCall(this->Table().StartPolling, intervalMs);
+    }
+
+    void Kinesis_StopPolling() override {
+        // Polling is device-wide and shared by the channels; it stops when
+        // the connection is closed
+    }
+
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+        override {
+        return DeviceCall(this->Table().GetHardwareInfo, modelNo,
+            sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+            firmwareVersion, hardwareVersion, modificationState);
+    }
+
+    DWORD Kinesis_GetStatusBits() override {
+        return ChannelCall(this->Table().GetStatusBits);
+    }
+
+protected: // Inertial motor
+    short Kinesis_MoveAbsolute(int position) override {
+        auto const& func = this->Table().MoveAbsolute;
+        return ChannelCall(func, static_cast<ApiParam<decltype(func), 0>>(position));
+    }
+
+    short Kinesis_MoveRelative(int stepSize) override {
+        auto const& func = this->Table().MoveRelative;
+        return ChannelCall(func, static_cast<ApiParam<decltype(func), 0>>(stepSize));
+    }
+
+    short Kinesis_MoveStop() override {
+        return ChannelCall(this->Table().MoveStop);
+    }
+
+    int Kinesis_GetCurrentPosition() override {
+        return static_cast<int>(ChannelCall(this->Table().GetCurrentPosition));
+    }
+
+    short Kinesis_SetPosition(int position) override {
+        auto const& func = this->Table().SetPosition;
+        return ChannelCall(func, static_cast<ApiParam<decltype(func), 0>>(position));
+    }
+
+    short Kinesis_GetDriveOPParameters(short& maxVoltage, int& stepRate,
+        int& stepAcceleration) override {
+        return ChannelCall(this->Table().GetDriveOPParameters, maxVoltage,
+            stepRate, stepAcceleration);
+    }
+
+    short Kinesis_SetDriveOPParameters(short maxVoltage, int stepRate,
+        int stepAcceleration) override {
+        auto const& func = this->Table().SetDriveOPParameters;
+        return ChannelCall(func,
+            static_cast<ApiParam<decltype(func), 0>>(maxVoltage),
+            static_cast<ApiParam<decltype(func), 1>>(stepRate),
+            static_cast<ApiParam<decltype(func), 2>>(stepAcceleration));
+    }
+};
+
+
+// Factory functions for a family
+template<typename Traits>
+using InertialMotorFamily =
+    DeviceFamily<Traits, InertialMotorDrive, InertialMotorFamilyDrive>;
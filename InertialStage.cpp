@@ -0,0 +1,274 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "InertialStage.h"
+
+#include <cmath>
+
+
+namespace {
+    char const* const PROP_StepSizeUm = "StepSizeUm";
+    char const* const PROP_MaxVoltage = "MaxVoltage";
+    char const* const PROP_StepRate = "StepRate";
+    char const* const PROP_StepAcceleration = "StepAcceleration";
+}
+
+
+InertialStage::InertialStage(std::string const& name,
+    std::string const& serialNo, short channel,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, channel, connection,
+        "Inertial motor controllers" }
+{
+    // Nominal step size of PIA series actuators is about 20 nm
+    CreateFloatProperty(PROP_StepSizeUm, stepSizeUm_, false, nullptr, true);
+    SetPropertyLimits(PROP_StepSizeUm, 0.001, 1.0);
+}
+
+
+InertialStage::~InertialStage() = default;
+
+
+int
+InertialStage::Initialize() {
+    int ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    GetProperty(PROP_StepSizeUm, stepSizeUm_);
+
+    short err = drive_->RequestSettings();
+    if (err)
+        return ERR_OFFSET + err;
+    err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    // Start polling, which keeps the step counts and status bits of all
+    // channels up to date
+    if (!drive_->StartPolling(pollingIntervalMs_)) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+
+    err = drive_->GetDriveParameters(maxVoltage_, stepRate_,
+        stepAcceleration_);
+    if (err)
+        return ERR_OFFSET + err;
+
+    CreateIntegerProperty(PROP_MaxVoltage, maxVoltage_, false,
+        new CPropertyAction(this, &InertialStage::OnMaxVoltage));
+    SetPropertyLimits(PROP_MaxVoltage, 85, 125);
+
+    CreateIntegerProperty(PROP_StepRate, stepRate_, false,
+        new CPropertyAction(this, &InertialStage::OnStepRate));
+    SetPropertyLimits(PROP_StepRate, 1, 2000);
+
+    CreateIntegerProperty(PROP_StepAcceleration, stepAcceleration_, false,
+        new CPropertyAction(this, &InertialStage::OnStepAcceleration));
+    SetPropertyLimits(PROP_StepAcceleration, 1, 100000);
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::Shutdown() {
+    // Polling is left running for the other channels
+    CloseDrive(false);
+    return DEVICE_OK;
+}
+
+
+bool
+InertialStage::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection() != DEVICE_OK)
+        return false; // The restore is retried by the next command
+    if (!movePending_)
+        return false;
+
+    // The status bits lag the move command by up to a polling interval
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    if (msSinceMovementStart < 2 * pollingIntervalMs_)
+        return true;
+    if (drive_->GetStatusBits() & InertialMotorDrive::StatusBitsMoving)
+        return true;
+    movePending_ = false;
+    return false;
+}
+
+
+int
+InertialStage::GetPositionUm(double& pos) {
+    long steps;
+    int err = GetPositionSteps(steps);
+    if (err != DEVICE_OK)
+        return err;
+    pos = steps * stepSizeUm_;
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::SetPositionUm(double pos) {
+    return SetPositionSteps(std::lround(pos / stepSizeUm_));
+}
+
+
+int
+InertialStage::SetRelativePositionUm(double d) {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    // Relative to the controller's count, so no position query is needed
+    short err = drive_->MoveRelative(int(std::lround(d / stepSizeUm_)));
+    if (err)
+        return ERR_OFFSET + err;
+    StartedMove();
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::GetPositionSteps(long& steps) {
+    steps = drive_->GetPosition();
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::SetPositionSteps(long steps) {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->MoveAbsolute(int(steps));
+    if (err)
+        return ERR_OFFSET + err;
+    StartedMove();
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::SetOrigin() {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->SetPositionCounter(0);
+    if (err)
+        return ERR_OFFSET + err;
+    return OnStagePositionChanged(0.0);
+}
+
+
+int
+InertialStage::Stop() {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->Stop();
+    if (err)
+        return ERR_OFFSET + err;
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::OnMaxVoltage(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(long(maxVoltage_));
+    }
+    else if (eAct == MM::AfterSet) {
+        long v;
+        pProp->Get(v);
+        maxVoltage_ = short(v);
+        return ApplyDriveParameters();
+    }
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::OnStepRate(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(long(stepRate_));
+    }
+    else if (eAct == MM::AfterSet) {
+        long v;
+        pProp->Get(v);
+        stepRate_ = int(v);
+        return ApplyDriveParameters();
+    }
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::OnStepAcceleration(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(long(stepAcceleration_));
+    }
+    else if (eAct == MM::AfterSet) {
+        long v;
+        pProp->Get(v);
+        stepAcceleration_ = int(v);
+        return ApplyDriveParameters();
+    }
+    return DEVICE_OK;
+}
+
+
+int
+InertialStage::ApplyDriveParameters() {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->SetDriveParameters(maxVoltage_, stepRate_,
+        stepAcceleration_);
+    if (err)
+        return ERR_OFFSET + err;
+    return DEVICE_OK;
+}
+
+
+void
+InertialStage::StartedMove() {
+    movePending_ = true;
+    lastMovementStart_ = GetCurrentMMTime();
+}
@@ -0,0 +1,96 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+
+
+// One channel of an inertial piezo motor controller (KIM101, TIM101) as a
+// stage. Each channel is a separate device sharing the controller's
+// connection; moves are asynchronous, so moves issued to several channels
+// run concurrently.
+//
+// Inertial motors have no encoder: the position is the controller's step
+// count, converted with StepSizeUm (which varies between actuators and with
+// load and direction, so positions are approximate). The count is kept up to
+// date by device-wide polling, so reading the position does not require a
+// round trip to the controller. If the controller is reconnected (see
+// StateRestorer), the drive parameters are re-applied.
+class InertialStage final :
+    public KinesisDriveDevice<CStageBase, InertialStage, InertialMotorDrive> {
+    // Set during Initialize():
+    double stepSizeUm_{ 0.02 };
+    int pollingIntervalMs_{ 50 };
+
+    // Dynamic state:
+    bool movePending_{ false };
+    MM::MMTime lastMovementStart_{ 0.0 };
+    short maxVoltage_{ 0 };
+    int stepRate_{ 0 };
+    int stepAcceleration_{ 0 };
+
+public:
+    InertialStage(std::string const& name, std::string const& serialNo,
+        short channel, std::shared_ptr<KinesisDeviceConnection> connection);
+    ~InertialStage() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    int GetPositionUm(double& pos) override;
+    int SetPositionUm(double pos) override;
+    int SetRelativePositionUm(double d) override;
+    int GetPositionSteps(long& steps) override;
+    int SetPositionSteps(long steps) override;
+    int SetOrigin() override;
+    int GetLimits(double&, double&) override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int Stop() override;
+
+    bool IsContinuousFocusDrive() const override { return false; }
+    int IsStageSequenceable(bool& f) const override { f = false; return DEVICE_OK; }
+
+    int OnMaxVoltage(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnStepRate(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnStepAcceleration(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    int ApplyDriveParameters();
+    void StartedMove();
+};
@@ -0,0 +1,99 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "Instrumentation.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+
+std::atomic<unsigned> Instrumentation::flags_{ 0 };
+
+
+namespace {
+    struct FunctionRegistry {
+        std::mutex mutex;
+        std::map<std::pair<std::string, std::string>, size_t> ids;
+        std::vector<std::pair<std::string, std::string>> functions; // By id
+    };
+
+    FunctionRegistry& TheRegistry() {
+        static FunctionRegistry registry;
+        return registry;
+    }
+}
+
+
+size_t
+Instrumentation::FunctionId(std::string const& library, std::string const& name) {
+    FunctionRegistry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    auto key = std::make_pair(library, name);
+    auto found = registry.ids.find(key);
+    if (found != registry.ids.end())
+        return found->second;
+    if (registry.functions.size() >= MaxFunctions)
+        return NoFunction;
+    size_t id = registry.functions.size();
+    registry.functions.push_back(key);
+    registry.ids.emplace(key, id);
+    return id;
+}
+
+
+size_t
+Instrumentation::FunctionCount() {
+    FunctionRegistry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    return registry.functions.size();
+}
+
+
+std::string
+Instrumentation::FunctionLibrary(size_t id) {
+    FunctionRegistry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    if (id >= registry.functions.size())
+        return {};
+    return registry.functions[id].first;
+}
+
+
+std::string
+Instrumentation::FunctionName(size_t id) {
+    FunctionRegistry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    if (id >= registry.functions.size())
+        return {};
+    return registry.functions[id].second;
+}
@@ -0,0 +1,209 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "CallStatistics.h"
+#include "CallTrace.h"
+#include "EventTrace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+// Process-wide switches for the instrumentation built into DLLFunc (call
+// statistics, call trace recording/replay, and trace events), and the numbering of DLL
+// functions used to index per-function data.
+class Instrumentation {
+public:
+    enum Flags : unsigned {
+        FlagsStatistics = 0x1,
+        FlagsTraceRecord = 0x2,
+        FlagsTraceReplay = 0x4,
+        FlagsEventTrace = 0x8,
+    };
+
+    static size_t const MaxFunctions = 256;
+    static size_t const NoFunction = size_t(-1);
+
+    // Nonzero if any instrumentation is on; this is the only test made on
+    // every call
+    static unsigned Active() {
+        return flags_.load(std::memory_order_relaxed);
+    }
+
+    static void SetFlag(Flags flag, bool on) {
+        if (on)
+            flags_.fetch_or(flag, std::memory_order_relaxed);
+        else
+            flags_.fetch_and(~unsigned(flag), std::memory_order_relaxed);
+    }
+
+    // Return the id of the given function (NoFunction if the table is full).
+    // Functions with the same name from the same DLL share an id.
+    static size_t FunctionId(std::string const& library, std::string const& name);
+
+    static size_t FunctionCount();
+    static std::string FunctionLibrary(size_t id);
+    static std::string FunctionName(size_t id);
+
+private:
+    static std::atomic<unsigned> flags_;
+};
+
+
+namespace InstrumentationDetail {
+    // Holds a function's result (if any) for recording and returning
+    template<typename R>
+    struct Result {
+        R value{};
+
+        template<typename G>
+        void Call(G&& g) { value = g(); }
+        bool IsError() const { return IsKinesisErrorResult(value); }
+        void Put(TraceBuffer& buffer) const { buffer.PutValue(value); }
+        void Get(TraceReader& reader) { reader.GetValue(&value); }
+        R Return() const { return value; }
+    };
+
+    template<>
+    struct Result<void> {
+        template<typename G>
+        void Call(G&& g) { g(); }
+        bool IsError() const { return false; }
+        void Put(TraceBuffer&) const {}
+        void Get(TraceReader&) {}
+        void Return() const {}
+    };
+
+    using Expand = int[];
+
+    // The parameter following an output buffer gives its size
+    template<typename T>
+    std::enable_if_t<std::is_integral<T>::value, size_t> SizeArg(T value) {
+        return value > 0 ? size_t(value) : 0;
+    }
+
+    template<typename T>
+    std::enable_if_t<!std::is_integral<T>::value, size_t> SizeArg(T const&) {
+        return 0;
+    }
+
+    template<size_t I, typename Tuple>
+    std::enable_if_t<(I + 1 < std::tuple_size<Tuple>::value), size_t>
+    SizeAfter(Tuple const& args) {
+        return SizeArg(std::get<I + 1>(args));
+    }
+
+    template<size_t I, typename Tuple>
+    std::enable_if_t<(I + 1 >= std::tuple_size<Tuple>::value), size_t>
+    SizeAfter(Tuple const&) {
+        return 0;
+    }
+}
+
+
+// Call a DLL function with whichever instrumentation is on (see DLLFunc)
+template<typename F> struct InstrumentedCall;
+
+template<typename R, typename... Params>
+struct InstrumentedCall<R(Params...)> {
+    static R Invoke(size_t function, R (*proc)(Params...), Params... params) {
+        using namespace InstrumentationDetail;
+        unsigned const flags = Instrumentation::Active();
+
+        TraceBuffer inputs;
+        if (flags & (Instrumentation::FlagsTraceRecord | Instrumentation::FlagsTraceReplay)) {
+            (void)Expand{ 0, (ArgCodec<Params>::PutInput(inputs, params), 0)... };
+        }
+
+        Result<R> result;
+        if (flags & Instrumentation::FlagsTraceReplay) {
+            CallTrace::Response response;
+            if (CallTrace::FindResponse(function, inputs, &response)) {
+                TraceReader outputs{ response.outputs };
+                GetOutputs(outputs, std::index_sequence_for<Params...>{}, params...);
+                TraceReader resultReader{ response.result };
+                result.Get(resultReader);
+                CallTrace::WaitForReplay(response);
+            }
+            return result.Return();
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        result.Call([&] { return proc(params...); });
+        auto const duration = std::chrono::steady_clock::now() - start;
+
+        if (flags & Instrumentation::FlagsStatistics)
+            CallStatistics::Record(function, duration, result.IsError());
+
+        if (flags & Instrumentation::FlagsEventTrace)
+            EventTrace::KinesisCall(function, start, duration, result.IsError());
+
+        if (flags & Instrumentation::FlagsTraceRecord) {
+            // Output arguments are not necessarily set by a failed call
+            TraceBuffer outputs;
+            if (!result.IsError())
+                PutOutputs(outputs, std::index_sequence_for<Params...>{}, params...);
+            TraceBuffer resultBuffer;
+            result.Put(resultBuffer);
+            CallTrace::Append(function, start, duration, inputs, outputs, resultBuffer);
+        }
+        return result.Return();
+    }
+
+private:
+    template<size_t... I>
+    static void PutOutputs(TraceBuffer& buffer, std::index_sequence<I...>,
+        Params... params) {
+        using namespace InstrumentationDetail;
+        auto const args = std::forward_as_tuple(params...);
+        (void)args; // When there are no parameters
+        (void)Expand{ 0, (ArgCodec<Params>::PutOutput(buffer, params,
+            SizeAfter<I>(args)), 0)... };
+    }
+
+    template<size_t... I>
+    static void GetOutputs(TraceReader& reader, std::index_sequence<I...>,
+        Params... params) {
+        using namespace InstrumentationDetail;
+        auto const args = std::forward_as_tuple(params...);
+        (void)args; // When there are no parameters
+        (void)Expand{ 0, (ArgCodec<Params>::GetOutput(reader, params,
+            SizeAfter<I>(args)), 0)... };
+    }
+};
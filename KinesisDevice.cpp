@@ -32,20 +32,289 @@
 
 #include "KinesisDevice.h"
 
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+
+namespace {
+    // Reconnecting gives up after this long, so that devices report an error
+    // instead of staying busy
+    std::chrono::seconds const ReconnectTimeLimit{ 60 };
+}
+
+
+std::atomic<bool> KinesisDeviceConnection::autoReconnect_{ true };
+
+
+KinesisDeviceConnection::~KinesisDeviceConnection() {
+    {
+        std::lock_guard<std::mutex> lock{ reconnectMutex_ };
+        stopReconnecting_ = true;
+    }
+    reconnectCv_.notify_all();
+    if (reconnectThread_.joinable())
+        reconnectThread_.join();
+
+    if (connectionError_ == 0)
+        access_->Close();
+}
+
+
+void
+KinesisDeviceConnection::ReportLost() {
+    if (!IsValid() || !AutoReconnect())
+        return;
+
+    std::lock_guard<std::mutex> lock{ reconnectMutex_ };
+    if (lost_.load() || stopReconnecting_)
+        return;
+    lost_.store(true);
+    reconnectFailed_.store(false);
+
+    // A previous reconnect thread has finished (it clears lost_ as its last
+    // action under the lock)
+    if (reconnectThread_.joinable())
+        reconnectThread_.join();
+    reconnectThread_ = std::thread([this] { Reconnect(); });
+}
+
+
+void
+KinesisDeviceConnection::Reconnect() {
+    std::chrono::milliseconds const maxBackoff{ 1000 };
+    std::chrono::milliseconds backoff{ 50 };
+    auto const deadline = std::chrono::steady_clock::now() + ReconnectTimeLimit;
+    std::vector<char> deviceList;
+
+    std::unique_lock<std::mutex> lock{ reconnectMutex_ };
+    while (!reconnectCv_.wait_for(lock, backoff, [this] { return stopReconnecting_; })) {
+        lock.unlock();
+        // A replugged device cannot be opened until the device list has been
+        // rebuilt, which the DeviceMonitor may not be doing
+        if (IsKinesisDriverAvailable())
+            ReadDeviceList(deviceList);
+        short err = executor_.Execute(CommandExecutor::LaneConfiguration, [&] {
+            access_->Close();
+            return access_->Open();
+        });
+        lock.lock();
+
+        if (err == 0) {
+            // Give the device a fresh start with the breaker, which has
+            // most likely opened while the device was gone
+            retrier_.ResetBreaker();
+            ++generation_;
+            lost_.store(false);
+            return;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            reconnectFailed_.store(true);
+            lost_.store(false);
+            return;
+        }
+        backoff = std::min(backoff * 2, maxBackoff);
+    }
+}
+
 
 std::string
 KinesisDevice::GetModelNo() {
-    char modelNo[16];
+    char modelNo[16] = "";
     WORD type;
     WORD numChannels;
-    char notes[128];
+    char notes[128] = "";
     DWORD firmwareVersion;
     WORD hardwareVersion;
     WORD modificationState;
-    short err = Kinesis_GetHardwareInfo(modelNo, sizeof(modelNo),
-        &type, &numChannels, notes, sizeof(notes), &firmwareVersion,
-        &hardwareVersion, &modificationState);
+    short err = Run(CommandExecutor::LaneConfiguration, [&] {
+        return Kinesis_GetHardwareInfo(modelNo, sizeof(modelNo),
+            &type, &numChannels, notes, sizeof(notes), &firmwareVersion,
+            &hardwareVersion, &modificationState);
+    });
     if (err)
         return "Error";
     return modelNo;
 }
+
+
+short
+KinesisDevice::RestoreState() {
+    short err = RequestSettings();
+    if (err)
+        return err;
+    if (pollingIntervalMs_ > 0 && !StartPolling(pollingIntervalMs_))
+        return 20; // The function failed to complete successfully
+    return RequestStatusBits();
+}
+
+
+short
+MotorDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (homingParams_.isSet) {
+        auto const p = homingParams_;
+        err = SetHomingParameters(p.direction, p.limitSwitchMode,
+            p.offsetDistance, p.velocity);
+        if (err)
+            return err;
+    }
+    if (limitSwitchParams_.isSet) {
+        auto const p = limitSwitchParams_;
+        err = SetLimitSwitchParameters(p.ccwHardwareLimitMode,
+            p.ccwSoftwareLimitPosition, p.cwHardwareLimitMode,
+            p.cwSoftwareLimitPosition, p.softwareLimitMode);
+        if (err)
+            return err;
+    }
+    if (velocityParams_.isSet) {
+        auto const p = velocityParams_;
+        err = SetVelocityParameters(p.acceleration, p.maxVelocity);
+        if (err)
+            return err;
+    }
+    return RequestPosition();
+}
+
+
+std::string
+MotorDrive::FormatCapabilities(unsigned capabilities) {
+    static const std::pair<Capabilities, char const*> names[] = {
+        { CapabilitiesHomingParams, "HomingParams" },
+        { CapabilitiesLimitSwitchParams, "LimitSwitchParams" },
+        { CapabilitiesActuatorDetection, "ActuatorDetection" },
+        { CapabilitiesTriggers, "Triggers" },
+        { CapabilitiesVelocityParams, "VelocityParams" },
+        { CapabilitiesMessageQueue, "MessageQueue" },
+        { CapabilitiesRotationModes, "RotationModes" },
+        { CapabilitiesEncoder, "Encoder" },
+    };
+
+    std::string ret;
+    for (auto const& name : names) {
+        if (capabilities & name.first) {
+            if (!ret.empty())
+                ret += ',';
+            ret += name.second;
+        }
+    }
+    if (ret.empty())
+        ret = "None";
+    return ret;
+}
+
+
+short
+PiezoDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (enabled_) {
+        err = SetEnabled(true);
+        if (err)
+            return err;
+    }
+    if (maxOutputVoltage_ > 0) {
+        err = SetMaxOutputVoltage(maxOutputVoltage_);
+        if (err)
+            return err;
+    }
+    if (controlMode_ != 0)
+        return SetControlMode(static_cast<ControlMode>(controlMode_));
+    return 0;
+}
+
+
+short
+FlipperDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (transitTimeMs_ > 0)
+        return SetTransitTimeMs(transitTimeMs_);
+    return 0;
+}
+
+
+short
+InertialMotorDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (driveParams_.isSet) {
+        auto const p = driveParams_;
+        return SetDriveParameters(p.maxVoltage, p.stepRate, p.stepAcceleration);
+    }
+    return 0;
+}
+
+
+short
+SolenoidDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (cycleParams_.isSet) {
+        auto const p = cycleParams_;
+        err = SetCycleParams(p.openTimeMs, p.closedTimeMs, p.numCycles);
+        if (err)
+            return err;
+    }
+    if (operatingMode_ != 0)
+        return SetOperatingMode(static_cast<OperatingMode>(operatingMode_));
+    return 0;
+}
+
+
+short
+StrainGaugeDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (displayMode_ != 0)
+        return SetDisplayMode(static_cast<DisplayMode>(displayMode_));
+    return 0;
+}
+
+
+short
+PolarizerDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (velocityPercent_ > 0 && HasCapability(CapabilitiesVelocity))
+        return SetVelocityPercent(velocityPercent_);
+    return 0;
+}
+
+
+short
+FilterWheelDrive::RestoreState() {
+    short err = KinesisDevice::RestoreState();
+    if (err)
+        return err;
+
+    if (speedMode_ >= 0 && HasCapability(CapabilitiesSpeedMode)) {
+        err = SetSpeedMode(static_cast<SpeedMode>(speedMode_));
+        if (err)
+            return err;
+    }
+    if (triggerMode_ >= 0 && HasCapability(CapabilitiesTriggerMode))
+        return SetTriggerMode(static_cast<TriggerMode>(triggerMode_));
+    return 0;
+}
+
+
+std::string
+PiezoDrive::FormatCapabilities(unsigned capabilities) {
+    return (capabilities & CapabilitiesLUT) ? "LUT" : "None";
+}
@@ -32,8 +32,18 @@
 
 #pragma once
 
-#include <string>
+#include "CommandExecutor.h"
+#include "CommandRetrier.h"
+#include "DeviceEnumeration.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
 
 #include <Windows.h>
 
@@ -49,6 +59,12 @@
 // be called once per multi-channel device. So we use a separate RAII class to
 // open the device. These "connection" objects should be managed with
 // shared_ptr. They form a class hierarchy just like KinesisDeivce.
+//
+// Every Kinesis call made after opening goes through the CommandExecutor
+// owned by the connection, so that channels sharing a controller (and MMCore
+// threads sharing a device) are serialized and motion commands take priority
+// over status queries. Commands that return an error code are additionally
+// retried on transient errors (see CommandRetrier).
 
 // Common base class for KinesisDeviceConnection and KinesisDevice
 class SerialNumbered {
@@ -81,9 +97,11 @@ public:
 
 private:
     friend class KinesisDeviceConnection;
+    friend class FaultInjectingAccess; // Forwards to the wrapped access
     short Open() {
         if (!IsKinesisDriverAvailable())
             return short(-1);
+        std::lock_guard<std::mutex> lock{ DeviceListMutex() };
         return Kinesis_Open();
     }
     short Close() { return Kinesis_Close(); }
@@ -102,9 +120,29 @@ protected: // Functions to be implemented by derived classes
 
 
 // RAII object for connection (open/close); we manage these with shared_ptr
+//
+// If a command fails because the device has gone away (e.g. its USB cable
+// was unplugged), the connection is marked lost and a background thread
+// rebuilds the device list and closes and reopens the connection, with
+// backoff, until it succeeds or a minute has passed (ReconnectFailed(); the
+// next lost-connection error starts over). Devices using the connection
+// notice the change of Generation() and restore their state (see
+// KinesisDevice::RestoreState() and StateRestorer.h).
 class KinesisDeviceConnection {
     std::unique_ptr<KinesisDeviceAccess> access_;
     short const connectionError_;
+    CommandExecutor executor_;
+    CommandRetrier retrier_;
+
+    std::atomic<bool> lost_{ false };
+    std::atomic<bool> reconnectFailed_{ false };
+    std::atomic<uint64_t> generation_{ 0 }; // Incremented on each reopen
+    std::mutex reconnectMutex_;
+    std::condition_variable reconnectCv_;
+    bool stopReconnecting_ = false; // Guarded by reconnectMutex_
+    std::thread reconnectThread_;
+
+    static std::atomic<bool> autoReconnect_;
 
 public:
     explicit KinesisDeviceConnection(std::unique_ptr<KinesisDeviceAccess> access) :
@@ -112,17 +150,15 @@ public:
         connectionError_{ access_->Open() }
     {}
 
-    virtual ~KinesisDeviceConnection() {
-        if (connectionError_ == 0)
-            access_->Close();
-    }
+    virtual ~KinesisDeviceConnection();
 
     std::string SerialNo() const {
         return access_->SerialNo();
     }
 
     short GetNumChannels() {
-        return access_->GetNumChannels();
+        return executor_.Execute(CommandExecutor::LaneConfiguration,
+            [&] { return access_->GetNumChannels(); });
     }
 
     bool IsValid() const {
@@ -132,12 +168,64 @@ public:
     short ConnectionError() const {
         return connectionError_;
     }
+
+    CommandExecutor& Executor() { return executor_; }
+    CommandRetrier& Retrier() { return retrier_; }
+
+    // Whether err means that the device is no longer there
+    static bool IsConnectionLostError(short err) {
+        return err == 7 || err == 33;
+    }
+
+    // Mark the connection lost and start reconnecting (if enabled and not
+    // already doing so)
+    void ReportLost();
+
+    bool IsLost() const { return lost_.load(); }
+
+    // Whether the last reconnect attempt gave up (the connection is closed)
+    bool ReconnectFailed() const { return reconnectFailed_.load(); }
+
+    // Number of times the connection has been reopened
+    uint64_t Generation() const { return generation_.load(); }
+
+    // Whether lost connections are reopened (applies to all connections)
+    static bool AutoReconnect() { return autoReconnect_.load(); }
+    static void SetAutoReconnect(bool enable) { autoReconnect_.store(enable); }
+
+private:
+    void Reconnect();
 };
 
 
 class KinesisDevice : public SerialNumbered {
     short const channel_;
     std::shared_ptr<KinesisDeviceConnection> const connection_;
+    int pollingIntervalMs_ = 0; // Zero if not polling
+
+    template<typename> friend class FaultInjectingMotorDrive; // Forwards to the wrapped drive
+
+protected:
+    // Run a Kinesis call through the connection's executor
+    template<typename F>
+    decltype(auto) Run(CommandExecutor::Lane lane, F&& f) {
+        return connection_->Executor().Execute(lane, std::forward<F>(f));
+    }
+
+    // Run a Kinesis command that returns an error code, retrying transient
+    // errors; each attempt is a separate turn on the executor. While the
+    // connection is lost, fail immediately with error 7. Status queries are
+    // kept out of the retrier's circuit breaker.
+    template<typename F>
+    short RunCommand(CommandExecutor::Lane lane, F&& f) {
+        if (connection_->IsLost())
+            return 7; // The device is no longer present
+        short err = connection_->Retrier().Execute([&] { return Run(lane, f); },
+            lane != CommandExecutor::LaneStatus);
+        if (KinesisDeviceConnection::IsConnectionLostError(err))
+            connection_->ReportLost();
+        return err;
+    }
 
 public:
     explicit KinesisDevice(std::shared_ptr<KinesisDeviceConnection> connection) :
@@ -155,14 +243,43 @@ public:
     // Return channel, or -1 if device is not multi-channel
     short Channel() const { return channel_; }
 
-    short RequestSettings() { return Kinesis_RequestSettings(); }
-    short RequestStatusBits() { return Kinesis_RequestStatusBits(); }
-    bool StartPolling(int intervalMs) { return Kinesis_StartPolling(intervalMs); }
-    void StopPolling() { Kinesis_StopPolling(); }
+    // Optional features, as a mask of the Capabilities enum of the drive
+    // class; none unless overridden
+    virtual unsigned GetCapabilities() const { return 0; }
+
+    bool HasCapability(unsigned capability) const {
+        return (GetCapabilities() & capability) != 0;
+    }
+
+    short RequestSettings() {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_RequestSettings(); });
+    }
+    short RequestStatusBits() {
+        return RunCommand(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_RequestStatusBits(); });
+    }
+    bool StartPolling(int intervalMs) {
+        pollingIntervalMs_ = intervalMs;
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_StartPolling(intervalMs); });
+    }
+    void StopPolling() {
+        pollingIntervalMs_ = 0;
+        Run(CommandExecutor::LaneConfiguration,
+            [&] { Kinesis_StopPolling(); });
+    }
+
+    // Re-apply settings made through this object, after the connection has
+    // been reopened
+    virtual short RestoreState();
 
     std::string GetModelNo();
 
-    int GetStatusBits() { return Kinesis_GetStatusBits(); }
+    int GetStatusBits() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetStatusBits(); });
+    }
 
 protected: // 1:1 wrappers for Kinesis API functions
     virtual short Kinesis_RequestSettings() = 0;
@@ -179,6 +296,28 @@ protected: // 1:1 wrappers for Kinesis API functions
 
 
 class MotorDrive : public KinesisDevice {
+    template<typename> friend class FaultInjectingMotorDrive;
+
+    // Parameters last set (or read, for velocity), re-applied by
+    // RestoreState()
+    struct SavedHomingParams {
+        bool isSet;
+        int direction, limitSwitchMode, offsetDistance, velocity;
+    };
+    struct SavedLimitSwitchParams {
+        bool isSet;
+        int ccwHardwareLimitMode, ccwSoftwareLimitPosition;
+        int cwHardwareLimitMode, cwSoftwareLimitPosition;
+        int softwareLimitMode;
+    };
+    struct SavedVelocityParams {
+        bool isSet;
+        int acceleration, maxVelocity;
+    };
+    SavedHomingParams homingParams_{};
+    SavedLimitSwitchParams limitSwitchParams_{};
+    SavedVelocityParams velocityParams_{};
+
 public:
     explicit MotorDrive(std::shared_ptr<KinesisDeviceConnection> connection) :
         KinesisDevice{ connection }
@@ -188,6 +327,22 @@ public:
         KinesisDevice{ connection, channel }
     {}
 
+    // Optional features, according to the functions exported by the
+    // family's DLL (determined when the DLL is loaded)
+    enum Capabilities : unsigned {
+        CapabilitiesHomingParams = 0x1,
+        CapabilitiesLimitSwitchParams = 0x2,
+        CapabilitiesActuatorDetection = 0x4, // LoadSettings, stage axis params
+        CapabilitiesTriggers = 0x8,
+        CapabilitiesVelocityParams = 0x10,
+        CapabilitiesMessageQueue = 0x20,
+        CapabilitiesRotationModes = 0x40,
+        CapabilitiesEncoder = 0x80,
+    };
+
+    // Comma-separated names, e.g. "HomingParams,Encoder"
+    static std::string FormatCapabilities(unsigned capabilities);
+
     // Below are wrapped Kinesis functions. Several are kept even though they
     // do not work (see comments below), in case they get fixed in the future.
 
@@ -217,7 +372,9 @@ public:
     // "channel enabled" bit in the status bits, disabling a channel does not
     // actually prevent movement.
     short SetChannelEnabled(bool enabled) {
-        return enabled ? Kinesis_EnableChannel() : Kinesis_DisableChannel();
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return enabled ? Kinesis_EnableChannel() : Kinesis_DisableChannel();
+        });
     }
 
     bool IsChannelEnabled() {
@@ -232,7 +389,9 @@ public:
     // This function is unusable: it seems to always return 1 (Linear) (Kinesis
     // 1.14.18).
     TravelMode GetMotorTravelMode() {
-        switch (Kinesis_GetMotorTravelMode()) {
+        int mode = Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetMotorTravelMode(); });
+        switch (mode) {
         case 1: return TravelModeLinear;
         case 2: return TravelModeRotational;
         default: return TravelModeLinear;
@@ -242,7 +401,8 @@ public:
     // This function is unusable: it seems to always return error 1 (a few
     // devices tested; Kinesis 1.14.18).
     short SetMotorTravelMode(TravelMode mode) {
-        return Kinesis_SetMotorTravelMode(mode);
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetMotorTravelMode(mode); });
     }
 
     enum RotationMode {
@@ -255,44 +415,114 @@ public:
         RotationDirectionForward = 1,
         RotationDirectionReverse = 2,
     };
-    short ResetRotationMode() { return Kinesis_ResetRotationModes(); }
+    short ResetRotationMode() {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_ResetRotationModes(); });
+    }
 
     // This function is unusable: either it crashes, or causes subsequent moves
     // to crash (a few devices tested; Kinesis 1.14.18).
     short SetRotationMode(RotationMode mode, RotationDirection direction) {
-        return Kinesis_SetRotationModes(mode, direction);
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetRotationModes(mode, direction); });
     }
 
     short SetHomingParameters(int direction, int limitSwitchMode, int offsetDistance, int velocity)
     {
-        return Kinesis_SetHomingParams(direction, limitSwitchMode, offsetDistance, velocity);
+        homingParams_ = SavedHomingParams{ true, direction, limitSwitchMode, offsetDistance, velocity };
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_SetHomingParams(direction, limitSwitchMode, offsetDistance, velocity);
+        });
     }
 
     short SetLimitSwitchParameters(int ccwHardwareLimitMode, int ccwSoftwareLimitPosition,
         int cwHardwareLimitMode, int cwSoftwareLimitPosition, int softwareLimitMode)
     {
-        return Kinesis_SetLimitSwitchParams(ccwHardwareLimitMode, ccwSoftwareLimitPosition,
-            cwHardwareLimitMode, cwSoftwareLimitPosition, softwareLimitMode);
+        limitSwitchParams_ = SavedLimitSwitchParams{ true, ccwHardwareLimitMode, ccwSoftwareLimitPosition,
+            cwHardwareLimitMode, cwSoftwareLimitPosition, softwareLimitMode };
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_SetLimitSwitchParams(ccwHardwareLimitMode, ccwSoftwareLimitPosition,
+                cwHardwareLimitMode, cwSoftwareLimitPosition, softwareLimitMode);
+        });
     }
 
-    short RequestPosition() { return Kinesis_RequestPosition(); }
-    int GetPosition() { return Kinesis_GetPosition(); }
-    long GetPositionCounter() { return Kinesis_GetPositionCounter(); }
-    short MoveToPosition(int index) { return Kinesis_MoveToPosition(index); }
+    // Also remembers the parameters, so that they are restored on reconnect
+    // even if never set through this object
+    short GetVelocityParameters(int* acceleration, int* maxVelocity) {
+        short err = RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_GetVelParams(acceleration, maxVelocity);
+        });
+        if (!err)
+            velocityParams_ = SavedVelocityParams{ true, *acceleration, *maxVelocity };
+        return err;
+    }
 
-    bool CanHome() { return Kinesis_CanHome(); }
-    short Home() { return Kinesis_Home(); }
+    short SetVelocityParameters(int acceleration, int maxVelocity) {
+        velocityParams_ = SavedVelocityParams{ true, acceleration, maxVelocity };
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_SetVelParams(acceleration, maxVelocity);
+        });
+    }
+
+    short RestoreState() override;
+
+    short RequestPosition() {
+        return RunCommand(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_RequestPosition(); });
+    }
+    int GetPosition() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPosition(); });
+    }
+    long GetPositionCounter() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPositionCounter(); });
+    }
+    short MoveToPosition(int index) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveToPosition(index); });
+    }
+
+    bool CanHome() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_CanHome(); });
+    }
+    short Home() {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_Home(); });
+    }
 
-    short LoadSettings() { return Kinesis_LoadSettings(); }
-    short GetConnectedActuatorName(std::string* actuatorName) { return Kinesis_GetConnectedActuatorName(actuatorName); }
+    short LoadSettings() {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_LoadSettings(); });
+    }
+    short GetConnectedActuatorName(std::string* actuatorName) {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetConnectedActuatorName(actuatorName); });
+    }
 
     // These conversion functions seem to always return an error (tested with
     // cage rotator K10CR1; Kinesis 1.14.18)
     short DeviceToPhysicalPosition(int deviceUnits, double& physicalUnits) {
-        return Kinesis_GetRealValueFromDeviceUnit(deviceUnits, &physicalUnits, 0);
+        return DeviceToPhysicalValue(deviceUnits, physicalUnits, 0);
     }
     short PhysicalToDevicePosition(double physicalUnits, int& deviceUnits) {
-        return Kinesis_GetDeviceUnitFromRealValue(physicalUnits, &deviceUnits, 0);
+        return PhysicalToDeviceValue(physicalUnits, deviceUnits, 0);
+    }
+    // unitType: 0 = distance, 1 = velocity, 2 = acceleration
+    short DeviceToPhysicalValue(int deviceUnits, double& physicalUnits,
+        int unitType) {
+        return Run(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_GetRealValueFromDeviceUnit(deviceUnits,
+                &physicalUnits, unitType);
+        });
+    }
+    short PhysicalToDeviceValue(double physicalUnits, int& deviceUnits,
+        int unitType) {
+        return Run(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_GetDeviceUnitFromRealValue(physicalUnits,
+                &deviceUnits, unitType);
+        });
     }
 
 protected:
@@ -322,6 +552,10 @@ protected:
     virtual short Kinesis_LoadSettings() { return 1; };
     virtual short Kinesis_GetConnectedActuatorName(std::string* actuator_name) { actuator_name->append("ERROR"); return 1; };
 
+    // Error 18: "The function is not available for this device"
+    virtual short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) { return 18; }
+    virtual short Kinesis_SetVelParams(int acceleration, int maxVelocity) { return 18; }
+
     virtual short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
         double* realValue, int unitType) = 0;
     virtual short Kinesis_GetDeviceUnitFromRealValue(double realValue,
@@ -330,6 +564,8 @@ protected:
 
 
 class NonStepperMotorDrive : public MotorDrive {
+    friend class FaultInjectingNonStepperMotorDrive;
+
 public:
     explicit NonStepperMotorDrive(std::shared_ptr<KinesisDeviceConnection> connection) :
         MotorDrive{ connection }
@@ -339,8 +575,637 @@ public:
         MotorDrive{ connection, channel }
     {}
 
-    long GetEncoderCounter() { return Kinesis_GetEncoderCounter(); }
+    long GetEncoderCounter() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetEncoderCounter(); });
+    }
 
 protected:
     virtual long Kinesis_GetEncoderCounter() = 0;
 };
+
+
+// Piezo controllers (K-Cube, T-Cube and benchtop). Positions and output
+// voltages are in the API's units: a fraction of the maximum travel, 0 to
+// MaxValue, and a fraction of the maximum output voltage, -MaxValue to
+// MaxValue. Position control requires closed-loop mode (strain gauge
+// feedback); in open-loop mode only the voltage is controlled.
+class PiezoDrive : public KinesisDevice {
+    // Settings last made, re-applied by RestoreState()
+    bool enabled_ = false;
+    int controlMode_ = 0; // Zero if never set
+    short maxOutputVoltage_ = 0; // Zero if never set
+
+public:
+    PiezoDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    static int const MaxValue = 32767;
+
+    enum Capabilities : unsigned {
+        CapabilitiesLUT = 0x1, // Output lookup table (waveform)
+    };
+
+    // Comma-separated names, e.g. "LUT"
+    static std::string FormatCapabilities(unsigned capabilities);
+
+    // Size of the output lookup table (zero if not available)
+    virtual short MaxLUTSamples() const { return 0; }
+
+    enum StatusBits : DWORD {
+        StatusBitsActuatorConnected = 0x1,
+        StatusBitsZeroed = 0x10,
+        StatusBitsZeroing = 0x20,
+        StatusBitsStrainGaugeConnected = 0x100,
+        StatusBitsClosedLoop = 0x400,
+        StatusBitsChannelEnabled = 0x80000000,
+    };
+
+    short SetEnabled(bool enabled) {
+        enabled_ = enabled;
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return enabled ? Kinesis_Enable() : Kinesis_Disable();
+        });
+    }
+
+    enum ControlMode {
+        ControlModeOpenLoop = 1,
+        ControlModeClosedLoop = 2,
+        ControlModeOpenLoopSmooth = 3,
+        ControlModeClosedLoopSmooth = 4,
+    };
+
+    static bool IsClosedLoop(ControlMode mode) {
+        return mode == ControlModeClosedLoop || mode == ControlModeClosedLoopSmooth;
+    }
+
+    ControlMode GetControlMode() {
+        int mode = Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPositionControlMode(); });
+        switch (mode) {
+        case 2: return ControlModeClosedLoop;
+        case 3: return ControlModeOpenLoopSmooth;
+        case 4: return ControlModeClosedLoopSmooth;
+        default: return ControlModeOpenLoop;
+        }
+    }
+
+    short SetControlMode(ControlMode mode) {
+        controlMode_ = mode;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetPositionControlMode(mode); });
+    }
+
+    // In units of 0.1 V
+    short GetMaxOutputVoltage() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetMaxOutputVoltage(); });
+    }
+    short SetMaxOutputVoltage(short tenthsOfVolt) {
+        maxOutputVoltage_ = tenthsOfVolt;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetMaxOutputVoltage(tenthsOfVolt); });
+    }
+
+    short GetOutputVoltage() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetOutputVoltage(); });
+    }
+    short SetOutputVoltage(short voltage) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_SetOutputVoltage(voltage); });
+    }
+
+    int GetPosition() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPosition(); });
+    }
+    short SetPosition(int position) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_SetPosition(position); });
+    }
+
+    // In units of 100 nm; zero if the actuator does not report its travel
+    int GetMaximumTravel() {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetMaximumTravel(); });
+    }
+
+    // Closed-loop mode: calibrate the strain gauge zero (takes ~30 s;
+    // StatusBitsZeroing is set meanwhile)
+    short SetZero() {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_SetZero(); });
+    }
+
+    // The lookup table holds positions (closed loop) or voltages (open
+    // loop), output one per sampleIntervalMs, cycling through the first
+    // cycleLength samples
+    struct LUTParams {
+        bool continuous = true; // Otherwise numCycles cycles
+        short cycleLength = 0;
+        unsigned numCycles = 1;
+        unsigned sampleIntervalMs = 1;
+        unsigned preCycleDelayMs = 0;
+        unsigned postCycleDelayMs = 0;
+    };
+
+    short SetLUTSample(short index, int value) {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetLUTSample(index, value); });
+    }
+    short SetLUTParams(LUTParams const& params) {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetLUTParams(params); });
+    }
+    short StartLUT() {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_StartLUT(); });
+    }
+    short StopLUT() {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_StopLUT(); });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual short Kinesis_Enable() = 0;
+    virtual short Kinesis_Disable() = 0;
+    virtual int Kinesis_GetPositionControlMode() = 0;
+    virtual short Kinesis_SetPositionControlMode(int mode) = 0;
+    virtual short Kinesis_GetMaxOutputVoltage() = 0;
+    virtual short Kinesis_SetMaxOutputVoltage(short maxVoltage) = 0;
+    virtual short Kinesis_GetOutputVoltage() = 0;
+    virtual short Kinesis_SetOutputVoltage(short voltage) = 0;
+    virtual int Kinesis_GetPosition() = 0;
+    virtual short Kinesis_SetPosition(int position) = 0;
+    virtual int Kinesis_GetMaximumTravel() = 0;
+    virtual short Kinesis_SetZero() = 0;
+
+    // Error 18: "The function is not available for this device"
+    virtual short Kinesis_SetLUTSample(short index, int value) { return 18; }
+    virtual short Kinesis_SetLUTParams(LUTParams const& params) { return 18; }
+    virtual short Kinesis_StartLUT() { return 18; }
+    virtual short Kinesis_StopLUT() { return 18; }
+};
+
+
+// Filter flippers (MFF10x): a two-position mount. Completion of a move is
+// reported through the device's message queue, when the DLL provides one,
+// as well as by the status bits.
+class FlipperDrive : public KinesisDevice {
+    unsigned transitTimeMs_ = 0; // Zero if never set; re-applied by RestoreState()
+
+public:
+    FlipperDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    enum Capabilities : unsigned {
+        CapabilitiesMessageQueue = 0x1,
+    };
+
+    enum StatusBits : DWORD {
+        StatusBitsPosition1 = 0x1, // Limit switch at position 1
+        StatusBitsPosition2 = 0x2,
+        StatusBitsMoving = 0x10 | 0x20 | 0x40 | 0x80, // Moving or jogging, either direction
+        StatusBitsHoming = 0x200,
+    };
+
+    // Kinesis message (type 2, "generic motor") IDs sent on completion
+    static WORD const MessageTypeGenericMotor = 2;
+    enum MessageID : WORD {
+        MessageIDHomed = 0,
+        MessageIDMoved = 1,
+        MessageIDStopped = 2,
+    };
+
+    struct Message {
+        WORD type;
+        WORD id;
+        DWORD data;
+    };
+
+    short Home() {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_Home(); });
+    }
+
+    // Position is 1 or 2
+    short MoveToPosition(int position) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveToPosition(position); });
+    }
+
+    // 1 or 2, or 0 if unknown (e.g. while moving)
+    int GetPosition() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPosition(); });
+    }
+
+    // Time taken to move between the two positions
+    unsigned GetTransitTimeMs() {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetTransitTime(); });
+    }
+    short SetTransitTimeMs(unsigned ms) {
+        transitTimeMs_ = ms;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetTransitTime(ms); });
+    }
+
+    // CapabilitiesMessageQueue
+    void ClearMessageQueue() {
+        Run(CommandExecutor::LaneStatus,
+            [&] { Kinesis_ClearMessageQueue(); });
+    }
+    // Return false if the queue is empty
+    bool GetNextMessage(Message& message) {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetNextMessage(message); });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual short Kinesis_Home() = 0;
+    virtual short Kinesis_MoveToPosition(int position) = 0;
+    virtual int Kinesis_GetPosition() = 0;
+    virtual unsigned Kinesis_GetTransitTime() = 0;
+    virtual short Kinesis_SetTransitTime(unsigned ms) = 0;
+
+    virtual void Kinesis_ClearMessageQueue() {}
+    virtual bool Kinesis_GetNextMessage(Message& message) { return false; }
+};
+
+
+// Inertial piezo motor controllers (KIM101, TIM101): four channels, each
+// driving an open-loop stepping actuator whose position is a step count
+// kept by the controller. Moves are asynchronous, so moves on different
+// channels run concurrently.
+class InertialMotorDrive : public KinesisDevice {
+    // Parameters last set, re-applied by RestoreState()
+    struct SavedDriveParams {
+        bool isSet;
+        short maxVoltage;
+        int stepRate, stepAcceleration;
+    };
+    SavedDriveParams driveParams_{};
+
+public:
+    InertialMotorDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    enum StatusBits : DWORD {
+        StatusBitsMoving = 0x10 | 0x20 | 0x40 | 0x80, // Moving or jogging, either direction
+    };
+
+    short MoveAbsolute(int steps) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveAbsolute(steps); });
+    }
+    short MoveRelative(int steps) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveRelative(steps); });
+    }
+    short Stop() {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveStop(); });
+    }
+
+    // As of the last status update (polling), without a round trip to the
+    // device
+    int GetPosition() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetCurrentPosition(); });
+    }
+
+    // Set the step count of the current position (no motion)
+    short SetPositionCounter(int steps) {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetPosition(steps); });
+    }
+
+    // Drive parameters: maxVoltage in volts (85 to 125), stepRate in
+    // steps/s (1 to 2000), stepAcceleration in steps/s^2 (1 to 100000)
+    short GetDriveParameters(short& maxVoltage, int& stepRate, int& stepAcceleration) {
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_GetDriveOPParameters(maxVoltage, stepRate,
+                stepAcceleration);
+        });
+    }
+    short SetDriveParameters(short maxVoltage, int stepRate, int stepAcceleration) {
+        driveParams_ = { true, maxVoltage, stepRate, stepAcceleration };
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_SetDriveOPParameters(maxVoltage, stepRate,
+                stepAcceleration);
+        });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual short Kinesis_MoveAbsolute(int position) = 0;
+    virtual short Kinesis_MoveRelative(int stepSize) = 0;
+    virtual short Kinesis_MoveStop() = 0;
+    virtual int Kinesis_GetCurrentPosition() = 0;
+    virtual short Kinesis_SetPosition(int position) = 0;
+    virtual short Kinesis_GetDriveOPParameters(short& maxVoltage,
+        int& stepRate, int& stepAcceleration) = 0;
+    virtual short Kinesis_SetDriveOPParameters(short maxVoltage,
+        int stepRate, int stepAcceleration) = 0;
+};
+
+
+// Solenoid controllers (KSC101, TSC001). The solenoid is driven according to
+// the operating mode while the controller is active: held open (manual),
+// opened once for the open time (single), cycled (auto), or opened by the
+// trigger input (triggered).
+class SolenoidDrive : public KinesisDevice {
+    // Settings last made, re-applied by RestoreState()
+    int operatingMode_ = 0; // Zero if never set
+    struct SavedCycleParams {
+        bool isSet;
+        unsigned openTimeMs, closedTimeMs, numCycles;
+    };
+    SavedCycleParams cycleParams_{};
+
+public:
+    SolenoidDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    enum OperatingMode {
+        OperatingModeManual = 1,
+        OperatingModeSingle = 2,
+        OperatingModeAuto = 3,
+        OperatingModeTriggered = 4,
+    };
+
+    OperatingMode GetOperatingMode() {
+        int mode = Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetOperatingMode(); });
+        switch (mode) {
+        case 2: return OperatingModeSingle;
+        case 3: return OperatingModeAuto;
+        case 4: return OperatingModeTriggered;
+        default: return OperatingModeManual;
+        }
+    }
+
+    short SetOperatingMode(OperatingMode mode) {
+        operatingMode_ = mode;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetOperatingMode(mode); });
+    }
+
+    // Activate or deactivate the output (in manual mode, open or close)
+    short SetActive(bool active) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_SetOperatingState(active); });
+    }
+
+    // As of the last status update (polling)
+    bool IsActive() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_IsActive(); });
+    }
+    bool IsSolenoidOpen() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_IsSolenoidOpen(); });
+    }
+
+    // Single and auto modes: numCycles zero means cycle until deactivated
+    short GetCycleParams(unsigned& openTimeMs, unsigned& closedTimeMs,
+        unsigned& numCycles) {
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_GetCycleParams(openTimeMs, closedTimeMs, numCycles);
+        });
+    }
+    short SetCycleParams(unsigned openTimeMs, unsigned closedTimeMs,
+        unsigned numCycles) {
+        cycleParams_ = { true, openTimeMs, closedTimeMs, numCycles };
+        return RunCommand(CommandExecutor::LaneConfiguration, [&] {
+            return Kinesis_SetCycleParams(openTimeMs, closedTimeMs, numCycles);
+        });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual int Kinesis_GetOperatingMode() = 0;
+    virtual short Kinesis_SetOperatingMode(int mode) = 0;
+    virtual short Kinesis_SetOperatingState(bool active) = 0;
+    virtual bool Kinesis_IsActive() = 0;
+    virtual bool Kinesis_IsSolenoidOpen() = 0;
+    virtual short Kinesis_GetCycleParams(unsigned& openTimeMs,
+        unsigned& closedTimeMs, unsigned& numCycles) = 0;
+    virtual short Kinesis_SetCycleParams(unsigned openTimeMs,
+        unsigned closedTimeMs, unsigned numCycles) = 0;
+};
+
+
+// Strain gauge readers (KSG101, TSG001). Readings are a fraction of full
+// scale, -MaxValue to MaxValue, in the quantity selected by the display
+// mode.
+class StrainGaugeDrive : public KinesisDevice {
+    int displayMode_ = 0; // Zero if never set; re-applied by RestoreState()
+
+public:
+    StrainGaugeDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    static int const MaxValue = 32767;
+
+    enum DisplayMode {
+        DisplayModePosition = 1,
+        DisplayModeVoltage = 2,
+        DisplayModeForce = 3,
+    };
+
+    DisplayMode GetDisplayMode() {
+        int mode = Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetDisplayMode(); });
+        switch (mode) {
+        case 2: return DisplayModeVoltage;
+        case 3: return DisplayModeForce;
+        default: return DisplayModePosition;
+        }
+    }
+
+    short SetDisplayMode(DisplayMode mode) {
+        displayMode_ = mode;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetDisplayMode(mode); });
+    }
+
+    // As of the last status update (polling)
+    int GetReading(bool smoothed) {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetReading(smoothed); });
+    }
+
+    // In units of 100 nm
+    int GetMaximumTravel() {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetMaximumTravel(); });
+    }
+
+    // Take the current reading as zero
+    short SetZero() {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetZero(); });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual int Kinesis_GetDisplayMode() = 0;
+    virtual short Kinesis_SetDisplayMode(int mode) = 0;
+    virtual int Kinesis_GetReading(bool smoothed) = 0;
+    virtual int Kinesis_GetMaximumTravel() = 0;
+    virtual short Kinesis_SetZero() = 0;
+};
+
+
+// Polarization controllers (MPC320): three paddles, each rotated to an angle
+// in degrees. The paddles are addressed by number (1 to NumPaddles) within a
+// single device, so that commands for different paddles share a connection
+// and the paddles can move at the same time.
+class PolarizerDrive : public KinesisDevice {
+    int velocityPercent_ = 0; // Zero if never set; re-applied by RestoreState()
+
+public:
+    PolarizerDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    static int const NumPaddles = 3;
+
+    enum Capabilities : unsigned {
+        CapabilitiesVelocity = 0x1,
+    };
+
+    // Returns once the move is started
+    short MoveToPosition(int paddle, double degrees) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveToPosition(paddle, degrees); });
+    }
+
+    // As of the last status update (polling)
+    double GetPosition(int paddle) {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPosition(paddle); });
+    }
+
+    // Degrees
+    double GetMaxTravel() {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetMaxTravel(); });
+    }
+
+    // CapabilitiesVelocity; percent of maximum, shared by all paddles
+    short GetVelocityPercent(int& percent) {
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetVelocity(percent); });
+    }
+    short SetVelocityPercent(int percent) {
+        velocityPercent_ = percent;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetVelocity(percent); });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual short Kinesis_MoveToPosition(int paddle, double degrees) = 0;
+    virtual double Kinesis_GetPosition(int paddle) = 0;
+    virtual double Kinesis_GetMaxTravel() = 0;
+
+    // Error 18: "The function is not available for this device"
+    virtual short Kinesis_GetVelocity(int& percent) { return 18; }
+    virtual short Kinesis_SetVelocity(int percent) { return 18; }
+};
+
+
+// Filter wheels (FW102C, FW212C): positions are numbered from 1 to
+// GetPositionCount(), and the controller turns the wheel the shorter way
+// round to reach a position. In trigger input mode, each pulse at the
+// trigger input advances the wheel to the next position (wrapping around).
+class FilterWheelDrive : public KinesisDevice {
+    // Settings last made, re-applied by RestoreState()
+    int speedMode_ = -1; // Negative if never set
+    int triggerMode_ = -1;
+
+public:
+    FilterWheelDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        KinesisDevice{ connection, channel }
+    {}
+
+    enum Capabilities : unsigned {
+        CapabilitiesSpeedMode = 0x1,
+        CapabilitiesTriggerMode = 0x2,
+    };
+
+    enum SpeedMode {
+        SpeedModeNormal = 0,
+        SpeedModeHigh = 1,
+    };
+
+    enum TriggerMode {
+        TriggerModeInput = 0,
+        TriggerModeOutput = 1,
+    };
+
+    int GetPositionCount() {
+        return Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetPositionCount(); });
+    }
+
+    short MoveToPosition(int position) {
+        return RunCommand(CommandExecutor::LaneMotion,
+            [&] { return Kinesis_MoveToPosition(position); });
+    }
+
+    // As of the last status update (polling); 0 if unknown (e.g. while
+    // moving)
+    int GetPosition() {
+        return Run(CommandExecutor::LaneStatus,
+            [&] { return Kinesis_GetPosition(); });
+    }
+
+    // CapabilitiesSpeedMode
+    SpeedMode GetSpeedMode() {
+        int mode = Run(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_GetSpeedMode(); });
+        return mode == 1 ? SpeedModeHigh : SpeedModeNormal;
+    }
+    short SetSpeedMode(SpeedMode mode) {
+        speedMode_ = mode;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetSpeedMode(mode); });
+    }
+
+    // CapabilitiesTriggerMode
+    short SetTriggerMode(TriggerMode mode) {
+        triggerMode_ = mode;
+        return RunCommand(CommandExecutor::LaneConfiguration,
+            [&] { return Kinesis_SetTriggerMode(mode); });
+    }
+
+    short RestoreState() override;
+
+protected:
+    virtual int Kinesis_GetPositionCount() = 0;
+    virtual short Kinesis_MoveToPosition(int position) = 0;
+    virtual int Kinesis_GetPosition() = 0;
+
+    // Error 18: "The function is not available for this device"
+    virtual int Kinesis_GetSpeedMode() { return 0; }
+    virtual short Kinesis_SetSpeedMode(int mode) { return 18; }
+    virtual short Kinesis_SetTriggerMode(int mode) { return 18; }
+};
@@ -30,32 +30,122 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include "Broker.h"
+#include "CallStatistics.h"
+#include "CallTrace.h"
+#include "CommandRetrier.h"
+#include "EventTrace.h"
+#include "FaultInjection.h"
+#include "PositionOrder.h"
+#include "StatusBoard.h"
+#include "XYStage.h"
 #include "Connections.h"
 #include "DeviceEnumeration.h"
 #include "DeviceInstantiation.h"
+#include "DeviceMonitor.h"
 
 #include "DeviceBase.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 namespace {
     std::string const DEVICENAME_HUB = "ThorlabsKinesis";
 
     std::string const PROPERTY_ENABLE_SIMULATED = "EnableSimulatedDevices";
+    std::string const PROPERTY_CALL_STATISTICS = "KinesisCallStatistics";
+    std::string const PROPERTY_LOG_CALL_STATISTICS = "KinesisCallStatisticsReport";
+    std::string const PROPERTY_CALL_TRACE = "KinesisCallTrace";
+    std::string const PROPERTY_CALL_TRACE_FILE = "KinesisCallTraceFile";
+    std::string const PROPERTY_CALL_TRACE_SIZE_MB = "KinesisCallTraceSizeMB";
+    std::string const PROPERTY_CALL_TRACE_TIMING = "KinesisCallTraceReplayTiming";
+    std::string const PROPERTY_EVENT_TRACE = "EventTrace";
+    std::string const PROPERTY_EVENT_TRACE_FILE = "EventTraceFile";
+    std::string const PROPERTY_RETRY_MAX_ATTEMPTS_BUSY = "RetryMaxAttemptsBusy";
+    std::string const PROPERTY_RETRY_MAX_ATTEMPTS_IO = "RetryMaxAttemptsIO";
+    std::string const PROPERTY_RETRY_INITIAL_BACKOFF_MS = "RetryInitialBackoffMs";
+    std::string const PROPERTY_RETRY_LATENCY_BUDGET_MS = "RetryLatencyBudgetMs";
+    std::string const PROPERTY_BREAKER_THRESHOLD = "CircuitBreakerThreshold";
+    std::string const PROPERTY_BREAKER_COOLDOWN_MS = "CircuitBreakerCooldownMs";
+    std::string const PROPERTY_FAULT_INJECTION = "FaultInjection";
+    std::string const PROPERTY_AUTO_RECONNECT = "AutoReconnect";
+    std::string const PROPERTY_HOT_PLUG_INTERVAL_MS = "HotPlugScanIntervalMs";
+    std::string const PROPERTY_ATTACHED_DEVICES = "AttachedDevices";
+    std::string const PROPERTY_DEVICE_ALLOWLIST = "DeviceAllowlist";
+    std::string const PROPERTY_DEVICE_DENYLIST = "DeviceDenylist";
+    std::string const PROPERTY_STATUS_BOARD = "StatusBoard";
+    std::string const PROPERTY_STATUS_BOARD_NAME = "StatusBoardName";
+    std::string const PROPERTY_STATUS_BOARD_SLOTS = "StatusBoardSlots";
+    std::string const PROPERTY_BROKER_MODE = "BrokerMode";
+    std::string const PROPERTY_BROKER_PIPE_NAME = "BrokerPipeName";
+    std::string const PROPERTY_POSITION_ORDER_AXES = "PositionOrderAxes";
+    std::string const PROPERTY_POSITION_ORDER_TOGETHER = "PositionOrderAxesMoveTogether";
+    std::string const PROPERTY_POSITION_ORDER_INPUT = "PositionOrderInput";
+    std::string const PROPERTY_POSITION_ORDER_INPUT_FILE = "PositionOrderInputFile";
+    std::string const PROPERTY_POSITION_ORDER = "PositionOrder";
+    std::string const PROPERTY_POSITION_ORDER_FILE = "PositionOrderFile";
+    std::string const PROPERTY_POSITION_ORDER_INPUT_MS = "PositionOrderInputPredictedMs";
+    std::string const PROPERTY_POSITION_ORDER_MS = "PositionOrderPredictedMs";
 
     std::string const PROPVALUE_YES = "Yes";
     std::string const PROPVALUE_NO = "No";
+    std::string const PROPVALUE_ON = "On";
+    std::string const PROPVALUE_OFF = "Off";
+    std::string const PROPVALUE_IDLE = "Idle";
+    std::string const PROPVALUE_LOG = "WriteToLog";
+    std::string const PROPVALUE_RECORD = "Record";
+    std::string const PROPVALUE_REPLAY = "Replay";
+    std::string const PROPVALUE_ORIGINAL = "Original";
+    std::string const PROPVALUE_AS_FAST_AS_POSSIBLE = "AsFastAsPossible";
+    std::string const PROPVALUE_SERVE = "Serve";
+    std::string const PROPVALUE_CLIENT = "Client";
 
 
     int const ERR_KINESIS_DRIVER_NOT_FOUND = 99999;
     int const ERR_MULTIPLE_HUBS = 99998;
+    int const ERR_CALL_TRACE = 99997;
+    int const ERR_EVENT_TRACE = 99996;
+    int const ERR_FAULT_SCHEDULE = 99995;
+    int const ERR_DEVICE_FILTER = 99994;
+    int const ERR_STATUS_BOARD = 99993;
+    int const ERR_BROKER = 99992;
+    int const ERR_POSITION_LIST = 99991;
+    int const ERR_POSITION_LIST_TOO_LONG = 99990;
+    int const ERR_POSITION_LIST_FILE = 99989;
 }
 
 
 namespace {
 
     class KinesisHub final : public HubBase<KinesisHub> {
+        // Updated by the DeviceMonitor thread as devices come and go
+        std::mutex deviceSerialNosMutex_;
         std::vector<std::string> deviceSerialNos_;
+        std::unique_ptr<DeviceMonitor> deviceMonitor_;
+        std::unique_ptr<BrokerServer> brokerServer_;
+
+        // Result of the last PositionOrderInput
+        PositionOrderResult positionOrder_;
+        enum PositionOrderValue {
+            PositionOrderIndices,
+            PositionOrderInputMs,
+            PositionOrderMs,
+        };
+
+        // Results of DetectInstalledDevices() by serial number, so that the
+        // Hardware Configuration Wizard does not reopen every device each
+        // time it is run; guarded by deviceSerialNosMutex_
+        struct DetectedDevice {
+            short channel;
+            std::string name;
+        };
+        std::unordered_map<std::string, std::vector<DetectedDevice>> detectedDevices_;
         bool simulatorsEnabled_;
 
         // Only allow a single instance of hub to be initialized at a time.
@@ -76,15 +166,176 @@ namespace {
                 "Cannot load the Thorlabs Kinesis DLLs. Make sure Kinesis is "
                 "installed at the standard location");
             SetErrorText(ERR_MULTIPLE_HUBS, "Only one hub can be created");
+            SetErrorText(ERR_CALL_TRACE,
+                "Cannot open the Kinesis call trace file");
+            SetErrorText(ERR_EVENT_TRACE,
+                "Cannot open the event trace file");
+            SetErrorText(ERR_FAULT_SCHEDULE,
+                "Invalid fault injection schedule");
+            SetErrorText(ERR_DEVICE_FILTER,
+                "Invalid device allowlist or denylist");
+            SetErrorText(ERR_BROKER,
+                "Cannot start the device broker, or connect to it (in Client "
+                "mode, make sure the serving Micro-Manager is running)");
+            SetErrorText(ERR_STATUS_BOARD,
+                "Cannot create the status board shared memory (it may already "
+                "be in use by another process)");
+            SetErrorText(ERR_POSITION_LIST,
+                "Invalid position list (expected one integer per axis of "
+                "PositionOrderAxes for each position, e.g. \"0,0;1000,0\")");
+            SetErrorText(ERR_POSITION_LIST_TOO_LONG,
+                "Position list or order too long for a property value (use "
+                "PositionOrderInputFile and PositionOrderFile instead)");
+            SetErrorText(ERR_POSITION_LIST_FILE,
+                "Cannot read the position list file or write the position "
+                "order file");
+
+            // Restrict which devices are detected and opened, e.g.
+            // "27*,type:83" (see DeviceFilter in DeviceEnumeration.h); an
+            // empty allowlist allows all devices
+            CreateStringProperty(PROPERTY_DEVICE_ALLOWLIST.c_str(), "",
+                false, nullptr, true);
+            CreateStringProperty(PROPERTY_DEVICE_DENYLIST.c_str(), "",
+                false, nullptr, true);
+
+            // Record all Kinesis calls to a trace file, or replay a recorded
+            // trace without hardware (see CallTrace.h)
+            CreateStringProperty(PROPERTY_CALL_TRACE.c_str(), PROPVALUE_OFF.c_str(),
+                false, nullptr, true);
+            AddAllowedValue(PROPERTY_CALL_TRACE.c_str(), PROPVALUE_OFF.c_str());
+            AddAllowedValue(PROPERTY_CALL_TRACE.c_str(), PROPVALUE_RECORD.c_str());
+            AddAllowedValue(PROPERTY_CALL_TRACE.c_str(), PROPVALUE_REPLAY.c_str());
+            CreateStringProperty(PROPERTY_CALL_TRACE_FILE.c_str(),
+                "KinesisCallTrace.bin", false, nullptr, true);
+            CreateIntegerProperty(PROPERTY_CALL_TRACE_SIZE_MB.c_str(), 64,
+                false, nullptr, true);
+            SetPropertyLimits(PROPERTY_CALL_TRACE_SIZE_MB.c_str(), 1, 4096);
+            CreateStringProperty(PROPERTY_CALL_TRACE_TIMING.c_str(),
+                PROPVALUE_ORIGINAL.c_str(), false, nullptr, true);
+            AddAllowedValue(PROPERTY_CALL_TRACE_TIMING.c_str(), PROPVALUE_ORIGINAL.c_str());
+            AddAllowedValue(PROPERTY_CALL_TRACE_TIMING.c_str(), PROPVALUE_AS_FAST_AS_POSSIBLE.c_str());
+
+            // Per-function call counts and latency histograms for all
+            // Kinesis calls; off by default (see CallStatistics.h)
+            CreateStringProperty(PROPERTY_CALL_STATISTICS.c_str(),
+                CallStatistics::IsEnabled() ? PROPVALUE_ON.c_str() : PROPVALUE_OFF.c_str(),
+                false, new CPropertyAction(this, &KinesisHub::OnCallStatistics));
+            AddAllowedValue(PROPERTY_CALL_STATISTICS.c_str(), PROPVALUE_OFF.c_str());
+            AddAllowedValue(PROPERTY_CALL_STATISTICS.c_str(), PROPVALUE_ON.c_str());
+
+            // Retry of commands failing with transient errors, applied to
+            // all devices (see CommandRetrier.h)
+            CommandRetrier::Policy const retry = CommandRetrier::DefaultPolicy();
+            CreateIntegerProperty(PROPERTY_RETRY_MAX_ATTEMPTS_BUSY.c_str(),
+                long(retry.maxAttempts[CommandRetrier::ErrorClassBusy]),
+                false, nullptr, true);
+            SetPropertyLimits(PROPERTY_RETRY_MAX_ATTEMPTS_BUSY.c_str(), 1, 100);
+            CreateIntegerProperty(PROPERTY_RETRY_MAX_ATTEMPTS_IO.c_str(),
+                long(retry.maxAttempts[CommandRetrier::ErrorClassIO]),
+                false, nullptr, true);
+            SetPropertyLimits(PROPERTY_RETRY_MAX_ATTEMPTS_IO.c_str(), 1, 100);
+            CreateIntegerProperty(PROPERTY_RETRY_INITIAL_BACKOFF_MS.c_str(),
+                long(retry.initialBackoff.count()), false, nullptr, true);
+            SetPropertyLimits(PROPERTY_RETRY_INITIAL_BACKOFF_MS.c_str(), 0, 1000);
+            CreateIntegerProperty(PROPERTY_RETRY_LATENCY_BUDGET_MS.c_str(),
+                long(retry.latencyBudget.count()), false, nullptr, true);
+            SetPropertyLimits(PROPERTY_RETRY_LATENCY_BUDGET_MS.c_str(), 0, 10000);
+            CreateIntegerProperty(PROPERTY_BREAKER_THRESHOLD.c_str(),
+                long(retry.breakerThreshold), false, nullptr, true);
+            SetPropertyLimits(PROPERTY_BREAKER_THRESHOLD.c_str(), 0, 1000);
+            CreateIntegerProperty(PROPERTY_BREAKER_COOLDOWN_MS.c_str(),
+                long(retry.breakerCooldown.count()), false, nullptr, true);
+            SetPropertyLimits(PROPERTY_BREAKER_COOLDOWN_MS.c_str(), 0, 60000);
+
+            // Reopen devices in the background when they disappear (e.g.
+            // unplugged or power cycled), restoring their settings
+            CreateStringProperty(PROPERTY_AUTO_RECONNECT.c_str(),
+                KinesisDeviceConnection::AutoReconnect() ?
+                PROPVALUE_YES.c_str() : PROPVALUE_NO.c_str(),
+                false, nullptr, true);
+            AddAllowedValue(PROPERTY_AUTO_RECONNECT.c_str(), PROPVALUE_YES.c_str());
+            AddAllowedValue(PROPERTY_AUTO_RECONNECT.c_str(), PROPVALUE_NO.c_str());
+
+            // Rescan for devices plugged in or unplugged while running, so
+            // that they can be added without restarting; 0 to scan only at
+            // startup
+            CreateIntegerProperty(PROPERTY_HOT_PLUG_INTERVAL_MS.c_str(), 1000,
+                false, nullptr, true);
+            SetPropertyLimits(PROPERTY_HOT_PLUG_INTERVAL_MS.c_str(), 0, 60000);
+
+            // Share devices with other processes: Serve executes Kinesis
+            // calls for clients; in Client mode, calls go to the server
+            // instead of the Kinesis DLL (see Broker.h)
+            CreateStringProperty(PROPERTY_BROKER_MODE.c_str(),
+                PROPVALUE_OFF.c_str(), false, nullptr, true);
+            AddAllowedValue(PROPERTY_BROKER_MODE.c_str(), PROPVALUE_OFF.c_str());
+            AddAllowedValue(PROPERTY_BROKER_MODE.c_str(), PROPVALUE_SERVE.c_str());
+            AddAllowedValue(PROPERTY_BROKER_MODE.c_str(), PROPVALUE_CLIENT.c_str());
+            CreateStringProperty(PROPERTY_BROKER_PIPE_NAME.c_str(),
+                "\\\\.\\pipe\\MMThorlabsKinesisBroker", false, nullptr, true);
+
+            // Publish stage positions in shared memory for other processes
+            // (see StatusBoard.h)
+            CreateStringProperty(PROPERTY_STATUS_BOARD.c_str(),
+                PROPVALUE_OFF.c_str(), false, nullptr, true);
+            AddAllowedValue(PROPERTY_STATUS_BOARD.c_str(), PROPVALUE_OFF.c_str());
+            AddAllowedValue(PROPERTY_STATUS_BOARD.c_str(), PROPVALUE_ON.c_str());
+            CreateStringProperty(PROPERTY_STATUS_BOARD_NAME.c_str(),
+                "Local\\MMThorlabsKinesisStatusBoard", false, nullptr, true);
+            CreateIntegerProperty(PROPERTY_STATUS_BOARD_SLOTS.c_str(), 32,
+                false, nullptr, true);
+            SetPropertyLimits(PROPERTY_STATUS_BOARD_SLOTS.c_str(), 1, 1024);
+
+            // Simulated misbehavior for testing, e.g.
+            // "seed=7,latency=0.01:250,error47=0.05"; empty for none (see
+            // FaultInjection.h)
+            CreateStringProperty(PROPERTY_FAULT_INJECTION.c_str(), "",
+                false, nullptr, true);
+
+            // Timeline of moves, status polls, and Kinesis calls in Chrome
+            // trace event format; can be switched on and off at any time
+            // (see EventTrace.h)
+            CreateStringProperty(PROPERTY_EVENT_TRACE_FILE.c_str(),
+                "KinesisEventTrace.json", false, nullptr, true);
+            CreateStringProperty(PROPERTY_EVENT_TRACE.c_str(),
+                EventTrace::IsEnabled() ? PROPVALUE_ON.c_str() : PROPVALUE_OFF.c_str(),
+                false, new CPropertyAction(this, &KinesisHub::OnEventTrace));
+            AddAllowedValue(PROPERTY_EVENT_TRACE.c_str(), PROPVALUE_OFF.c_str());
+            AddAllowedValue(PROPERTY_EVENT_TRACE.c_str(), PROPVALUE_ON.c_str());
         }
 
         int Initialize() override {
             if (lock_)
                 return ERR_MULTIPLE_HUBS;
 
+            // Must be set up before the first Kinesis call
+            int err = StartCallTrace();
+            if (err != DEVICE_OK)
+                return err;
+
             if (!IsKinesisDriverAvailable())
                 return ERR_KINESIS_DRIVER_NOT_FOUND;
 
+            // Must be set before enumeration and connections
+            err = ApplyDeviceFilter();
+            if (err != DEVICE_OK)
+                return err;
+
+            // Must be set before connections are made
+            ApplyRetryPolicy();
+            char autoReconnect[MM::MaxStrLength];
+            GetProperty(PROPERTY_AUTO_RECONNECT.c_str(), autoReconnect);
+            KinesisDeviceConnection::SetAutoReconnect(autoReconnect == PROPVALUE_YES);
+            err = ApplyFaultSchedule();
+            if (err != DEVICE_OK)
+                return err;
+            err = CreateStatusBoard();
+            if (err != DEVICE_OK)
+                return err;
+            err = StartBroker();
+            if (err != DEVICE_OK)
+                return err;
+
             lock_ = true;
             lockHeld_ = true;
 
@@ -95,12 +346,60 @@ namespace {
                 simulatorsEnabled_ = true;
             }
 
-            deviceSerialNos_ = EnumerateSerialNumbers();
+            {
+                std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+                deviceSerialNos_ = EnumerateSerialNumbers();
+            }
+
+            CreateStringProperty(PROPERTY_ATTACHED_DEVICES.c_str(),
+                FormatSerialNumbers().c_str(), true,
+                new CPropertyAction(this, &KinesisHub::OnAttachedDevices));
+            StartDeviceMonitor();
+
+            CreateStringProperty(PROPERTY_LOG_CALL_STATISTICS.c_str(),
+                PROPVALUE_IDLE.c_str(), false,
+                new CPropertyAction(this, &KinesisHub::OnLogCallStatistics));
+            AddAllowedValue(PROPERTY_LOG_CALL_STATISTICS.c_str(), PROPVALUE_IDLE.c_str());
+            AddAllowedValue(PROPERTY_LOG_CALL_STATISTICS.c_str(), PROPVALUE_LOG.c_str());
+
+            // Position ordering service (see PositionOrder.h): set the axes,
+            // then a position list; read back the order. Lists and orders
+            // longer than MM::MaxStrLength (e.g. a 384-well plate) must go
+            // through files, as MMCore truncates longer property values.
+            CreateStringProperty(PROPERTY_POSITION_ORDER_AXES.c_str(), "", false);
+            CreateStringProperty(PROPERTY_POSITION_ORDER_TOGETHER.c_str(),
+                PROPVALUE_YES.c_str(), false);
+            AddAllowedValue(PROPERTY_POSITION_ORDER_TOGETHER.c_str(), PROPVALUE_YES.c_str());
+            AddAllowedValue(PROPERTY_POSITION_ORDER_TOGETHER.c_str(), PROPVALUE_NO.c_str());
+            CreateStringProperty(PROPERTY_POSITION_ORDER_INPUT.c_str(), "", false,
+                new CPropertyAction(this, &KinesisHub::OnPositionOrderInput));
+            CreateStringProperty(PROPERTY_POSITION_ORDER_INPUT_FILE.c_str(), "",
+                false, new CPropertyAction(this, &KinesisHub::OnPositionOrderInputFile));
+            CreateStringProperty(PROPERTY_POSITION_ORDER_FILE.c_str(), "", false);
+            CreateStringProperty(PROPERTY_POSITION_ORDER.c_str(), "", true,
+                new CPropertyActionEx(this, &KinesisHub::OnPositionOrder, PositionOrderIndices));
+            CreateFloatProperty(PROPERTY_POSITION_ORDER_INPUT_MS.c_str(), 0.0, true,
+                new CPropertyActionEx(this, &KinesisHub::OnPositionOrder, PositionOrderInputMs));
+            CreateFloatProperty(PROPERTY_POSITION_ORDER_MS.c_str(), 0.0, true,
+                new CPropertyActionEx(this, &KinesisHub::OnPositionOrder, PositionOrderMs));
 
             return DEVICE_OK;
         }
 
         int Shutdown() override {
+            deviceMonitor_.reset();
+            brokerServer_.reset();
+            BrokerClient::SetActive(nullptr);
+            if (CallStatistics::IsEnabled())
+                LogCallStatistics();
+            if (CallTrace::IsRecording())
+                CallTrace::Stop();
+            EventTrace::Stop();
+
+            FaultSchedule::ClearActive();
+            DeviceFilter::ClearActive();
+            // Stages that are still initialized keep the board alive
+            StatusBoard::SetActive(nullptr);
             if (simulatorsEnabled_)
                 DisableSimulatedDevices();
             if (lockHeld_)
@@ -119,15 +418,35 @@ namespace {
         int DetectInstalledDevices() override {
             ClearInstalledDevices();
 
-            for (auto const& serialNo : deviceSerialNos_) {
+            std::vector<std::string> serialNos;
+            {
+                std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+                serialNos = deviceSerialNos_;
+            }
+
+            for (auto const& serialNo : serialNos) {
+                // Devices detected by a previous run can be recreated by name
+                // without reconnecting
+                std::vector<DetectedDevice> cached;
+                {
+                    std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+                    auto it = detectedDevices_.find(serialNo);
+                    if (it != detectedDevices_.end())
+                        cached = it->second;
+                }
+                if (!cached.empty()) {
+                    for (auto const& device : cached) {
+                        MM::Device* dummy = MakeDevice(device.name, serialNo,
+                            device.channel);
+                        if (dummy)
+                            AddInstalledDevice(dummy);
+                    }
+                    continue;
+                }
+
                 // We need to make a connection to the device in order to
                 // determine the number of channels, and also to get the model
                 // number.
-                // TODO Currently the dummy device will reconnect when
-                // GetName() is called. It might be good to prime the dummy
-                // device with the connection to avoid that (some devices are
-                // slow). This would mean passing the connection to
-                // MakeDevice() et al.
                 std::shared_ptr<KinesisDeviceConnection> connection = MakeConnection(serialNo);
                 if (!connection) {
                     // Unsupported or (less likely) could not connect. If we
@@ -139,24 +458,403 @@ namespace {
                         if (dummy)
                             AddInstalledDevice(dummy);
                     }
+                    continue;
                 }
-                else if (IsPotentiallyMultiChannel(serialNo)) {
+
+                std::vector<short> channels;
+                if (IsPotentiallyMultiChannel(serialNo)) {
                     short numChannels = connection->GetNumChannels();
-                    for (short ch = 1; ch <= numChannels; ++ch) {
-                        MM::Device* dummy = MakeDevice("", serialNo, ch, connection);
-                        if (dummy)
-                            AddInstalledDevice(dummy);
-                    }
+                    for (short ch = 1; ch <= numChannels; ++ch)
+                        channels.push_back(ch);
                 }
                 else {
-                    MM::Device* dummy = MakeDevice("", serialNo, short(-1), connection);
-                    if (dummy)
-                        AddInstalledDevice(dummy);
+                    channels.push_back(-1);
+                }
+
+                std::vector<DetectedDevice> detected;
+                for (short ch : channels) {
+                    MM::Device* dummy = MakeDevice("", serialNo, ch, connection);
+                    if (!dummy)
+                        continue;
+                    // The name includes the model number, which requires the
+                    // connection we already have
+                    char name[MM::MaxStrLength];
+                    dummy->GetName(name);
+                    detected.push_back({ ch, name });
+                    AddInstalledDevice(dummy);
+                }
+
+                std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+                detectedDevices_[serialNo] = std::move(detected);
+            }
+
+            // XY stages: channels 1 and 2 of each multi-channel controller,
+            // and each pair of single-axis controllers
+            std::vector<std::string> xyNames;
+            {
+                std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+                std::vector<std::pair<std::string, short>> singleAxes;
+                for (auto const& serialNo : serialNos) {
+                    auto it = detectedDevices_.find(serialNo);
+                    if (it == detectedDevices_.end() || !IsSupportedMotorAxis(serialNo))
+                        continue;
+                    auto const& devices = it->second;
+                    if (devices.size() >= 2) {
+                        xyNames.push_back(XYStage::MakeName(serialNo, devices[0].channel,
+                            serialNo, devices[1].channel));
+                    }
+                    else if (devices.size() == 1) {
+                        singleAxes.emplace_back(serialNo, devices[0].channel);
+                    }
+                }
+                for (size_t i = 0; i < singleAxes.size(); ++i) {
+                    for (size_t j = i + 1; j < singleAxes.size(); ++j) {
+                        xyNames.push_back(XYStage::MakeName(
+                            singleAxes[i].first, singleAxes[i].second,
+                            singleAxes[j].first, singleAxes[j].second));
+                    }
+                }
+            }
+            for (auto const& name : xyNames) {
+                MM::Device* dummy = MakeXYStage(name);
+                if (dummy)
+                    AddInstalledDevice(dummy);
+            }
+
+            return DEVICE_OK;
+        }
+
+    private:
+        void StartDeviceMonitor() {
+            long intervalMs;
+            GetProperty(PROPERTY_HOT_PLUG_INTERVAL_MS.c_str(), intervalMs);
+            // A replayed call trace must see the same sequence of calls as
+            // was recorded
+            if (intervalMs <= 0 || CallTrace::IsReplaying())
+                return;
+
+            deviceMonitor_ = std::make_unique<DeviceMonitor>(
+                std::chrono::milliseconds{ intervalMs },
+                [this](std::string const& serialNo) {
+                    OnDeviceListChanged(serialNo, true);
+                },
+                [this](std::string const& serialNo) {
+                    OnDeviceListChanged(serialNo, false);
+                },
+                IsConnectionOpen);
+            deviceMonitor_->Start();
+        }
+
+        // Called on the DeviceMonitor thread
+        void OnDeviceListChanged(std::string const& serialNo, bool added) {
+            if (!DeviceFilter::Active().Allows(serialNo))
+                return;
+            {
+                std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+                detectedDevices_.erase(serialNo);
+                auto it = std::find(deviceSerialNos_.begin(),
+                    deviceSerialNos_.end(), serialNo);
+                if (added && it == deviceSerialNos_.end())
+                    deviceSerialNos_.push_back(serialNo);
+                else if (!added && it != deviceSerialNos_.end())
+                    deviceSerialNos_.erase(it);
+                else
+                    return;
+            }
+            LogMessage("Device " + serialNo +
+                (added ? " attached" : " detached"), true);
+            OnPropertyChanged(PROPERTY_ATTACHED_DEVICES.c_str(),
+                FormatSerialNumbers().c_str());
+        }
+
+        std::string FormatSerialNumbers() {
+            std::lock_guard<std::mutex> lock{ deviceSerialNosMutex_ };
+            std::string ret;
+            for (auto const& serialNo : deviceSerialNos_) {
+                if (!ret.empty())
+                    ret += ",";
+                ret += serialNo;
+            }
+            return ret;
+        }
+
+        int OnAttachedDevices(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet)
+                pProp->Set(FormatSerialNumbers().c_str());
+            return DEVICE_OK;
+        }
+
+        int StartBroker() {
+            char mode[MM::MaxStrLength];
+            GetProperty(PROPERTY_BROKER_MODE.c_str(), mode);
+            if (mode == PROPVALUE_OFF)
+                return DEVICE_OK;
+
+            char pipeName[MM::MaxStrLength];
+            GetProperty(PROPERTY_BROKER_PIPE_NAME.c_str(), pipeName);
+            if (mode == PROPVALUE_SERVE) {
+                brokerServer_ = std::make_unique<BrokerServer>(pipeName);
+                if (!brokerServer_->Start()) {
+                    brokerServer_.reset();
+                    return ERR_BROKER;
                 }
             }
+            else {
+                auto client = BrokerClient::Connect(pipeName);
+                if (!client)
+                    return ERR_BROKER;
+                BrokerClient::SetActive(client);
+            }
+            LogMessage(std::string{ "Device broker: " } + mode + " " + pipeName);
+            return DEVICE_OK;
+        }
+
+        int CreateStatusBoard() {
+            char enabled[MM::MaxStrLength];
+            GetProperty(PROPERTY_STATUS_BOARD.c_str(), enabled);
+            if (enabled != PROPVALUE_ON)
+                return DEVICE_OK;
+
+            char name[MM::MaxStrLength];
+            GetProperty(PROPERTY_STATUS_BOARD_NAME.c_str(), name);
+            long slots;
+            GetProperty(PROPERTY_STATUS_BOARD_SLOTS.c_str(), slots);
+            auto board = StatusBoard::Create(name, uint32_t(slots));
+            if (!board)
+                return ERR_STATUS_BOARD;
+            StatusBoard::SetActive(board);
+            LogMessage(std::string{ "Status board: " } + name);
+            return DEVICE_OK;
+        }
+
+        int ApplyDeviceFilter() {
+            char allowlist[MM::MaxStrLength];
+            char denylist[MM::MaxStrLength];
+            GetProperty(PROPERTY_DEVICE_ALLOWLIST.c_str(), allowlist);
+            GetProperty(PROPERTY_DEVICE_DENYLIST.c_str(), denylist);
+
+            DeviceFilter filter;
+            if (!DeviceFilter::Parse(allowlist, denylist, &filter))
+                return ERR_DEVICE_FILTER;
+            DeviceFilter::SetActive(filter);
+            if (!filter.IsEmpty()) {
+                LogMessage(std::string{ "Device allowlist: " } + allowlist +
+                    "; denylist: " + denylist);
+            }
+            return DEVICE_OK;
+        }
+
+        void ApplyRetryPolicy() {
+            CommandRetrier::Policy policy = CommandRetrier::DefaultPolicy();
+            long value;
+            GetProperty(PROPERTY_RETRY_MAX_ATTEMPTS_BUSY.c_str(), value);
+            policy.maxAttempts[CommandRetrier::ErrorClassBusy] = unsigned(value);
+            GetProperty(PROPERTY_RETRY_MAX_ATTEMPTS_IO.c_str(), value);
+            policy.maxAttempts[CommandRetrier::ErrorClassIO] = unsigned(value);
+            GetProperty(PROPERTY_RETRY_INITIAL_BACKOFF_MS.c_str(), value);
+            policy.initialBackoff = std::chrono::milliseconds{ value };
+            policy.maxBackoff = std::max(policy.maxBackoff, policy.initialBackoff);
+            GetProperty(PROPERTY_RETRY_LATENCY_BUDGET_MS.c_str(), value);
+            policy.latencyBudget = std::chrono::milliseconds{ value };
+            GetProperty(PROPERTY_BREAKER_THRESHOLD.c_str(), value);
+            policy.breakerThreshold = unsigned(value);
+            GetProperty(PROPERTY_BREAKER_COOLDOWN_MS.c_str(), value);
+            policy.breakerCooldown = std::chrono::milliseconds{ value };
+            CommandRetrier::SetDefaultPolicy(policy);
+        }
 
+        int ApplyFaultSchedule() {
+            char spec[MM::MaxStrLength];
+            GetProperty(PROPERTY_FAULT_INJECTION.c_str(), spec);
+            if (spec[0] == '\0') {
+                FaultSchedule::ClearActive();
+                return DEVICE_OK;
+            }
+
+            FaultSchedule schedule;
+            if (!FaultSchedule::Parse(spec, &schedule))
+                return ERR_FAULT_SCHEDULE;
+            FaultSchedule::SetActive(schedule);
+            LogMessage(std::string{ "Fault injection: " } + spec);
             return DEVICE_OK;
         }
+
+        int StartCallTrace() {
+            char mode[MM::MaxStrLength];
+            GetProperty(PROPERTY_CALL_TRACE.c_str(), mode);
+            if (mode == PROPVALUE_OFF)
+                return DEVICE_OK;
+
+            char path[MM::MaxStrLength];
+            GetProperty(PROPERTY_CALL_TRACE_FILE.c_str(), path);
+
+            bool ok;
+            if (mode == PROPVALUE_RECORD) {
+                long sizeMB;
+                GetProperty(PROPERTY_CALL_TRACE_SIZE_MB.c_str(), sizeMB);
+                ok = CallTrace::StartRecording(path, uint64_t(sizeMB) << 20);
+            }
+            else {
+                char timing[MM::MaxStrLength];
+                GetProperty(PROPERTY_CALL_TRACE_TIMING.c_str(), timing);
+                ok = CallTrace::StartReplay(path, timing == PROPVALUE_ORIGINAL);
+            }
+            if (!ok)
+                return ERR_CALL_TRACE;
+            LogMessage(std::string{ "Kinesis call trace: " } + mode + " " + path);
+            return DEVICE_OK;
+        }
+
+        int OnCallStatistics(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet) {
+                pProp->Set(CallStatistics::IsEnabled() ?
+                    PROPVALUE_ON.c_str() : PROPVALUE_OFF.c_str());
+            }
+            else if (eAct == MM::AfterSet) {
+                std::string value;
+                pProp->Get(value);
+                CallStatistics::SetEnabled(value == PROPVALUE_ON);
+            }
+            return DEVICE_OK;
+        }
+
+        int OnEventTrace(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet) {
+                pProp->Set(EventTrace::IsEnabled() ?
+                    PROPVALUE_ON.c_str() : PROPVALUE_OFF.c_str());
+            }
+            else if (eAct == MM::AfterSet) {
+                std::string value;
+                pProp->Get(value);
+                if (value == PROPVALUE_ON && !EventTrace::IsEnabled()) {
+                    char path[MM::MaxStrLength];
+                    GetProperty(PROPERTY_EVENT_TRACE_FILE.c_str(), path);
+                    if (!EventTrace::Start(path))
+                        return ERR_EVENT_TRACE;
+                    LogMessage(std::string{ "Event trace: " } + path);
+                }
+                else if (value == PROPVALUE_OFF) {
+                    EventTrace::Stop();
+                }
+            }
+            return DEVICE_OK;
+        }
+
+        int OnLogCallStatistics(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet) {
+                pProp->Set(PROPVALUE_IDLE.c_str());
+            }
+            else if (eAct == MM::AfterSet) {
+                std::string value;
+                pProp->Get(value);
+                if (value == PROPVALUE_LOG)
+                    LogCallStatistics();
+            }
+            return DEVICE_OK;
+        }
+
+        int OnPositionOrderInput(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct != MM::AfterSet)
+                return DEVICE_OK;
+
+            std::string input;
+            pProp->Get(input);
+            if (input.size() >= MM::MaxStrLength - 1) {
+                // May have been cut short on the way here
+                positionOrder_ = {};
+                return ERR_POSITION_LIST_TOO_LONG;
+            }
+            return OrderPositions(input);
+        }
+
+        int OnPositionOrderInputFile(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct != MM::AfterSet)
+                return DEVICE_OK;
+
+            std::string path;
+            pProp->Get(path);
+            if (path.empty())
+                return DEVICE_OK;
+            std::ifstream file{ path };
+            if (!file) {
+                positionOrder_ = {};
+                return ERR_POSITION_LIST_FILE;
+            }
+            std::string input{ std::istreambuf_iterator<char>{ file },
+                std::istreambuf_iterator<char>{} };
+            // Allow one position per line (empty items are skipped)
+            std::replace(input.begin(), input.end(), '\r', ';');
+            std::replace(input.begin(), input.end(), '\n', ';');
+            return OrderPositions(input);
+        }
+
+        int OrderPositions(std::string const& input) {
+            char axisNames[MM::MaxStrLength];
+            GetProperty(PROPERTY_POSITION_ORDER_AXES.c_str(), axisNames);
+            char together[MM::MaxStrLength];
+            GetProperty(PROPERTY_POSITION_ORDER_TOGETHER.c_str(), together);
+
+            PositionOrderProblem problem;
+            for (auto const& axis : ParseAxisNames(axisNames)) {
+                auto const model = MotionModel::ForAxis(axis);
+                if (!model->IsFitted())
+                    LogMessage("Motion model of axis " + axis +
+                        " not yet fitted; using default move times", false);
+                problem.axes.push_back(model->Get());
+            }
+            problem.axesMoveTogether = together == PROPVALUE_YES;
+
+            if (problem.axes.empty() ||
+                !ParsePositionList(input, problem.axes.size(), &problem.positions)) {
+                positionOrder_ = {};
+                return ERR_POSITION_LIST;
+            }
+
+            positionOrder_ = OptimizePositionOrder(problem);
+            LogMessage("Ordered " + std::to_string(problem.positions.size()) +
+                " positions: predicted " +
+                std::to_string(positionOrder_.originalMs) + " ms -> " +
+                std::to_string(positionOrder_.optimizedMs) + " ms", true);
+
+            char orderPath[MM::MaxStrLength];
+            GetProperty(PROPERTY_POSITION_ORDER_FILE.c_str(), orderPath);
+            if (orderPath[0] != '\0') {
+                std::ofstream file{ orderPath };
+                file << FormatPositionOrder(positionOrder_.order) << '\n';
+                if (!file)
+                    return ERR_POSITION_LIST_FILE;
+            }
+            return DEVICE_OK;
+        }
+
+        int OnPositionOrder(MM::PropertyBase* pProp, MM::ActionType eAct,
+            long which) {
+            if (eAct != MM::BeforeGet)
+                return DEVICE_OK;
+            switch (which) {
+            case PositionOrderIndices: {
+                std::string const order = FormatPositionOrder(positionOrder_.order);
+                if (order.size() >= MM::MaxStrLength)
+                    return ERR_POSITION_LIST_TOO_LONG;
+                pProp->Set(order.c_str());
+                break;
+            }
+            case PositionOrderInputMs:
+                pProp->Set(positionOrder_.originalMs);
+                break;
+            case PositionOrderMs:
+                pProp->Set(positionOrder_.optimizedMs);
+                break;
+            }
+            return DEVICE_OK;
+        }
+
+        void LogCallStatistics() {
+            std::string report = CallStatistics::Format();
+            if (report.empty())
+                report = "(no calls recorded)\n";
+            LogMessage("Kinesis call statistics:\n" + report);
+        }
     };
 
     bool KinesisHub::lock_ = false;
@@ -177,6 +875,10 @@ MODULE_API MM::Device* CreateDevice(char const* name) {
     if (name == DEVICENAME_HUB)
         return new KinesisHub();
 
+    if (std::string{ name }.compare(0, std::strlen(XYStage::NamePrefix),
+            XYStage::NamePrefix) == 0)
+        return MakeXYStage(name);
+
     // Device names are ModelNo_SerialNo or ModelNo_SerialNo-Channel.
     // ModelNo may be Error[N] or Unsupported.
     std::istringstream nameStream{ name };
@@ -0,0 +1,266 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "Connections.h"
+#include "Errors.h"
+#include "KinesisDevice.h"
+#include "StateRestorer.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+
+// Returned by Initialize() when the device is connected through a device
+// broker, which only serves motors (see Broker.h)
+int const ERR_NOT_AVAILABLE = 99999;
+
+
+namespace KinesisDriveDeviceDetail {
+    // Opens a Drive on a connection (see Connections.h)
+    template<typename Drive> struct DriveFactory;
+
+    template<> struct DriveFactory<PiezoDrive> {
+        static std::unique_ptr<PiezoDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+            return MakeKinesisPiezoDrive(connection, channel);
+        }
+    };
+
+    template<> struct DriveFactory<FlipperDrive> {
+        static std::unique_ptr<FlipperDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short) {
+            return MakeKinesisFlipperDrive(connection);
+        }
+    };
+
+    template<> struct DriveFactory<InertialMotorDrive> {
+        static std::unique_ptr<InertialMotorDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+            return MakeKinesisInertialMotorDrive(connection, channel);
+        }
+    };
+
+    template<> struct DriveFactory<SolenoidDrive> {
+        static std::unique_ptr<SolenoidDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short) {
+            return MakeKinesisSolenoidDrive(connection);
+        }
+    };
+
+    template<> struct DriveFactory<StrainGaugeDrive> {
+        static std::unique_ptr<StrainGaugeDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short) {
+            return MakeKinesisStrainGaugeDrive(connection);
+        }
+    };
+
+    template<> struct DriveFactory<PolarizerDrive> {
+        static std::unique_ptr<PolarizerDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short) {
+            return MakeKinesisPolarizerDrive(connection);
+        }
+    };
+
+    template<> struct DriveFactory<FilterWheelDrive> {
+        static std::unique_ptr<FilterWheelDrive> Make(
+            std::shared_ptr<KinesisDeviceConnection> connection, short) {
+            return MakeKinesisFilterWheelDrive(connection);
+        }
+    };
+}
+
+
+// Common part of the devices, other than the motor stages, that each wrap a
+// single Kinesis drive (as DeviceFamily is for the drives): the device name,
+// opening and closing the drive, and restoring its state after the
+// connection has been reopened (see StateRestorer). Derived is the device
+// class and Base<Derived> its Micro-Manager base class, e.g.
+//
+//   class Flipper final :
+//       public KinesisDriveDevice<CStateDeviceBase, Flipper, FlipperDrive>
+//
+// Derived calls OpenDrive() at the start of Initialize() and
+// StartRestoringState() at its end, CloseDrive() from Shutdown(), and
+// CheckConnection() before each command and from Busy() (which should report
+// busy while stateRestorer_.IsLost()). It overrides RestoreDeviceState() if
+// it has settings of its own to re-apply.
+template<template<class> class Base, typename Derived, typename Drive>
+class KinesisDriveDevice : public Base<Derived> {
+protected:
+    std::string const serialNo_;
+    short const channel_; // -1 if not multi-channel
+
+    // The device name, if created via CreateDevice() (empty if created via
+    // DetectInstalledDevices())
+    std::string const givenName_;
+
+    // Connection that is optionally passed in to constructor, so that existing
+    // connection is kept instead of creating a new one when needed.
+    std::shared_ptr<KinesisDeviceConnection> retainedConnection_;
+
+    // Set by OpenDrive():
+    std::unique_ptr<Drive> drive_;
+    StateRestorer stateRestorer_;
+
+    // familyName is the plural used in error messages, e.g. "Filter flippers"
+    KinesisDriveDevice(std::string const& name, std::string const& serialNo,
+        short channel, std::shared_ptr<KinesisDeviceConnection> connection,
+        char const* familyName) :
+        serialNo_{ serialNo },
+        channel_{ channel },
+        givenName_{ name },
+        retainedConnection_{ connection }
+    {
+        for (auto const& item : KinesisErrorCodes()) {
+            this->SetErrorText(ERR_OFFSET + item.first, item.second.c_str());
+        }
+        this->SetErrorText(ERR_NOT_AVAILABLE, (std::string{ familyName } +
+            " are not available through the device broker").c_str());
+    }
+
+public:
+    void GetName(char* name) const override {
+        // Name format is ModelNo_SerialNo or ModelNo_SerialNo-Channel; see
+        // SingleAxisStage::GetName() for when a temporary connection is made
+        std::string n;
+        if (!givenName_.empty()) {
+            n = givenName_;
+        }
+        else {
+            auto tmpDrive = Connect();
+            n = MakeName(tmpDrive.get());
+        }
+
+        CDeviceUtils::CopyLimitedString(name, n.c_str());
+    }
+
+protected:
+    int OpenDrive() {
+        auto drive = Connect();
+        if (!drive)
+            return ERR_NOT_AVAILABLE;
+        if (!drive->GetConnection()->IsValid()) {
+            for (auto const& name : MissingKinesisFunctions(serialNo_)) {
+                this->LogMessage(("Kinesis driver lacks required function " +
+                    name).c_str());
+            }
+            return ERR_OFFSET + drive->GetConnection()->ConnectionError();
+        }
+        drive_ = std::move(drive);
+        return DEVICE_OK;
+    }
+
+    // Record that the settings made so far are applied to the current
+    // connection
+    void StartRestoringState() {
+        stateRestorer_.Start(drive_->GetConnection());
+    }
+
+    // Polling can be left running for other channels sharing the connection;
+    // it stops when the last one releases it
+    void CloseDrive(bool stopPolling = true) {
+        if (!drive_)
+            return;
+        stateRestorer_.Stop();
+        if (stopPolling)
+            drive_->StopPolling();
+
+        this->LogMessage(("Kinesis call statistics for serial no " + serialNo_ +
+            ":\n" + drive_->GetConnection()->Executor().FormatStatistics()).c_str(),
+            true);
+
+        drive_.reset();
+    }
+
+    // Wait (up to the reconnect timeout) if the connection is lost, and
+    // restore the device's settings if it has been reopened since they were
+    // last applied
+    int CheckConnection() {
+        short err = stateRestorer_.Check([&] {
+            this->LogMessage(("Reconnected to serial no " + serialNo_ +
+                "; restoring state").c_str());
+            short err = RestoreDeviceState();
+            if (err) {
+                this->LogMessage(("Failed to restore state of serial no " +
+                    serialNo_ + " after reconnecting: error " +
+                    std::to_string(err)).c_str());
+            }
+            return err;
+        });
+        if (err)
+            return ERR_OFFSET + err;
+        return DEVICE_OK;
+    }
+
+    // Re-apply the settings after the connection has been reopened; returns
+    // a Kinesis error code
+    virtual short RestoreDeviceState() { return drive_->RestoreState(); }
+
+private:
+    std::unique_ptr<Drive> Connect() const {
+        auto connection = MakeConnection(serialNo_);
+        if (!connection) // Shouldn't happen
+            return {};
+
+        return KinesisDriveDeviceDetail::DriveFactory<Drive>::Make(connection,
+            channel_);
+    }
+
+    std::string MakeName(Drive* drive) const {
+        std::string name;
+
+        if (drive && drive->GetConnection()->IsValid()) {
+            name += drive->GetModelNo();
+        }
+        else {
+            name += "Error";
+            if (drive) {
+                name += std::to_string(drive->GetConnection()->ConnectionError());
+            }
+        }
+
+        name += '_';
+        name += serialNo_;
+
+        if (channel_ > 0) {
+            name += '-';
+            name += std::to_string(channel_);
+        }
+
+        return name;
+    }
+};
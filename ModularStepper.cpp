@@ -0,0 +1,70 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "MotorFamily.h"
+
+#include "Thorlabs.MotionControl.ModularRack.StepperMotor.h"
+
+
+namespace {
+    // Modular rack (MMR60x) with stepper modules (MST60x); the channel is the
+    // bay's channel within the rack.
+    //
+    // The velocity parameters are accessed through the non-struct functions
+    // only: this header declares MOT_VelocityParameters with #pragma pack(1),
+    // which the DLL does not honor (see DeviceEnumeration.cpp).
+    struct ModularStepperTraits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.ModularRack.StepperMotor.dll";
+        }
+        static constexpr bool isMultiChannel = true;
+        // The bays share the rack's connection to the computer
+        static constexpr bool pollChannelsTogether = true;
+
+        struct Functions : FunctionTable {
+            KINESIS_DEVICE_FUNCTIONS(MST);
+            KINESIS_MULTICHANNEL_FUNCTIONS(MST);
+            KINESIS_MOTOR_FUNCTIONS(MST);
+            KINESIS_ROTATION_MODE_FUNCTIONS(MST);
+            KINESIS_HOMING_PARAMS_FUNCTIONS(MST);
+            KINESIS_LIMIT_SWITCH_FUNCTIONS(MST);
+            KINESIS_VELOCITY_PARAMS_FUNCTIONS(MST);
+            KINESIS_MESSAGE_QUEUE_FUNCTIONS(MST);
+        };
+    };
+} // namespace
+
+
+MotorFamilyEntry const&
+ModularStepperFamily() {
+    return MotorFamily<ModularStepperTraits>::Entry();
+}
@@ -0,0 +1,188 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "MotionModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+
+
+namespace {
+    // A sample is an outlier if it exceeds the prediction by this factor
+    // plus margin; after this many outliers in a row, the axis is taken to
+    // have slowed down and they are used
+    double const OutlierFactor = 3.0;
+    double const OutlierMarginMs = 500.0;
+    size_t const MaxConsecutiveOutliers = 3;
+
+    // Solve the system a x = b restricted to the first n unknowns (the rest
+    // set to zero) by Gaussian elimination with partial pivoting; return
+    // false if singular. A pivot is taken as zero relative to the diagonal
+    // of a (the normal equations of nearly collinear terms are only
+    // singular up to rounding).
+    template<size_t N>
+    bool
+    Solve(std::array<std::array<double, N>, N> a, std::array<double, N> b,
+        size_t n, std::array<double, N>* x) {
+        std::array<double, N> scale;
+        for (size_t col = 0; col < n; ++col)
+            scale[col] = std::fabs(a[col][col]);
+        for (size_t col = 0; col < n; ++col) {
+            size_t pivot = col;
+            for (size_t row = col + 1; row < n; ++row) {
+                if (std::fabs(a[row][col]) > std::fabs(a[pivot][col]))
+                    pivot = row;
+            }
+            if (std::fabs(a[pivot][col]) <= 1e-9 * scale[col])
+                return false;
+            std::swap(a[col], a[pivot]);
+            std::swap(b[col], b[pivot]);
+            for (size_t row = col + 1; row < n; ++row) {
+                double const f = a[row][col] / a[col][col];
+                for (size_t k = col; k < n; ++k)
+                    a[row][k] -= f * a[col][k];
+                b[row] -= f * b[col];
+            }
+        }
+        x->fill(0.0);
+        for (size_t col = n; col-- > 0; ) {
+            double sum = b[col];
+            for (size_t k = col + 1; k < n; ++k)
+                sum -= a[col][k] * (*x)[k];
+            (*x)[col] = sum / a[col][col];
+        }
+        return true;
+    }
+}
+
+
+bool
+MotionModel::AddSample(long distance, double moveTimeMs) {
+    double const d = std::fabs(double(distance));
+    std::array<double, NumTerms> const x{
+        1.0, d, std::sqrt(d), distance < 0 ? 1.0 : 0.0 };
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    if (samples_ >= MinSamples && moveTimeMs >
+        OutlierFactor * Predict(coefficients_, distance) + OutlierMarginMs) {
+        if (++consecutiveOutliers_ < MaxConsecutiveOutliers)
+            return false;
+    }
+    consecutiveOutliers_ = 0;
+
+    for (size_t i = 0; i < NumTerms; ++i) {
+        for (size_t j = 0; j < NumTerms; ++j)
+            xtx_[i][j] += x[i] * x[j];
+        xtt_[i] += x[i] * moveTimeMs;
+    }
+    ++samples_;
+    if (samples_ < MinSamples)
+        return true;
+
+    // Drop terms the moves cannot tell apart, last first: the reverse term
+    // (all moves in one direction), then the sqrt term (only two distinct
+    // distances), then the linear term (all moves the same length), leaving
+    // the mean move time
+    std::array<double, NumTerms> fit;
+    size_t terms = NumTerms;
+    while (!Solve(xtx_, xtt_, terms, &fit)) {
+        if (--terms == 0)
+            return true;
+    }
+
+    // Negative velocity or settle terms are artifacts of noise
+    coefficients_.settleMs = std::max(fit[0], 0.0);
+    coefficients_.msPerUnit = std::max(fit[1], 0.0);
+    coefficients_.msPerSqrtUnit = std::max(fit[2], 0.0);
+    coefficients_.reverseMs = fit[3];
+    fitted_ = true;
+    return true;
+}
+
+
+size_t
+MotionModel::Samples() const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return samples_;
+}
+
+
+bool
+MotionModel::IsFitted() const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return fitted_;
+}
+
+
+MotionModel::Coefficients
+MotionModel::Get() const {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return coefficients_;
+}
+
+
+double
+MotionModel::Predict(Coefficients const& c, long distance) {
+    if (distance == 0)
+        return 0.0;
+    double const d = std::fabs(double(distance));
+    double const t = c.settleMs + c.msPerUnit * d + c.msPerSqrtUnit * std::sqrt(d) +
+        (distance < 0 ? c.reverseMs : 0.0);
+    return std::max(t, 0.0);
+}
+
+
+std::string
+MotionModel::Format(Coefficients const& c, size_t samples, bool fitted) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "settle=%.1fms velocity=%.3gunits/ms accel=%.3gms/sqrt(unit) "
+        "reverse=%.1fms (%zu moves%s)",
+        c.settleMs, c.msPerUnit > 0.0 ? 1.0 / c.msPerUnit : 0.0,
+        c.msPerSqrtUnit, c.reverseMs, samples, fitted ? "" : ", not fitted");
+    return buf;
+}
+
+
+std::shared_ptr<MotionModel>
+MotionModel::ForAxis(std::string const& axis) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<MotionModel>> models;
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    auto& model = models[axis];
+    if (!model)
+        model = std::make_shared<MotionModel>();
+    return model;
+}
@@ -0,0 +1,98 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+// Predicted move time of one axis, learned from the moves it has made.
+//
+// The time from issuing a move of d device units to the stage reporting
+// idle is modeled as
+//
+//     t = settle + |d| / velocity + k * sqrt(|d|) + (d < 0 ? reverse : 0)
+//
+// The sqrt term covers the acceleration phase (a move too short to reach
+// full velocity takes time proportional to the square root of its length),
+// and the last term the extra time (e.g. backlash takeup) of moving in the
+// negative direction (negative if the positive direction is slower). The
+// coefficients are fitted by least squares over all recorded moves; until
+// enough moves have been seen, a conservative default is used. Terms that
+// the moves cannot tell apart (e.g. all moves the same length) are dropped,
+// down to the mean move time if need be. Once fitted,
+// a move taking far longer than predicted (e.g. one whose arrival was only
+// noticed late) is discarded, unless several in a row do.
+class MotionModel {
+public:
+    struct Coefficients {
+        double settleMs = 100.0;
+        double msPerUnit = 0.0; // 1 / velocity
+        double msPerSqrtUnit = 1.0;
+        double reverseMs = 0.0;
+    };
+
+private:
+    static size_t const NumTerms = 4;
+    static size_t const MinSamples = 8;
+
+    mutable std::mutex mutex_;
+    // Normal equations (X^T X and X^T t), accumulated per sample
+    std::array<std::array<double, NumTerms>, NumTerms> xtx_{};
+    std::array<double, NumTerms> xtt_{};
+    size_t samples_ = 0;
+    size_t consecutiveOutliers_ = 0;
+    bool fitted_ = false; // Whether coefficients_ are no longer the defaults
+    Coefficients coefficients_; // Refitted after each sample
+
+public:
+    // Record a completed move; return false if discarded as an outlier
+    bool AddSample(long distance, double moveTimeMs);
+
+    size_t Samples() const;
+    bool IsFitted() const;
+    Coefficients Get() const;
+
+    static double Predict(Coefficients const& c, long distance);
+
+    // "settle=..ms velocity=..units/ms ..." for display
+    static std::string Format(Coefficients const& c, size_t samples,
+        bool fitted);
+
+    // The model for the named axis (serial number, or serial-channel),
+    // created on first use; shared by all devices in the process
+    static std::shared_ptr<MotionModel> ForAxis(std::string const& axis);
+};
@@ -0,0 +1,71 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Factory functions for the supported motor controller families. Each family
+// is implemented (from the generic code in MotorFamily.h) in its own
+// translation unit, which includes the family's Thorlabs header.
+struct MotorFamilyEntry {
+    std::unique_ptr<KinesisDeviceAccess> (*makeAccess)(std::string const& serialNo);
+    std::unique_ptr<MotorDrive> (*makeDrive)(
+        std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+
+    // Required functions that the loaded DLL lacks
+    std::vector<std::string> (*missingFunctions)();
+
+    // Whether the channels share one status polling pass (see
+    // StatusPollerGroup)
+    bool pollChannelsTogether;
+};
+
+
+MotorFamilyEntry const& BenchtopBrushless200Family();
+MotorFamilyEntry const& BenchtopBrushless300Family();
+MotorFamilyEntry const& BenchtopDCServoFamily();
+MotorFamilyEntry const& BenchtopStepperFamily();
+MotorFamilyEntry const& IntegratedStepperFamily();
+MotorFamilyEntry const& KCubeBrushlessFamily();
+MotorFamilyEntry const& KCubeDCServoFamily();
+MotorFamilyEntry const& KCubeStepperFamily();
+MotorFamilyEntry const& ModularStepperFamily();
+MotorFamilyEntry const& TCubeBrushlessFamily();
+MotorFamilyEntry const& TCubeDCServoFamily();
+MotorFamilyEntry const& TCubeStepperFamily();
+MotorFamilyEntry const& VerticalStageFamily();
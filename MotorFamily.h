@@ -0,0 +1,711 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DLLAccess.h"
+#include "KinesisDevice.h"
+#include "MotorFamilies.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Generic implementation of KinesisDeviceAccess and MotorDrive for a family
+// of Kinesis motor controllers (e.g. K-Cube DC servo, benchtop stepper).
+//
+// The Kinesis motor APIs are nearly identical across families, differing
+// mainly in the function name prefix (CC_, SBC_, BMC_, ...), whether
+// functions take a channel argument, and which optional functions exist. A
+// family is described by a traits struct, defined in the family's own
+// translation unit (because only one Thorlabs header can be included at a
+// time; see DeviceEnumeration.cpp). For example:
+//
+//   struct KCubeDCServoTraits {
+//       static char const* DLLName() {
+//           return "Thorlabs.MotionControl.KCube.DCServo.dll";
+//       }
+//       static constexpr bool isMultiChannel = false;
+//
+//       struct Functions : FunctionTable {
+//           KINESIS_DEVICE_FUNCTIONS(CC);
+//           KINESIS_MOTOR_FUNCTIONS(CC);
+//           KINESIS_ENCODER_FUNCTIONS(CC);
+//           // ...
+//       };
+//   };
+//
+// The Functions table lists exactly the functions that the family's header
+// declares (using decltype, so signatures come from the Thorlabs header).
+// All functions are resolved together when the DLL is first loaded (before
+// the first connection to a device of the family is opened), so that each
+// call is a plain indirect call through the table. If any required function
+// is missing from the DLL, the driver is treated as unavailable. Optional
+// functions that are absent from the table or the DLL are reported as
+// unavailable (error 18) rather than called, and determine the drive's
+// capabilities (see MotorDrive::Capabilities).
+
+
+// Declare a DLLFunc member of a FunctionTable, named after the function
+// without its prefix
+#define KINESIS_FUNCTION(prefix, name) \
+    DLLFunc<decltype(prefix##_##name)> name{ *this, #prefix "_" #name }
+
+// Same, but missing from some versions of the DLL
+#define KINESIS_OPTIONAL_FUNCTION(prefix, name) \
+    DLLFunc<decltype(prefix##_##name)> name{ *this, #prefix "_" #name, \
+        FunctionTable::RequirementOptional }
+
+// Declare a DLLFunc member under a name other than the function's (for
+// functions that are equivalent but named differently between families
+// or device types)
+#define KINESIS_FUNCTION_AS(member, prefix, name) \
+    DLLFunc<decltype(prefix##_##name)> member{ *this, #prefix "_" #name }
+
+// Functions common to all device types
+#define KINESIS_DEVICE_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, Open); \
+    KINESIS_FUNCTION(prefix, Close); \
+    KINESIS_FUNCTION(prefix, RequestSettings); \
+    KINESIS_FUNCTION(prefix, RequestStatusBits); \
+    KINESIS_FUNCTION(prefix, StartPolling); \
+    KINESIS_FUNCTION(prefix, StopPolling); \
+    KINESIS_FUNCTION(prefix, GetHardwareInfo); \
+    KINESIS_FUNCTION(prefix, GetStatusBits)
+
+// Multi-channel controllers (whose functions take a channel argument)
+#define KINESIS_MULTICHANNEL_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, GetNumChannels)
+
+// Functions common to all motor types
+#define KINESIS_MOTOR_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, EnableChannel); \
+    KINESIS_FUNCTION(prefix, DisableChannel); \
+    KINESIS_FUNCTION(prefix, GetMotorTravelMode); \
+    KINESIS_FUNCTION(prefix, SetMotorTravelMode); \
+    KINESIS_FUNCTION(prefix, RequestPosition); \
+    KINESIS_FUNCTION(prefix, GetPosition); \
+    KINESIS_FUNCTION(prefix, GetPositionCounter); \
+    KINESIS_FUNCTION(prefix, MoveToPosition); \
+    KINESIS_FUNCTION(prefix, CanHome); \
+    KINESIS_FUNCTION(prefix, Home); \
+    KINESIS_FUNCTION(prefix, GetRealValueFromDeviceUnit); \
+    KINESIS_FUNCTION(prefix, GetDeviceUnitFromRealValue)
+
+// Encoder (non-stepper motors); required when listed, because it
+// determines the drive's class
+#define KINESIS_ENCODER_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, GetEncoderCounter)
+
+// Optional function groups, each corresponding to a capability
+#define KINESIS_ROTATION_MODE_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, ResetRotationModes); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetRotationModes)
+
+#define KINESIS_HOMING_PARAMS_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetHomingParamsBlock)
+
+#define KINESIS_LIMIT_SWITCH_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetLimitSwitchParams)
+
+#define KINESIS_STAGE_AXIS_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, LoadSettings); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, GetStageAxisParamsBlock)
+
+#define KINESIS_VELOCITY_PARAMS_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, GetVelParams); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetVelParams)
+
+#define KINESIS_MESSAGE_QUEUE_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, ClearMessageQueue); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, MessageQueueSize); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, GetNextMessage)
+
+#define KINESIS_TRIGGER_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, GetTriggerSwitches); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetTriggerSwitches)
+
+
+namespace MotorFamilyDetail {
+    template<typename...> struct MakeVoid { using type = void; };
+    template<typename... Ts> using VoidT = typename MakeVoid<Ts...>::type;
+
+    // Detect whether a Functions table has a given member (HasName), and
+    // whether it has it and it was resolved (IsNameResolved(table))
+#define KINESIS_DEFINE_HAS_FUNCTION(name) \
+    template<typename T, typename = void> \
+    struct Has##name : std::false_type {}; \
+    template<typename T> \
+    struct Has##name<T, VoidT<decltype(&T::name)>> : std::true_type {}; \
+    template<typename T> \
+    bool Is##name##Resolved(T const& table, std::true_type) { \
+        return table.name.IsResolved(); \
+    } \
+    template<typename T> \
+    bool Is##name##Resolved(T const&, std::false_type) { return false; } \
+    template<typename T> \
+    bool Is##name##Resolved(T const& table) { \
+        return Is##name##Resolved(table, Has##name<T>{}); \
+    }
+
+    KINESIS_DEFINE_HAS_FUNCTION(GetNumChannels);
+    KINESIS_DEFINE_HAS_FUNCTION(ResetRotationModes);
+    KINESIS_DEFINE_HAS_FUNCTION(SetRotationModes);
+    KINESIS_DEFINE_HAS_FUNCTION(SetHomingParamsBlock);
+    KINESIS_DEFINE_HAS_FUNCTION(SetLimitSwitchParams);
+    KINESIS_DEFINE_HAS_FUNCTION(LoadSettings);
+    KINESIS_DEFINE_HAS_FUNCTION(GetStageAxisParamsBlock);
+    KINESIS_DEFINE_HAS_FUNCTION(GetVelParams);
+    KINESIS_DEFINE_HAS_FUNCTION(SetVelParams);
+    KINESIS_DEFINE_HAS_FUNCTION(ClearMessageQueue);
+    KINESIS_DEFINE_HAS_FUNCTION(MessageQueueSize);
+    KINESIS_DEFINE_HAS_FUNCTION(GetNextMessage);
+    KINESIS_DEFINE_HAS_FUNCTION(GetTriggerSwitches);
+    KINESIS_DEFINE_HAS_FUNCTION(SetTriggerSwitches);
+    KINESIS_DEFINE_HAS_FUNCTION(GetEncoderCounter);
+
+#undef KINESIS_DEFINE_HAS_FUNCTION
+
+    // Traits::numChannels, for multi-channel families whose DLL cannot
+    // report the number of channels (zero if not given)
+    template<typename Traits, typename = void>
+    struct FixedNumChannels : std::integral_constant<short, 0> {};
+    template<typename Traits>
+    struct FixedNumChannels<Traits, VoidT<decltype(Traits::numChannels)>> :
+        std::integral_constant<short, Traits::numChannels> {};
+
+    // Traits::pollChannelsTogether, for multi-channel families whose
+    // channels' status is best read in one pass (false if not given)
+    template<typename Traits, typename = void>
+    struct PollsChannelsTogether : std::false_type {};
+    template<typename Traits>
+    struct PollsChannelsTogether<Traits,
+        VoidT<decltype(Traits::pollChannelsTogether)>> :
+        std::integral_constant<bool, Traits::pollChannelsTogether> {};
+
+    // Parameter types of a function type
+    template<typename F> struct FunctionParams;
+    template<typename R, typename... Params>
+    struct FunctionParams<R(Params...)> {
+        template<size_t N>
+        using Type = std::tuple_element_t<N, std::tuple<Params...>>;
+    };
+
+    template<typename F> struct FunctionOf;
+    template<typename F>
+    struct FunctionOf<DLLFunc<F>> { using Type = F; };
+
+    // Type of the Nth API parameter (not counting serial number and
+    // channel) of the function held by a DLLFunc member
+    template<typename Func, bool isMultiChannel, size_t N>
+    using ApiParam = typename FunctionParams<
+        typename FunctionOf<std::decay_t<Func>>::Type>::template Type<
+        N + (isMultiChannel ? 2 : 1)>;
+
+    // Call with serial number, and channel if the API is multi-channel
+    template<bool isMultiChannel> struct ChannelCall;
+
+    template<>
+    struct ChannelCall<true> {
+        template<typename Func, typename... Args>
+        static decltype(auto) Invoke(Func const& func, char const* serialNo,
+            short channel, Args&&... args) {
+            return func(serialNo, channel, std::forward<Args>(args)...);
+        }
+    };
+
+    template<>
+    struct ChannelCall<false> {
+        template<typename Func, typename... Args>
+        static decltype(auto) Invoke(Func const& func, char const* serialNo,
+            short, Args&&... args) {
+            return func(serialNo, std::forward<Args>(args)...);
+        }
+    };
+
+    // Some functions report success as a bool rather than an error code
+    inline short ToErrorCode(bool ok) { return ok ? 0 : 1; }
+    inline short ToErrorCode(short err) { return err; }
+
+    short const ErrorFunctionNotAvailable = 18;
+
+    template<typename Functions>
+    unsigned CapabilitiesOfTable(Functions const& table) {
+        unsigned caps = 0;
+        if (IsSetHomingParamsBlockResolved(table))
+            caps |= MotorDrive::CapabilitiesHomingParams;
+        if (IsSetLimitSwitchParamsResolved(table))
+            caps |= MotorDrive::CapabilitiesLimitSwitchParams;
+        if (IsLoadSettingsResolved(table) &&
+            IsGetStageAxisParamsBlockResolved(table))
+            caps |= MotorDrive::CapabilitiesActuatorDetection;
+        if (IsGetTriggerSwitchesResolved(table) &&
+            IsSetTriggerSwitchesResolved(table))
+            caps |= MotorDrive::CapabilitiesTriggers;
+        if (IsGetVelParamsResolved(table) && IsSetVelParamsResolved(table))
+            caps |= MotorDrive::CapabilitiesVelocityParams;
+        if (IsClearMessageQueueResolved(table) &&
+            IsMessageQueueSizeResolved(table) &&
+            IsGetNextMessageResolved(table))
+            caps |= MotorDrive::CapabilitiesMessageQueue;
+        if (IsResetRotationModesResolved(table) &&
+            IsSetRotationModesResolved(table))
+            caps |= MotorDrive::CapabilitiesRotationModes;
+        if (IsGetEncoderCounterResolved(table))
+            caps |= MotorDrive::CapabilitiesEncoder;
+        return caps;
+    }
+} // namespace MotorFamilyDetail
+
+
+// Per-family function table and DLL
+template<typename Traits>
+class MotorFamilyFunctions {
+    using Functions = typename Traits::Functions;
+    static Functions table_;
+    static unsigned capabilities_;
+
+public:
+    static Functions const& Table() { return table_; }
+
+    // Valid after successful Load()
+    static unsigned Capabilities() { return capabilities_; }
+
+    // Load the DLL and resolve the table (once). Returns false if the DLL
+    // cannot be loaded or lacks any required function.
+    static bool Load() {
+        static DLLAccess dll{ Traits::DLLName() };
+        static std::mutex mutex;
+        static bool resolved = false;
+        static bool usable = false;
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (!resolved && dll.IsValid()) {
+            usable = table_.Resolve(dll) == 0;
+            capabilities_ = MotorFamilyDetail::CapabilitiesOfTable(table_);
+            resolved = true;
+        }
+        return usable;
+    }
+
+    // Required functions missing from the DLL (empty if not loaded)
+    static std::vector<std::string> MissingFunctions() {
+        return table_.UnresolvedFunctions(FunctionTable::RequirementRequired);
+    }
+};
+
+template<typename Traits>
+typename Traits::Functions MotorFamilyFunctions<Traits>::table_;
+
+template<typename Traits>
+unsigned MotorFamilyFunctions<Traits>::capabilities_ = 0;
+
+
+template<typename Traits>
+class MotorFamilyAccess final : public KinesisDeviceAccess {
+    using Functions = typename Traits::Functions;
+    using Family = MotorFamilyFunctions<Traits>;
+
+public:
+    explicit MotorFamilyAccess(std::string const& serialNo) :
+        KinesisDeviceAccess{ serialNo }
+    {}
+
+protected:
+    bool IsKinesisDriverAvailable() override { return Family::Load(); }
+
+    short Kinesis_Open() override {
+        return Family::Table().Open(CSerialNo());
+    }
+
+    short Kinesis_Close() override {
+        Family::Table().Close(CSerialNo());
+        return 0;
+    }
+
+    short Kinesis_GetNumChannels() override {
+        return GetNumChannels(MotorFamilyDetail::HasGetNumChannels<Functions>{});
+    }
+
+private:
+    short GetNumChannels(std::true_type) {
+        return Family::Table().GetNumChannels(CSerialNo());
+    }
+
+    short GetNumChannels(std::false_type) {
+        return MotorFamilyDetail::FixedNumChannels<Traits>::value;
+    }
+};
+
+
+// Base for MotorFamilyDrive: calling convention for the family's functions
+template<typename Traits, typename Base>
+class MotorFamilyDriveBase : public Base {
+protected:
+    using Functions = typename Traits::Functions;
+
+    MotorFamilyDriveBase(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        Base{ connection, channel }
+    {}
+
+    static Functions const& Table() {
+        return MotorFamilyFunctions<Traits>::Table();
+    }
+
+    template<typename Func, typename... Args>
+    decltype(auto) Call(Func const& func, Args&&... args) {
+        return MotorFamilyDetail::ChannelCall<Traits::isMultiChannel>::Invoke(
+            func, this->CSerialNo(), this->Channel(), std::forward<Args>(args)...);
+    }
+};
+
+
+// Families with an encoder derive from NonStepperMotorDrive
+template<typename Traits,
+    bool = MotorFamilyDetail::HasGetEncoderCounter<typename Traits::Functions>::value>
+class MotorFamilyEncoderLayer : public MotorFamilyDriveBase<Traits, MotorDrive> {
+protected:
+    MotorFamilyEncoderLayer(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyDriveBase<Traits, MotorDrive>{ connection, channel }
+    {}
+};
+
+template<typename Traits>
+class MotorFamilyEncoderLayer<Traits, true> :
+    public MotorFamilyDriveBase<Traits, NonStepperMotorDrive> {
+protected:
+    MotorFamilyEncoderLayer(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyDriveBase<Traits, NonStepperMotorDrive>{ connection, channel }
+    {}
+
+    long Kinesis_GetEncoderCounter() override {
+        return this->Call(this->Table().GetEncoderCounter);
+    }
+};
+
+
+template<typename Traits>
+class MotorFamilyDrive final : public MotorFamilyEncoderLayer<Traits> {
+    using Functions = typename Traits::Functions;
+    template<typename Func, size_t N>
+    using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+public:
+    MotorFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyEncoderLayer<Traits>{ connection, channel }
+    {}
+
+    unsigned GetCapabilities() const override {
+        return MotorFamilyFunctions<Traits>::Capabilities();
+    }
+
+protected: // General
+    short Kinesis_RequestSettings() override {
+        return this->Call(this->Table().RequestSettings);
+    }
+
+    short Kinesis_RequestStatusBits() override {
+        return this->Call(this->Table().RequestStatusBits);
+    }
+
+    bool Kinesis_StartPolling(int intervalMs) override {
+        return this->Call(this->Table().StartPolling, intervalMs);
+    }
+
+    void Kinesis_StopPolling() override {
+        this->Call(this->Table().StopPolling);
+    }
+
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+        override {
+
+        // Brushless motor APIs use short rather than WORD for numChannels
+        auto const& func = this->Table().GetHardwareInfo;
+        std::remove_pointer_t<ApiParam<decltype(func), 3>> apiNumChannels{};
+        short ret = this->Call(func, modelNo, sizeOfModelNo,
+            type, &apiNumChannels, notes, sizeOfNotes, firmwareVersion,
+            hardwareVersion, modificationState);
+        *numChannels = static_cast<WORD>(apiNumChannels);
+        return ret;
+    }
+
+    DWORD Kinesis_GetStatusBits() override {
+        return this->Call(this->Table().GetStatusBits);
+    }
+
+protected: // Motor
+    short Kinesis_EnableChannel() override {
+        return this->Call(this->Table().EnableChannel);
+    }
+
+    short Kinesis_DisableChannel() override {
+        return this->Call(this->Table().DisableChannel);
+    }
+
+    int Kinesis_GetMotorTravelMode() override {
+        return this->Call(this->Table().GetMotorTravelMode);
+    }
+
+    short Kinesis_SetMotorTravelMode(int mode) override {
+        auto const& func = this->Table().SetMotorTravelMode;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(mode));
+    }
+
+    short Kinesis_ResetRotationModes() override {
+        return ResetRotationModes(
+            MotorFamilyDetail::HasResetRotationModes<Functions>{});
+    }
+
+    short Kinesis_SetRotationModes(int mode, int direction) override {
+        return SetRotationModes(
+            MotorFamilyDetail::HasResetRotationModes<Functions>{},
+            mode, direction);
+    }
+
+    short Kinesis_SetHomingParams(int direction, int limitSwitchMode,
+        int offsetDistance, int velocity) override {
+        return SetHomingParams(
+            MotorFamilyDetail::HasSetHomingParamsBlock<Functions>{},
+            direction, limitSwitchMode, offsetDistance, velocity);
+    }
+
+    short Kinesis_SetLimitSwitchParams(int ccwHardwareLimitMode,
+        int ccwSoftwareLimitPosition, int cwHardwareLimitMode,
+        int cwSoftwareLimitPosition, int softwareLimitMode) override {
+        return SetLimitSwitchParams(
+            MotorFamilyDetail::HasSetLimitSwitchParams<Functions>{},
+            ccwHardwareLimitMode, ccwSoftwareLimitPosition,
+            cwHardwareLimitMode, cwSoftwareLimitPosition, softwareLimitMode);
+    }
+
+    short Kinesis_RequestPosition() override {
+        return this->Call(this->Table().RequestPosition);
+    }
+
+    int Kinesis_GetPosition() override {
+        return this->Call(this->Table().GetPosition);
+    }
+
+    long Kinesis_GetPositionCounter() override {
+        return this->Call(this->Table().GetPositionCounter);
+    }
+
+    short Kinesis_MoveToPosition(int index) override {
+        return this->Call(this->Table().MoveToPosition, index);
+    }
+
+    bool Kinesis_CanHome() override {
+        return this->Call(this->Table().CanHome);
+    }
+
+    short Kinesis_Home() override {
+        return this->Call(this->Table().Home);
+    }
+
+    short Kinesis_LoadSettings() override {
+        return LoadSettings(
+            MotorFamilyDetail::HasGetStageAxisParamsBlock<Functions>{});
+    }
+
+    short Kinesis_GetConnectedActuatorName(std::string* actuatorName) override {
+        return GetConnectedActuatorName(
+            MotorFamilyDetail::HasGetStageAxisParamsBlock<Functions>{},
+            actuatorName);
+    }
+
+    short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) override {
+        return GetVelParams(MotorFamilyDetail::HasGetVelParams<Functions>{},
+            acceleration, maxVelocity);
+    }
+
+    short Kinesis_SetVelParams(int acceleration, int maxVelocity) override {
+        return SetVelParams(MotorFamilyDetail::HasSetVelParams<Functions>{},
+            acceleration, maxVelocity);
+    }
+
+    short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
+        double* realValue, int unitType) override {
+        return this->Call(this->Table().GetRealValueFromDeviceUnit,
+            deviceUnits, realValue, unitType);
+    }
+
+    short Kinesis_GetDeviceUnitFromRealValue(double realValue,
+        int* deviceUnits, int unitType) override {
+        return this->Call(this->Table().GetDeviceUnitFromRealValue,
+            realValue, deviceUnits, unitType);
+    }
+
+private: // Optional functions, dispatched on presence in the table
+    short ResetRotationModes(std::true_type) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesRotationModes))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        return this->Call(this->Table().ResetRotationModes);
+    }
+
+    short ResetRotationModes(std::false_type) {
+        return MotorFamilyDetail::ErrorFunctionNotAvailable;
+    }
+
+    short SetRotationModes(std::true_type, int mode, int direction) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesRotationModes))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        auto const& func = this->Table().SetRotationModes;
+        return this->Call(func,
+            static_cast<ApiParam<decltype(func), 0>>(mode),
+            static_cast<ApiParam<decltype(func), 1>>(direction));
+    }
+
+    short SetRotationModes(std::false_type, int, int) {
+        return MotorFamilyDetail::ErrorFunctionNotAvailable;
+    }
+
+    short SetHomingParams(std::true_type, int direction, int limitSwitchMode,
+        int offsetDistance, int velocity) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesHomingParams))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        auto const& func = this->Table().SetHomingParamsBlock;
+        std::remove_pointer_t<ApiParam<decltype(func), 0>> params{};
+        params.direction = static_cast<decltype(params.direction)>(direction);
+        params.limitSwitch = static_cast<decltype(params.limitSwitch)>(limitSwitchMode);
+        params.offsetDistance = offsetDistance;
+        params.velocity = velocity;
+        return this->Call(func, &params);
+    }
+
+    short SetHomingParams(std::false_type, int, int, int, int) {
+        return MotorFamilyDetail::ErrorFunctionNotAvailable;
+    }
+
+    short SetLimitSwitchParams(std::true_type, int ccwHardwareLimitMode,
+        int ccwSoftwareLimitPosition, int cwHardwareLimitMode,
+        int cwSoftwareLimitPosition, int softwareLimitMode) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesLimitSwitchParams))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        // Note the API's argument order: clockwise first
+        auto const& func = this->Table().SetLimitSwitchParams;
+        return this->Call(func,
+            static_cast<ApiParam<decltype(func), 0>>(cwHardwareLimitMode),
+            static_cast<ApiParam<decltype(func), 1>>(ccwHardwareLimitMode),
+            static_cast<ApiParam<decltype(func), 2>>(cwSoftwareLimitPosition),
+            static_cast<ApiParam<decltype(func), 3>>(ccwSoftwareLimitPosition),
+            static_cast<ApiParam<decltype(func), 4>>(softwareLimitMode));
+    }
+
+    short SetLimitSwitchParams(std::false_type, int, int, int, int, int) {
+        return MotorFamilyDetail::ErrorFunctionNotAvailable;
+    }
+
+    short LoadSettings(std::true_type) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesActuatorDetection))
+            return MotorDrive::Kinesis_LoadSettings();
+        return MotorFamilyDetail::ToErrorCode(
+            this->Call(this->Table().LoadSettings));
+    }
+
+    short LoadSettings(std::false_type) {
+        return MotorDrive::Kinesis_LoadSettings();
+    }
+
+    short GetConnectedActuatorName(std::true_type, std::string* actuatorName) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesActuatorDetection))
+            return MotorDrive::Kinesis_GetConnectedActuatorName(actuatorName);
+        auto const& func = this->Table().GetStageAxisParamsBlock;
+        std::remove_pointer_t<ApiParam<decltype(func), 0>> paramsBlock{};
+        short ret = this->Call(func, &paramsBlock);
+        actuatorName->append(paramsBlock.partNumber);
+        return ret;
+    }
+
+    short GetConnectedActuatorName(std::false_type, std::string* actuatorName) {
+        return MotorDrive::Kinesis_GetConnectedActuatorName(actuatorName);
+    }
+
+    short GetVelParams(std::true_type, int* acceleration, int* maxVelocity) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesVelocityParams))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        auto const& func = this->Table().GetVelParams;
+        std::remove_pointer_t<ApiParam<decltype(func), 0>> apiAcceleration{};
+        std::remove_pointer_t<ApiParam<decltype(func), 1>> apiMaxVelocity{};
+        short ret = this->Call(func, &apiAcceleration, &apiMaxVelocity);
+        *acceleration = static_cast<int>(apiAcceleration);
+        *maxVelocity = static_cast<int>(apiMaxVelocity);
+        return ret;
+    }
+
+    short GetVelParams(std::false_type, int*, int*) {
+        return MotorFamilyDetail::ErrorFunctionNotAvailable;
+    }
+
+    short SetVelParams(std::true_type, int acceleration, int maxVelocity) {
+        if (!this->HasCapability(MotorDrive::CapabilitiesVelocityParams))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        auto const& func = this->Table().SetVelParams;
+        return this->Call(func,
+            static_cast<ApiParam<decltype(func), 0>>(acceleration),
+            static_cast<ApiParam<decltype(func), 1>>(maxVelocity));
+    }
+
+    short SetVelParams(std::false_type, int, int) {
+        return MotorFamilyDetail::ErrorFunctionNotAvailable;
+    }
+};
+
+
+// Factory functions for a family
+template<typename Traits>
+struct MotorFamily {
+    static std::unique_ptr<KinesisDeviceAccess> MakeAccess(std::string const& serialNo) {
+        return std::make_unique<MotorFamilyAccess<Traits>>(serialNo);
+    }
+
+    static std::unique_ptr<MotorDrive> MakeDrive(
+        std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+        if (!Traits::isMultiChannel)
+            channel = -1;
+        return std::make_unique<MotorFamilyDrive<Traits>>(connection, channel);
+    }
+
+    static MotorFamilyEntry const& Entry() {
+        static MotorFamilyEntry const entry{ &MakeAccess, &MakeDrive,
+            &MotorFamilyFunctions<Traits>::MissingFunctions,
+            MotorFamilyDetail::PollsChannelsTogether<Traits>::value };
+        return entry;
+    }
+};
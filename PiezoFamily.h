@@ -0,0 +1,252 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceFamily.h"
+#include "PiezoFamilies.h"
+
+#include <memory>
+#include <string>
+#include <type_traits>
+
+
+// Generic implementation of PiezoDrive for a family of Kinesis piezo
+// controllers, in the same way as MotorFamily.h does for motors (whose
+// function table loading and KinesisDeviceAccess it reuses). A family's
+// traits additionally give the size of its output lookup table:
+//
+//   struct KCubePiezoTraits {
+//       static char const* DLLName() {
+//           return "Thorlabs.MotionControl.KCube.Piezo.dll";
+//       }
+//       static constexpr bool isMultiChannel = false;
+//       static constexpr short maxLUTSamples = 512;
+//
+//       struct Functions : FunctionTable {
+//           KINESIS_DEVICE_FUNCTIONS(PCC);
+//           KINESIS_PIEZO_FUNCTIONS(PCC);
+//           KINESIS_PIEZO_ENABLE_FUNCTIONS(PCC);
+//           KINESIS_PIEZO_LUT_FUNCTIONS(PCC);
+//       };
+//   };
+
+
+// Functions common to all piezo controllers
+#define KINESIS_PIEZO_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, GetPositionControlMode); \
+    KINESIS_FUNCTION(prefix, SetPositionControlMode); \
+    KINESIS_FUNCTION(prefix, GetMaxOutputVoltage); \
+    KINESIS_FUNCTION(prefix, SetMaxOutputVoltage); \
+    KINESIS_FUNCTION(prefix, GetOutputVoltage); \
+    KINESIS_FUNCTION(prefix, SetOutputVoltage); \
+    KINESIS_FUNCTION(prefix, GetPosition); \
+    KINESIS_FUNCTION(prefix, SetPosition); \
+    KINESIS_FUNCTION(prefix, GetMaximumTravel); \
+    KINESIS_FUNCTION(prefix, SetZero)
+
+// Single-channel controllers: Enable/Disable
+#define KINESIS_PIEZO_ENABLE_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, Enable); \
+    KINESIS_FUNCTION(prefix, Disable)
+
+// Multi-channel controllers: EnableChannel/DisableChannel
+#define KINESIS_PIEZO_CHANNEL_ENABLE_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION_AS(Enable, prefix, EnableChannel); \
+    KINESIS_FUNCTION_AS(Disable, prefix, DisableChannel)
+
+// Output lookup table (CapabilitiesLUT)
+#define KINESIS_PIEZO_LUT_FUNCTIONS(prefix) \
+    KINESIS_OPTIONAL_FUNCTION(prefix, GetLUTwaveParams); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetLUTwaveParams); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, SetLUTwaveSample); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, StartLUTwave); \
+    KINESIS_OPTIONAL_FUNCTION(prefix, StopLUTwave)
+
+
+template<typename Traits>
+class PiezoFamilyDrive final : public MotorFamilyDriveBase<Traits, PiezoDrive> {
+    template<typename Func, size_t N>
+    using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+public:
+    PiezoFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyDriveBase<Traits, PiezoDrive>{ connection, channel }
+    {}
+
+    unsigned GetCapabilities() const override {
+        auto const& table = this->Table();
+        if (table.SetLUTwaveParams.IsResolved() &&
+            table.SetLUTwaveSample.IsResolved() &&
+            table.StartLUTwave.IsResolved() && table.StopLUTwave.IsResolved())
+            return PiezoDrive::CapabilitiesLUT;
+        return 0;
+    }
+
+    short MaxLUTSamples() const override {
+        return this->HasCapability(PiezoDrive::CapabilitiesLUT) ?
+            Traits::maxLUTSamples : short(0);
+    }
+
+protected: // General
+    short Kinesis_RequestSettings() override {
+        return this->Call(this->Table().RequestSettings);
+    }
+
+    short Kinesis_RequestStatusBits() override {
+        return this->Call(this->Table().RequestStatusBits);
+    }
+
+    bool Kinesis_StartPolling(int intervalMs) override {
+        return this->Call(this->Table().StartPolling, intervalMs);
+    }
+
+    void Kinesis_StopPolling() override {
+        this->Call(this->Table().StopPolling);
+    }
+
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+        override {
+        return this->Call(this->Table().GetHardwareInfo, modelNo,
+            sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+            firmwareVersion, hardwareVersion, modificationState);
+    }
+
+    DWORD Kinesis_GetStatusBits() override {
+        return this->Call(this->Table().GetStatusBits);
+    }
+
+protected: // Piezo
+    short Kinesis_Enable() override {
+        return this->Call(this->Table().Enable);
+    }
+
+    short Kinesis_Disable() override {
+        return this->Call(this->Table().Disable);
+    }
+
+    int Kinesis_GetPositionControlMode() override {
+        return static_cast<int>(this->Call(this->Table().GetPositionControlMode));
+    }
+
+    short Kinesis_SetPositionControlMode(int mode) override {
+        auto const& func = this->Table().SetPositionControlMode;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(mode));
+    }
+
+    short Kinesis_GetMaxOutputVoltage() override {
+        return this->Call(this->Table().GetMaxOutputVoltage);
+    }
+
+    short Kinesis_SetMaxOutputVoltage(short maxVoltage) override {
+        auto const& func = this->Table().SetMaxOutputVoltage;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(maxVoltage));
+    }
+
+    short Kinesis_GetOutputVoltage() override {
+        return this->Call(this->Table().GetOutputVoltage);
+    }
+
+    short Kinesis_SetOutputVoltage(short voltage) override {
+        auto const& func = this->Table().SetOutputVoltage;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(voltage));
+    }
+
+    int Kinesis_GetPosition() override {
+        return static_cast<int>(this->Call(this->Table().GetPosition));
+    }
+
+    short Kinesis_SetPosition(int position) override {
+        auto const& func = this->Table().SetPosition;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(position));
+    }
+
+    int Kinesis_GetMaximumTravel() override {
+        return static_cast<int>(this->Call(this->Table().GetMaximumTravel));
+    }
+
+    short Kinesis_SetZero() override {
+        return this->Call(this->Table().SetZero);
+    }
+
+    short Kinesis_SetLUTSample(short index, int value) override {
+        if (!this->HasCapability(PiezoDrive::CapabilitiesLUT))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        auto const& func = this->Table().SetLUTwaveSample;
+        return this->Call(func, index,
+            static_cast<ApiParam<decltype(func), 1>>(value));
+    }
+
+    short Kinesis_SetLUTParams(PiezoDrive::LUTParams const& params) override {
+        if (!this->HasCapability(PiezoDrive::CapabilitiesLUT))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        auto const& func = this->Table().SetLUTwaveParams;
+        std::remove_pointer_t<ApiParam<decltype(func), 0>> apiParams{};
+        // Start from the current parameters, so that those not given here
+        // (the output trigger, as configured in the Kinesis application) are
+        // kept
+        auto const& getFunc = this->Table().GetLUTwaveParams;
+        if (getFunc.IsResolved()) {
+            short err = this->Call(getFunc, &apiParams);
+            if (err)
+                return err;
+        }
+        // Mode: 1 = continuous, 2 = fixed number of cycles
+        apiParams.mode = static_cast<decltype(apiParams.mode)>(
+            params.continuous ? 1 : 2);
+        apiParams.cycleLength = params.cycleLength;
+        apiParams.numCycles = params.numCycles;
+        apiParams.LUTValueDelay = params.sampleIntervalMs;
+        apiParams.preCycleDelay = params.preCycleDelayMs;
+        apiParams.postCycleDelay = params.postCycleDelayMs;
+        return this->Call(func, &apiParams);
+    }
+
+    short Kinesis_StartLUT() override {
+        if (!this->HasCapability(PiezoDrive::CapabilitiesLUT))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        return this->Call(this->Table().StartLUTwave);
+    }
+
+    short Kinesis_StopLUT() override {
+        if (!this->HasCapability(PiezoDrive::CapabilitiesLUT))
+            return MotorFamilyDetail::ErrorFunctionNotAvailable;
+        return this->Call(this->Table().StopLUTwave);
+    }
+};
+
+
+// Factory functions for a family
+template<typename Traits>
+using PiezoFamily = DeviceFamily<Traits, PiezoDrive, PiezoFamilyDrive>;
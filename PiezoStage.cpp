@@ -0,0 +1,454 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "PiezoStage.h"
+
+#include "DeviceEnumeration.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    char const* const PROP_TravelRangeUm = "TravelRangeUm";
+    char const* const PROP_Capabilities = "Capabilities";
+    char const* const PROP_ControlMode = "ControlMode";
+    char const* const PROPVAL_ControlModeOpenLoop = "OpenLoop";
+    char const* const PROPVAL_ControlModeClosedLoop = "ClosedLoop";
+    char const* const PROPVAL_ControlModeOpenLoopSmooth = "OpenLoopSmooth";
+    char const* const PROPVAL_ControlModeClosedLoopSmooth = "ClosedLoopSmooth";
+    char const* const PROP_MaxOutputVoltage = "MaxOutputVoltage";
+    char const* const PROP_OutputVoltage = "OutputVoltage";
+    char const* const PROP_Zero = "Zero";
+    char const* const PROPVAL_ZeroIdle = "Idle";
+    char const* const PROPVAL_ZeroStart = "Zero";
+    char const* const PROP_SettleTimeMs = "SettleTimeMs";
+    char const* const PROP_SequenceIntervalMs = "SequenceSampleIntervalMs";
+
+    int const ERR_TRAVEL_UNKNOWN = 99998;
+
+    struct ControlModeName {
+        PiezoDrive::ControlMode mode;
+        char const* name;
+    };
+    ControlModeName const controlModeNames[] = {
+        { PiezoDrive::ControlModeOpenLoop, PROPVAL_ControlModeOpenLoop },
+        { PiezoDrive::ControlModeClosedLoop, PROPVAL_ControlModeClosedLoop },
+        { PiezoDrive::ControlModeOpenLoopSmooth, PROPVAL_ControlModeOpenLoopSmooth },
+        { PiezoDrive::ControlModeClosedLoopSmooth, PROPVAL_ControlModeClosedLoopSmooth },
+    };
+}
+
+
+PiezoStage::PiezoStage(std::string const& name,
+    std::string const& serialNo, short channel,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, channel, connection,
+        "Piezo controllers" }
+{
+    SetErrorText(ERR_TRAVEL_UNKNOWN,
+        "The piezo controller does not report the actuator's travel; "
+        "please set TravelRangeUm");
+
+    // Zero to use the travel reported by the controller (which requires a
+    // strain gauge on some actuators)
+    CreateFloatProperty(PROP_TravelRangeUm, 0.0, false, nullptr, true);
+    SetPropertyLimits(PROP_TravelRangeUm, 0.0, 10000.0);
+}
+
+
+PiezoStage::~PiezoStage() = default;
+
+
+int
+PiezoStage::Initialize() {
+    int ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    std::string const capabilities =
+        PiezoDrive::FormatCapabilities(drive_->GetCapabilities());
+    LogMessage(("Kinesis driver capabilities for serial no " + serialNo_ +
+        ": " + capabilities).c_str());
+    CreateStringProperty(PROP_Capabilities, capabilities.c_str(), true);
+
+    short err = drive_->RequestSettings();
+    if (err)
+        return ERR_OFFSET + err;
+    err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    // Start polling, which keeps the position, voltage, and status bits up
+    // to date
+    if (!drive_->StartPolling(pollingIntervalMs_)) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+
+    if (!(drive_->GetStatusBits() & PiezoDrive::StatusBitsChannelEnabled)) {
+        err = drive_->SetEnabled(true);
+        if (err)
+            return ERR_OFFSET + err;
+        didEnable_ = true;
+    }
+
+    GetProperty(PROP_TravelRangeUm, travelUm_);
+    if (travelUm_ <= 0.0)
+        travelUm_ = 0.1 * drive_->GetMaximumTravel();
+    if (travelUm_ <= 0.0)
+        return ERR_TRAVEL_UNKNOWN;
+
+    closedLoop_ = PiezoDrive::IsClosedLoop(drive_->GetControlMode());
+
+    CreateStringProperty(PROP_ControlMode, PROPVAL_ControlModeOpenLoop, false,
+        new CPropertyAction(this, &PiezoStage::OnControlMode));
+    for (auto const& item : controlModeNames)
+        AddAllowedValue(PROP_ControlMode, item.name);
+
+    CreateIntegerProperty(PROP_MaxOutputVoltage, 75, false,
+        new CPropertyAction(this, &PiezoStage::OnMaxOutputVoltage));
+    AddAllowedValue(PROP_MaxOutputVoltage, "75");
+    AddAllowedValue(PROP_MaxOutputVoltage, "100");
+    AddAllowedValue(PROP_MaxOutputVoltage, "150");
+
+    CreateFloatProperty(PROP_OutputVoltage, 0.0, true,
+        new CPropertyAction(this, &PiezoStage::OnOutputVoltage));
+
+    // Closed-loop operation requires the strain gauge to have been zeroed
+    // (with the actuator at rest); this takes about 30 s
+    CreateStringProperty(PROP_Zero, PROPVAL_ZeroIdle, false,
+        new CPropertyAction(this, &PiezoStage::OnZero));
+    AddAllowedValue(PROP_Zero, PROPVAL_ZeroIdle);
+    AddAllowedValue(PROP_Zero, PROPVAL_ZeroStart);
+
+    // Busy() reports true for this long after each move
+    CreateFloatProperty(PROP_SettleTimeMs, settleTimeMs_, false,
+        new CPropertyAction(this, &PiezoStage::OnSettleTimeMs));
+    SetPropertyLimits(PROP_SettleTimeMs, 0.0, 1000.0);
+
+    if (drive_->HasCapability(PiezoDrive::CapabilitiesLUT)) {
+        CreateIntegerProperty(PROP_SequenceIntervalMs, sequenceIntervalMs_, false,
+            new CPropertyAction(this, &PiezoStage::OnSequenceIntervalMs));
+        SetPropertyLimits(PROP_SequenceIntervalMs, 1, 10000);
+    }
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::Shutdown() {
+    if (drive_ && didEnable_)
+        drive_->SetEnabled(false);
+    CloseDrive();
+    return DEVICE_OK;
+}
+
+
+bool
+PiezoStage::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection() != DEVICE_OK)
+        return false; // The restore is retried by the next command
+    if (drive_->GetStatusBits() & PiezoDrive::StatusBitsZeroing)
+        return true;
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    return msSinceMovementStart < settleTimeMs_;
+}
+
+
+int
+PiezoStage::GetPositionUm(double& pos) {
+    long steps;
+    int err = GetPositionSteps(steps);
+    if (err != DEVICE_OK)
+        return err;
+    pos = ToUm(int(steps));
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::SetPositionUm(double pos) {
+    return SetPositionSteps(ToDeviceUnits(pos));
+}
+
+
+int
+PiezoStage::GetPositionSteps(long& steps) {
+    steps = closedLoop_ ? drive_->GetPosition() :
+        drive_->GetOutputVoltage();
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::SetPositionSteps(long steps) {
+    int const value = int(std::max(0L, std::min(steps, long(PiezoDrive::MaxValue))));
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = closedLoop_ ? drive_->SetPosition(value) :
+        drive_->SetOutputVoltage(short(value));
+    if (err)
+        return ERR_OFFSET + err;
+    lastMovementStart_ = GetCurrentMMTime();
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::GetLimits(double& lower, double& upper) {
+    lower = 0.0;
+    upper = travelUm_;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::IsStageSequenceable(bool& f) const {
+    f = drive_ && drive_->HasCapability(PiezoDrive::CapabilitiesLUT);
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::GetStageSequenceMaxLength(long& nrEvents) const {
+    nrEvents = drive_ ? drive_->MaxLUTSamples() : 0;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::StartStageSequence() {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->StartLUT();
+    if (err)
+        return ERR_OFFSET + err;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::StopStageSequence() {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->StopLUT();
+    if (err)
+        return ERR_OFFSET + err;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::ClearStageSequence() {
+    sequence_.clear();
+    sequenceLoaded_ = false;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::AddToStageSequence(double position) {
+    sequence_.push_back(ToDeviceUnits(position));
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::SendStageSequence() {
+    if (sequence_.empty())
+        return DEVICE_INVALID_INPUT_PARAM;
+    if (long(sequence_.size()) > drive_->MaxLUTSamples())
+        return DEVICE_SEQUENCE_TOO_LARGE;
+
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    sequenceLoaded_ = false;
+    short err = LoadSequence();
+    if (err)
+        return ERR_OFFSET + err;
+    sequenceLoaded_ = true;
+    return DEVICE_OK;
+}
+
+
+// Write sequence_ to the controller's lookup table
+short
+PiezoStage::LoadSequence() {
+    for (size_t i = 0; i < sequence_.size(); ++i) {
+        short err = drive_->SetLUTSample(short(i), sequence_[i]);
+        if (err)
+            return err;
+    }
+
+    PiezoDrive::LUTParams params;
+    params.continuous = true;
+    params.cycleLength = short(sequence_.size());
+    params.sampleIntervalMs = unsigned(sequenceIntervalMs_);
+    return drive_->SetLUTParams(params);
+}
+
+
+int
+PiezoStage::OnControlMode(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        PiezoDrive::ControlMode const mode = drive_->GetControlMode();
+        for (auto const& item : controlModeNames) {
+            if (item.mode == mode)
+                pProp->Set(item.name);
+        }
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        for (auto const& item : controlModeNames) {
+            if (value != item.name)
+                continue;
+            int ret = CheckConnection();
+            if (ret != DEVICE_OK)
+                return ret;
+            short err = drive_->SetControlMode(item.mode);
+            if (err)
+                return ERR_OFFSET + err;
+            // Positions are now in the other mode's units
+            closedLoop_ = PiezoDrive::IsClosedLoop(item.mode);
+            sequence_.clear();
+            sequenceLoaded_ = false;
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnMaxOutputVoltage(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(long(std::lround(0.1 * drive_->GetMaxOutputVoltage())));
+    }
+    else if (eAct == MM::AfterSet) {
+        long volts;
+        pProp->Get(volts);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        short err = drive_->SetMaxOutputVoltage(short(volts * 10));
+        if (err)
+            return ERR_OFFSET + err;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnOutputVoltage(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        double const maxVolts = 0.1 * drive_->GetMaxOutputVoltage();
+        pProp->Set(maxVolts * drive_->GetOutputVoltage() / PiezoDrive::MaxValue);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnZero(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(PROPVAL_ZeroIdle);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        if (value == PROPVAL_ZeroStart) {
+            int ret = CheckConnection();
+            if (ret != DEVICE_OK)
+                return ret;
+            short err = drive_->SetZero();
+            if (err)
+                return ERR_OFFSET + err;
+            lastMovementStart_ = GetCurrentMMTime();
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnSettleTimeMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(settleTimeMs_);
+    else if (eAct == MM::AfterSet)
+        pProp->Get(settleTimeMs_);
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnSequenceIntervalMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(sequenceIntervalMs_);
+    else if (eAct == MM::AfterSet)
+        pProp->Get(sequenceIntervalMs_);
+    return DEVICE_OK;
+}
+
+
+short
+PiezoStage::RestoreDeviceState() {
+    short err = drive_->RestoreState();
+    if (!err && sequenceLoaded_)
+        err = LoadSequence();
+    return err;
+}
+
+
+int
+PiezoStage::ToDeviceUnits(double um) const {
+    double const value = std::round(um / travelUm_ * PiezoDrive::MaxValue);
+    return int(std::max(0.0, std::min(value, double(PiezoDrive::MaxValue))));
+}
+
+
+double
+PiezoStage::ToUm(int deviceUnits) const {
+    return deviceUnits * travelUm_ / PiezoDrive::MaxValue;
+}
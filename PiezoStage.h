@@ -0,0 +1,105 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Focus stage driven by a piezo controller (KPZ101, TPZ001, BPC30x).
+//
+// Positions map linearly onto the travel range: in closed-loop mode they are
+// set as positions; in open-loop mode as output voltages, assuming the full
+// travel at the maximum voltage. The stage is sequenceable if the controller
+// has an output lookup table: the sequence is loaded into the table and
+// output at a fixed sample interval (the piezo, not the camera, sets the
+// timing; use the controller's trigger output to trigger the camera).
+class PiezoStage final :
+    public KinesisDriveDevice<CStageBase, PiezoStage, PiezoDrive> {
+    // Set during Initialize():
+    double travelUm_{ 0.0 };
+    bool closedLoop_{ false };
+    int pollingIntervalMs_{ 50 };
+    bool didEnable_{ false };
+
+    // Dynamic state:
+    MM::MMTime lastMovementStart_{ 0.0 };
+    double settleTimeMs_{ 1.0 };
+    long sequenceIntervalMs_{ 10 };
+    std::vector<int> sequence_; // In device units
+    bool sequenceLoaded_{ false }; // Re-loaded after reconnecting
+
+public:
+    PiezoStage(std::string const& name, std::string const& serialNo,
+        short channel, std::shared_ptr<KinesisDeviceConnection> connection);
+    ~PiezoStage() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    int GetPositionUm(double& pos) override;
+    int SetPositionUm(double pos) override;
+    int GetPositionSteps(long& steps) override;
+    int SetPositionSteps(long steps) override;
+    int SetOrigin() override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int GetLimits(double& lower, double& upper) override;
+
+    bool IsContinuousFocusDrive() const override { return false; }
+    int IsStageSequenceable(bool& f) const override;
+    int GetStageSequenceMaxLength(long& nrEvents) const override;
+    int StartStageSequence() override;
+    int StopStageSequence() override;
+    int ClearStageSequence() override;
+    int AddToStageSequence(double position) override;
+    int SendStageSequence() override;
+
+    int OnControlMode(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnMaxOutputVoltage(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnOutputVoltage(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnZero(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSettleTimeMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSequenceIntervalMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    short RestoreDeviceState() override;
+    short LoadSequence();
+    int ToDeviceUnits(double um) const;
+    double ToUm(int deviceUnits) const;
+};
@@ -0,0 +1,330 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "PolarizationController.h"
+
+#include <cmath>
+#include <sstream>
+
+
+namespace {
+    char const* const PROP_VelocityPercent = "VelocityPercent";
+
+    int const ERR_INVALID_PRESET = 99998;
+    int const ERR_PRESET_OUT_OF_RANGE = 99997;
+
+    int const MaxPresets = 8;
+
+    // A paddle is at its target when the polled position is this close
+    double const PositionToleranceDeg = 0.5;
+
+    // If a paddle has not reached its target by this long after the move
+    // started, stop reporting busy
+    double const CompletionTimeoutMs = 10000.0;
+
+    std::string PresetAnglesProperty(int preset) {
+        return "Preset" + std::to_string(preset) + "Angles";
+    }
+
+    std::string PaddleAngleProperty(int paddle) {
+        return "Paddle" + std::to_string(paddle) + "AngleDeg";
+    }
+}
+
+
+PolarizationController::PolarizationController(std::string const& name,
+    std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, -1, connection,
+        "Polarization controllers" }
+{
+    SetErrorText(ERR_INVALID_PRESET,
+        "Each preset must be three comma-separated paddle angles in degrees, "
+        "and presets must be numbered consecutively from 1");
+    SetErrorText(ERR_PRESET_OUT_OF_RANGE,
+        "Preset paddle angles must be between 0 and the controller's maximum "
+        "travel");
+
+    // Presets are positions 0, 1, ... in order; leave unused ones empty
+    for (int i = 1; i <= MaxPresets; ++i) {
+        CreateStringProperty(PresetAnglesProperty(i).c_str(),
+            i == 1 ? "0,0,0" : "", false, nullptr, true);
+    }
+}
+
+
+PolarizationController::~PolarizationController() = default;
+
+
+int
+PolarizationController::Initialize() {
+    int ret = ParsePresets();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    short err = drive_->RequestSettings();
+    if (err)
+        return ERR_OFFSET + err;
+    err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    // Start polling, which keeps the paddle positions up to date
+    if (!drive_->StartPolling(pollingIntervalMs_)) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+
+    double const maxTravelDeg = drive_->GetMaxTravel();
+    ret = CheckPresetRange(maxTravelDeg);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    CreateIntegerProperty(MM::g_Keyword_State, 0, false,
+        new CPropertyAction(this, &PolarizationController::OnState));
+    for (size_t i = 0; i < presets_.size(); ++i)
+        AddAllowedValue(MM::g_Keyword_State, std::to_string(i).c_str());
+
+    CreateStringProperty(MM::g_Keyword_Label, "", false,
+        new CPropertyAction(this, &CStateBase::OnLabel));
+    for (size_t i = 0; i < presets_.size(); ++i)
+        SetPositionLabel(long(i), ("Preset-" + std::to_string(i + 1)).c_str());
+
+    for (int paddle = 1; paddle <= NumPaddles; ++paddle) {
+        auto const prop = PaddleAngleProperty(paddle);
+        CreateFloatProperty(prop.c_str(), 0.0, false,
+            new CPropertyActionEx(this, &PolarizationController::OnPaddleAngle,
+                paddle));
+        if (maxTravelDeg > 0.0)
+            SetPropertyLimits(prop.c_str(), 0.0, maxTravelDeg);
+    }
+
+    if (drive_->HasCapability(PolarizerDrive::CapabilitiesVelocity)) {
+        CreateIntegerProperty(PROP_VelocityPercent, 100, false,
+            new CPropertyAction(this, &PolarizationController::OnVelocityPercent));
+        SetPropertyLimits(PROP_VelocityPercent, 10, 100);
+    }
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+PolarizationController::Shutdown() {
+    CloseDrive();
+    return DEVICE_OK;
+}
+
+
+bool
+PolarizationController::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection() != DEVICE_OK)
+        return false; // The restore is retried by the next command
+
+    // Busy while any paddle is; check them all so that finished moves are
+    // cleared
+    bool busy = false;
+    for (int paddle = 1; paddle <= NumPaddles; ++paddle) {
+        auto& move = moves_[paddle - 1];
+        if (!move.pending)
+            continue;
+        if (PaddleMoveFinished(paddle)) {
+            move.pending = false;
+            continue;
+        }
+        if ((GetCurrentMMTime() - move.start).getMsec() > CompletionTimeoutMs) {
+            LogMessage(("Paddle " + std::to_string(paddle) + " of serial no " +
+                serialNo_ + " did not reach its target; no longer waiting").c_str());
+            move.pending = false;
+            continue;
+        }
+        busy = true;
+    }
+    return busy;
+}
+
+
+int
+PolarizationController::OnState(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(lastPreset_);
+    }
+    else if (eAct == MM::AfterSet) {
+        long state;
+        pProp->Get(state);
+        if (state < 0 || size_t(state) >= presets_.size())
+            return DEVICE_UNKNOWN_POSITION;
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+
+        // Start all paddles before waiting for any of them
+        auto const& angles = presets_[size_t(state)];
+        for (int paddle = 1; paddle <= NumPaddles; ++paddle) {
+            ret = StartPaddleMove(paddle, angles[paddle - 1]);
+            if (ret != DEVICE_OK)
+                return ret;
+        }
+        lastPreset_ = state;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PolarizationController::OnPaddleAngle(MM::PropertyBase* pProp,
+    MM::ActionType eAct, long paddle) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(drive_->GetPosition(int(paddle)));
+    }
+    else if (eAct == MM::AfterSet) {
+        double degrees;
+        pProp->Get(degrees);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        return StartPaddleMove(int(paddle), degrees);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PolarizationController::OnVelocityPercent(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        int percent;
+        short err = drive_->GetVelocityPercent(percent);
+        if (err)
+            return ERR_OFFSET + err;
+        pProp->Set(long(percent));
+    }
+    else if (eAct == MM::AfterSet) {
+        long percent;
+        pProp->Get(percent);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        short err = drive_->SetVelocityPercent(int(percent));
+        if (err)
+            return ERR_OFFSET + err;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PolarizationController::ParsePresets() {
+    presets_.clear();
+    bool ended = false;
+    for (int i = 1; i <= MaxPresets; ++i) {
+        char value[MM::MaxStrLength];
+        GetProperty(PresetAnglesProperty(i).c_str(), value);
+        std::string const text = value;
+        if (text.find_first_not_of(" \t") == std::string::npos) {
+            ended = true;
+            continue;
+        }
+        if (ended)
+            return ERR_INVALID_PRESET;
+
+        PaddleAngles angles;
+        std::istringstream stream(text);
+        for (int paddle = 0; paddle < NumPaddles; ++paddle) {
+            char comma = ',';
+            if (paddle > 0)
+                stream >> comma;
+            stream >> angles[paddle];
+            if (!stream || comma != ',')
+                return ERR_INVALID_PRESET;
+        }
+        stream >> std::ws;
+        if (!stream.eof())
+            return ERR_INVALID_PRESET;
+        presets_.push_back(angles);
+    }
+    if (presets_.empty())
+        return ERR_INVALID_PRESET;
+    return DEVICE_OK;
+}
+
+
+// The presets are parsed before the controller is opened, so their range is
+// checked once its travel is known (zero if not reported)
+int
+PolarizationController::CheckPresetRange(double maxTravelDeg) {
+    for (size_t i = 0; i < presets_.size(); ++i) {
+        for (double const angle : presets_[i]) {
+            if (angle >= 0.0 && (maxTravelDeg <= 0.0 || angle <= maxTravelDeg))
+                continue;
+            LogMessage(("Preset " + std::to_string(i + 1) + " of serial no " +
+                serialNo_ + " has angle " + std::to_string(angle) +
+                " outside 0 to " + std::to_string(maxTravelDeg)).c_str());
+            return ERR_PRESET_OUT_OF_RANGE;
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PolarizationController::StartPaddleMove(int paddle, double degrees) {
+    short err = drive_->MoveToPosition(paddle, degrees);
+    if (err)
+        return ERR_OFFSET + err;
+    moves_[paddle - 1] = { true, degrees, GetCurrentMMTime() };
+    return DEVICE_OK;
+}
+
+
+bool
+PolarizationController::PaddleMoveFinished(int paddle) {
+    auto const& move = moves_[paddle - 1];
+
+    // The position lags the move by up to a polling interval
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - move.start).getMsec();
+    if (msSinceMovementStart < 2 * pollingIntervalMs_)
+        return false;
+    return std::abs(drive_->GetPosition(paddle) - move.target) <=
+        PositionToleranceDeg;
+}
@@ -0,0 +1,94 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+
+#include "DeviceBase.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Polarization controller (MPC320) as a state device whose positions are
+// presets of the three paddle angles.
+//
+// Selecting a preset starts all three paddles at once, so switching takes as
+// long as the largest single paddle move; Busy() is true while any paddle is
+// moving. The presets are set before initialization (Preset<N>Angles, as
+// three comma-separated angles in degrees). Each paddle can also be moved on
+// its own (Paddle<N>AngleDeg).
+class PolarizationController final : public KinesisDriveDevice<
+    CStateDeviceBase, PolarizationController, PolarizerDrive> {
+    static int const NumPaddles = PolarizerDrive::NumPaddles;
+    using PaddleAngles = std::array<double, NumPaddles>;
+
+    // Set during Initialize():
+    std::vector<PaddleAngles> presets_;
+    int pollingIntervalMs_{ 50 };
+
+    // Dynamic state:
+    struct PaddleMove {
+        bool pending;
+        double target;
+        MM::MMTime start;
+    };
+    std::array<PaddleMove, NumPaddles> moves_{};
+    long lastPreset_{ 0 };
+
+public:
+    PolarizationController(std::string const& name, std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> connection);
+    ~PolarizationController() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    unsigned long GetNumberOfPositions() const override {
+        return static_cast<unsigned long>(presets_.size());
+    }
+
+    int OnState(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnPaddleAngle(MM::PropertyBase* pProp, MM::ActionType eAct, long paddle);
+    int OnVelocityPercent(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    int ParsePresets();
+    int CheckPresetRange(double maxTravelDeg);
+    int StartPaddleMove(int paddle, double degrees);
+    bool PaddleMoveFinished(int paddle);
+};
@@ -0,0 +1,167 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DeviceFamily.h"
+
+#include "Thorlabs.MotionControl.Polarizer.h"
+
+
+// Polarization controllers have a single family, so its traits and the
+// implementation of PolarizerDrive are both here (as for filter flippers).
+
+namespace {
+    struct PolarizerTraits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.Polarizer.dll";
+        }
+        static constexpr bool isMultiChannel = false;
+
+        // The polarizer parameters (velocity, home position, jog sizes) are
+        // its only settings
+        struct Functions : FunctionTable {
+            KINESIS_FUNCTION(MPC, Open);
+            KINESIS_FUNCTION(MPC, Close);
+            KINESIS_FUNCTION_AS(RequestSettings, MPC, RequestPolParams);
+            KINESIS_FUNCTION_AS(RequestStatusBits, MPC, RequestStatus);
+            KINESIS_FUNCTION(MPC, StartPolling);
+            KINESIS_FUNCTION(MPC, StopPolling);
+            KINESIS_FUNCTION(MPC, GetHardwareInfo);
+            KINESIS_FUNCTION(MPC, GetStatusBits);
+            KINESIS_FUNCTION(MPC, MoveToPosition);
+            KINESIS_FUNCTION(MPC, GetPosition);
+            KINESIS_FUNCTION(MPC, GetMaxTravel);
+            KINESIS_OPTIONAL_FUNCTION(MPC, GetPolParams);
+            KINESIS_OPTIONAL_FUNCTION(MPC, SetPolParams);
+        };
+    };
+
+
+    template<typename Traits>
+    class PolarizerFamilyDrive final : public MotorFamilyDriveBase<Traits, PolarizerDrive> {
+        // Per-paddle functions take the paddle enum after the serial number
+        template<typename Func, size_t N>
+        using ApiParam = MotorFamilyDetail::ApiParam<Func, false, N>;
+
+    public:
+        PolarizerFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+            MotorFamilyDriveBase<Traits, PolarizerDrive>{ connection, channel }
+        {}
+
+        unsigned GetCapabilities() const override {
+            auto const& table = this->Table();
+            if (table.GetPolParams.IsResolved() && table.SetPolParams.IsResolved())
+                return PolarizerDrive::CapabilitiesVelocity;
+            return 0;
+        }
+
+    private:
+        template<typename Func, typename... Args>
+        decltype(auto) PaddleCall(Func const& func, int paddle, Args&&... args) {
+            return this->Call(func, static_cast<ApiParam<Func, 0>>(paddle),
+                std::forward<Args>(args)...);
+        }
+
+    protected: // General
+        short Kinesis_RequestSettings() override {
+            return this->Call(this->Table().RequestSettings);
+        }
+
+        short Kinesis_RequestStatusBits() override {
+            return this->Call(this->Table().RequestStatusBits);
+        }
+
+        bool Kinesis_StartPolling(int intervalMs) override {
+            return this->Call(this->Table().StartPolling, intervalMs);
+        }
+
+        void Kinesis_StopPolling() override {
+            this->Call(this->Table().StopPolling);
+        }
+
+        short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+            WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+            DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+            override {
+            return this->Call(this->Table().GetHardwareInfo, modelNo,
+                sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+                firmwareVersion, hardwareVersion, modificationState);
+        }
+
+        DWORD Kinesis_GetStatusBits() override {
+            return this->Call(this->Table().GetStatusBits);
+        }
+
+    protected: // Polarizer
+        short Kinesis_MoveToPosition(int paddle, double degrees) override {
+            auto const& func = this->Table().MoveToPosition;
+            return PaddleCall(func, paddle,
+                static_cast<ApiParam<decltype(func), 1>>(degrees));
+        }
+
+        double Kinesis_GetPosition(int paddle) override {
+            return static_cast<double>(PaddleCall(this->Table().GetPosition, paddle));
+        }
+
+        double Kinesis_GetMaxTravel() override {
+            return static_cast<double>(this->Call(this->Table().GetMaxTravel));
+        }
+
+        short Kinesis_GetVelocity(int& percent) override {
+            if (!this->HasCapability(PolarizerDrive::CapabilitiesVelocity))
+                return 18;
+            TLI_PolarizerParameters params{};
+            short err = this->Call(this->Table().GetPolParams, &params);
+            if (err)
+                return err;
+            percent = params.Velocity;
+            return 0;
+        }
+
+        short Kinesis_SetVelocity(int percent) override {
+            if (!this->HasCapability(PolarizerDrive::CapabilitiesVelocity))
+                return 18;
+            // Keep the home position and jog sizes
+            TLI_PolarizerParameters params{};
+            short err = this->Call(this->Table().GetPolParams, &params);
+            if (err)
+                return err;
+            params.Velocity = static_cast<WORD>(percent);
+            return this->Call(this->Table().SetPolParams, &params);
+        }
+    };
+} // namespace
+
+
+DeviceFamilyEntry<PolarizerDrive> const&
+PolarizerFamily() {
+    return DeviceFamily<PolarizerTraits, PolarizerDrive, PolarizerFamilyDrive>::Entry();
+}
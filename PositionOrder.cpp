@@ -0,0 +1,310 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "PositionOrder.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+
+namespace {
+    class CostMatrix {
+        size_t const n_;
+        std::vector<double> costs_;
+
+    public:
+        explicit CostMatrix(size_t n) : n_{ n }, costs_(n * n) {}
+
+        double operator()(size_t from, size_t to) const {
+            return costs_[from * n_ + to];
+        }
+        double& At(size_t from, size_t to) { return costs_[from * n_ + to]; }
+    };
+
+
+    unsigned
+    NumWorkers(size_t workItems) {
+        unsigned const hw = std::max(1u, std::thread::hardware_concurrency());
+        return unsigned(std::min<size_t>(hw, std::max<size_t>(workItems, 1)));
+    }
+
+
+    // Run f(i) for i in [0, count) on all cores
+    template<typename F>
+    void
+    ParallelFor(size_t count, F f) {
+        unsigned const workers = NumWorkers(count);
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < workers; ++w) {
+            threads.emplace_back([=, &f] {
+                for (size_t i = w; i < count; i += workers)
+                    f(i);
+            });
+        }
+        for (size_t i = 0; i < count; i += workers)
+            f(i);
+        for (auto& t : threads)
+            t.join();
+    }
+
+
+    double
+    PathCost(CostMatrix const& cost, std::vector<size_t> const& path) {
+        double total = 0.0;
+        for (size_t k = 0; k + 1 < path.size(); ++k)
+            total += cost(path[k], path[k + 1]);
+        return total;
+    }
+
+
+    std::vector<size_t>
+    NearestNeighbor(CostMatrix const& cost, size_t n, size_t start) {
+        std::vector<size_t> path{ start };
+        std::vector<bool> visited(n, false);
+        visited[start] = true;
+        for (size_t step = 1; step < n; ++step) {
+            size_t const from = path.back();
+            size_t best = n;
+            for (size_t to = 0; to < n; ++to) {
+                if (!visited[to] && (best == n || cost(from, to) < cost(from, best)))
+                    best = to;
+            }
+            visited[best] = true;
+            path.push_back(best);
+        }
+        return path;
+    }
+
+
+    // Reverse one segment if that shortens the path. Reversal changes the
+    // direction of every move in the segment, so its cost is computed from
+    // prefix sums of the forward and backward costs.
+    bool
+    TwoOptOnce(CostMatrix const& cost, std::vector<size_t>& path) {
+        size_t const n = path.size();
+        std::vector<double> forward(n, 0.0), backward(n, 0.0);
+        for (size_t k = 0; k + 1 < n; ++k) {
+            forward[k + 1] = forward[k] + cost(path[k], path[k + 1]);
+            backward[k + 1] = backward[k] + cost(path[k + 1], path[k]);
+        }
+
+        for (size_t i = 0; i + 1 < n; ++i) {
+            for (size_t j = i + 1; j < n; ++j) {
+                double delta = (backward[j] - backward[i]) -
+                    (forward[j] - forward[i]);
+                if (i > 0) {
+                    delta += cost(path[i - 1], path[j]) -
+                        cost(path[i - 1], path[i]);
+                }
+                if (j + 1 < n) {
+                    delta += cost(path[i], path[j + 1]) -
+                        cost(path[j], path[j + 1]);
+                }
+                if (delta < -1e-9) {
+                    std::reverse(path.begin() + i, path.begin() + j + 1);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+
+    // Move a run of 1 to 3 positions elsewhere in the path (keeping its
+    // direction) if that shortens the path
+    bool
+    OrOptOnce(CostMatrix const& cost, std::vector<size_t>& path) {
+        size_t const n = path.size();
+        size_t const none = n;
+        auto edge = [&](size_t a, size_t b) {
+            return (a == none || b == none) ? 0.0 : cost(path[a], path[b]);
+        };
+
+        for (size_t len = 1; len <= 3 && len < n; ++len) {
+            for (size_t i = 0; i + len <= n; ++i) {
+                size_t const first = i, last = i + len - 1;
+                size_t const prev = i > 0 ? i - 1 : none;
+                size_t const next = last + 1 < n ? last + 1 : none;
+                double const removeGain = edge(prev, first) + edge(last, next) -
+                    edge(prev, next);
+
+                // Insert at the front
+                if (i > 0) {
+                    double const delta = edge(last, 0) - removeGain;
+                    if (delta < -1e-9) {
+                        std::vector<size_t> seg(path.begin() + first, path.begin() + last + 1);
+                        path.erase(path.begin() + first, path.begin() + last + 1);
+                        path.insert(path.begin(), seg.begin(), seg.end());
+                        return true;
+                    }
+                }
+
+                // Insert after position k
+                for (size_t k = 0; k < n; ++k) {
+                    if (k + 1 >= first && k <= last)
+                        continue; // Adjacent to or inside the segment
+                    size_t const after = k + 1 < n ? k + 1 : none;
+                    double const delta = edge(k, first) + edge(last, after) -
+                        edge(k, after) - removeGain;
+                    if (delta < -1e-9) {
+                        std::vector<size_t> seg(path.begin() + first, path.begin() + last + 1);
+                        path.erase(path.begin() + first, path.begin() + last + 1);
+                        size_t const at = k < first ? k + 1 : k + 1 - len;
+                        path.insert(path.begin() + at, seg.begin(), seg.end());
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+
+    void
+    Improve(CostMatrix const& cost, std::vector<size_t>& path) {
+        // Bounded, in case of cycling on floating-point ties
+        size_t const maxRounds = 100 * path.size();
+        for (size_t round = 0; round < maxRounds; ++round) {
+            if (!TwoOptOnce(cost, path) && !OrOptOnce(cost, path))
+                break;
+        }
+    }
+} // namespace
+
+
+PositionOrderResult
+OptimizePositionOrder(PositionOrderProblem const& problem) {
+    PositionOrderResult result;
+    size_t const n = problem.positions.size();
+    result.order.resize(n);
+    std::iota(result.order.begin(), result.order.end(), size_t(0));
+    if (n < 3)
+        return result;
+
+    CostMatrix cost{ n };
+    ParallelFor(n, [&](size_t from) {
+        for (size_t to = 0; to < n; ++to) {
+            double total = 0.0;
+            for (size_t axis = 0; axis < problem.axes.size(); ++axis) {
+                long const distance = problem.positions[to][axis] -
+                    problem.positions[from][axis];
+                double const t = MotionModel::Predict(problem.axes[axis], distance);
+                total = problem.axesMoveTogether ? std::max(total, t) : total + t;
+            }
+            cost.At(from, to) = total;
+        }
+    });
+    result.originalMs = PathCost(cost, result.order);
+
+    // Each worker improves a path from a different starting position
+    size_t const starts = NumWorkers(n);
+    std::vector<std::vector<size_t>> paths(starts);
+    std::vector<double> costs(starts, std::numeric_limits<double>::infinity());
+    ParallelFor(starts, [&](size_t s) {
+        paths[s] = NearestNeighbor(cost, n, s * n / starts);
+        Improve(cost, paths[s]);
+        costs[s] = PathCost(cost, paths[s]);
+    });
+
+    size_t const best = size_t(std::min_element(costs.begin(), costs.end()) - costs.begin());
+    if (costs[best] < result.originalMs) {
+        result.order = std::move(paths[best]);
+        result.optimizedMs = costs[best];
+    }
+    else {
+        result.optimizedMs = result.originalMs;
+    }
+    return result;
+}
+
+
+bool
+ParsePositionList(std::string const& text, size_t axes,
+    std::vector<std::vector<long>>* positions) {
+    positions->clear();
+    std::istringstream list{ text };
+    std::string item;
+    while (std::getline(list, item, ';')) {
+        if (item.find_first_not_of(" \t") == std::string::npos)
+            continue; // Allow a trailing ';'
+        std::istringstream coords{ item };
+        std::vector<long> position;
+        std::string coord;
+        while (std::getline(coords, coord, ',')) {
+            std::size_t used = 0;
+            try {
+                position.push_back(std::stol(coord, &used));
+            }
+            catch (std::exception const&) {
+                return false;
+            }
+            if (coord.find_first_not_of(" \t", used) != std::string::npos)
+                return false;
+        }
+        if (position.size() != axes)
+            return false;
+        positions->push_back(std::move(position));
+    }
+    return true;
+}
+
+
+std::vector<std::string>
+ParseAxisNames(std::string const& text) {
+    std::vector<std::string> names;
+    std::istringstream list{ text };
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        auto const first = name.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+        auto const last = name.find_last_not_of(" \t");
+        names.push_back(name.substr(first, last - first + 1));
+    }
+    return names;
+}
+
+
+std::string
+FormatPositionOrder(std::vector<size_t> const& order) {
+    std::string ret;
+    for (auto index : order) {
+        if (!ret.empty())
+            ret += ",";
+        ret += std::to_string(index);
+    }
+    return ret;
+}
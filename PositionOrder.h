@@ -0,0 +1,75 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "MotionModel.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+// Ordering of a list of stage positions (e.g. the wells of a plate) so that
+// visiting them takes the least predicted time.
+//
+// The time to move between two positions is predicted from each axis's
+// MotionModel: the slowest axis if the axes move together (as with an
+// XYStage), otherwise the sum over axes. Because of the direction term this
+// is not symmetric. The order is an open path (no return to the start),
+// found by nearest neighbor followed by 2-opt and Or-opt improvement, from
+// several starting positions in parallel.
+struct PositionOrderProblem {
+    std::vector<std::vector<long>> positions; // [position][axis], device units
+    std::vector<MotionModel::Coefficients> axes;
+    bool axesMoveTogether = true;
+};
+
+
+struct PositionOrderResult {
+    std::vector<size_t> order; // Indices into positions
+    double originalMs = 0.0; // Predicted time in the given order
+    double optimizedMs = 0.0; // Predicted time in the returned order
+};
+
+
+PositionOrderResult OptimizePositionOrder(PositionOrderProblem const& problem);
+
+// Parse "x,y;x,y;..." (one integer per axis, positions separated by ';')
+bool ParsePositionList(std::string const& text, size_t axes,
+    std::vector<std::vector<long>>* positions);
+
+// Parse "name,name,..."
+std::vector<std::string> ParseAxisNames(std::string const& text);
+
+// "i,j,k,..."
+std::string FormatPositionOrder(std::vector<size_t> const& order);
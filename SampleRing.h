@@ -0,0 +1,180 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+
+// Single-writer, multiple-reader ring buffer of the most recent samples.
+//
+// The writer never blocks and never waits for readers: when the ring is
+// full, the oldest samples are overwritten. Readers take a View of a range
+// of recent samples without copying them; because the writer may overwrite
+// the range while it is being read, a reader must check IsIntact() after
+// reading (as with SeqLock) and discard what it read if the check fails.
+//
+// As in SeqLock, samples are stored as relaxed atomic words so that
+// concurrent reads and writes are not a data race. T must be trivially
+// copyable.
+template<typename T>
+class SampleRing {
+    static_assert(std::is_trivially_copyable<T>::value,
+        "SampleRing requires a trivially copyable type");
+
+    using Word = uint64_t;
+    static constexpr size_t WordsPerSample = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+    size_t const capacity_; // Power of 2
+    std::unique_ptr<std::atomic<Word>[]> words_;
+    std::atomic<uint64_t> count_{ 0 }; // Samples ever pushed
+
+public:
+    // Capacity is rounded up to a power of 2
+    explicit SampleRing(size_t capacity) :
+        capacity_{ RoundUpToPowerOf2(capacity) },
+        words_{ new std::atomic<Word>[capacity_ * WordsPerSample] }
+    {
+        for (size_t i = 0; i < capacity_ * WordsPerSample; ++i)
+            words_[i].store(0, std::memory_order_relaxed);
+    }
+
+    // Noncopyable
+    SampleRing(SampleRing const&) = delete;
+    SampleRing& operator=(SampleRing const&) = delete;
+
+    size_t Capacity() const { return capacity_; }
+
+    // Total number of samples pushed (including those overwritten)
+    uint64_t Count() const { return count_.load(std::memory_order_acquire); }
+
+    // Writer only
+    void Push(T const& sample) {
+        Word buf[WordsPerSample] = {};
+        std::memcpy(buf, &sample, sizeof(T));
+
+        uint64_t const n = count_.load(std::memory_order_relaxed);
+        std::atomic<Word>* slot = Slot(n);
+        // Pairs with the fence in IsIntact(): a reader that sees any word of
+        // this sample also sees count_ of at least n, and so rejects the
+        // sample it overwrites
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WordsPerSample; ++i)
+            slot[i].store(buf[i], std::memory_order_relaxed);
+        count_.store(n + 1, std::memory_order_release);
+    }
+
+    // A range of samples, by sequence number (0 for the first sample ever
+    // pushed), valid while the ring exists
+    class View {
+        SampleRing const* ring_ = nullptr;
+        uint64_t begin_ = 0;
+        uint64_t end_ = 0;
+
+    public:
+        View() = default;
+        View(SampleRing const* ring, uint64_t begin, uint64_t end) :
+            ring_{ ring }, begin_{ begin }, end_{ end }
+        {}
+
+        size_t Size() const { return size_t(end_ - begin_); }
+        bool Empty() const { return begin_ == end_; }
+        uint64_t BeginSequence() const { return begin_; }
+        uint64_t EndSequence() const { return end_; }
+
+        // The samples from the i-th on
+        View Suffix(size_t i) const {
+            return View{ ring_, std::min(begin_ + i, end_), end_ };
+        }
+
+        // The i-th sample of the view (oldest first); only meaningful if
+        // IsIntact() is true afterwards
+        T operator[](size_t i) const {
+            Word buf[WordsPerSample];
+            std::atomic<Word> const* slot = ring_->Slot(begin_ + i);
+            for (size_t j = 0; j < WordsPerSample; ++j)
+                buf[j] = slot[j].load(std::memory_order_relaxed);
+            T sample;
+            std::memcpy(&sample, buf, sizeof(T));
+            return sample;
+        }
+
+        // Whether no sample of the view has been (or is being)
+        // overwritten so far
+        bool IsIntact() const {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // The writer's next slot is that of sequence number count
+            return ring_->count_.load(std::memory_order_relaxed) - begin_ <
+                ring_->capacity_;
+        }
+    };
+
+    // The most recent samples, at most maxCount
+    View Latest(size_t maxCount) const {
+        uint64_t const end = Count();
+        uint64_t const n = std::min<uint64_t>(maxCount, end - Oldest(end));
+        return View{ this, end - n, end };
+    }
+
+    // Samples pushed since sequence number begin (or the oldest still
+    // available, if begin has been overwritten)
+    View Since(uint64_t begin) const {
+        uint64_t const end = Count();
+        begin = std::max(begin, Oldest(end));
+        begin = std::min(begin, end);
+        return View{ this, begin, end };
+    }
+
+private:
+    // Oldest sample that can be read while the writer continues; the slot
+    // after the newest is the one the writer fills next, so at most
+    // capacity - 1 samples are available
+    uint64_t Oldest(uint64_t end) const {
+        return end < capacity_ ? 0 : end - (capacity_ - 1);
+    }
+
+    std::atomic<Word>* Slot(uint64_t sequence) const {
+        return &words_[size_t(sequence & (capacity_ - 1)) * WordsPerSample];
+    }
+
+    static size_t RoundUpToPowerOf2(size_t n) {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+};
@@ -0,0 +1,123 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+// Single-writer, multiple-reader sequence lock.
+//
+// Readers never block and never write to shared memory, so any number of
+// threads may read concurrently with each other and with the writer, at the
+// cost of retrying if a write happened during the read. Writers must be
+// serialized externally.
+//
+// The value is stored as an array of relaxed atomic words (rather than as a
+// plain T guarded by fences) so that concurrent reads and writes are not a
+// data race in the C++ memory model. T must be trivially copyable.
+template<typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value,
+        "SeqLock requires a trivially copyable type");
+
+    using Word = uint64_t;
+    static constexpr size_t NumWords = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+    std::atomic<uint64_t> sequence_{ 0 }; // Odd while a write is in progress
+    std::array<std::atomic<Word>, NumWords> words_;
+
+public:
+    SeqLock() {
+        for (auto& w : words_)
+            w.store(0, std::memory_order_relaxed);
+    }
+
+    explicit SeqLock(T const& value) :
+        SeqLock{}
+    {
+        Store(value);
+    }
+
+    // Noncopyable
+    SeqLock(SeqLock const&) = delete;
+    SeqLock& operator=(SeqLock const&) = delete;
+
+    void Store(T const& value) {
+        Word buf[NumWords] = {};
+        std::memcpy(buf, &value, sizeof(T));
+
+        uint64_t const seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < NumWords; ++i)
+            words_[i].store(buf[i], std::memory_order_relaxed);
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    T Load() const {
+        T value;
+        while (!TryLoad(&value, 1))
+            ;
+        return value;
+    }
+
+    // Like Load(), but give up (returning false) after maxAttempts reads
+    // that overlapped a write. For readers in another process than the
+    // writer: if the writer dies in the middle of Store(), the sequence
+    // number stays odd and Load() would never return.
+    bool TryLoad(T* value, unsigned maxAttempts) const {
+        Word buf[NumWords];
+        for (unsigned attempt = 0; attempt < maxAttempts; ++attempt) {
+            uint64_t const seq0 = sequence_.load(std::memory_order_acquire);
+            if (seq0 & 1)
+                continue; // Write in progress
+            for (size_t i = 0; i < NumWords; ++i)
+                buf[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == seq0) {
+                std::memcpy(value, buf, sizeof(T));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Number of completed writes
+    uint64_t Version() const {
+        return sequence_.load(std::memory_order_acquire) / 2;
+    }
+};
@@ -42,6 +42,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <vector>
 #include <map>
@@ -59,6 +60,24 @@ namespace {
     char const* const PROPVAL_StageNameDEFAULT = "SELECT";
     char const* const PROPVAL_StageNameAuto = "AUTO";
     char const* const PROPVAL_StageNameCustom = "CUSTOM";
+    char const* const PROP_StatusIntervalMs = "StatusSnapshotIntervalMs";
+    char const* const PROP_StatusMaxStalenessMs = "StatusMaxStalenessMs";
+    char const* const PROP_Capabilities = "Capabilities";
+    char const* const PROP_MovesIssued = "MovesIssued";
+    char const* const PROP_MoveToIdleMeanMs = "MoveToIdleMeanMs";
+    char const* const PROP_MoveToIdleMaxMs = "MoveToIdleMaxMs";
+    char const* const PROP_LastSettleTimeMs = "LastSettleTimeMs";
+    char const* const PROP_MotionModel = "MotionModel";
+    char const* const PROP_BusyCalls = "BusyCalls";
+    char const* const PROP_StatusStalenessMs = "StatusStalenessMs";
+    char const* const PROP_KinesisErrors = "KinesisErrors";
+    char const* const PROP_KinesisRetries = "KinesisRetries";
+    char const* const PROP_Reconnects = "Reconnects";
+    char const* const PROP_ConnectionState = "ConnectionState";
+    char const* const PROPVAL_ConnectionStateConnected = "Connected";
+    char const* const PROPVAL_ConnectionStateReconnecting = "Reconnecting";
+    char const* const PROPVAL_ConnectionStateDisconnected = "Disconnected";
+    char const* const PROP_ReconnectTimeoutMs = "ReconnectTimeoutMs";
 }
 
 //Show pre-init properties for all selection modes
@@ -190,6 +209,21 @@ SingleAxisStage::SingleAxisStage(std::string const& name,
     CreateFloatProperty(PROP_DeviceUnitsPerRevolution,
         defaultDeviceUnitsPerRevolution, false, nullptr, true);
 
+    // Busy() and position queries are answered from a status snapshot that
+    // is refreshed in the background at this interval. If the snapshot is
+    // older than the maximum staleness (e.g. because the background thread
+    // is held up), a fresh read is made instead.
+    CreateIntegerProperty(PROP_StatusIntervalMs, 20, false, nullptr, true);
+    SetPropertyLimits(PROP_StatusIntervalMs, 1, 1000);
+    CreateIntegerProperty(PROP_StatusMaxStalenessMs,
+        long(maxStatusStaleness_.count()), false, nullptr, true);
+    SetPropertyLimits(PROP_StatusMaxStalenessMs, 0, 10000);
+
+    // If the device disappears (e.g. USB cable unplugged), moves wait up to
+    // this long for the connection to be reopened
+    CreateIntegerProperty(PROP_ReconnectTimeoutMs,
+        5000, false, nullptr, true);
+    SetPropertyLimits(PROP_ReconnectTimeoutMs, 0, 60000);
 }
 
 
@@ -202,16 +236,27 @@ SingleAxisStage::Initialize() {
     if (!motorDrive) // Shouldn't happen
         return DEVICE_ERR;
     if (!motorDrive->GetConnection()->IsValid()) {
+        for (auto const& name : MissingKinesisFunctions(serialNo_)) {
+            LogMessage(("Kinesis driver lacks required function " + name).c_str());
+        }
         return ERR_OFFSET + motorDrive->GetConnection()->ConnectionError();
     }
     motorDrive_ = std::move(motorDrive);
 
+    // Features that the driver does not provide are skipped below rather
+    // than attempted
+    std::string const capabilities =
+        MotorDrive::FormatCapabilities(motorDrive_->GetCapabilities());
+    LogMessage(("Kinesis driver capabilities for serial no " + serialNo_ +
+        ": " + capabilities).c_str());
+    CreateStringProperty(PROP_Capabilities, capabilities.c_str(), true);
+
     short err;
 
     // For what it's worth (doesn't seem to change anything)
     err = motorDrive_->RequestSettings();
     if (err)
-        return ERR_OFFSET + err;
+        return KinesisError(err);
 
     char stageName[MM::MaxStrLength];
     GetProperty(PROP_StageNameSelection, stageName);
@@ -220,7 +265,12 @@ SingleAxisStage::Initialize() {
         std::map<int, double> actuatorParams;
 
         //Property is available
-        if (supportsAutoDetection_ && stageName == std::string{PROPVAL_StageNameAuto})
+        if (supportsAutoDetection_ && stageName == std::string{PROPVAL_StageNameAuto} &&
+            !motorDrive_->HasCapability(MotorDrive::CapabilitiesActuatorDetection))
+        {
+            LogMessage(("Actuator detection not available for serial number: " + serialNo_).c_str());
+        }
+        else if (supportsAutoDetection_ && stageName == std::string{PROPVAL_StageNameAuto})
         {
             err = motorDrive_->LoadSettings();
             if (err)
@@ -303,13 +353,21 @@ SingleAxisStage::Initialize() {
         SetProperty(PROP_DeviceUnitsPerRevolution, std::to_string(deviceUnitsPerUm_ * 360).c_str());
         SetProperty(PROP_StageType, isRotational_ ? PROPVAL_StageTypeRotational : PROPVAL_StageTypeLinear);
 
-        if (hasHomeParams)
+        if (hasHomeParams && !motorDrive_->HasCapability(MotorDrive::CapabilitiesHomingParams))
+        {
+            LogMessage("Homing parameters not supported by device; not applied");
+        }
+        else if (hasHomeParams)
         {
             const int offsetDistance = std::lround(homeParams.offsetDistance * deviceUnitsPerUm_ * 1000);
             const int velocity = std::lround(homeParams.velocity * deviceUnitsPerUm_ * 1000);
             motorDrive_->SetHomingParameters(homeParams.direction, homeParams.limitSwitch, offsetDistance, velocity);
         }
-        if (hasLimitParams)
+        if (hasLimitParams && !motorDrive_->HasCapability(MotorDrive::CapabilitiesLimitSwitchParams))
+        {
+            LogMessage("Limit switch parameters not supported by device; not applied");
+        }
+        else if (hasLimitParams)
         {
             motorDrive_->SetLimitSwitchParameters(limitParams.ccwHardwareLimitMode, limitParams.ccwSoftwareLimitPosition, limitParams.cwHardwareLimitMode, limitParams.cwSoftwareLimitPosition, limitParams.softwareLimitMode);
         }
@@ -360,11 +418,11 @@ SingleAxisStage::Initialize() {
 
     err = motorDrive_->RequestPosition();
     if (err)
-        return ERR_OFFSET + err;
+        return KinesisError(err);
 
     err = motorDrive_->RequestStatusBits();
     if (err)
-        return ERR_OFFSET + err;
+        return KinesisError(err);
 
     bool ok = motorDrive_->StartPolling(pollingIntervalMs_);
     if (!ok) {
@@ -380,22 +438,113 @@ SingleAxisStage::Initialize() {
         // always start up disabled, so enabling _is_ necessary for those.
         err = motorDrive_->SetChannelEnabled(true);
         if (err)
-            return ERR_OFFSET + err;
+            return KinesisError(err);
         didEnable_ = true;
     }
 
+    // Remember the velocity parameters, so that they can be restored if the
+    // device is reconnected
+    if (motorDrive_->HasCapability(MotorDrive::CapabilitiesVelocityParams)) {
+        int acceleration, maxVelocity;
+        motorDrive_->GetVelocityParameters(&acceleration, &maxVelocity);
+    }
+
+    long reconnectTimeoutMs;
+    GetProperty(PROP_ReconnectTimeoutMs, reconnectTimeoutMs);
+    stateRestorer_.Start(motorDrive_->GetConnection(),
+        std::chrono::milliseconds{ reconnectTimeoutMs });
+
+    long statusIntervalMs;
+    GetProperty(PROP_StatusIntervalMs, statusIntervalMs);
+    long maxStalenessMs;
+    GetProperty(PROP_StatusMaxStalenessMs, maxStalenessMs);
+    maxStatusStaleness_ = std::chrono::milliseconds{ maxStalenessMs };
+
+    traceTrack_ = EventTrace::NewTrack(MakeName(motorDrive_.get()));
+    motionModel_ = MotionModel::ForAxis(channel_ > 0 ?
+        serialNo_ + '-' + std::to_string(channel_) : serialNo_);
+    statusPoller_ = std::make_unique<StatusPoller>(*motorDrive_,
+        std::chrono::milliseconds{ statusIntervalMs }, traceTrack_);
+    if (PollsChannelsTogether(serialNo_)) {
+        // Poll the channels (e.g. the bays of a rack) together; the first
+        // channel's interval applies
+        auto group = StatusPollerGroup::ForDevice(serialNo_,
+            std::chrono::milliseconds{ statusIntervalMs });
+        if (group->Interval().count() != statusIntervalMs) {
+            LogMessage(std::string{ PROP_StatusIntervalMs } + " of " +
+                std::to_string(statusIntervalMs) + " ms ignored; the channels "
+                "of serial no " + serialNo_ + " are polled together every " +
+                std::to_string(group->Interval().count()) + " ms");
+        }
+        statusPoller_->SetGroup(std::move(group));
+    }
+    statusBoard_ = StatusBoard::Active();
+    if (statusBoard_) {
+        statusBoardSlot_ = statusBoard_->Claim(serialNo_, channel_);
+        if (statusBoardSlot_ == StatusBoard::NoSlot) {
+            LogMessage("No free status board slot for serial no " + serialNo_);
+        }
+        else {
+            std::strncpy(statusBoardEntry_.serialNo, serialNo_.c_str(),
+                sizeof(statusBoardEntry_.serialNo) - 1);
+            statusBoardEntry_.channel = channel_;
+            statusPoller_->SetPublisher([this](StatusSnapshot const& status) {
+                PublishStatus(status);
+            });
+        }
+    }
+    statusPoller_->Start();
+
+    // Live counters (see Counters), for spotting a degrading axis without a
+    // debugger
+    CreateIntegerProperty(PROP_MovesIssued, 0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterMovesIssued));
+    CreateFloatProperty(PROP_MoveToIdleMeanMs, 0.0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterMoveToIdleMeanMs));
+    CreateFloatProperty(PROP_MoveToIdleMaxMs, 0.0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterMoveToIdleMaxMs));
+    CreateFloatProperty(PROP_LastSettleTimeMs, 0.0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterLastSettleTimeMs));
+    CreateIntegerProperty(PROP_BusyCalls, 0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterBusyCalls));
+    CreateFloatProperty(PROP_StatusStalenessMs, 0.0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterStatusStalenessMs));
+    CreateStringProperty(PROP_KinesisErrors, "", true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterKinesisErrors));
+    CreateStringProperty(PROP_KinesisRetries, "", true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterKinesisRetries));
+    CreateIntegerProperty(PROP_Reconnects, 0, true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterReconnects));
+    CreateStringProperty(PROP_MotionModel, "", true,
+        new CPropertyActionEx(this, &SingleAxisStage::OnCounter, CounterMotionModel));
+    CreateStringProperty(PROP_ConnectionState, PROPVAL_ConnectionStateConnected,
+        true, new CPropertyAction(this, &SingleAxisStage::OnConnectionState));
+
     return DEVICE_OK;
 }
 
 
 int
 SingleAxisStage::Shutdown() {
+    statusPoller_.reset();
+    if (statusBoard_) {
+        statusBoard_->Release(statusBoardSlot_);
+        statusBoardSlot_ = StatusBoard::NoSlot;
+        statusBoard_.reset();
+    }
+
     if (didEnable_)
         motorDrive_->SetChannelEnabled(false);
 
-    if (motorDrive_)
+    if (motorDrive_) {
         motorDrive_->StopPolling();
 
+        LogMessage(("Kinesis call statistics for serial no " + serialNo_ +
+            ":\n" + motorDrive_->GetConnection()->Executor().FormatStatistics() +
+            "\nretry: " + motorDrive_->GetConnection()->Retrier().FormatStatistics()).c_str(),
+            true);
+    }
+
     motorDrive_.reset();
 
     return DEVICE_OK;
@@ -432,6 +581,18 @@ SingleAxisStage::GetName(char* name) const {
 
 bool
 SingleAxisStage::Busy() {
+    ++counters_.busyCalls;
+
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection(true) != DEVICE_OK) {
+        // The move cannot complete; the restore is retried (and its error
+        // returned) by the next command
+        movePending_ = false;
+        return false;
+    }
+
     // We are busy if the motor is moving, which we get from the status bits.
     // However, the status bits are only updated every polling interval, so
     // they do not immediately indicate movement after we kick off a move. So
@@ -446,14 +607,11 @@ SingleAxisStage::Busy() {
     if (msSinceMovementStart <= pollingIntervalMs_ + 10.0)
         return true;
 
-    DWORD status = motorDrive_->GetStatusBits();
-    return status & (
-        MotorDrive::StatusBitsMovingCW |
-        MotorDrive::StatusBitsMovingCCW |
-        MotorDrive::StatusBitsJoggingCW |
-        MotorDrive::StatusBitsJoggingCCW |
-        MotorDrive::StatusBitsHoming
-    );
+    StatusSnapshot status = GetStatus();
+    bool busy = status.IsMoving();
+    if (!busy && movePending_)
+        MoveFinished(status);
+    return busy;
 }
 
 
@@ -481,7 +639,7 @@ SingleAxisStage::SetPositionUm(double pos) {
 int
 SingleAxisStage::GetPositionSteps(long& steps) {
     // TODO Does it make sense to use encoder position for non-stepper?
-    steps = motorDrive_->GetPositionCounter();
+    steps = GetStatus().positionCounter;
     return DEVICE_OK;
 }
 
@@ -491,11 +649,25 @@ SingleAxisStage::SetPositionSteps(long steps) {
     int iSteps = sizeof(steps) > sizeof(iSteps) ?
         clamp_int(steps) : static_cast<int>(steps);
 
+    int ret = CheckConnection(false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    auto const start = EventTrace::Clock::now();
     short err = motorDrive_->MoveToPosition(iSteps);
+    if (KinesisDeviceConnection::IsConnectionLostError(err) &&
+            KinesisDeviceConnection::AutoReconnect()) {
+        // The device went away; wait for it to come back and try once more
+        ret = CheckConnection(false);
+        if (ret != DEVICE_OK)
+            return ret;
+        err = motorDrive_->MoveToPosition(iSteps);
+    }
     if (err)
-        return ERR_OFFSET + err;
+        return KinesisError(err);
 
     lastMovementStart_ = GetCurrentMMTime();
+    MoveIssued(false, start, iSteps);
 
     return DEVICE_OK;
 }
@@ -506,11 +678,24 @@ SingleAxisStage::Home() {
     if (!motorDrive_->CanHome())
         return DEVICE_UNSUPPORTED_COMMAND;
 
+    int ret = CheckConnection(false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    auto const start = EventTrace::Clock::now();
     short err = motorDrive_->Home();
+    if (KinesisDeviceConnection::IsConnectionLostError(err) &&
+            KinesisDeviceConnection::AutoReconnect()) {
+        ret = CheckConnection(false);
+        if (ret != DEVICE_OK)
+            return ret;
+        err = motorDrive_->Home();
+    }
     if (err)
-        return ERR_OFFSET + err;
+        return KinesisError(err);
 
     lastMovementStart_ = GetCurrentMMTime();
+    MoveIssued(true, start, 0);
 
     return DEVICE_OK;
 }
@@ -551,6 +736,223 @@ SingleAxisStage::MakeName(MotorDrive* motorDrive) const {
     return name;
 }
 
+
+int
+SingleAxisStage::LogMessage(char const* msg, bool debugOnly) const {
+    if (logSink_) {
+        logSink_(msg, debugOnly);
+        return DEVICE_OK;
+    }
+    return CStageBase::LogMessage(msg, debugOnly);
+}
+
+
+int
+SingleAxisStage::LogMessage(std::string const& msg, bool debugOnly) const {
+    return LogMessage(msg.c_str(), debugOnly);
+}
+
+
+int
+SingleAxisStage::KinesisError(short err) {
+    size_t const index = std::min<size_t>(size_t(std::max<short>(err, 0)),
+        Counters::MaxErrorCode + 1);
+    ++counters_.errors[index];
+    return ERR_OFFSET + err;
+}
+
+
+StatusSnapshot
+SingleAxisStage::GetStatus() {
+    StatusSnapshot status = statusPoller_->Get(maxStatusStaleness_);
+    counters_.statusStalenessMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - status.acquired).count();
+    return status;
+}
+
+
+// Wait (up to the reconnect timeout) if the connection is lost, and restore
+// our settings if it has been reopened since they were last applied (see
+// StateRestorer). If resumeMove, also reissue a move that was in progress
+// (unless it was to a position and the device has lost its home).
+int
+SingleAxisStage::CheckConnection(bool resumeMove) {
+    short err = stateRestorer_.Check([&] {
+        // The device may have been power cycled, so re-apply everything we
+        // set up in Initialize()
+        LogMessage(("Reconnected to serial no " + serialNo_ +
+            "; restoring state").c_str());
+        short err = motorDrive_->RestoreState();
+        if (!err && didEnable_)
+            err = motorDrive_->SetChannelEnabled(true);
+        if (!err && resumeMove && movePending_) {
+            if (pendingMoveIsHome_) {
+                err = motorDrive_->Home();
+            }
+            else if (!motorDrive_->CanHome() ||
+                    (motorDrive_->GetStatusBits() & MotorDrive::StatusBitsHomed)) {
+                err = motorDrive_->MoveToPosition(clamp_int(pendingMoveTarget_));
+            }
+            else {
+                // Position counts are meaningless until the device is homed
+                LogMessage(("Not resuming move of serial no " + serialNo_ +
+                    " because it is no longer homed").c_str());
+                movePending_ = false;
+            }
+            if (!err && movePending_)
+                lastMovementStart_ = GetCurrentMMTime();
+        }
+        if (err) {
+            LogMessage(("Failed to restore state of serial no " + serialNo_ +
+                " after reconnecting: error " + std::to_string(err)).c_str());
+        }
+        else {
+            statusPoller_->Refresh();
+        }
+        return err;
+    });
+    if (err)
+        return KinesisError(err);
+    return DEVICE_OK;
+}
+
+
+void
+SingleAxisStage::MoveIssued(bool home, EventTrace::Clock::time_point start,
+    long target) {
+    ++counters_.movesIssued;
+    learnFromMove_ = !home && !movePending_;
+    moveStart_ = start;
+    movePending_ = true;
+    pendingMoveIsHome_ = home;
+    pendingMoveTarget_ = target;
+    moveOrigin_ = statusPoller_->Latest().positionCounter;
+
+    EventTrace::Instant(traceTrack_, home ? "HomeIssued" : "MoveIssued",
+        start, "target", target);
+}
+
+
+void
+SingleAxisStage::MoveFinished(StatusSnapshot const& status) {
+    // Busy() has just returned false for the first time since the move was
+    // issued
+    auto const now = EventTrace::Clock::now();
+    double const moveToIdleMs =
+        std::chrono::duration<double, std::milli>(now - moveStart_).count();
+    ++counters_.movesCompleted;
+    counters_.moveToIdleTotalMs += moveToIdleMs;
+    counters_.moveToIdleMaxMs = std::max(counters_.moveToIdleMaxMs, moveToIdleMs);
+
+    // Settle time: from the first status read showing the motion bits
+    // cleared to now
+    if (status.motionChanged > moveStart_) {
+        counters_.lastSettleTimeMs = std::chrono::duration<double, std::milli>(
+            now - status.motionChanged).count();
+    }
+
+    // Homing distance is not known in advance, and a move issued while
+    // another was in progress did not start from rest
+    if (learnFromMove_ && pendingMoveTarget_ != moveOrigin_)
+        motionModel_->AddSample(pendingMoveTarget_ - moveOrigin_, moveToIdleMs);
+
+    movePending_ = false;
+
+    EventTrace::Instant(traceTrack_, "BusyFalse", now);
+    EventTrace::Complete(traceTrack_, "Move", moveStart_, now - moveStart_);
+}
+
+
+int
+SingleAxisStage::OnCounter(MM::PropertyBase* pProp, MM::ActionType eAct,
+    long counter) {
+    if (eAct != MM::BeforeGet)
+        return DEVICE_OK;
+
+    switch (counter) {
+    case CounterMovesIssued:
+        pProp->Set(long(counters_.movesIssued));
+        break;
+    case CounterMoveToIdleMeanMs:
+        pProp->Set(counters_.movesCompleted == 0 ? 0.0 :
+            counters_.moveToIdleTotalMs / counters_.movesCompleted);
+        break;
+    case CounterMoveToIdleMaxMs:
+        pProp->Set(counters_.moveToIdleMaxMs);
+        break;
+    case CounterLastSettleTimeMs:
+        pProp->Set(counters_.lastSettleTimeMs);
+        break;
+    case CounterBusyCalls:
+        pProp->Set(long(counters_.busyCalls));
+        break;
+    case CounterStatusStalenessMs:
+        pProp->Set(counters_.statusStalenessMs);
+        break;
+    case CounterKinesisErrors: {
+        // Format: "code:count code:count ..." (">63" for larger codes)
+        std::string errors;
+        for (size_t code = 0; code < counters_.errors.size(); ++code) {
+            if (counters_.errors[code] == 0)
+                continue;
+            if (!errors.empty())
+                errors += ' ';
+            errors += code > Counters::MaxErrorCode ?
+                ">" + std::to_string(Counters::MaxErrorCode) :
+                std::to_string(code);
+            errors += ':' + std::to_string(counters_.errors[code]);
+        }
+        pProp->Set(errors.c_str());
+        break;
+    }
+    case CounterReconnects:
+        pProp->Set(long(motorDrive_->GetConnection()->Generation()));
+        break;
+    case CounterMotionModel:
+        pProp->Set(MotionModel::Format(motionModel_->Get(),
+            motionModel_->Samples(), motionModel_->IsFitted()).c_str());
+        break;
+    case CounterKinesisRetries:
+        // Shared by all channels of the controller
+        pProp->Set(motorDrive_->GetConnection()->Retrier().FormatStatistics().c_str());
+        break;
+    }
+    return DEVICE_OK;
+}
+
+
+// Called by statusPoller_ with each snapshot
+void
+SingleAxisStage::PublishStatus(StatusSnapshot const& status) {
+    // Convert the steady-clock acquisition time to wall-clock time, which
+    // other processes can interpret
+    auto const age = std::chrono::steady_clock::now() - status.acquired;
+    auto const acquired = std::chrono::system_clock::now() -
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(age);
+
+    statusBoardEntry_.statusBits = status.statusBits;
+    statusBoardEntry_.positionSteps = status.positionCounter;
+    statusBoardEntry_.positionUm = status.positionCounter / deviceUnitsPerUm_.load();
+    statusBoardEntry_.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        acquired.time_since_epoch()).count();
+    statusBoard_->Publish(statusBoardSlot_, statusBoardEntry_);
+}
+
+
+int
+SingleAxisStage::OnConnectionState(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        auto const& connection = motorDrive_->GetConnection();
+        pProp->Set(connection->IsLost() ?
+            PROPVAL_ConnectionStateReconnecting :
+            connection->ReconnectFailed() ?
+            PROPVAL_ConnectionStateDisconnected :
+            PROPVAL_ConnectionStateConnected);
+    }
+    return DEVICE_OK;
+}
+
+
 int 
 SingleAxisStage::OnStageNameChange(MM::PropertyBase* pProp, MM::ActionType eAct)
 {
@@ -32,10 +32,19 @@
 
 #pragma once
 
+#include "EventTrace.h"
 #include "KinesisDevice.h"
+#include "MotionModel.h"
+#include "StateRestorer.h"
+#include "StatusBoard.h"
+#include "StatusPoller.h"
 
 #include "DeviceBase.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 
 
@@ -57,16 +66,78 @@ class SingleAxisStage final : public CStageBase<SingleAxisStage> {
     bool supportsStageSelection_{ false };
     bool supportsAutoDetection_{ false };
     bool isRotational_{ false };
-    double deviceUnitsPerUm_{ 1.0 }; // Per degree if rotational
+    // Per degree if rotational; atomic because the status board publisher
+    // reads it on the polling thread
+    std::atomic<double> deviceUnitsPerUm_{ 1.0 };
     double motorPitch_{ 1.0 };
     double motorGearboxRatio_{ 1.0 };
     double motorStepsPerRev_{1.0};
     int pollingIntervalMs_{ 200 };
+    std::chrono::milliseconds maxStatusStaleness_{ 100 };
     bool didEnable_{ false };
 
+    // Shared-memory slot that statusPoller_ publishes to, if enabled on the
+    // hub (see StatusBoard.h)
+    std::shared_ptr<StatusBoard> statusBoard_;
+    int statusBoardSlot_{ StatusBoard::NoSlot };
+    StatusBoardEntry statusBoardEntry_{}; // Only accessed by the publisher
+
+    // Declared after motorDrive_ and statusBoard_, which it refers to
+    std::unique_ptr<StatusPoller> statusPoller_;
+
     // Dynamic state:
     MM::MMTime lastMovementStart_{ 0.0 };
 
+    // A move is pending from when it is issued until Busy() first returns
+    // false.
+    bool movePending_{ false };
+    bool pendingMoveIsHome_{ false };
+    long pendingMoveTarget_{ 0 };
+    long moveOrigin_{ 0 }; // Position when the move was issued
+    bool learnFromMove_{ false }; // Not a home and not interrupting a move
+    EventTrace::Clock::time_point moveStart_{};
+
+    // Learns this axis's move times from completed moves, for ordering
+    // position lists on the hub (see PositionOrder.h)
+    std::shared_ptr<MotionModel> motionModel_;
+
+    // Reconnection (see KinesisDeviceConnection)
+    StateRestorer stateRestorer_;
+    int traceTrack_{ EventTrace::NoTrack };
+
+    // Set when the stage is an axis of an XYStage, which logs on its behalf
+    std::function<void(std::string const&, bool)> logSink_;
+
+    // Runtime counters, exposed as read-only properties. Updated in the
+    // MMCore-facing calls without allocating; only formatted when a property
+    // is read.
+    enum Counter {
+        CounterMovesIssued,
+        CounterMoveToIdleMeanMs,
+        CounterMoveToIdleMaxMs,
+        CounterLastSettleTimeMs,
+        CounterBusyCalls,
+        CounterStatusStalenessMs,
+        CounterKinesisErrors,
+        CounterKinesisRetries, // Of the connection (see CommandRetrier)
+        CounterReconnects, // Of the connection
+        CounterMotionModel,
+    };
+
+    struct Counters {
+        static size_t const MaxErrorCode = 63;
+
+        unsigned long movesIssued = 0;
+        unsigned long movesCompleted = 0;
+        double moveToIdleTotalMs = 0.0;
+        double moveToIdleMaxMs = 0.0;
+        double lastSettleTimeMs = 0.0;
+        unsigned long busyCalls = 0;
+        double statusStalenessMs = 0.0;
+        // By Kinesis error code; the last element counts larger codes
+        std::array<unsigned long, MaxErrorCode + 2> errors{};
+    } counters_;
+
     struct MOT_HomingParameters
     {
         unsigned int direction = 0;
@@ -102,13 +173,34 @@ public:
     int SetOrigin() override { return DEVICE_UNSUPPORTED_COMMAND; }
     int GetLimits(double&, double&) override { return DEVICE_UNSUPPORTED_COMMAND; }
     int Home();
+    bool CanHome() const { return motorDrive_ && motorDrive_->CanHome(); }
+    double DeviceUnitsPerUm() const { return deviceUnitsPerUm_; }
+
+    // Send log messages to the given function instead of the core (see
+    // XYStage)
+    void SetLogSink(std::function<void(std::string const&, bool)> sink) {
+        logSink_ = std::move(sink);
+    }
 
     int OnStageNameChange(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnCounter(MM::PropertyBase* pProp, MM::ActionType eAct, long counter);
+    int OnConnectionState(MM::PropertyBase* pProp, MM::ActionType eAct);
 
     bool IsContinuousFocusDrive() const override { return false; }
     int IsStageSequenceable(bool& f) const override { f = false; return DEVICE_OK; }
 
 private:
+    // Hide CDeviceBase::LogMessage() so that logSink_ is honored
+    int LogMessage(char const* msg, bool debugOnly = false) const;
+    int LogMessage(std::string const& msg, bool debugOnly = false) const;
+
     std::unique_ptr<MotorDrive> Connect() const;
     std::string MakeName(MotorDrive* motorDrive) const;
+    int KinesisError(short err);
+    StatusSnapshot GetStatus();
+    int CheckConnection(bool resumeMove);
+    void MoveIssued(bool home, EventTrace::Clock::time_point start,
+        long target);
+    void MoveFinished(StatusSnapshot const& status);
+    void PublishStatus(StatusSnapshot const& status);
 };
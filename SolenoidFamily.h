@@ -0,0 +1,159 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceFamily.h"
+
+#include <memory>
+#include <string>
+
+
+// Generic implementation of SolenoidDrive for the K-Cube and T-Cube solenoid
+// controllers (see MotorFamily.h and PiezoFamily.h), which share the SC_
+// prefix:
+//
+//   struct KCubeSolenoidTraits {
+//       static char const* DLLName() {
+//           return "Thorlabs.MotionControl.KCube.Solenoid.dll";
+//       }
+//       static constexpr bool isMultiChannel = false;
+//
+//       struct Functions : FunctionTable {
+//           KINESIS_SOLENOID_FUNCTIONS(SC);
+//       };
+//   };
+
+// SC has RequestStatus instead of RequestStatusBits, and no RequestSettings
+#define KINESIS_SOLENOID_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, Open); \
+    KINESIS_FUNCTION(prefix, Close); \
+    KINESIS_FUNCTION_AS(RequestStatusBits, prefix, RequestStatus); \
+    KINESIS_FUNCTION(prefix, StartPolling); \
+    KINESIS_FUNCTION(prefix, StopPolling); \
+    KINESIS_FUNCTION(prefix, GetHardwareInfo); \
+    KINESIS_FUNCTION(prefix, GetStatusBits); \
+    KINESIS_FUNCTION(prefix, GetOperatingMode); \
+    KINESIS_FUNCTION(prefix, SetOperatingMode); \
+    KINESIS_FUNCTION(prefix, GetOperatingState); \
+    KINESIS_FUNCTION(prefix, SetOperatingState); \
+    KINESIS_FUNCTION(prefix, GetSolenoidState); \
+    KINESIS_FUNCTION(prefix, GetCycleParams); \
+    KINESIS_FUNCTION(prefix, SetCycleParams)
+
+
+template<typename Traits>
+class SolenoidFamilyDrive final : public MotorFamilyDriveBase<Traits, SolenoidDrive> {
+    template<typename Func, size_t N>
+    using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+    // API values of SC_OperatingStates and SC_SolenoidStates
+    static int const Active = 1;
+    static int const Inactive = 2;
+    static int const SolenoidOpen = 1;
+
+public:
+    SolenoidFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyDriveBase<Traits, SolenoidDrive>{ connection, channel }
+    {}
+
+protected: // General
+    short Kinesis_RequestSettings() override {
+        return 0; // Not applicable
+    }
+
+    short Kinesis_RequestStatusBits() override {
+        return this->Call(this->Table().RequestStatusBits);
+    }
+
+    bool Kinesis_StartPolling(int intervalMs) override {
+        return this->Call(this->Table().StartPolling, intervalMs);
+    }
+
+    void Kinesis_StopPolling() override {
+        this->Call(this->Table().StopPolling);
+    }
+
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+        override {
+        return this->Call(this->Table().GetHardwareInfo, modelNo,
+            sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+            firmwareVersion, hardwareVersion, modificationState);
+    }
+
+    DWORD Kinesis_GetStatusBits() override {
+        return this->Call(this->Table().GetStatusBits);
+    }
+
+protected: // Solenoid
+    int Kinesis_GetOperatingMode() override {
+        return static_cast<int>(this->Call(this->Table().GetOperatingMode));
+    }
+
+    short Kinesis_SetOperatingMode(int mode) override {
+        auto const& func = this->Table().SetOperatingMode;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(mode));
+    }
+
+    short Kinesis_SetOperatingState(bool active) override {
+        auto const& func = this->Table().SetOperatingState;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(
+            active ? Active : Inactive));
+    }
+
+    bool Kinesis_IsActive() override {
+        return static_cast<int>(this->Call(this->Table().GetOperatingState)) == Active;
+    }
+
+    bool Kinesis_IsSolenoidOpen() override {
+        return static_cast<int>(this->Call(this->Table().GetSolenoidState)) == SolenoidOpen;
+    }
+
+    short Kinesis_GetCycleParams(unsigned& openTimeMs, unsigned& closedTimeMs,
+        unsigned& numCycles) override {
+        return this->Call(this->Table().GetCycleParams, &openTimeMs,
+            &closedTimeMs, &numCycles);
+    }
+
+    short Kinesis_SetCycleParams(unsigned openTimeMs, unsigned closedTimeMs,
+        unsigned numCycles) override {
+        return this->Call(this->Table().SetCycleParams, openTimeMs,
+            closedTimeMs, numCycles);
+    }
+};
+
+
+// Factory functions for a family
+template<typename Traits>
+using SolenoidFamily = DeviceFamily<Traits, SolenoidDrive, SolenoidFamilyDrive>;
@@ -0,0 +1,328 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "SolenoidShutter.h"
+
+#include <cmath>
+
+
+namespace {
+    char const* const PROP_OperatingMode = "OperatingMode";
+    char const* const PROPVAL_OperatingModeManual = "Manual";
+    char const* const PROPVAL_OperatingModeSingle = "Single";
+    char const* const PROPVAL_OperatingModeAuto = "Auto";
+    char const* const PROPVAL_OperatingModeTriggered = "Triggered";
+    char const* const PROP_OpenTimeMs = "OpenTimeMs";
+    char const* const PROP_ClosedTimeMs = "ClosedTimeMs";
+    char const* const PROP_NumCycles = "NumCycles";
+    char const* const PROP_ActuationTimeMs = "ActuationTimeMs";
+    char const* const PROP_LastCommandLatencyMs = "LastCommandLatencyMs";
+
+    int const ERR_FIRE_NEEDS_SINGLE_MODE = 99998;
+
+    struct OperatingModeName {
+        SolenoidDrive::OperatingMode mode;
+        char const* name;
+    };
+    OperatingModeName const operatingModeNames[] = {
+        { SolenoidDrive::OperatingModeManual, PROPVAL_OperatingModeManual },
+        { SolenoidDrive::OperatingModeSingle, PROPVAL_OperatingModeSingle },
+        { SolenoidDrive::OperatingModeAuto, PROPVAL_OperatingModeAuto },
+        { SolenoidDrive::OperatingModeTriggered, PROPVAL_OperatingModeTriggered },
+    };
+}
+
+
+SolenoidShutter::SolenoidShutter(std::string const& name,
+    std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, -1, connection,
+        "Solenoid controllers" }
+{
+    SetErrorText(ERR_FIRE_NEEDS_SINGLE_MODE,
+        "Fire requires the solenoid controller to be in Single mode");
+}
+
+
+SolenoidShutter::~SolenoidShutter() = default;
+
+
+int
+SolenoidShutter::Initialize() {
+    int ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    short err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    // Polling is only needed for the state shown in the property browser;
+    // Busy() and GetOpen() do not depend on it
+    if (!drive_->StartPolling(pollingIntervalMs_)) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+
+    // Start closed, in whatever mode the controller is in
+    err = drive_->SetActive(false);
+    if (err)
+        return ERR_OFFSET + err;
+    mode_ = drive_->GetOperatingMode();
+    err = drive_->GetCycleParams(openTimeMs_, closedTimeMs_, numCycles_);
+    if (err)
+        return ERR_OFFSET + err;
+
+    CreateStringProperty(PROP_OperatingMode, PROPVAL_OperatingModeManual, false,
+        new CPropertyAction(this, &SolenoidShutter::OnOperatingMode));
+    for (auto const& item : operatingModeNames)
+        AddAllowedValue(PROP_OperatingMode, item.name);
+
+    // Single and auto modes
+    CreateIntegerProperty(PROP_OpenTimeMs, long(openTimeMs_), false,
+        new CPropertyActionEx(this, &SolenoidShutter::OnCycleParam,
+            CycleParamOpenTimeMs));
+    SetPropertyLimits(PROP_OpenTimeMs, 10, 100000);
+    CreateIntegerProperty(PROP_ClosedTimeMs, long(closedTimeMs_), false,
+        new CPropertyActionEx(this, &SolenoidShutter::OnCycleParam,
+            CycleParamClosedTimeMs));
+    SetPropertyLimits(PROP_ClosedTimeMs, 10, 100000);
+    // Auto mode; zero to cycle until closed
+    CreateIntegerProperty(PROP_NumCycles, long(numCycles_), false,
+        new CPropertyActionEx(this, &SolenoidShutter::OnCycleParam,
+            CycleParamNumCycles));
+    SetPropertyLimits(PROP_NumCycles, 0, 1000000);
+
+    CreateFloatProperty(PROP_ActuationTimeMs, actuationTimeMs_, false,
+        new CPropertyAction(this, &SolenoidShutter::OnActuationTimeMs));
+    SetPropertyLimits(PROP_ActuationTimeMs, 0.0, 1000.0);
+
+    // Time taken by the last open or close command to be accepted by the
+    // controller; the hub's KinesisCallStatistics report the distribution
+    // (SC_SetOperatingState)
+    CreateFloatProperty(PROP_LastCommandLatencyMs, 0.0, true,
+        new CPropertyAction(this, &SolenoidShutter::OnLastCommandLatencyMs));
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+SolenoidShutter::Shutdown() {
+    if (drive_)
+        drive_->SetActive(false);
+    CloseDrive();
+    return DEVICE_OK;
+}
+
+
+bool
+SolenoidShutter::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection() != DEVICE_OK)
+        return false; // The restore is retried by the next command
+    return GetCurrentMMTime() < busyUntil_;
+}
+
+
+int
+SolenoidShutter::SetOpen(bool open) {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    switch (mode_) {
+    case SolenoidDrive::OperatingModeManual:
+        return Activate(open, actuationTimeMs_);
+    case SolenoidDrive::OperatingModeSingle:
+        // Opening fires one pulse; the controller closes by itself
+        if (!open)
+            return Activate(false, actuationTimeMs_);
+        return Activate(true, openTimeMs_ + actuationTimeMs_);
+    default:
+        // Auto and triggered: arm or disarm
+        return Activate(open, 0.0);
+    }
+}
+
+
+int
+SolenoidShutter::GetOpen(bool& open) {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    if (mode_ == SolenoidDrive::OperatingModeSingle)
+        open = GetCurrentMMTime() < pulseEnd_;
+    else
+        open = commandedOpen_;
+    return DEVICE_OK;
+}
+
+
+int
+SolenoidShutter::Fire(double deltaT) {
+    if (mode_ != SolenoidDrive::OperatingModeSingle)
+        return ERR_FIRE_NEEDS_SINGLE_MODE;
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    unsigned const openTimeMs = unsigned(std::lround(deltaT));
+    if (openTimeMs != openTimeMs_) {
+        short err = drive_->SetCycleParams(openTimeMs, closedTimeMs_,
+            numCycles_);
+        if (err)
+            return ERR_OFFSET + err;
+        openTimeMs_ = openTimeMs;
+    }
+    return Activate(true, openTimeMs_ + actuationTimeMs_);
+}
+
+
+int
+SolenoidShutter::OnOperatingMode(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        for (auto const& item : operatingModeNames) {
+            if (item.mode == mode_)
+                pProp->Set(item.name);
+        }
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        for (auto const& item : operatingModeNames) {
+            if (value != item.name)
+                continue;
+            int ret = CheckConnection();
+            if (ret != DEVICE_OK)
+                return ret;
+            // The mode applies to the next activation
+            ret = Activate(false, actuationTimeMs_);
+            if (ret != DEVICE_OK)
+                return ret;
+            short err = drive_->SetOperatingMode(item.mode);
+            if (err)
+                return ERR_OFFSET + err;
+            mode_ = item.mode;
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SolenoidShutter::OnCycleParam(MM::PropertyBase* pProp, MM::ActionType eAct,
+    long param) {
+    unsigned* const value =
+        param == CycleParamOpenTimeMs ? &openTimeMs_ :
+        param == CycleParamClosedTimeMs ? &closedTimeMs_ : &numCycles_;
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(long(*value));
+    }
+    else if (eAct == MM::AfterSet) {
+        long v;
+        pProp->Get(v);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        unsigned const saved = *value;
+        *value = unsigned(v);
+        short err = drive_->SetCycleParams(openTimeMs_, closedTimeMs_,
+            numCycles_);
+        if (err) {
+            *value = saved;
+            return ERR_OFFSET + err;
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SolenoidShutter::OnActuationTimeMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(actuationTimeMs_);
+    else if (eAct == MM::AfterSet)
+        pProp->Get(actuationTimeMs_);
+    return DEVICE_OK;
+}
+
+
+int
+SolenoidShutter::OnLastCommandLatencyMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(lastCommandLatencyMs_);
+    return DEVICE_OK;
+}
+
+
+// The controller comes back inactive and possibly in its default mode; the
+// drive only remembers settings made through it, so re-apply the mode and
+// cycle parameters read during Initialize() as well
+short
+SolenoidShutter::RestoreDeviceState() {
+    short err = drive_->KinesisDevice::RestoreState();
+    if (err)
+        return err;
+    err = drive_->SetCycleParams(openTimeMs_, closedTimeMs_, numCycles_);
+    if (err)
+        return err;
+    err = drive_->SetOperatingMode(mode_);
+    if (err)
+        return err;
+    commandedOpen_ = false;
+    pulseEnd_ = busyUntil_ = GetCurrentMMTime();
+    return 0;
+}
+
+
+// Send the command and compute when the resulting motion ends (busyMs after
+// the command was issued)
+int
+SolenoidShutter::Activate(bool active, double busyMs) {
+    MM::MMTime const start = GetCurrentMMTime();
+    short err = drive_->SetActive(active);
+    lastCommandLatencyMs_ = (GetCurrentMMTime() - start).getMsec();
+    if (err)
+        return ERR_OFFSET + err;
+
+    commandedOpen_ = active;
+    busyUntil_ = start + MM::MMTime::fromMs(busyMs);
+    if (active && mode_ == SolenoidDrive::OperatingModeSingle)
+        pulseEnd_ = start + MM::MMTime::fromMs(openTimeMs_);
+    else
+        pulseEnd_ = start;
+    return DEVICE_OK;
+}
@@ -0,0 +1,97 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+
+
+// Solenoid controller (KSC101, TSC001) as a shutter.
+//
+// Busy() is computed from the commanded timing rather than polled: after a
+// command, the shutter is busy for ActuationTimeMs (the solenoid's response
+// time), plus the open time of a single-mode pulse. In auto and triggered
+// modes, opening the shutter activates the controller, which then drives the
+// solenoid by itself (cycling, or following the trigger input, e.g. a
+// camera's exposure output) without further commands from the host; the
+// shutter is not busy in these modes. If the controller is reconnected (see
+// StateRestorer), it is closed and its mode and cycle parameters re-applied.
+class SolenoidShutter final :
+    public KinesisDriveDevice<CShutterBase, SolenoidShutter, SolenoidDrive> {
+    // Set during Initialize():
+    int pollingIntervalMs_{ 200 };
+
+    // Dynamic state:
+    SolenoidDrive::OperatingMode mode_{ SolenoidDrive::OperatingModeManual };
+    unsigned openTimeMs_{ 0 };
+    unsigned closedTimeMs_{ 0 };
+    unsigned numCycles_{ 0 };
+    double actuationTimeMs_{ 20.0 };
+    bool commandedOpen_{ false };
+    MM::MMTime pulseEnd_{ 0.0 }; // Single mode
+    MM::MMTime busyUntil_{ 0.0 };
+    double lastCommandLatencyMs_{ 0.0 };
+
+public:
+    SolenoidShutter(std::string const& name, std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> connection);
+    ~SolenoidShutter() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    int SetOpen(bool open = true) override;
+    int GetOpen(bool& open) override;
+    int Fire(double deltaT) override;
+
+    int OnOperatingMode(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnCycleParam(MM::PropertyBase* pProp, MM::ActionType eAct, long param);
+    int OnActuationTimeMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnLastCommandLatencyMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    enum CycleParam {
+        CycleParamOpenTimeMs,
+        CycleParamClosedTimeMs,
+        CycleParamNumCycles,
+    };
+
+    short RestoreDeviceState() override;
+    int Activate(bool active, double busyMs);
+};
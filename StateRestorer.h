@@ -0,0 +1,103 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+
+// Keeps a device's settings applied across reconnections (see
+// KinesisDeviceConnection). Remembers the connection generation for which
+// the settings were last applied; when the connection has since been
+// reopened, Check() re-applies them (KinesisDevice::RestoreState(), which
+// also restarts polling, plus anything the device adds) before the device's
+// next command goes out.
+//
+// Devices call Check() at the start of each command and from Busy(), which
+// should report busy while IsLost().
+class StateRestorer {
+    std::shared_ptr<KinesisDeviceConnection> connection_;
+    std::chrono::milliseconds reconnectTimeout_{ 5000 };
+    uint64_t generation_{ 0 };
+
+public:
+    // Call at the end of Initialize(), once the settings have been applied
+    void Start(std::shared_ptr<KinesisDeviceConnection> connection,
+        std::chrono::milliseconds reconnectTimeout = std::chrono::milliseconds{ 5000 }) {
+        connection_ = connection;
+        reconnectTimeout_ = reconnectTimeout;
+        generation_ = connection_->Generation();
+    }
+
+    void Stop() { connection_.reset(); }
+
+    bool IsLost() const { return connection_ && connection_->IsLost(); }
+
+    // Whether the connection has been reopened since the settings were last
+    // applied
+    bool IsStale() const {
+        return connection_ && connection_->Generation() != generation_;
+    }
+
+    // Wait (up to the reconnect timeout) if the connection is lost, then call
+    // restore (returning a Kinesis error code) if the connection has been
+    // reopened since the last successful restore. A failed restore is
+    // attempted again on the next call. If reconnecting has given up, start
+    // it again. Returns a Kinesis error code.
+    template<typename F>
+    short Check(F&& restore) {
+        if (!connection_)
+            return 0;
+        if (connection_->ReconnectFailed())
+            connection_->ReportLost();
+        if (connection_->IsLost()) {
+            auto const deadline = std::chrono::steady_clock::now() + reconnectTimeout_;
+            while (connection_->IsLost() && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+            if (connection_->IsLost() || connection_->ReconnectFailed())
+                return 7; // The device is no longer present
+        }
+
+        uint64_t const generation = connection_->Generation();
+        if (generation == generation_)
+            return 0;
+        short err = restore();
+        if (!err)
+            generation_ = generation;
+        return err;
+    }
+};
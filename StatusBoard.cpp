@@ -0,0 +1,247 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "StatusBoard.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+
+
+namespace {
+    char const Magic[8] = "MMKSTAT";
+
+    // Reads that overlap a write before a reader concludes that the writer
+    // died in the middle of it
+    unsigned const MaxReadAttempts = 100000;
+
+    std::mutex activeMutex;
+    std::shared_ptr<StatusBoard> activeBoard; // Guarded by activeMutex
+
+    size_t MappingSize(uint32_t slotCount) {
+        return sizeof(StatusBoardHeader) + size_t(slotCount) * sizeof(StatusBoardSlot);
+    }
+}
+
+
+StatusBoard::StatusBoard(HANDLE mapping, void* view, uint32_t slotCount) :
+    mapping_{ mapping },
+    view_{ view },
+    header_{ static_cast<StatusBoardHeader*>(view) },
+    slots_{ reinterpret_cast<StatusBoardSlot*>(
+        static_cast<char*>(view) + sizeof(StatusBoardHeader)) },
+    claimed_{ std::make_unique<bool[]>(slotCount) }
+{
+    for (uint32_t i = 0; i < slotCount; ++i)
+        new (&slots_[i]) StatusBoardSlot{};
+
+    header_->version = StatusBoardHeader::CurrentVersion;
+    header_->headerSize = sizeof(StatusBoardHeader);
+    header_->slotSize = sizeof(StatusBoardSlot);
+    header_->slotCount = slotCount;
+    header_->writerProcessId = GetCurrentProcessId();
+
+    // The magic is written last, so that readers never accept a partially
+    // initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, Magic, sizeof(Magic));
+}
+
+
+std::shared_ptr<StatusBoard>
+StatusBoard::Create(std::string const& name, uint32_t slotCount) {
+    size_t const size = MappingSize(slotCount);
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+        PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), name.c_str());
+    if (!mapping)
+        return {};
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return {};
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!view) {
+        CloseHandle(mapping);
+        return {};
+    }
+
+    return std::shared_ptr<StatusBoard>(
+        new StatusBoard{ mapping, view, slotCount });
+}
+
+
+std::shared_ptr<StatusBoard>
+StatusBoard::Active() {
+    std::lock_guard<std::mutex> lock{ activeMutex };
+    return activeBoard;
+}
+
+
+void
+StatusBoard::SetActive(std::shared_ptr<StatusBoard> board) {
+    std::lock_guard<std::mutex> lock{ activeMutex };
+    activeBoard = std::move(board);
+}
+
+
+StatusBoard::~StatusBoard() {
+    std::memset(header_->magic, 0, sizeof(header_->magic));
+    UnmapViewOfFile(view_);
+    CloseHandle(mapping_);
+}
+
+
+int
+StatusBoard::Claim(std::string const& serialNo, short channel) {
+    std::lock_guard<std::mutex> lock{ claimMutex_ };
+    for (uint32_t i = 0; i < header_->slotCount; ++i) {
+        if (claimed_[i])
+            continue;
+        claimed_[i] = true;
+
+        StatusBoardEntry entry{};
+        std::strncpy(entry.serialNo, serialNo.c_str(), sizeof(entry.serialNo) - 1);
+        entry.channel = channel;
+        slots_[i].entry.Store(entry);
+        return int(i);
+    }
+    return NoSlot;
+}
+
+
+void
+StatusBoard::Release(int slot) {
+    if (slot == NoSlot)
+        return;
+    std::lock_guard<std::mutex> lock{ claimMutex_ };
+    slots_[slot].entry.Store(StatusBoardEntry{});
+    claimed_[slot] = false;
+}
+
+
+void
+StatusBoard::Publish(int slot, StatusBoardEntry const& entry) {
+    if (slot == NoSlot)
+        return;
+    slots_[slot].entry.Store(entry);
+}
+
+
+StatusBoardReader::~StatusBoardReader() {
+    Close();
+}
+
+
+bool
+StatusBoardReader::Open(std::string const& name) {
+    Close();
+
+    mapping_ = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (!mapping_)
+        return false;
+
+    // Map the header first to learn the size
+    void const* headerView = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0,
+        sizeof(StatusBoardHeader));
+    if (!headerView) {
+        Close();
+        return false;
+    }
+    StatusBoardHeader header;
+    std::memcpy(&header, headerView, sizeof(header));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    UnmapViewOfFile(headerView);
+
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+            header.version != StatusBoardHeader::CurrentVersion ||
+            header.headerSize != sizeof(StatusBoardHeader) ||
+            header.slotSize != sizeof(StatusBoardSlot)) {
+        Close();
+        return false;
+    }
+
+    view_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0,
+        MappingSize(header.slotCount));
+    if (!view_) {
+        Close();
+        return false;
+    }
+    header_ = static_cast<StatusBoardHeader const*>(view_);
+    slots_ = reinterpret_cast<StatusBoardSlot const*>(
+        static_cast<char const*>(view_) + sizeof(StatusBoardHeader));
+    return true;
+}
+
+
+void
+StatusBoardReader::Close() {
+    if (view_)
+        UnmapViewOfFile(view_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    view_ = nullptr;
+    mapping_ = nullptr;
+    header_ = nullptr;
+    slots_ = nullptr;
+}
+
+
+uint32_t
+StatusBoardReader::SlotCount() const {
+    return header_ ? header_->slotCount : 0;
+}
+
+
+bool
+StatusBoardReader::Read(uint32_t slot, StatusBoardEntry* entry) const {
+    if (slot >= SlotCount())
+        return false;
+    if (!slots_[slot].entry.TryLoad(entry, MaxReadAttempts))
+        return false;
+    return entry->serialNo[0] != '\0';
+}
+
+
+bool
+StatusBoardReader::Find(std::string const& serialNo, short channel,
+    uint32_t* slot) const {
+    for (uint32_t i = 0; i < SlotCount(); ++i) {
+        StatusBoardEntry entry;
+        if (Read(i, &entry) && entry.channel == channel &&
+                serialNo == entry.serialNo) {
+            *slot = i;
+            return true;
+        }
+    }
+    return false;
+}
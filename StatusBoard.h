@@ -0,0 +1,161 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "SeqLock.h"
+
+#include <Windows.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+// Live stage positions published in shared memory, for monitoring and
+// analysis processes that must not go through MMCore (and compete with
+// acquisitions) or through the Kinesis DLL.
+//
+// The hub creates a named file mapping (see StatusBoard::Create()) with a
+// fixed layout: a 64-byte StatusBoardHeader, followed by slotCount 64-byte
+// slots. Each slot is a SeqLock<StatusBoardEntry>: a 64-bit sequence number
+// (odd while the entry is being written), then the entry. Each axis claims a
+// slot when initialized, and its StatusPoller writes the slot every time it
+// reads the status, so readers see data no older than the poll interval.
+//
+// Readers (see StatusBoardReader, or map the same layout from e.g. Python)
+// never block the writer: read the sequence number, copy the entry, and
+// retry if the sequence number was odd or has changed. Writes take well
+// under a microsecond, so a sequence number that stays odd means that the
+// writer process died while writing; readers should give up after a bounded
+// number of retries rather than spin.
+struct StatusBoardEntry {
+    char serialNo[16]; // NUL-terminated; empty if the slot is unused
+    int32_t channel; // -1 for single-channel devices
+    uint32_t statusBits;
+    int64_t positionSteps; // Device units
+    double positionUm; // Degrees for rotation stages
+    int64_t timestampUs; // Status read time, microseconds since 1970 (UTC)
+};
+
+
+struct StatusBoardHeader {
+    static uint32_t const CurrentVersion = 1;
+
+    char magic[8]; // "MMKSTAT" when fully initialized
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slotSize;
+    uint32_t slotCount;
+    uint32_t writerProcessId;
+    char reserved[36];
+};
+
+
+struct alignas(64) StatusBoardSlot {
+    SeqLock<StatusBoardEntry> entry;
+};
+
+
+static_assert(sizeof(StatusBoardHeader) == 64, "Header layout is fixed");
+static_assert(sizeof(StatusBoardSlot) == 64, "Slot layout is fixed");
+
+
+// The writer side, owned by the hub and shared by the axes publishing to it
+class StatusBoard {
+    HANDLE mapping_;
+    void* view_;
+    StatusBoardHeader* header_;
+    StatusBoardSlot* slots_;
+
+    std::mutex claimMutex_;
+    std::unique_ptr<bool[]> claimed_; // Guarded by claimMutex_
+
+    StatusBoard(HANDLE mapping, void* view, uint32_t slotCount);
+
+public:
+    static int const NoSlot = -1;
+
+    // Create the named mapping; return null if it cannot be created or
+    // already exists (e.g. another Micro-Manager instance is publishing)
+    static std::shared_ptr<StatusBoard> Create(std::string const& name,
+        uint32_t slotCount);
+
+    // The board that axes should publish to, if any
+    static std::shared_ptr<StatusBoard> Active();
+    static void SetActive(std::shared_ptr<StatusBoard> board);
+
+    ~StatusBoard();
+
+    // Noncopyable
+    StatusBoard(StatusBoard const&) = delete;
+    StatusBoard& operator=(StatusBoard const&) = delete;
+
+    // Return a free slot for the axis, or NoSlot if all are in use
+    int Claim(std::string const& serialNo, short channel);
+    void Release(int slot);
+
+    // Must not be called concurrently for the same slot
+    void Publish(int slot, StatusBoardEntry const& entry);
+};
+
+
+// The reader side, for use by other processes
+class StatusBoardReader {
+    HANDLE mapping_ = nullptr;
+    void const* view_ = nullptr;
+    StatusBoardHeader const* header_ = nullptr;
+    StatusBoardSlot const* slots_ = nullptr;
+
+public:
+    StatusBoardReader() = default;
+    ~StatusBoardReader();
+
+    // Noncopyable
+    StatusBoardReader(StatusBoardReader const&) = delete;
+    StatusBoardReader& operator=(StatusBoardReader const&) = delete;
+
+    // Return false if the board does not exist or has an unknown layout
+    bool Open(std::string const& name);
+    void Close();
+
+    uint32_t SlotCount() const;
+
+    // Copy the slot's latest entry without blocking; return false if the
+    // slot is unused, or if it stays mid-write (the writer has died)
+    bool Read(uint32_t slot, StatusBoardEntry* entry) const;
+
+    // Find the slot for the given axis, or return false
+    bool Find(std::string const& serialNo, short channel,
+        uint32_t* slot) const;
+};
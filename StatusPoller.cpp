@@ -0,0 +1,223 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "StatusPoller.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+
+StatusPoller::StatusPoller(MotorDrive& drive,
+    std::chrono::milliseconds interval, int traceTrack) :
+    drive_{ drive },
+    encoderDrive_{ dynamic_cast<NonStepperMotorDrive*>(&drive) },
+    interval_{ interval },
+    traceTrack_{ traceTrack }
+{}
+
+
+StatusPoller::~StatusPoller() {
+    Stop();
+}
+
+
+void
+StatusPoller::Start() {
+    if (thread_.joinable() || inGroup_)
+        return;
+
+    // Publish an initial snapshot so that readers never see an invalid one
+    // once we have started.
+    Refresh();
+
+    if (group_) {
+        group_->Add(this);
+        inGroup_ = true;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = false;
+    }
+    thread_ = std::thread([this] { Run(); });
+}
+
+
+void
+StatusPoller::Stop() {
+    if (inGroup_) {
+        group_->Remove(this);
+        inGroup_ = false;
+        return;
+    }
+    if (!thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = true;
+    }
+    stopCv_.notify_all();
+    thread_.join();
+}
+
+
+StatusSnapshot
+StatusPoller::Get(std::chrono::milliseconds maxStaleness) {
+    StatusSnapshot snapshot = snapshot_.Load();
+    if (snapshot.IsValid() && Clock::now() - snapshot.acquired <= maxStaleness)
+        return snapshot;
+    return Refresh();
+}
+
+
+StatusSnapshot
+StatusPoller::Refresh() {
+    // Hold the write lock while reading, so that published snapshots are in
+    // order of acquisition.
+    std::lock_guard<std::mutex> lock{ writeMutex_ };
+
+    StatusSnapshot snapshot;
+    snapshot.statusBits = drive_.GetStatusBits();
+    snapshot.positionCounter = drive_.GetPositionCounter();
+    if (encoderDrive_)
+        snapshot.encoderCounter = encoderDrive_->GetEncoderCounter();
+    snapshot.acquired = Clock::now();
+    bool const moving = snapshot.IsMoving();
+    if (lastSequence_ == 0 || moving != lastMoving_)
+        lastMotionChange_ = snapshot.acquired;
+    snapshot.motionChanged = lastMotionChange_;
+    snapshot.sequence = ++lastSequence_;
+    snapshot_.Store(snapshot);
+    if (publisher_)
+        publisher_(snapshot);
+
+    if (EventTrace::IsEnabled()) {
+        EventTrace::Instant(traceTrack_, "Poll", snapshot.acquired,
+            "position", snapshot.positionCounter);
+        if (moving && !lastMoving_)
+            EventTrace::Instant(traceTrack_, "MotionBitsSet", snapshot.acquired);
+        else if (!moving && lastMoving_)
+            EventTrace::Instant(traceTrack_, "MotionBitsCleared", snapshot.acquired);
+    }
+    lastMoving_ = moving;
+
+    return snapshot;
+}
+
+
+void
+StatusPoller::Run() {
+    std::unique_lock<std::mutex> lock{ stopMutex_ };
+    while (!stopCv_.wait_for(lock, interval_, [this] { return stopRequested_; })) {
+        lock.unlock();
+        Refresh();
+        lock.lock();
+    }
+}
+
+
+StatusPollerGroup::StatusPollerGroup(std::chrono::milliseconds interval) :
+    interval_{ interval }
+{
+    thread_ = std::thread([this] { Run(); });
+}
+
+
+StatusPollerGroup::~StatusPollerGroup() {
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = true;
+    }
+    stopCv_.notify_all();
+    thread_.join();
+}
+
+
+std::shared_ptr<StatusPollerGroup>
+StatusPollerGroup::ForDevice(std::string const& serialNo,
+    std::chrono::milliseconds interval) {
+    // Groups uniqued by serial number, as for connections (see
+    // UniqueConnection())
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<StatusPollerGroup>> groups;
+    std::lock_guard<std::mutex> lock{ mutex };
+
+    auto existing = groups.find(serialNo);
+    if (existing != groups.end()) {
+        auto ret = existing->second.lock();
+        if (ret)
+            return ret;
+    }
+
+    auto newGroup = std::make_shared<StatusPollerGroup>(interval);
+    groups[serialNo] = newGroup;
+    return newGroup;
+}
+
+
+void
+StatusPollerGroup::Add(StatusPoller* poller) {
+    std::lock_guard<std::mutex> lock{ membersMutex_ };
+    members_.push_back(poller);
+}
+
+
+void
+StatusPollerGroup::Remove(StatusPoller* poller) {
+    std::lock_guard<std::mutex> lock{ membersMutex_ };
+    members_.erase(std::remove(members_.begin(), members_.end(), poller),
+        members_.end());
+}
+
+
+void
+StatusPollerGroup::Run() {
+    // Keep to a fixed schedule, so that the pass duration (which grows with
+    // the number of members) does not stretch the interval
+    auto nextPass = Clock::now() + interval_;
+    std::unique_lock<std::mutex> lock{ stopMutex_ };
+    while (!stopCv_.wait_until(lock, nextPass, [this] { return stopRequested_; })) {
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> membersLock{ membersMutex_ };
+            for (StatusPoller* poller : members_)
+                poller->Refresh();
+        }
+        nextPass += interval_;
+        auto const now = Clock::now();
+        if (nextPass < now) // Overran; skip the missed passes
+            nextPass = now + interval_;
+        lock.lock();
+    }
+}
@@ -0,0 +1,197 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "EventTrace.h"
+#include "KinesisDevice.h"
+#include "SeqLock.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// The status of one motor channel as last read from the Kinesis DLL
+struct StatusSnapshot {
+    DWORD statusBits = 0;
+    long positionCounter = 0;
+    long encoderCounter = 0; // Zero if the drive has no encoder
+    std::chrono::steady_clock::time_point acquired{};
+    // When the motion bits (see IsMoving()) were first seen in their current
+    // state
+    std::chrono::steady_clock::time_point motionChanged{};
+    uint64_t sequence = 0; // Zero if never acquired
+
+    bool IsValid() const { return sequence != 0; }
+
+    // Whether the status bits show the motor moving, jogging, or homing
+    bool IsMoving() const {
+        return (statusBits & (
+            MotorDrive::StatusBitsMovingCW |
+            MotorDrive::StatusBitsMovingCCW |
+            MotorDrive::StatusBitsJoggingCW |
+            MotorDrive::StatusBitsJoggingCCW |
+            MotorDrive::StatusBitsHoming
+        )) != 0;
+    }
+};
+
+
+class StatusPollerGroup;
+
+
+// Background reader that keeps a StatusSnapshot up to date.
+//
+// MMCore may spin on Busy() and query the position at a high rate. Each
+// such query used to be a call into the Kinesis DLL (and, with the
+// CommandExecutor, a turn on the connection's strand). Instead, a dedicated
+// thread reads the status bits and counters at a fixed interval and
+// publishes them through a SeqLock, from which MMCore-facing calls read
+// without blocking.
+//
+// Note that the Kinesis DLL itself only refreshes its cached status from the
+// device every polling interval (see MotorDrive::StartPolling()), so there
+// is little to gain by reading much faster than that.
+class StatusPoller {
+public:
+    using Publisher = std::function<void(StatusSnapshot const&)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    MotorDrive& drive_;
+    NonStepperMotorDrive* const encoderDrive_; // Null if not available
+    std::chrono::milliseconds const interval_;
+    int const traceTrack_;
+
+    SeqLock<StatusSnapshot> snapshot_;
+    std::mutex writeMutex_; // Serializes writers to snapshot_
+    uint64_t lastSequence_ = 0; // Guarded by writeMutex_
+    bool lastMoving_ = false; // Guarded by writeMutex_
+    Clock::time_point lastMotionChange_{}; // Guarded by writeMutex_
+    Publisher publisher_; // Called with writeMutex_ held
+
+    std::mutex stopMutex_;
+    std::condition_variable stopCv_;
+    bool stopRequested_ = false;
+    std::thread thread_;
+
+    std::shared_ptr<StatusPollerGroup> group_; // Null if polling on own thread
+    bool inGroup_ = false;
+
+public:
+    // The drive must outlive this object. If traceTrack is given, each read
+    // and each change in the motion bits is emitted as an EventTrace event.
+    StatusPoller(MotorDrive& drive, std::chrono::milliseconds interval,
+        int traceTrack = EventTrace::NoTrack);
+    ~StatusPoller();
+
+    // Noncopyable
+    StatusPoller(StatusPoller const&) = delete;
+    StatusPoller& operator=(StatusPoller const&) = delete;
+
+    // Call publisher with each new snapshot (on the polling thread, or
+    // whichever thread refreshes); must be set before Start()
+    void SetPublisher(Publisher publisher) { publisher_ = std::move(publisher); }
+
+    // Poll as part of group (at the group's interval) instead of on a thread
+    // of our own; must be set before Start()
+    void SetGroup(std::shared_ptr<StatusPollerGroup> group) { group_ = std::move(group); }
+
+    void Start();
+    void Stop();
+
+    // Return the latest snapshot without blocking (may be invalid if not yet
+    // acquired).
+    StatusSnapshot Latest() const { return snapshot_.Load(); }
+
+    // Return the latest snapshot if it is no older than maxStaleness;
+    // otherwise read the status now (blocking on the Kinesis DLL) and
+    // publish the result. A zero maxStaleness always reads fresh.
+    StatusSnapshot Get(std::chrono::milliseconds maxStaleness);
+
+    // Read the status now and publish it
+    StatusSnapshot Refresh();
+
+private:
+    void Run();
+};
+
+
+// Shared polling thread for the channels of one device (e.g. the bays of a
+// modular rack). Each pass refreshes all member pollers back to back, so
+// that the device sees one burst of status reads per interval instead of
+// one per channel at unrelated times, and there is one thread per device
+// instead of one per channel.
+class StatusPollerGroup {
+    using Clock = std::chrono::steady_clock;
+
+    std::chrono::milliseconds const interval_;
+
+    std::mutex membersMutex_; // Held for the duration of each pass
+    std::vector<StatusPoller*> members_;
+
+    std::mutex stopMutex_;
+    std::condition_variable stopCv_;
+    bool stopRequested_ = false;
+    std::thread thread_;
+
+public:
+    explicit StatusPollerGroup(std::chrono::milliseconds interval);
+    ~StatusPollerGroup();
+
+    // Noncopyable
+    StatusPollerGroup(StatusPollerGroup const&) = delete;
+    StatusPollerGroup& operator=(StatusPollerGroup const&) = delete;
+
+    // The group for the given device, shared by all its channels; created
+    // with interval if it does not exist (otherwise the existing group's
+    // interval applies)
+    static std::shared_ptr<StatusPollerGroup> ForDevice(
+        std::string const& serialNo, std::chrono::milliseconds interval);
+
+    std::chrono::milliseconds Interval() const { return interval_; }
+
+private:
+    friend class StatusPoller;
+    void Add(StatusPoller* poller);
+    void Remove(StatusPoller* poller); // Returns after any pass in progress
+
+    void Run();
+};
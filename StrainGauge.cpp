@@ -0,0 +1,322 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "StrainGauge.h"
+
+
+namespace {
+    char const* const PROP_SampleIntervalMs = "SampleIntervalMs";
+    char const* const PROP_BufferSize = "BufferSize";
+    char const* const PROP_FullScale = "FullScale";
+    char const* const PROP_DisplayMode = "DisplayMode";
+    char const* const PROPVAL_DisplayModePosition = "Position";
+    char const* const PROPVAL_DisplayModeVoltage = "Voltage";
+    char const* const PROPVAL_DisplayModeForce = "Force";
+    char const* const PROP_Zero = "Zero";
+    char const* const PROPVAL_ZeroIdle = "Idle";
+    char const* const PROPVAL_ZeroStart = "Zero";
+    char const* const PROP_Value = "Value";
+    char const* const PROP_WindowMs = "WindowMs";
+    char const* const PROP_WindowMean = "WindowMean";
+    char const* const PROP_WindowMin = "WindowMin";
+    char const* const PROP_WindowMax = "WindowMax";
+    char const* const PROP_WindowSampleCount = "WindowSampleCount";
+    char const* const PROP_SampleCount = "SampleCount";
+
+    struct DisplayModeName {
+        StrainGaugeDrive::DisplayMode mode;
+        char const* name;
+    };
+    DisplayModeName const displayModeNames[] = {
+        { StrainGaugeDrive::DisplayModePosition, PROPVAL_DisplayModePosition },
+        { StrainGaugeDrive::DisplayModeVoltage, PROPVAL_DisplayModeVoltage },
+        { StrainGaugeDrive::DisplayModeForce, PROPVAL_DisplayModeForce },
+    };
+}
+
+
+StrainGauge::StrainGauge(std::string const& name, std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, -1, connection,
+        "Strain gauge readers" }
+{
+    // Also the Kinesis polling interval, which limits the rate at which new
+    // readings arrive
+    CreateIntegerProperty(PROP_SampleIntervalMs, sampleIntervalMs_, false,
+        nullptr, true);
+    SetPropertyLimits(PROP_SampleIntervalMs, 1, 1000);
+
+    // Number of samples kept (rounded up to a power of 2)
+    CreateIntegerProperty(PROP_BufferSize, 65536, false, nullptr, true);
+    SetPropertyLimits(PROP_BufferSize, 16, 16777216);
+
+    // Value at a full-scale reading; zero for the default
+    CreateFloatProperty(PROP_FullScale, givenFullScale_, false, nullptr, true);
+}
+
+
+StrainGauge::~StrainGauge() = default;
+
+
+int
+StrainGauge::Initialize() {
+    int ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    GetProperty(PROP_SampleIntervalMs, sampleIntervalMs_);
+    long bufferSize;
+    GetProperty(PROP_BufferSize, bufferSize);
+    GetProperty(PROP_FullScale, givenFullScale_);
+
+    short err = drive_->RequestSettings();
+    if (err)
+        return ERR_OFFSET + err;
+    err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    if (!drive_->StartPolling(int(sampleIntervalMs_))) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+
+    UpdateFullScale(drive_->GetDisplayMode());
+
+    sampler_ = std::make_unique<StrainGaugeSampler>(*drive_,
+        std::chrono::milliseconds{ sampleIntervalMs_ }, size_t(bufferSize));
+    sampler_->Start();
+
+    CreateStringProperty(PROP_DisplayMode, PROPVAL_DisplayModePosition, false,
+        new CPropertyAction(this, &StrainGauge::OnDisplayMode));
+    for (auto const& item : displayModeNames)
+        AddAllowedValue(PROP_DisplayMode, item.name);
+
+    CreateStringProperty(PROP_Zero, PROPVAL_ZeroIdle, false,
+        new CPropertyAction(this, &StrainGauge::OnZero));
+    AddAllowedValue(PROP_Zero, PROPVAL_ZeroIdle);
+    AddAllowedValue(PROP_Zero, PROPVAL_ZeroStart);
+
+    CreateFloatProperty(PROP_Value, 0.0, true,
+        new CPropertyAction(this, &StrainGauge::OnValue));
+
+    CreateIntegerProperty(PROP_WindowMs, windowMs_, false,
+        new CPropertyAction(this, &StrainGauge::OnWindowMs));
+    SetPropertyLimits(PROP_WindowMs, 1, 600000);
+    CreateFloatProperty(PROP_WindowMean, 0.0, true,
+        new CPropertyActionEx(this, &StrainGauge::OnWindowStat, WindowStatMean));
+    CreateFloatProperty(PROP_WindowMin, 0.0, true,
+        new CPropertyActionEx(this, &StrainGauge::OnWindowStat, WindowStatMin));
+    CreateFloatProperty(PROP_WindowMax, 0.0, true,
+        new CPropertyActionEx(this, &StrainGauge::OnWindowStat, WindowStatMax));
+    CreateIntegerProperty(PROP_WindowSampleCount, 0, true,
+        new CPropertyActionEx(this, &StrainGauge::OnWindowStat, WindowStatCount));
+
+    CreateIntegerProperty(PROP_SampleCount, 0, true,
+        new CPropertyAction(this, &StrainGauge::OnSampleCount));
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+StrainGauge::Shutdown() {
+    sampler_.reset();
+    CloseDrive();
+    return DEVICE_OK;
+}
+
+
+bool
+StrainGauge::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale())
+        CheckConnection(); // Retried by the next call if it fails
+    return false;
+}
+
+
+SampleRing<StrainGaugeSample> const*
+StrainGauge::Samples() const {
+    return sampler_ ? &sampler_->Samples() : nullptr;
+}
+
+
+int
+StrainGauge::OnDisplayMode(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        StrainGaugeDrive::DisplayMode const mode = drive_->GetDisplayMode();
+        for (auto const& item : displayModeNames) {
+            if (item.mode == mode)
+                pProp->Set(item.name);
+        }
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        for (auto const& item : displayModeNames) {
+            if (value != item.name)
+                continue;
+            short err = drive_->SetDisplayMode(item.mode);
+            if (err)
+                return ERR_OFFSET + err;
+            UpdateFullScale(item.mode);
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+StrainGauge::OnZero(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(PROPVAL_ZeroIdle);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        if (value == PROPVAL_ZeroStart) {
+            int ret = CheckConnection();
+            if (ret != DEVICE_OK)
+                return ret;
+            short err = drive_->SetZero();
+            if (err)
+                return ERR_OFFSET + err;
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+StrainGauge::OnValue(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        int ret = CheckReadings();
+        if (ret != DEVICE_OK)
+            return ret;
+        StrainGaugeSample sample;
+        if (sampler_->Latest(sample))
+            pProp->Set(sample.reading * ReadingScale());
+    }
+    return DEVICE_OK;
+}
+
+
+int
+StrainGauge::OnWindowMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(windowMs_);
+    else if (eAct == MM::AfterSet)
+        pProp->Get(windowMs_);
+    return DEVICE_OK;
+}
+
+
+int
+StrainGauge::OnWindowStat(MM::PropertyBase* pProp, MM::ActionType eAct,
+    long stat) {
+    if (eAct == MM::BeforeGet) {
+        int ret = CheckReadings();
+        if (ret != DEVICE_OK)
+            return ret;
+        auto const stats =
+            sampler_->WindowStats(std::chrono::milliseconds{ windowMs_ });
+        switch (stat) {
+        case WindowStatMean:
+            pProp->Set(stats.mean * ReadingScale());
+            break;
+        case WindowStatMin:
+            pProp->Set(stats.min * ReadingScale());
+            break;
+        case WindowStatMax:
+            pProp->Set(stats.max * ReadingScale());
+            break;
+        case WindowStatCount:
+            pProp->Set(long(stats.count));
+            break;
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+StrainGauge::OnSampleCount(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(long(sampler_->Samples().Count()));
+    return DEVICE_OK;
+}
+
+
+// The readings stop updating while polling is stopped, so restart it (with
+// the other settings) once the connection has been reopened; this does not
+// wait if the connection is still lost
+int
+StrainGauge::CheckReadings() {
+    if (stateRestorer_.IsLost() || !stateRestorer_.IsStale())
+        return DEVICE_OK;
+    return CheckConnection();
+}
+
+
+short
+StrainGauge::RestoreDeviceState() {
+    short err = drive_->RestoreState();
+    if (err)
+        return err;
+    // The display mode is the controller's own unless set through DisplayMode
+    UpdateFullScale(drive_->GetDisplayMode());
+    return 0;
+}
+
+
+void
+StrainGauge::UpdateFullScale(StrainGaugeDrive::DisplayMode mode) {
+    if (givenFullScale_ > 0.0) {
+        fullScale_ = givenFullScale_;
+        return;
+    }
+    fullScale_ = 100.0; // Percent
+    if (mode == StrainGaugeDrive::DisplayModePosition) {
+        double const travelUm = 0.1 * drive_->GetMaximumTravel();
+        if (travelUm > 0.0)
+            fullScale_ = travelUm;
+    }
+}
@@ -0,0 +1,98 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+#include "StrainGaugeSampler.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+
+
+// Strain gauge reader (KSG101, TSG001) as a signal source, for logging force
+// or displacement alongside imaging.
+//
+// Readings are taken on a background thread at SampleIntervalMs and kept in
+// a ring buffer (see StrainGaugeSampler). Properties report the latest value
+// and the mean, minimum and maximum over the last WindowMs, in the units of
+// FullScale (by default, um in position mode and percent of full scale
+// otherwise). Code in the adapter can retrieve the buffered samples through
+// Samples() without copying them. If the reader is reconnected (see
+// StateRestorer), polling and the display mode are restored.
+class StrainGauge final :
+    public KinesisDriveDevice<CGenericBase, StrainGauge, StrainGaugeDrive> {
+    // Set during Initialize():
+    std::unique_ptr<StrainGaugeSampler> sampler_;
+    long sampleIntervalMs_{ 10 };
+    double givenFullScale_{ 0.0 }; // Zero to use the default
+
+    // Dynamic state:
+    double fullScale_{ 100.0 };
+    long windowMs_{ 1000 };
+
+public:
+    StrainGauge(std::string const& name, std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> connection);
+    ~StrainGauge() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    // Buffered samples (null before initialization); readings are converted
+    // to the units of the properties by multiplying by ReadingScale()
+    SampleRing<StrainGaugeSample> const* Samples() const;
+    double ReadingScale() const { return fullScale_ / StrainGaugeDrive::MaxValue; }
+
+    int OnDisplayMode(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnZero(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnValue(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnWindowMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnWindowStat(MM::PropertyBase* pProp, MM::ActionType eAct, long stat);
+    int OnSampleCount(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    enum WindowStat {
+        WindowStatMean,
+        WindowStatMin,
+        WindowStatMax,
+        WindowStatCount,
+    };
+
+    int CheckReadings();
+    short RestoreDeviceState() override;
+    void UpdateFullScale(StrainGaugeDrive::DisplayMode mode);
+};
@@ -0,0 +1,141 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceFamily.h"
+
+#include <memory>
+#include <string>
+
+
+// Generic implementation of StrainGaugeDrive for the K-Cube and T-Cube
+// strain gauge readers (see MotorFamily.h and PiezoFamily.h), which share
+// the SG_ prefix:
+//
+//   struct KCubeStrainGaugeTraits {
+//       static char const* DLLName() {
+//           return "Thorlabs.MotionControl.KCube.StrainGauge.dll";
+//       }
+//       static constexpr bool isMultiChannel = false;
+//
+//       struct Functions : FunctionTable {
+//           KINESIS_STRAIN_GAUGE_FUNCTIONS(SG);
+//       };
+//   };
+
+// SG has RequestStatus instead of RequestStatusBits
+#define KINESIS_STRAIN_GAUGE_FUNCTIONS(prefix) \
+    KINESIS_FUNCTION(prefix, Open); \
+    KINESIS_FUNCTION(prefix, Close); \
+    KINESIS_FUNCTION(prefix, RequestSettings); \
+    KINESIS_FUNCTION_AS(RequestStatusBits, prefix, RequestStatus); \
+    KINESIS_FUNCTION(prefix, StartPolling); \
+    KINESIS_FUNCTION(prefix, StopPolling); \
+    KINESIS_FUNCTION(prefix, GetHardwareInfo); \
+    KINESIS_FUNCTION(prefix, GetStatusBits); \
+    KINESIS_FUNCTION(prefix, GetReading); \
+    KINESIS_FUNCTION(prefix, GetDisplayMode); \
+    KINESIS_FUNCTION(prefix, SetDisplayMode); \
+    KINESIS_FUNCTION(prefix, GetMaximumTravel); \
+    KINESIS_FUNCTION(prefix, SetZero)
+
+
+template<typename Traits>
+class StrainGaugeFamilyDrive final :
+    public MotorFamilyDriveBase<Traits, StrainGaugeDrive> {
+    template<typename Func, size_t N>
+    using ApiParam = MotorFamilyDetail::ApiParam<Func, Traits::isMultiChannel, N>;
+
+public:
+    StrainGaugeFamilyDrive(std::shared_ptr<KinesisDeviceConnection> connection, short channel) :
+        MotorFamilyDriveBase<Traits, StrainGaugeDrive>{ connection, channel }
+    {}
+
+protected: // General
+    short Kinesis_RequestSettings() override {
+        return this->Call(this->Table().RequestSettings);
+    }
+
+    short Kinesis_RequestStatusBits() override {
+        return this->Call(this->Table().RequestStatusBits);
+    }
+
+    bool Kinesis_StartPolling(int intervalMs) override {
+        return this->Call(this->Table().StartPolling, intervalMs);
+    }
+
+    void Kinesis_StopPolling() override {
+        this->Call(this->Table().StopPolling);
+    }
+
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+        override {
+        return this->Call(this->Table().GetHardwareInfo, modelNo,
+            sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+            firmwareVersion, hardwareVersion, modificationState);
+    }
+
+    DWORD Kinesis_GetStatusBits() override {
+        return this->Call(this->Table().GetStatusBits);
+    }
+
+protected: // Strain gauge
+    int Kinesis_GetDisplayMode() override {
+        return static_cast<int>(this->Call(this->Table().GetDisplayMode));
+    }
+
+    short Kinesis_SetDisplayMode(int mode) override {
+        auto const& func = this->Table().SetDisplayMode;
+        return this->Call(func, static_cast<ApiParam<decltype(func), 0>>(mode));
+    }
+
+    int Kinesis_GetReading(bool smoothed) override {
+        return static_cast<int>(this->Call(this->Table().GetReading, smoothed));
+    }
+
+    int Kinesis_GetMaximumTravel() override {
+        return static_cast<int>(this->Call(this->Table().GetMaximumTravel));
+    }
+
+    short Kinesis_SetZero() override {
+        return this->Call(this->Table().SetZero);
+    }
+};
+
+
+// Factory functions for a family
+template<typename Traits>
+using StrainGaugeFamily =
+    DeviceFamily<Traits, StrainGaugeDrive, StrainGaugeFamilyDrive>;
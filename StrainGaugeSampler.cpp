@@ -0,0 +1,142 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "StrainGaugeSampler.h"
+
+#include <algorithm>
+
+
+StrainGaugeSampler::StrainGaugeSampler(StrainGaugeDrive& drive,
+    std::chrono::milliseconds interval, size_t capacity) :
+    drive_{ drive },
+    interval_{ interval },
+    ring_{ capacity }
+{}
+
+
+StrainGaugeSampler::~StrainGaugeSampler() {
+    Stop();
+}
+
+
+void
+StrainGaugeSampler::Start() {
+    if (thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = false;
+    }
+    thread_ = std::thread([this] { Run(); });
+}
+
+
+void
+StrainGaugeSampler::Stop() {
+    if (!thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{ stopMutex_ };
+        stopRequested_ = true;
+    }
+    stopCv_.notify_all();
+    thread_.join();
+}
+
+
+bool
+StrainGaugeSampler::Latest(StrainGaugeSample& sample) const {
+    for (;;) {
+        auto const view = ring_.Latest(1);
+        if (view.Empty())
+            return false;
+        sample = view[0];
+        if (view.IsIntact())
+            return true;
+    }
+}
+
+
+StrainGaugeSampler::Stats
+StrainGaugeSampler::WindowStats(std::chrono::milliseconds window) const {
+    int64_t const since = NowNs() -
+        std::chrono::duration_cast<std::chrono::nanoseconds>(window).count();
+    for (;;) {
+        // Scan back from the newest sample until one is outside the window
+        auto const view = ring_.Latest(ring_.Capacity());
+        Stats stats;
+        int64_t sum = 0;
+        size_t oldestRead = view.Size();
+        for (size_t i = view.Size(); i > 0; --i) {
+            StrainGaugeSample const sample = view[i - 1];
+            oldestRead = i - 1;
+            if (sample.timeNs < since)
+                break;
+            if (stats.count == 0) {
+                stats.min = stats.max = sample.reading;
+            }
+            else {
+                stats.min = std::min(stats.min, sample.reading);
+                stats.max = std::max(stats.max, sample.reading);
+            }
+            sum += sample.reading;
+            ++stats.count;
+        }
+        if (!view.Suffix(oldestRead).IsIntact())
+            continue; // Overwritten while scanning
+        if (stats.count > 0)
+            stats.mean = double(sum) / stats.count;
+        return stats;
+    }
+}
+
+
+void
+StrainGaugeSampler::Run() {
+    std::unique_lock<std::mutex> lock{ stopMutex_ };
+    auto next = Clock::now();
+    for (;;) {
+        // Fixed rate rather than fixed delay, so that the sample times do
+        // not drift relative to the DLL's polling
+        next += interval_;
+        if (stopCv_.wait_until(lock, next, [this] { return stopRequested_; }))
+            break;
+        lock.unlock();
+        StrainGaugeSample sample;
+        sample.reading = drive_.GetReading(false);
+        sample.timeNs = NowNs();
+        ring_.Push(sample);
+        lock.lock();
+    }
+}
@@ -0,0 +1,106 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+#include "SampleRing.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+
+struct StrainGaugeSample {
+    int64_t timeNs; // steady_clock time since its epoch
+    int32_t reading; // Fraction of full scale (see StrainGaugeDrive)
+};
+
+
+// Background reader that records strain gauge readings into a SampleRing.
+//
+// The thread reads at a fixed interval, which should match the drive's
+// polling interval: the Kinesis DLL only refreshes its reading from the
+// device once per polling interval, so reading faster would record
+// duplicates. Readers (property handlers, or code that retrieves the
+// buffered samples in bulk) never block the thread.
+class StrainGaugeSampler {
+    using Clock = std::chrono::steady_clock;
+
+    StrainGaugeDrive& drive_;
+    std::chrono::milliseconds const interval_;
+    SampleRing<StrainGaugeSample> ring_;
+
+    std::mutex stopMutex_;
+    std::condition_variable stopCv_;
+    bool stopRequested_ = false;
+    std::thread thread_;
+
+public:
+    // The drive must outlive this object
+    StrainGaugeSampler(StrainGaugeDrive& drive,
+        std::chrono::milliseconds interval, size_t capacity);
+    ~StrainGaugeSampler();
+
+    // Noncopyable
+    StrainGaugeSampler(StrainGaugeSampler const&) = delete;
+    StrainGaugeSampler& operator=(StrainGaugeSampler const&) = delete;
+
+    void Start();
+    void Stop();
+
+    // The buffered samples are read through views (see SampleRing)
+    SampleRing<StrainGaugeSample> const& Samples() const { return ring_; }
+
+    // The latest sample; false if none yet
+    bool Latest(StrainGaugeSample& sample) const;
+
+    struct Stats {
+        size_t count = 0;
+        double mean = 0.0;
+        int32_t min = 0;
+        int32_t max = 0;
+    };
+
+    // Statistics of the readings taken within the last window
+    Stats WindowStats(std::chrono::milliseconds window) const;
+
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+    }
+
+private:
+    void Run();
+};
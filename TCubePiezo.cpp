@@ -0,0 +1,59 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "PiezoFamily.h"
+
+#include "Thorlabs.MotionControl.TCube.Piezo.h"
+
+
+namespace {
+    struct TCubePiezoTraits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.TCube.Piezo.dll";
+        }
+        static constexpr bool isMultiChannel = false;
+        static constexpr short maxLUTSamples = 512;
+
+        struct Functions : FunctionTable {
+            KINESIS_DEVICE_FUNCTIONS(PCC);
+            KINESIS_PIEZO_FUNCTIONS(PCC);
+            KINESIS_PIEZO_ENABLE_FUNCTIONS(PCC);
+            KINESIS_PIEZO_LUT_FUNCTIONS(PCC);
+        };
+    };
+} // namespace
+
+
+PiezoFamilyEntry const&
+TCubePiezoFamily() {
+    return PiezoFamily<TCubePiezoTraits>::Entry();
+}
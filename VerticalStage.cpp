@@ -30,186 +30,30 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include "VerticalStage.h"
-
-#include "DLLAccess.h"
+#include "MotorFamily.h"
 
 #include "Thorlabs.MotionControl.VerticalStage.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.VerticalStage.dll" };
-
-
-bool
-VerticalStageAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-VerticalStageAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStageAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-VerticalStage::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_RequestSettings, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_RequestStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-bool
-VerticalStage::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, KVS_StartPolling, func);
-    return func(CSerialNo(), intervalMs);
-}
-
-
-void
-VerticalStage::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_StopPolling, func);
-    func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetHardwareInfo, func);
-    return func(CSerialNo(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-VerticalStage::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_EnableChannel, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_DisableChannel, func);
-    return func(CSerialNo());
-}
-
-
-int
-VerticalStage::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetMotorTravelMode, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, KVS_SetMotorTravelMode, func);
-    return func(CSerialNo(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-VerticalStage::Kinesis_ResetRotationModes() {
-    return 18;
-}
-
-
-short
-VerticalStage::Kinesis_SetRotationModes(int, int) {
-    return 18;
-}
-
-
-short
-VerticalStage::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_RequestPosition, func);
-    return func(CSerialNo());
-}
-
-
-int
-VerticalStage::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetPosition, func);
-    return func(CSerialNo());
-}
-
-
-long
-VerticalStage::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetPositionCounter, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, KVS_MoveToPosition, func);
-    return func(CSerialNo(), index);
-}
-
-
-bool
-VerticalStage::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_CanHome, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_Home, func);
-    return func(CSerialNo());
-}
-
+namespace {
+    struct VerticalStageTraits {
+        static char const* DLLName() {
+            return "Thorlabs.MotionControl.VerticalStage.dll";
+        }
+        static constexpr bool isMultiChannel = false;
 
-short
-VerticalStage::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), deviceUnits, realValue, unitType);
-}
-
-
-short
-VerticalStage::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), realValue, deviceUnits, unitType);
-}
+        struct Functions : FunctionTable {
+            KINESIS_DEVICE_FUNCTIONS(KVS);
+            KINESIS_MOTOR_FUNCTIONS(KVS);
+            KINESIS_ENCODER_FUNCTIONS(KVS);
+            KINESIS_VELOCITY_PARAMS_FUNCTIONS(KVS);
+            KINESIS_MESSAGE_QUEUE_FUNCTIONS(KVS);
+        };
+    };
+} // namespace
 
 
-long
-VerticalStage::Kinesis_GetEncoderCounter() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetEncoderCounter, func);
-    return func(CSerialNo());
+MotorFamilyEntry const&
+VerticalStageFamily() {
+    return MotorFamily<VerticalStageTraits>::Entry();
 }
@@ -0,0 +1,434 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "Wheel.h"
+
+#include <algorithm>
+#include <sstream>
+
+
+namespace {
+    char const* const PROP_SpeedMode = "SpeedMode";
+    char const* const PROPVAL_SpeedModeNormal = "Normal";
+    char const* const PROPVAL_SpeedModeHigh = "High";
+    char const* const PROP_TransitMarginMs = "TransitMarginMs";
+    char const* const PROP_PredictedTransitMs = "PredictedTransitMs";
+    char const* const PROP_TransitModel = "TransitModel";
+
+    int const ERR_SEQUENCE_NOT_CONSECUTIVE = 99998;
+    int const ERR_SEQUENCE_NOT_CYCLIC = 99997;
+
+    // If the polled position does not reach the target by this long after
+    // the predicted transit time, stop reporting busy
+    double const CompletionTimeoutMs = 5000.0;
+
+    // The wheel state is not stored in the controller, so the limit is only
+    // a sanity check
+    long const MaxSequenceLength = 1024;
+}
+
+
+Wheel::Wheel(std::string const& name, std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> connection) :
+    KinesisDriveDevice{ name, serialNo, -1, connection,
+        "Filter wheels" }
+{
+    SetErrorText(ERR_SEQUENCE_NOT_CONSECUTIVE,
+        "Filter wheel sequences must step through consecutive positions "
+        "(the wheel advances one position per trigger)");
+    SetErrorText(ERR_SEQUENCE_NOT_CYCLIC,
+        "Filter wheel sequences must end one position before their first "
+        "position, so that the wheel is back at the start when the sequence "
+        "repeats");
+}
+
+
+Wheel::~Wheel() = default;
+
+
+int
+Wheel::Initialize() {
+    int ret = OpenDrive();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    short err = drive_->RequestStatusBits();
+    if (err)
+        return ERR_OFFSET + err;
+
+    // Start polling, which keeps the position up to date
+    if (!drive_->StartPolling(pollingIntervalMs_)) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+    CDeviceUtils::SleepMs(100); // Ensure the above requests finished
+
+    numPositions_ = drive_->GetPositionCount();
+    if (numPositions_ < 2)
+        numPositions_ = 6;
+    targetPosition_ = drive_->GetPosition();
+
+    transitModels_[FilterWheelDrive::SpeedModeNormal] =
+        MotionModel::ForAxis(serialNo_);
+    transitModels_[FilterWheelDrive::SpeedModeHigh] =
+        MotionModel::ForAxis(serialNo_ + "-HighSpeed");
+
+    CreateIntegerProperty(MM::g_Keyword_State, 0, false,
+        new CPropertyAction(this, &Wheel::OnState));
+    SetPropertyLimits(MM::g_Keyword_State, 0, numPositions_ - 1);
+
+    CreateStringProperty(MM::g_Keyword_Label, "", false,
+        new CPropertyAction(this, &CStateBase::OnLabel));
+    for (int i = 0; i < numPositions_; ++i)
+        SetPositionLabel(i, ("Position-" + std::to_string(i + 1)).c_str());
+
+    if (drive_->HasCapability(FilterWheelDrive::CapabilitiesSpeedMode)) {
+        speedMode_ = drive_->GetSpeedMode();
+        CreateStringProperty(PROP_SpeedMode, PROPVAL_SpeedModeNormal, false,
+            new CPropertyAction(this, &Wheel::OnSpeedMode));
+        AddAllowedValue(PROP_SpeedMode, PROPVAL_SpeedModeNormal);
+        AddAllowedValue(PROP_SpeedMode, PROPVAL_SpeedModeHigh);
+    }
+
+    CreateIntegerProperty(PROP_TransitMarginMs, transitMarginMs_, false,
+        new CPropertyAction(this, &Wheel::OnTransitMarginMs));
+    SetPropertyLimits(PROP_TransitMarginMs, 0, 1000);
+    CreateFloatProperty(PROP_PredictedTransitMs, 0.0, true,
+        new CPropertyAction(this, &Wheel::OnPredictedTransitMs));
+    CreateStringProperty(PROP_TransitModel, "", true,
+        new CPropertyAction(this, &Wheel::OnTransitModel));
+
+    StartRestoringState();
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::Shutdown() {
+    CloseDrive();
+    return DEVICE_OK;
+}
+
+
+bool
+Wheel::Busy() {
+    if (!drive_)
+        return false;
+    // While the device is being reconnected, report busy rather than fail
+    if (stateRestorer_.IsLost())
+        return true;
+    if (stateRestorer_.IsStale() && CheckConnection() != DEVICE_OK)
+        return false; // The restore is retried by the next command
+    if (!movePending_)
+        return false;
+
+    if (CheckArrival() && learnFromMove_)
+        LearnTransitTime();
+    if (arrivalSeen_) {
+        movePending_ = false;
+        return false;
+    }
+
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    if (IsTransitModelTrained() &&
+        msSinceMovementStart >= predictedTransitMs_ + transitMarginMs_) {
+        movePending_ = false;
+        return false;
+    }
+    if (msSinceMovementStart > predictedTransitMs_ + CompletionTimeoutMs) {
+        LogMessage(("Move of serial no " + serialNo_ +
+            " not seen to complete; no longer waiting").c_str());
+        movePending_ = false;
+        return false;
+    }
+    return true;
+}
+
+
+int
+Wheel::OnState(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        // While moving (or if unknown), report the requested position
+        int position = movePending_ ? 0 : drive_->GetPosition();
+        if (position < 1 || position > numPositions_)
+            position = targetPosition_;
+        if (position >= 1 && position <= numPositions_)
+            pProp->Set(long(position - 1));
+    }
+    else if (eAct == MM::AfterSet) {
+        long state;
+        pProp->Get(state);
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        return StartMove(int(state) + 1);
+    }
+    else if (eAct == MM::IsSequenceable) {
+        bool const sequenceable =
+            drive_->HasCapability(FilterWheelDrive::CapabilitiesTriggerMode);
+        pProp->SetSequenceable(sequenceable ? MaxSequenceLength : 0);
+    }
+    else if (eAct == MM::AfterLoadSequence) {
+        return LoadSequence(pProp->GetSequence());
+    }
+    else if (eAct == MM::StartSequence) {
+        return StartSequence();
+    }
+    else if (eAct == MM::StopSequence) {
+        return StopSequence();
+    }
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::OnSpeedMode(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(speedMode_ == FilterWheelDrive::SpeedModeHigh ?
+            PROPVAL_SpeedModeHigh : PROPVAL_SpeedModeNormal);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        auto const mode = value == PROPVAL_SpeedModeHigh ?
+            FilterWheelDrive::SpeedModeHigh : FilterWheelDrive::SpeedModeNormal;
+        int ret = CheckConnection();
+        if (ret != DEVICE_OK)
+            return ret;
+        short err = drive_->SetSpeedMode(mode);
+        if (err)
+            return ERR_OFFSET + err;
+        speedMode_ = mode;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::OnTransitMarginMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(transitMarginMs_);
+    else if (eAct == MM::AfterSet)
+        pProp->Get(transitMarginMs_);
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::OnPredictedTransitMs(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(predictedTransitMs_);
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::OnTransitModel(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        auto const& model = TransitModel();
+        pProp->Set(MotionModel::Format(model.Get(), model.Samples(),
+            model.IsFitted()).c_str());
+    }
+    return DEVICE_OK;
+}
+
+
+MotionModel&
+Wheel::TransitModel() const {
+    return *transitModels_[speedMode_];
+}
+
+
+bool
+Wheel::IsTransitModelTrained() const {
+    // Not just enough moves: until a fit succeeds, the prediction is
+    // MotionModel's default rather than this wheel's transit time
+    return TransitModel().IsFitted();
+}
+
+
+// Positions moved going the shorter way round from one position to another;
+// negative if backward
+long
+Wheel::ShortestDistance(int from, int to) const {
+    long distance = (to - from) % numPositions_;
+    if (distance < 0)
+        distance += numPositions_;
+    if (distance > numPositions_ / 2)
+        distance -= numPositions_;
+    return distance;
+}
+
+
+int
+Wheel::StartMove(int position) {
+    // An arrival not seen by Busy() is not learned from: the wheel may
+    // have been idle for any time since
+    CheckArrival();
+
+    // Learn only from moves that start at rest at a known position
+    int const origin = targetPosition_;
+    bool const fromRest = arrivalSeen_ && origin >= 1 && origin <= numPositions_;
+
+    short err = drive_->MoveToPosition(position);
+    if (err)
+        return ERR_OFFSET + err;
+    lastMovementStart_ = GetCurrentMMTime();
+
+    // Otherwise, predict (for display, and for Busy() once trained) as if
+    // for the longest move
+    moveDistance_ = fromRest ?
+        ShortestDistance(origin, position) : numPositions_ / 2;
+    predictedTransitMs_ = MotionModel::Predict(TransitModel().Get(), moveDistance_);
+    learnFromMove_ = fromRest;
+    targetPosition_ = position;
+    movePending_ = !fromRest || moveDistance_ != 0;
+    arrivalSeen_ = !movePending_;
+    return DEVICE_OK;
+}
+
+
+// If the polled position shows the wheel at the target, mark the move
+// arrived; return true if it was not already
+bool
+Wheel::CheckArrival() {
+    if (arrivalSeen_ || drive_->GetPosition() != targetPosition_)
+        return false;
+    arrivalSeen_ = true;
+    return true;
+}
+
+
+// Record the transit time of the move whose arrival Busy() has just seen,
+// less half a polling interval (the average delay of the status update)
+void
+Wheel::LearnTransitTime() {
+    auto const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    if (!TransitModel().AddSample(moveDistance_,
+            std::max(0.0, msSinceMovementStart - 0.5 * pollingIntervalMs_))) {
+        LogMessage(("Move of serial no " + serialNo_ + " took " +
+            std::to_string(msSinceMovementStart) + " ms, far longer than "
+            "predicted; not used for the transit model").c_str(), true);
+    }
+}
+
+
+int
+Wheel::WaitForMove() {
+    while (Busy())
+        CDeviceUtils::SleepMs(5);
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::LoadSequence(std::vector<std::string> const& sequence) {
+    std::vector<long> states;
+    for (auto const& value : sequence) {
+        std::istringstream stream{ value };
+        long state;
+        if (!(stream >> state) || state < 0 || state >= numPositions_)
+            return DEVICE_INVALID_PROPERTY_VALUE;
+        if (!states.empty() && state != (states.back() + 1) % numPositions_)
+            return ERR_SEQUENCE_NOT_CONSECUTIVE;
+        states.push_back(state);
+    }
+    if (states.empty())
+        return DEVICE_INVALID_INPUT_PARAM;
+    if (long(states.size()) > MaxSequenceLength)
+        return DEVICE_SEQUENCE_TOO_LARGE;
+    // The wheel keeps advancing when the sequence repeats
+    if ((states.back() + 1) % numPositions_ != states.front())
+        return ERR_SEQUENCE_NOT_CYCLIC;
+    sequence_ = std::move(states);
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::StartSequence() {
+    if (sequence_.empty())
+        return DEVICE_INVALID_INPUT_PARAM;
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    // Be at the first position before the first trigger
+    ret = StartMove(int(sequence_.front()) + 1);
+    if (ret != DEVICE_OK)
+        return ret;
+    ret = WaitForMove();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    short err = drive_->SetTriggerMode(FilterWheelDrive::TriggerModeInput);
+    if (err)
+        return ERR_OFFSET + err;
+    return DEVICE_OK;
+}
+
+
+int
+Wheel::StopSequence() {
+    int ret = CheckConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    short err = drive_->SetTriggerMode(FilterWheelDrive::TriggerModeOutput);
+    if (err)
+        return ERR_OFFSET + err;
+
+    // The wheel may have advanced any number of times
+    targetPosition_ = drive_->GetPosition();
+    arrivalSeen_ = true;
+    return DEVICE_OK;
+}
+
+
+// The controller may come back in its default speed mode, while the transit
+// model in use is that of speedMode_; it may also have moved (e.g. homed)
+short
+Wheel::RestoreDeviceState() {
+    short err = drive_->RestoreState();
+    if (err)
+        return err;
+    if (drive_->HasCapability(FilterWheelDrive::CapabilitiesSpeedMode) &&
+        drive_->GetSpeedMode() != speedMode_) {
+        err = drive_->SetSpeedMode(speedMode_);
+        if (err)
+            return err;
+    }
+    targetPosition_ = drive_->GetPosition();
+    movePending_ = false;
+    arrivalSeen_ = true;
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDriveDevice.h"
+#include "MotionModel.h"
+
+#include "DeviceBase.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Filter wheel (FW102C, FW212C) as a state device.
+//
+// Busy() follows a model of the transit time (see MotionModel), in units of
+// filter positions along the shorter way round, so that it does not have to
+// wait for the next status update after the wheel arrives. The model is
+// learned from the arrivals that Busy() sees in the polled position,
+// separately for each speed mode; until it has enough moves, Busy() waits
+// for the polled position to reach the target.
+//
+// The State property is sequenceable when the sequence steps through
+// consecutive positions and ends one position before it starts (so that it
+// can repeat): the wheel is put in trigger input mode and advances one
+// position per trigger pulse (e.g. from the camera at the end of each
+// exposure). If the controller is reconnected (see StateRestorer), the speed
+// and trigger modes are re-applied.
+class Wheel final :
+    public KinesisDriveDevice<CStateDeviceBase, Wheel, FilterWheelDrive> {
+    // Set during Initialize():
+    int numPositions_{ 0 };
+    int pollingIntervalMs_{ 50 };
+    std::array<std::shared_ptr<MotionModel>, 2> transitModels_; // By speed mode
+
+    // Dynamic state:
+    FilterWheelDrive::SpeedMode speedMode_{ FilterWheelDrive::SpeedModeNormal };
+    long transitMarginMs_{ 20 };
+    bool movePending_{ false };
+    bool arrivalSeen_{ true }; // Of the last move
+    bool learnFromMove_{ false };
+    int targetPosition_{ 0 }; // 1-based; zero if unknown
+    long moveDistance_{ 0 }; // Signed, in positions
+    double predictedTransitMs_{ 0.0 };
+    MM::MMTime lastMovementStart_{ 0.0 };
+    std::vector<long> sequence_; // States
+
+public:
+    Wheel(std::string const& name, std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> connection);
+    ~Wheel() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    bool Busy() override;
+
+    unsigned long GetNumberOfPositions() const override {
+        return static_cast<unsigned long>(numPositions_);
+    }
+
+    int OnState(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSpeedMode(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTransitMarginMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnPredictedTransitMs(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTransitModel(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    MotionModel& TransitModel() const;
+    bool IsTransitModelTrained() const;
+    long ShortestDistance(int from, int to) const;
+    int StartMove(int position);
+    bool CheckArrival();
+    void LearnTransitTime();
+    int WaitForMove();
+    int LoadSequence(std::vector<std::string> const& sequence);
+    int StartSequence();
+    int StopSequence();
+    short RestoreDeviceState() override;
+};
@@ -0,0 +1,286 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "XYStage.h"
+
+#include "Errors.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+    char const* const PROP_LastStartSkewUs = "LastStartSkewUs";
+    char const* const PROP_MaxStartSkewUs = "MaxStartSkewUs";
+
+    char const* const AxisPrefixes[] = { "X-", "Y-" };
+
+    std::string AxisName(std::string const& serialNo, short channel) {
+        if (channel < 0)
+            return serialNo;
+        return serialNo + "-" + std::to_string(channel);
+    }
+
+    long ClampToLong(double value) {
+        double const lower = std::numeric_limits<int>::min();
+        double const upper = std::numeric_limits<int>::max();
+        return static_cast<long>(std::min(std::max(value, lower), upper));
+    }
+}
+
+
+char const* const XYStage::NamePrefix = "XYStage";
+
+
+XYStage::XYStage(std::string const& name,
+    std::string const& xSerialNo, short xChannel,
+    std::string const& ySerialNo, short yChannel) :
+    name_{ name }
+{
+    axes_[0] = std::make_unique<SingleAxisStage>(
+        AxisName(xSerialNo, xChannel), xSerialNo, xChannel, nullptr);
+    axes_[1] = std::make_unique<SingleAxisStage>(
+        AxisName(ySerialNo, yChannel), ySerialNo, yChannel, nullptr);
+
+    for (auto const& item : KinesisErrorCodes()) {
+        SetErrorText(ERR_OFFSET + item.first, item.second.c_str());
+    }
+
+    // The axes' pre-init properties (actuator, device units, status and
+    // reconnect settings) become X-<name> and Y-<name>
+    MirrorAxisProperties(true);
+}
+
+
+XYStage::~XYStage() = default;
+
+
+std::string
+XYStage::MakeName(std::string const& xSerialNo, short xChannel,
+    std::string const& ySerialNo, short yChannel) {
+    return std::string{ NamePrefix } + "_" + AxisName(xSerialNo, xChannel) +
+        "_" + AxisName(ySerialNo, yChannel);
+}
+
+
+int
+XYStage::Initialize() {
+    for (int i = 0; i < 2; ++i) {
+        // The axes are not known to MMCore, so they log through this device
+        axes_[i]->SetCallback(GetCoreCallback());
+        std::string const prefix = AxisPrefixes[i];
+        axes_[i]->SetLogSink([this, prefix](std::string const& msg, bool debugOnly) {
+            LogMessage(prefix + "axis: " + msg, debugOnly);
+        });
+
+        int ret = axes_[i]->Initialize();
+        if (ret != DEVICE_OK)
+            return ret;
+    }
+
+    // Capabilities, counters and connection state
+    MirrorAxisProperties(false);
+
+    CreateFloatProperty(PROP_LastStartSkewUs, 0.0, true,
+        new CPropertyActionEx(this, &XYStage::OnStartSkew, 0));
+    CreateFloatProperty(PROP_MaxStartSkewUs, 0.0, true,
+        new CPropertyActionEx(this, &XYStage::OnStartSkew, 1));
+
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::Shutdown() {
+    for (auto& axis : axes_) {
+        axis->Shutdown();
+    }
+    return DEVICE_OK;
+}
+
+
+void
+XYStage::GetName(char* name) const {
+    CDeviceUtils::CopyLimitedString(name, name_.c_str());
+}
+
+
+bool
+XYStage::Busy() {
+    // Ask both axes, so that each notices the end of its own move
+    bool const xBusy = axes_[0]->Busy();
+    bool const yBusy = axes_[1]->Busy();
+    return xBusy || yBusy;
+}
+
+
+int
+XYStage::SetPositionUm(double x, double y) {
+    return SetPositionSteps(
+        ClampToLong(std::round(x * axes_[0]->DeviceUnitsPerUm())),
+        ClampToLong(std::round(y * axes_[1]->DeviceUnitsPerUm())));
+}
+
+
+int
+XYStage::GetPositionUm(double& x, double& y) {
+    int ret = axes_[0]->GetPositionUm(x);
+    if (ret != DEVICE_OK)
+        return ret;
+    return axes_[1]->GetPositionUm(y);
+}
+
+
+int
+XYStage::SetPositionSteps(long x, long y) {
+    using Clock = std::chrono::steady_clock;
+
+    // Issue both moves before doing anything else, so that the axes start
+    // as close together as possible
+    int xRet = axes_[0]->SetPositionSteps(x);
+    auto const xIssued = Clock::now();
+    int yRet = axes_[1]->SetPositionSteps(y);
+    auto const yIssued = Clock::now();
+
+    if (xRet != DEVICE_OK)
+        return xRet;
+    if (yRet != DEVICE_OK)
+        return yRet;
+
+    lastStartSkewUs_ = std::chrono::duration<double, std::micro>(
+        yIssued - xIssued).count();
+    maxStartSkewUs_ = std::max(maxStartSkewUs_, lastStartSkewUs_);
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::GetPositionSteps(long& x, long& y) {
+    int ret = axes_[0]->GetPositionSteps(x);
+    if (ret != DEVICE_OK)
+        return ret;
+    return axes_[1]->GetPositionSteps(y);
+}
+
+
+int
+XYStage::Home() {
+    for (auto& axis : axes_) {
+        if (!axis->CanHome())
+            return DEVICE_UNSUPPORTED_COMMAND;
+    }
+
+    int xRet = axes_[0]->Home();
+    int yRet = axes_[1]->Home();
+    if (xRet != DEVICE_OK)
+        return xRet;
+    return yRet;
+}
+
+
+// Create a property for each of the axes' (pre-init or other) properties,
+// with the same type, allowed values and limits, that reads and writes the
+// axis's property
+void
+XYStage::MirrorAxisProperties(bool preInit) {
+    for (int i = 0; i < 2; ++i) {
+        MM::Device& axis = *axes_[i];
+        for (unsigned p = 0; p < axis.GetNumberOfProperties(); ++p) {
+            char name[MM::MaxStrLength];
+            if (!axis.GetPropertyName(p, name))
+                continue;
+            bool isPreInit = false;
+            axis.GetPropertyInitStatus(name, isPreInit);
+            if (isPreInit != preInit)
+                continue;
+
+            bool readOnly = false;
+            axis.GetPropertyReadOnly(name, readOnly);
+            MM::PropertyType type = MM::String;
+            axis.GetPropertyType(name, type);
+            char value[MM::MaxStrLength] = "";
+            axis.GetProperty(name, value);
+
+            std::string const mirrorName = AxisPrefixes[i] + std::string{ name };
+            long const index = long(axisProperties_.size());
+            axisProperties_.emplace_back(i, name);
+            CreateProperty(mirrorName.c_str(), value, type, readOnly,
+                new CPropertyActionEx(this, &XYStage::OnAxisProperty, index),
+                preInit);
+
+            for (unsigned v = 0; v < axis.GetNumberOfPropertyValues(name); ++v) {
+                char allowed[MM::MaxStrLength];
+                if (axis.GetPropertyValueAt(name, v, allowed))
+                    AddAllowedValue(mirrorName.c_str(), allowed);
+            }
+
+            bool hasLimits = false;
+            axis.HasPropertyLimits(name, hasLimits);
+            if (hasLimits) {
+                double lower = 0.0, upper = 0.0;
+                axis.GetPropertyLowerLimit(name, lower);
+                axis.GetPropertyUpperLimit(name, upper);
+                SetPropertyLimits(mirrorName.c_str(), lower, upper);
+            }
+        }
+    }
+}
+
+
+int
+XYStage::OnAxisProperty(MM::PropertyBase* pProp, MM::ActionType eAct, long index) {
+    auto const& property = axisProperties_[index];
+    MM::Device& axis = *axes_[property.first];
+    if (eAct == MM::BeforeGet) {
+        char value[MM::MaxStrLength];
+        int ret = axis.GetProperty(property.second.c_str(), value);
+        if (ret != DEVICE_OK)
+            return ret;
+        pProp->Set(value);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        return axis.SetProperty(property.second.c_str(), value.c_str());
+    }
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::OnStartSkew(MM::PropertyBase* pProp, MM::ActionType eAct, long which) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(which == 0 ? lastStartSkewUs_ : maxStartSkewUs_);
+    return DEVICE_OK;
+}
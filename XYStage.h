@@ -0,0 +1,119 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "SingleAxisStage.h"
+
+#include "DeviceBase.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// Two motor channels driven as one XY stage, e.g. channels 1 and 2 of a
+// benchtop controller, or two K-Cubes.
+//
+// MMCore moves the X and Y axes of separate stages one after the other,
+// waiting for each to finish. Here both moves are issued back to back, so
+// that a tile-to-tile move takes as long as the slower axis. Busy() is true
+// while either axis is moving.
+//
+// Each axis is a SingleAxisStage, so that actuator selection, homing and
+// limit switch parameters, counters, tracing and reconnection are shared
+// with the single-axis stages. The axes' properties appear here with an X-
+// or Y- prefix.
+//
+// The device name is XYStage_<X>_<Y>, where each axis is a serial number,
+// followed by -<channel> for multi-channel controllers.
+class XYStage final : public CXYStageBase<XYStage> {
+    std::string const name_;
+    std::array<std::unique_ptr<SingleAxisStage>, 2> axes_; // X, Y
+
+    // Properties of the axes that are mirrored here, indexed by the
+    // property action's data: (axis, name)
+    std::vector<std::pair<int, std::string>> axisProperties_;
+
+    // Time from the X move command returning to the Y move command
+    // returning
+    double lastStartSkewUs_{ 0.0 };
+    double maxStartSkewUs_{ 0.0 };
+
+public:
+    static char const* const NamePrefix; // "XYStage"
+
+    XYStage(std::string const& name,
+        std::string const& xSerialNo, short xChannel,
+        std::string const& ySerialNo, short yChannel);
+    ~XYStage() override;
+
+    // Return the device name for the given axes
+    static std::string MakeName(std::string const& xSerialNo, short xChannel,
+        std::string const& ySerialNo, short yChannel);
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    void GetName(char* name) const override;
+    bool Busy() override;
+
+    int SetPositionUm(double x, double y) override;
+    int GetPositionUm(double& x, double& y) override;
+    int SetPositionSteps(long x, long y) override;
+    int GetPositionSteps(long& x, long& y) override;
+    int Home() override;
+    int Stop() override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int SetOrigin() override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int GetLimitsUm(double&, double&, double&, double&) override {
+        return DEVICE_UNSUPPORTED_COMMAND;
+    }
+    int GetStepLimits(long&, long&, long&, long&) override {
+        return DEVICE_UNSUPPORTED_COMMAND;
+    }
+    double GetStepSizeXUm() override { return 1.0 / axes_[0]->DeviceUnitsPerUm(); }
+    double GetStepSizeYUm() override { return 1.0 / axes_[1]->DeviceUnitsPerUm(); }
+
+    // Not sequenceable: the motor controllers cannot step through a list of
+    // positions on a trigger input, so an XY sequence would have to be
+    // played from the computer, which is no faster than MMCore issuing the
+    // moves.
+    int IsXYStageSequenceable(bool& f) const override { f = false; return DEVICE_OK; }
+
+    int OnAxisProperty(MM::PropertyBase* pProp, MM::ActionType eAct, long index);
+    int OnStartSkew(MM::PropertyBase* pProp, MM::ActionType eAct, long which);
+
+private:
+    void MirrorAxisProperties(bool preInit);
+};